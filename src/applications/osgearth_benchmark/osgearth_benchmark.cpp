@@ -0,0 +1,1078 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+/**
+ * Micro-benchmarks for osgEarth core data structures. Each benchmark
+ * prints its throughput; run with --help for the list.
+ */
+#include <osgEarth/Registry>
+#include <osgEarth/TileKey>
+#include <osgEarth/Notify>
+#include <osgEarth/StringUtils>
+#include <osgEarth/TileSource>
+#include <osgEarth/SpatialReference>
+#include <osgEarth/Map>
+#include <osgEarth/ElevationLayer>
+#include <osgEarth/ElevationPool>
+#include <osgEarth/HeightFieldUtils>
+#include <osgEarth/Cache>
+#include <osgEarth/ImageUtils>
+#include <osgEarth/HTTPClient>
+#include <osgEarth/MemCache>
+#include <osgEarth/Memory>
+#include <osgEarthDrivers/gdal/GDALOptions>
+#include <osgEarthDrivers/mbtiles/MBTilesOptions>
+#include <osgEarthFeatures/FeatureListSource>
+#include <osgEarthFeatures/FeatureCursor>
+#include <osgEarthSymbology/Geometry>
+#include <osg/ArgumentParser>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+
+#define LC "[benchmark] "
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+// Counts heap allocations, for benchmarks that report allocations per
+// operation. Replacing the global operator new in the executable covers the
+// osgEarth libraries too on platforms with symbol interposition (not Windows).
+// Counting is off unless a benchmark turns it on before starting any threads,
+// so the others don't pay for a shared atomic on every allocation.
+static bool s_countAllocations = false;
+static OpenThreads::Atomic s_numAllocations;
+
+void* operator new(std::size_t size)
+{
+    if ( s_countAllocations )
+        ++s_numAllocations;
+    void* ptr = std::malloc(size > 0 ? size : 1);
+    if ( !ptr )
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr)
+{
+    std::free(ptr);
+}
+
+namespace
+{
+    /** Simple stopwatch reporting operations per second. */
+    struct Stopwatch
+    {
+        Stopwatch(const std::string& name) : _name(name), _start(osg::Timer::instance()->tick()) { }
+
+        void report(unsigned ops)
+        {
+            double s = osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+            OE_NOTICE << LC << _name << ": " << ops << " ops in " << s << " s = "
+                << (s > 0.0 ? (double)ops/s : 0.0) << " ops/s" << std::endl;
+        }
+
+        std::string  _name;
+        osg::Timer_t _start;
+    };
+
+    int usage(const char* name)
+    {
+        std::cout
+            << "Usage: " << name << " <benchmark> [options]\n\n"
+            << "  --memcache [--tiles n] [--hits n] [--clone|--shared]\n"
+            << "                             Hit latency and memory of cloning vs. shared MemCache bins\n"
+            << "  --tilekey [--count n]      TileKey creation, derivation and map lookup\n"
+            << "  --gdal <file> [--lod n] [--threads n] [--elevation]\n"
+            << "                             Concurrent tile reads from a GDAL dataset\n"
+            << "  --srs [--points n] [--threads n] [--from srs] [--to srs]\n"
+            << "                             Concurrent point transforms through OGR\n"
+            << "  --elevation-pool [--tracks n] [--frames n] [--lod n]\n"
+            << "                             Track clamping through the ElevationPool at 1, 4 and 16 threads\n"
+            << "  --cache <driver> <path> [--count n] [--max-size-mb n] [--threads n]\n"
+            << "                             Tile writes and cache-hit latency through a cache driver;\n"
+            << "                             use \"compare\" as the driver to run filesystem, leveldb\n"
+            << "                             and packfile on the same workload\n"
+            << "  --mbtiles <file> [--count n] [--threads n] [--bulk]\n"
+            << "                             Seeds a new MBTiles file with PNG tiles; --bulk uses batched writes\n"
+            << "  --http <url> [--count n] [--threads n] [--connections n]\n"
+            << "                             Fetches <url>/0 .. <url>/n-1 with blocking reads on n threads,\n"
+            << "                             then through HTTPClient::readAsync; reports heap allocations per request\n"
+            << "  --features [--count n] [--queries n]\n"
+            << "                             Bounded queries on a FeatureListSource of 10k, 100k and 1M points\n"
+            << "                             (or n), through the spatial index and by a full scan\n"
+            << "  --crop [--count n] [--threads n]\n"
+            << "                             Crops n polygons to a tile rectangle with Geometry::crop, per polygon\n"
+            << "                             and through a PreparedCropPolygon (requires GEOS)\n"
+            << std::endl;
+        return 0;
+    }
+
+    //........................................................................
+
+    /**
+     * Fills a MemCache bin with 256x256 RGBA tiles, then reads them back
+     * the way ImageLayer does, holding on to each result to mimic the terrain
+     * engine keeping the tile's texture alive.
+     */
+    void benchMemCacheMode(bool share, unsigned numTiles, unsigned numHits)
+    {
+        unsigned rss0 = Memory::getProcessPhysicalUsage();
+
+        osg::ref_ptr<MemCache> cache = new MemCache(numTiles);
+        cache->setShareObjects(share);
+        CacheBin* bin = cache->getOrCreateDefaultBin();
+
+        for(unsigned i=0; i<numTiles; ++i)
+        {
+            osg::ref_ptr<osg::Image> image = ImageUtils::createEmptyImage(256, 256);
+            bin->write(Stringify() << "tile_" << i, image.get(), 0L);
+        }
+
+        std::vector< osg::ref_ptr<osg::Image> > inUse(numTiles);
+
+        Stopwatch sw(share ? "MemCache hit (shared)" : "MemCache hit (cloning)");
+        for(unsigned i=0; i<numHits; ++i)
+        {
+            unsigned k = i % numTiles;
+            ReadResult r = bin->readImage(Stringify() << "tile_" << k, 0L);
+            inUse[k] = r.releaseImage();
+        }
+        sw.report(numHits);
+
+        unsigned rss1 = Memory::getProcessPhysicalUsage();
+        OE_NOTICE << LC << "  RSS delta = " << ((rss1 > rss0 ? rss1-rss0 : 0u)/1048576u) << " MB" << std::endl;
+    }
+
+    int benchMemCache(osg::ArgumentParser& args)
+    {
+        unsigned numTiles = 256, numHits = 100000;
+        args.read("--tiles", numTiles);
+        args.read("--hits", numHits);
+        if ( numTiles == 0 || numHits == 0 )
+        {
+            OE_WARN << LC << "Tile and hit counts must be non-zero" << std::endl;
+            return -1;
+        }
+
+        // run one mode per process for an accurate RSS reading
+        bool shared = args.read("--shared");
+        bool clone  = args.read("--clone");
+        if ( clone || !shared )
+            benchMemCacheMode(false, numTiles, numHits);
+        if ( shared || !clone )
+            benchMemCacheMode(true,  numTiles, numHits);
+        return 0;
+    }
+
+    //........................................................................
+
+    int benchTileKey(osg::ArgumentParser& args)
+    {
+        unsigned count = 1000000;
+        args.read("--count", count);
+
+        const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+        const unsigned lod = 14;
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+
+        // key creation
+        unsigned sum = 0;
+        {
+            Stopwatch sw("TileKey create");
+            for(unsigned i=0; i<count; ++i)
+            {
+                TileKey key(lod, i % tx, (i / tx) % ty, profile);
+                sum += key.getTileX();
+            }
+            sw.report(count);
+        }
+
+        // parent/child/neighbor derivation
+        {
+            TileKey key(lod, tx/2, ty/2, profile);
+            Stopwatch sw("TileKey derive (parent+child+neighbor)");
+            for(unsigned i=0; i<count; ++i)
+            {
+                TileKey parent = key.createParentKey();
+                TileKey child  = parent.createChildKey(i & 3);
+                key = child.createNeighborKey(1, 0);
+            }
+            sw.report(count*3);
+        }
+
+        // map insert and lookup
+        {
+            TileKeyMap<unsigned>::type map;
+            const unsigned numKeys = std::min(count, 100000u);
+            std::vector<TileKey> keys;
+            keys.reserve(numKeys);
+            for(unsigned i=0; i<numKeys; ++i)
+                keys.push_back(TileKey(lod, (i*7919u) % tx, (i*104729u) % ty, profile));
+
+            Stopwatch insert("TileKeyMap insert");
+            for(unsigned i=0; i<numKeys; ++i)
+                map[keys[i]] = i;
+            insert.report(numKeys);
+
+            Stopwatch lookup("TileKeyMap lookup");
+            for(unsigned i=0; i<count; ++i)
+                sum += map.find(keys[i % numKeys]) != map.end() ? 1u : 0u;
+            lookup.report(count);
+        }
+
+        // string formatting, now only paid on request
+        {
+            TileKey key(lod, tx/3, ty/3, profile);
+            Stopwatch sw("TileKey str()");
+            for(unsigned i=0; i<count; ++i)
+                sum += key.str().size();
+            sw.report(count);
+        }
+
+        OE_DEBUG << LC << "checksum " << sum << std::endl;
+        return 0;
+    }
+
+    //........................................................................
+
+    /** Repeatedly transforms a batch of points between two SRS's. */
+    struct TransformThread : public OpenThreads::Thread
+    {
+        TransformThread(const SpatialReference* from, const SpatialReference* to, const std::vector<osg::Vec3d>& points, unsigned passes) :
+            _from(from), _to(to), _points(points), _passes(passes), _count(0u) { }
+
+        void run()
+        {
+            std::vector<osg::Vec3d> work;
+            for(unsigned p=0; p<_passes; ++p)
+            {
+                work = _points;
+                if ( _from->transform(work, _to) )
+                    _count += work.size();
+            }
+        }
+
+        const SpatialReference*         _from;
+        const SpatialReference*         _to;
+        const std::vector<osg::Vec3d>&  _points;
+        unsigned                        _passes;
+        unsigned                        _count;
+    };
+
+    int benchSRS(osg::ArgumentParser& args)
+    {
+        unsigned numPoints = 1000000, maxThreads = OpenThreads::GetNumberOfProcessors();
+        std::string fromInit = "wgs84", toInit = "+proj=utm +zone=33 +datum=WGS84";
+        args.read("--points", numPoints);
+        args.read("--threads", maxThreads);
+        args.read("--from", fromInit);
+        args.read("--to", toInit);
+
+        osg::ref_ptr<const SpatialReference> from = SpatialReference::get(fromInit);
+        osg::ref_ptr<const SpatialReference> to = SpatialReference::get(toInit);
+        if ( !from.valid() || !to.valid() )
+        {
+            OE_WARN << LC << "Invalid SRS" << std::endl;
+            return -1;
+        }
+
+        // batches the size of a typical feature or tile grid:
+        const unsigned batchSize = 1024;
+        std::vector<osg::Vec3d> points(batchSize);
+        for(unsigned i=0; i<batchSize; ++i)
+            points[i].set(12.0 + 5.0*(double)(i%32)/32.0, 40.0 + 10.0*(double)(i/32)/32.0, 0.0);
+
+        for(unsigned numThreads=1; numThreads <= maxThreads; numThreads *= 2)
+        {
+            // same total work at every thread count:
+            unsigned passes = std::max(1u, numPoints / (batchSize*numThreads));
+
+            std::vector<TransformThread*> threads;
+            for(unsigned t=0; t<numThreads; ++t)
+                threads.push_back(new TransformThread(from.get(), to.get(), points, passes));
+
+            Stopwatch sw(Stringify() << "SRS transform, " << numThreads << " thread(s)");
+            for(unsigned t=0; t<numThreads; ++t)
+                threads[t]->start();
+
+            unsigned count = 0;
+            for(unsigned t=0; t<numThreads; ++t)
+            {
+                threads[t]->join();
+                count += threads[t]->_count;
+                delete threads[t];
+            }
+            sw.report(count);
+        }
+        return 0;
+    }
+
+    //........................................................................
+
+    /** Elevation layer that computes a smooth surface, so the benchmark measures the pool and not a data source. */
+    class SyntheticElevationLayer : public ElevationLayer
+    {
+    public:
+        SyntheticElevationLayer()
+        {
+            setTileSourceExpected(false);
+            setProfile(Profile::create("global-geodetic"));
+        }
+
+    protected:
+        virtual void createImplementation(const TileKey& key, osg::ref_ptr<osg::HeightField>& out_hf, osg::ref_ptr<NormalMap>& out_normalMap, ProgressCallback* progress)
+        {
+            const GeoExtent& ex = key.getExtent();
+            osg::HeightField* hf = HeightFieldUtils::createReferenceHeightField(ex, getTileSize(), getTileSize(), 0u);
+            for(unsigned row=0; row<hf->getNumRows(); ++row)
+            {
+                double y = ex.yMin() + ex.height()*(double)row/(double)(hf->getNumRows()-1);
+                for(unsigned col=0; col<hf->getNumColumns(); ++col)
+                {
+                    double x = ex.xMin() + ex.width()*(double)col/(double)(hf->getNumColumns()-1);
+                    hf->setHeight(col, row, 1000.0f*(float)(sin(osg::DegreesToRadians(x)*20.0)*cos(osg::DegreesToRadians(y)*20.0)));
+                }
+            }
+            out_hf = hf;
+        }
+    };
+
+    /** Clamps a set of moving tracks, one envelope query per frame. */
+    struct ClampThread : public OpenThreads::Thread
+    {
+        ClampThread(ElevationPool* pool, const std::vector<osg::Vec3d>& tracks, unsigned frames, unsigned lod) :
+            _pool(pool), _tracks(tracks), _frames(frames), _lod(lod), _count(0u) { }
+
+        void run()
+        {
+            const SpatialReference* wgs84 = SpatialReference::get("wgs84");
+            std::vector<osg::Vec3d> points(_tracks);
+            std::vector<float> elevations;
+            for(unsigned f=0; f<_frames; ++f)
+            {
+                for(unsigned i=0; i<points.size(); ++i)
+                    points[i].x() = _tracks[i].x() + 0.001*(double)f;
+
+                osg::ref_ptr<ElevationEnvelope> envelope = _pool->createEnvelope(wgs84, _lod);
+                _count += envelope->getElevations(points, elevations);
+            }
+        }
+
+        ElevationPool*                  _pool;
+        const std::vector<osg::Vec3d>&  _tracks;
+        unsigned                        _frames, _lod;
+        unsigned                        _count;
+    };
+
+    int benchElevationPool(osg::ArgumentParser& args)
+    {
+        unsigned numTracks = 5000, frames = 50, lod = 8;
+        args.read("--tracks", numTracks);
+        args.read("--frames", frames);
+        args.read("--lod", lod);
+
+        osg::ref_ptr<Map> map = new Map();
+        map->addLayer(new SyntheticElevationLayer());
+        ElevationPool* pool = map->getElevationPool();
+
+        // tracks scattered over a region a few tiles across:
+        std::vector<osg::Vec3d> tracks(numTracks);
+        for(unsigned i=0; i<numTracks; ++i)
+            tracks[i].set(10.0 + 5.0*(double)((i*7919u) % 1000u)/1000.0, 40.0 + 5.0*(double)((i*104729u) % 1000u)/1000.0, 0.0);
+
+        const unsigned threadCounts[3] = { 1u, 4u, 16u };
+        for(unsigned c=0; c<3; ++c)
+        {
+            // same total work at every thread count:
+            unsigned numThreads = threadCounts[c];
+            unsigned threadFrames = std::max(1u, frames*4u / numThreads);
+
+            std::vector<ClampThread*> threads;
+            for(unsigned t=0; t<numThreads; ++t)
+                threads.push_back(new ClampThread(pool, tracks, threadFrames, lod));
+
+            Stopwatch sw(Stringify() << "ElevationPool clamp, " << numThreads << " thread(s)");
+            for(unsigned t=0; t<numThreads; ++t)
+                threads[t]->start();
+
+            unsigned count = 0;
+            for(unsigned t=0; t<numThreads; ++t)
+            {
+                threads[t]->join();
+                count += threads[t]->_count;
+                delete threads[t];
+            }
+            sw.report(count);
+        }
+        return 0;
+    }
+
+    //........................................................................
+
+    /** Reads every Nth key in a list from a tile source. */
+    struct TileReadThread : public OpenThreads::Thread
+    {
+        TileReadThread(TileSource* source, const std::vector<TileKey>& keys, unsigned first, unsigned stride, bool elevation) :
+            _source(source), _keys(keys), _first(first), _stride(stride), _elevation(elevation), _count(0u) { }
+
+        void run()
+        {
+            for(unsigned i=_first; i<_keys.size(); i += _stride)
+            {
+                if ( _elevation )
+                {
+                    osg::ref_ptr<osg::HeightField> hf = _source->createHeightField(_keys[i]);
+                    if ( hf.valid() ) ++_count;
+                }
+                else
+                {
+                    osg::ref_ptr<osg::Image> image = _source->createImage(_keys[i]);
+                    if ( image.valid() ) ++_count;
+                }
+            }
+        }
+
+        TileSource*                 _source;
+        const std::vector<TileKey>& _keys;
+        unsigned                    _first, _stride;
+        bool                        _elevation;
+        unsigned                    _count;
+    };
+
+    int benchGDAL(const std::string& file, osg::ArgumentParser& args)
+    {
+        unsigned lod = 8, maxThreads = OpenThreads::GetNumberOfProcessors();
+        args.read("--lod", lod);
+        args.read("--threads", maxThreads);
+        bool elevation = args.read("--elevation");
+
+        GDALOptions options;
+        options.url() = file;
+        options.L2CacheSize() = 0; // measure the driver, not the memory cache
+
+        osg::ref_ptr<TileSource> source = TileSourceFactory::create(options);
+        if ( !source.valid() || source->open().isError() )
+        {
+            OE_WARN << LC << "Failed to open " << file << std::endl;
+            return -1;
+        }
+
+        // every key at the requested LOD that intersects the data:
+        std::vector<TileKey> keys;
+        const Profile* profile = source->getProfile();
+        const DataExtentList& extents = source->getDataExtents();
+        unsigned tx, ty;
+        profile->getNumTiles(lod, tx, ty);
+        for(unsigned y=0; y<ty; ++y)
+        {
+            for(unsigned x=0; x<tx; ++x)
+            {
+                TileKey key(lod, x, y, profile);
+                bool hasData = extents.empty();
+                for(DataExtentList::const_iterator e = extents.begin(); e != extents.end() && !hasData; ++e)
+                    hasData = e->intersects(key.getExtent());
+                if ( hasData )
+                    keys.push_back(key);
+            }
+        }
+        OE_NOTICE << LC << keys.size() << " tiles at LOD " << lod << std::endl;
+
+        // each pass re-reads the same keys with twice as many threads:
+        for(unsigned numThreads=1; numThreads <= maxThreads; numThreads *= 2)
+        {
+            std::vector<TileReadThread*> threads;
+            for(unsigned t=0; t<numThreads; ++t)
+                threads.push_back(new TileReadThread(source.get(), keys, t, numThreads, elevation));
+
+            Stopwatch sw(Stringify() << "GDAL " << (elevation ? "heightfields" : "images") << ", " << numThreads << " thread(s)");
+            for(unsigned t=0; t<numThreads; ++t)
+                threads[t]->start();
+
+            unsigned count = 0;
+            for(unsigned t=0; t<numThreads; ++t)
+            {
+                threads[t]->join();
+                count += threads[t]->_count;
+                delete threads[t];
+            }
+            sw.report(count);
+        }
+        return 0;
+    }
+    //........................................................................
+
+    struct CacheReadThread : public OpenThreads::Thread
+    {
+        CacheReadThread(CacheBin* bin, const std::vector<std::string>& keys, unsigned pass, unsigned first, unsigned stride) :
+            _bin(bin), _keys(keys), _pass(pass), _first(first), _stride(stride), _hits(0u) { }
+
+        void run()
+        {
+            unsigned count = _keys.size();
+            for(unsigned i=_first; i<count; i += _stride)
+            {
+                unsigned k = _pass == 0 ? i : (i * 7919u) % count;
+                ReadResult r = _bin->readImage(_keys[k], 0L);
+                if ( r.succeeded() )
+                    ++_hits;
+            }
+        }
+
+        CacheBin*                       _bin;
+        const std::vector<std::string>& _keys;
+        unsigned                        _pass, _first, _stride;
+        unsigned                        _hits;
+    };
+
+    int benchCache(const std::string& driver, const std::string& path, unsigned count, unsigned maxSizeMB, unsigned numThreads)
+    {
+        Config conf("cache");
+        conf.set("driver", driver);
+        conf.set("path", path);
+        if ( maxSizeMB > 0 )
+            conf.set("max_size_mb", maxSizeMB);
+
+        osg::ref_ptr<Cache> cache = CacheFactory::create(CacheOptions(ConfigOptions(conf)));
+        if ( !cache.valid() || cache->isOK() == false )
+        {
+            OE_WARN << LC << "Failed to open a \"" << driver << "\" cache at " << path << std::endl;
+            return -1;
+        }
+
+        osg::ref_ptr<CacheBin> bin = cache->openBin("benchmark");
+        if ( !bin.valid() )
+            return -1;
+
+        // 256x256 RGBA tiles with a little variation so they don't all compress alike:
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        {
+            Stopwatch sw(Stringify() << "Cache \"" << driver << "\" write");
+            for(unsigned i=0; i<count; ++i)
+            {
+                osg::ref_ptr<osg::Image> image = ImageUtils::createEmptyImage(256, 256);
+                unsigned char* data = image->data();
+                for(unsigned b=0; b<image->getTotalSizeInBytes(); ++b)
+                    data[b] = (unsigned char)((b * (i+1)) >> 8);
+
+                keys.push_back(Stringify() << "tile_" << i);
+                bin->write(keys.back(), image.get(), Config(), 0L);
+            }
+            cache->flush();
+            sw.report(count);
+        }
+
+        // every read is a hit; the second pass reads in a different order.
+        for(unsigned pass=0; pass<2; ++pass)
+        {
+            std::vector<CacheReadThread*> threads;
+            for(unsigned t=0; t<numThreads; ++t)
+                threads.push_back(new CacheReadThread(bin.get(), keys, pass, t, numThreads));
+
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            for(unsigned t=0; t<numThreads; ++t)
+                threads[t]->start();
+
+            unsigned hits = 0;
+            for(unsigned t=0; t<numThreads; ++t)
+            {
+                threads[t]->join();
+                hits += threads[t]->_hits;
+                delete threads[t];
+            }
+
+            double s = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            OE_NOTICE << LC << "Cache \"" << driver << "\" hits (pass " << (pass+1) << ", "
+                << numThreads << " thread(s)): "
+                << hits << "/" << count << ", "
+                << (hits > 0 ? 1e6*s/(double)hits : 0.0) << " us/hit, "
+                << (s > 0.0 ? (double)hits/s : 0.0) << " hits/s" << std::endl;
+        }
+        return 0;
+    }
+
+    int benchCache(const std::string& driver, const std::string& path, osg::ArgumentParser& args)
+    {
+        unsigned count = 10000, maxSizeMB = 0, numThreads = 1;
+        args.read("--count", count);
+        args.read("--max-size-mb", maxSizeMB);
+        args.read("--threads", numThreads);
+        numThreads = osg::maximum(numThreads, 1u);
+
+        if ( driver != "compare" )
+            return benchCache(driver, path, count, maxSizeMB, numThreads);
+
+        // the same workload through each driver, each in its own folder:
+        const char* drivers[] = { "filesystem", "leveldb", "packfile" };
+        int result = 0;
+        for(unsigned d=0; d<3; ++d)
+        {
+            if ( benchCache(drivers[d], osgDB::concatPaths(path, drivers[d]), count, maxSizeMB, numThreads) != 0 )
+                result = -1;
+        }
+        return result;
+    }
+    //........................................................................
+
+    struct TileWriteThread : public OpenThreads::Thread
+    {
+        TileWriteThread(TileSource* dest, const std::vector<TileKey>& keys, const std::vector< osg::ref_ptr<osg::Image> >& images, unsigned first, unsigned stride) :
+            _dest(dest), _keys(keys), _images(images), _first(first), _stride(stride), _count(0u) { }
+
+        void run()
+        {
+            for(unsigned i=_first; i<_keys.size(); i += _stride)
+            {
+                if ( _dest->storeImage(_keys[i], _images[i % _images.size()].get(), 0L) )
+                    ++_count;
+            }
+        }
+
+        TileSource*                                     _dest;
+        const std::vector<TileKey>&                     _keys;
+        const std::vector< osg::ref_ptr<osg::Image> >& _images;
+        unsigned                                        _first, _stride;
+        unsigned                                        _count;
+    };
+
+    int benchMBTiles(const std::string& file, osg::ArgumentParser& args)
+    {
+        unsigned count = 20000, numThreads = OpenThreads::GetNumberOfProcessors();
+        args.read("--count", count);
+        args.read("--threads", numThreads);
+        numThreads = osg::maximum(numThreads, 1u);
+        bool bulk = args.read("--bulk");
+
+        if ( osgDB::fileExists(file) )
+        {
+            OE_WARN << LC << file << " already exists; the benchmark needs a new file" << std::endl;
+            return -1;
+        }
+
+        MBTilesTileSourceOptions options;
+        options.filename() = file;
+        options.format() = "png";
+        options.bulkWrite() = bulk;
+        options.profile() = ProfileOptions("spherical-mercator");
+
+        osg::ref_ptr<TileSource> dest = TileSourceFactory::create(options);
+        if ( !dest.valid() || dest->open(TileSource::MODE_WRITE | TileSource::MODE_CREATE).isError() )
+        {
+            OE_WARN << LC << "Failed to create " << file << std::endl;
+            return -1;
+        }
+
+        // a few distinct tiles, so the encoder can't cheat:
+        std::vector< osg::ref_ptr<osg::Image> > images;
+        for(unsigned i=0; i<16; ++i)
+        {
+            osg::Image* image = ImageUtils::createEmptyImage(256, 256);
+            unsigned char* data = image->data();
+            for(unsigned b=0; b<image->getTotalSizeInBytes(); ++b)
+                data[b] = (unsigned char)((b * (i+1)) >> 6);
+            images.push_back(image);
+        }
+
+        const unsigned lod = 12;
+        unsigned tx, ty;
+        dest->getProfile()->getNumTiles(lod, tx, ty);
+        std::vector<TileKey> keys;
+        keys.reserve(count);
+        for(unsigned i=0; i<count && i<tx*ty; ++i)
+            keys.push_back(TileKey(lod, i % tx, i / tx, dest->getProfile()));
+
+        Stopwatch sw(Stringify() << "MBTiles " << (bulk ? "bulk" : "single-row") << " writes, " << numThreads << " thread(s)");
+
+        std::vector<TileWriteThread*> threads;
+        for(unsigned t=0; t<numThreads; ++t)
+            threads.push_back(new TileWriteThread(dest.get(), keys, images, t, numThreads));
+        for(unsigned t=0; t<numThreads; ++t)
+            threads[t]->start();
+
+        unsigned written = 0;
+        for(unsigned t=0; t<numThreads; ++t)
+        {
+            threads[t]->join();
+            written += threads[t]->_count;
+            delete threads[t];
+        }
+
+        // closing commits any queued tiles and builds the index.
+        dest = 0L;
+        sw.report(written);
+        return 0;
+    }
+    //........................................................................
+
+    /** Prints throughput, median/99th percentile transfer times and heap allocations per request. */
+    void reportHTTP(const std::string& name, unsigned ok, unsigned count, double s, std::vector<double>& durations, unsigned allocations)
+    {
+        std::sort(durations.begin(), durations.end());
+        double p50 = durations.empty() ? 0.0 : durations[durations.size()/2];
+        double p99 = durations.empty() ? 0.0 : durations[(durations.size()*99)/100];
+        OE_NOTICE << LC << name << ": " << ok << "/" << count << " ok, "
+            << (s > 0.0 ? (double)count/s : 0.0) << " req/s, "
+            << "p50 " << 1e3*p50 << " ms, p99 " << 1e3*p99 << " ms, "
+            << (count > 0 ? (double)allocations/(double)count : 0.0) << " allocations/req" << std::endl;
+    }
+
+    /** Fetches every Nth URL in a list with blocking reads. */
+    struct HTTPReadThread : public OpenThreads::Thread
+    {
+        HTTPReadThread(const std::vector<std::string>& urls, unsigned first, unsigned stride) :
+            _urls(urls), _first(first), _stride(stride), _ok(0u) { }
+
+        void run()
+        {
+            for(unsigned i=_first; i<_urls.size(); i += _stride)
+            {
+                HTTPResponse response = HTTPClient::get(_urls[i]);
+                if ( response.isOK() )
+                    ++_ok;
+                _durations.push_back(response.getDuration());
+            }
+        }
+
+        const std::vector<std::string>& _urls;
+        unsigned                        _first, _stride;
+        unsigned                        _ok;
+        std::vector<double>             _durations;
+    };
+
+    int benchHTTP(const std::string& url, osg::ArgumentParser& args)
+    {
+        unsigned count = 1000, numThreads = 8;
+        int connections = HTTPClient::getMaxAsyncHostConnections();
+        args.read("--count", count);
+        args.read("--threads", numThreads);
+        args.read("--connections", connections);
+        numThreads = osg::maximum(numThreads, 1u);
+        HTTPClient::setMaxAsyncHostConnections(connections);
+
+        std::vector<std::string> urls;
+        urls.reserve(count);
+        for(unsigned i=0; i<count; ++i)
+            urls.push_back(Stringify() << url << "/" << i);
+
+        // blocking reads, one transfer per thread at a time:
+        {
+            std::vector<HTTPReadThread*> threads;
+            for(unsigned t=0; t<numThreads; ++t)
+                threads.push_back(new HTTPReadThread(urls, t, numThreads));
+
+            unsigned allocations = s_numAllocations;
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            for(unsigned t=0; t<numThreads; ++t)
+                threads[t]->start();
+
+            unsigned ok = 0;
+            std::vector<double> durations;
+            for(unsigned t=0; t<numThreads; ++t)
+            {
+                threads[t]->join();
+                ok += threads[t]->_ok;
+                durations.insert(durations.end(), threads[t]->_durations.begin(), threads[t]->_durations.end());
+                delete threads[t];
+            }
+
+            double s = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            allocations = s_numAllocations - allocations;
+            reportHTTP(Stringify() << "HTTP blocking, " << numThreads << " thread(s)", ok, count, s, durations, allocations);
+        }
+
+        // everything in flight at once through the shared engine:
+        {
+            unsigned allocations = s_numAllocations;
+            osg::Timer_t start = osg::Timer::instance()->tick();
+
+            std::vector< Threading::Future<AsyncReadResult> > futures;
+            futures.reserve(count);
+            for(unsigned i=0; i<count; ++i)
+                futures.push_back(HTTPClient::readAsync(HTTPRequest(urls[i]), AsyncReadResult::STRING));
+
+            unsigned ok = 0;
+            std::vector<double> durations;
+            for(unsigned i=0; i<count; ++i)
+            {
+                osg::ref_ptr<AsyncReadResult> result = futures[i].get();
+                if ( !result.valid() )
+                    continue;
+                if ( result->getResponse().isOK() )
+                    ++ok;
+                durations.push_back(result->getResponse().getDuration());
+            }
+
+            double s = osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick());
+            allocations = s_numAllocations - allocations;
+            reportHTTP(Stringify() << "HTTP async, " << connections << " connection(s) per host", ok, count, s, durations, allocations);
+        }
+        return 0;
+    }
+    //........................................................................
+
+    int benchFeatures(osg::ArgumentParser& args)
+    {
+        std::vector<unsigned> sizes;
+        unsigned count = 0, numQueries = 1000;
+        if ( args.read("--count", count) )
+            sizes.push_back(count);
+        else
+        {
+            sizes.push_back(10000);
+            sizes.push_back(100000);
+            sizes.push_back(1000000);
+        }
+        args.read("--queries", numQueries);
+        numQueries = osg::maximum(numQueries, 1u);
+
+        const SpatialReference* srs = SpatialReference::get("wgs84");
+
+        // query windows of 2 x 1 degrees scattered over the globe:
+        std::vector<Bounds> windows;
+        for(unsigned i=0; i<numQueries; ++i)
+        {
+            double x = -180.0 + (double)((i*7919u) % 358u);
+            double y = -90.0 + (double)((i*104729u) % 179u);
+            windows.push_back(Bounds(x, y, x+2.0, y+1.0));
+        }
+
+        for(unsigned s=0; s<sizes.size(); ++s)
+        {
+            unsigned size = sizes[s];
+
+            osg::ref_ptr<FeatureListSource> source = new FeatureListSource();
+            source->setCloneFeatures(false);
+            for(unsigned i=0; i<size; ++i)
+            {
+                PointSet* point = new PointSet();
+                point->push_back(osg::Vec3d(
+                    -180.0 + 360.0*(double)((i*2654435761u) % 1000003u)/1000003.0,
+                     -90.0 + 180.0*(double)((i*40503u) % 999983u)/999983.0,
+                    0.0));
+                source->getFeatures().push_back(new Feature(point, srs));
+            }
+            source->dirty();
+
+            unsigned hits = 0;
+
+            // the first bounded query builds the index:
+            {
+                Stopwatch sw(Stringify() << "FeatureListSource " << size << " features, index build + first query");
+                Query query;
+                query.bounds() = windows[0];
+                osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(query);
+                while( cursor->hasMore() )
+                    hits += cursor->nextFeature() ? 1u : 0u;
+                sw.report(1);
+            }
+
+            {
+                Stopwatch sw(Stringify() << "FeatureListSource " << size << " features, indexed queries");
+                for(unsigned i=0; i<numQueries; ++i)
+                {
+                    Query query;
+                    query.bounds() = windows[i];
+                    osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(query);
+                    while( cursor->hasMore() )
+                        hits += cursor->nextFeature() ? 1u : 0u;
+                }
+                sw.report(numQueries);
+            }
+
+            // what a caller had to do before: walk every feature and test its bounds.
+            // Capped at about 10M feature visits so the 1M case finishes.
+            {
+                unsigned scans = osg::clampBetween(10000000u / osg::maximum(size, 1u), 1u, numQueries);
+                Stopwatch sw(Stringify() << "FeatureListSource " << size << " features, full scans");
+                for(unsigned i=0; i<scans; ++i)
+                {
+                    osg::ref_ptr<FeatureCursor> cursor = source->createFeatureCursor(Query());
+                    while( cursor->hasMore() )
+                    {
+                        Feature* feature = cursor->nextFeature();
+                        const osg::Vec3d& p = feature->getGeometry()->front();
+                        if ( p.x() >= windows[i].xMin() && p.x() <= windows[i].xMax() &&
+                             p.y() >= windows[i].yMin() && p.y() <= windows[i].yMax() )
+                            ++hits;
+                    }
+                }
+                sw.report(scans);
+            }
+
+            OE_DEBUG << LC << "checksum " << hits << std::endl;
+        }
+        return 0;
+    }
+    //........................................................................
+
+    /** Crops every Nth geometry in a list to a rectangle, like the CropFilter does for a tile. */
+    struct CropThread : public OpenThreads::Thread
+    {
+        CropThread(const std::vector< osg::ref_ptr<Symbology::Geometry> >& geoms, const Symbology::Polygon* rect, bool prepared, unsigned first, unsigned stride) :
+            _geoms(geoms), _rect(rect), _prepared(prepared), _first(first), _stride(stride), _count(0u) { }
+
+        void run()
+        {
+            // prepared once per tile, on the thread that uses it:
+            osg::ref_ptr<Symbology::PreparedCropPolygon> prepared = _prepared ? new Symbology::PreparedCropPolygon(_rect) : 0L;
+
+            for(unsigned i=_first; i<_geoms.size(); i += _stride)
+            {
+                osg::ref_ptr<Symbology::Geometry> output;
+                bool ok = prepared.valid() ?
+                    _geoms[i]->crop(prepared.get(), output) :
+                    _geoms[i]->crop(_rect, output);
+                if ( ok )
+                    ++_count;
+            }
+        }
+
+        const std::vector< osg::ref_ptr<Symbology::Geometry> >& _geoms;
+        const Symbology::Polygon* _rect;
+        bool                      _prepared;
+        unsigned                  _first, _stride;
+        unsigned                  _count;
+    };
+
+    int benchCrop(osg::ArgumentParser& args)
+    {
+        unsigned count = 20000, numThreads = OpenThreads::GetNumberOfProcessors();
+        args.read("--count", count);
+        args.read("--threads", numThreads);
+        numThreads = osg::maximum(numThreads, 1u);
+
+        if ( !Symbology::Geometry::hasBufferOperation() )
+        {
+            OE_WARN << LC << "Cropping requires osgEarth built with GEOS" << std::endl;
+            return -1;
+        }
+
+        // 32-sided polygons scattered over [0,100]; the tile covers the middle
+        // so some polygons are inside, some outside and some cross its edges.
+        std::vector< osg::ref_ptr<Symbology::Geometry> > geoms;
+        for(unsigned i=0; i<count; ++i)
+        {
+            double cx = (double)((i*7919u) % 10007u) / 100.07;
+            double cy = (double)((i*104729u) % 10009u) / 100.09;
+            double r = 1.0 + (double)(i % 5);
+            Symbology::Polygon* poly = new Symbology::Polygon(32);
+            for(unsigned k=0; k<32; ++k)
+            {
+                double a = osg::PI * 2.0 * (double)k / 32.0;
+                double rk = k % 2 == 0 ? r : 0.6*r;
+                poly->push_back(osg::Vec3d(cx + rk*cos(a), cy + rk*sin(a), 0.0));
+            }
+            geoms.push_back(poly);
+        }
+
+        osg::ref_ptr<Symbology::Polygon> rect = new Symbology::Polygon();
+        rect->push_back(osg::Vec3d(20, 20, 0));
+        rect->push_back(osg::Vec3d(80, 20, 0));
+        rect->push_back(osg::Vec3d(80, 80, 0));
+        rect->push_back(osg::Vec3d(20, 80, 0));
+
+        unsigned threadCounts[2] = { 1u, numThreads };
+        for(unsigned t=0; t<2; ++t)
+        {
+            if ( t > 0 && numThreads == 1u )
+                break;
+
+            for(unsigned prepared=0; prepared<2; ++prepared)
+            {
+                Stopwatch sw(Stringify() << "Crop " << (prepared ? "prepared polygon" : "per geometry") << ", " << threadCounts[t] << " thread(s)");
+
+                std::vector<CropThread*> threads;
+                for(unsigned i=0; i<threadCounts[t]; ++i)
+                    threads.push_back(new CropThread(geoms, rect.get(), prepared != 0, i, threadCounts[t]));
+                for(unsigned i=0; i<threads.size(); ++i)
+                    threads[i]->start();
+
+                unsigned cropped = 0;
+                for(unsigned i=0; i<threads.size(); ++i)
+                {
+                    threads[i]->join();
+                    cropped += threads[i]->_count;
+                    delete threads[i];
+                }
+
+                sw.report(count);
+                OE_DEBUG << LC << cropped << " non-empty results" << std::endl;
+            }
+        }
+        return 0;
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    osg::ArgumentParser args(&argc, argv);
+
+    if ( args.read("--memcache") )
+        return benchMemCache(args);
+
+    if ( args.read("--tilekey") )
+        return benchTileKey(args);
+
+    if ( args.read("--srs") )
+        return benchSRS(args);
+
+    if ( args.read("--elevation-pool") )
+        return benchElevationPool(args);
+
+    std::string driver, path;
+    if ( args.read("--cache", driver, path) )
+        return benchCache(driver, path, args);
+
+    std::string file;
+    if ( args.read("--gdal", file) )
+        return benchGDAL(file, args);
+
+    if ( args.read("--mbtiles", file) )
+        return benchMBTiles(file, args);
+
+    std::string url;
+    if ( args.read("--http", url) )
+    {
+        s_countAllocations = true;
+        return benchHTTP(url, args);
+    }
+
+    if ( args.read("--features") )
+        return benchFeatures(args);
+
+    if ( args.read("--crop") )
+        return benchCrop(args);
+
+    return usage(argv[0]);
+}
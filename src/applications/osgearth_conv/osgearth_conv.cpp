@@ -189,6 +189,9 @@ struct ProgressReporter : public osgEarth::ProgressCallback
  *
  * The "in" properties come from the GDALOptions getConfig method. The
  * "out" properties come from the MBTilesOptions getConfig method.
+ * For large MBTiles outputs, add "--out bulk_write true" to commit tiles
+ * in large transactions, and "--out deduplicate true" to store identical
+ * tiles only once.
  *
  * Other arguments:
  *
@@ -425,6 +428,9 @@ main(int argc, char** argv)
 
     visitor->run( outputProfile.get() );
 
+    // close the output so it finishes any queued writes before we stop the clock.
+    output = 0L;
+
     osg::Timer_t t1 = osg::Timer::instance()->tick();
 
     std::cout
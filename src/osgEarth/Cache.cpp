@@ -19,13 +19,18 @@
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
 #include <osgEarth/ThreadingUtils>
+#include <osgEarth/DateTime>
 
 #include <osg/UserDataContainer>
+#include <osg/Shape>
+#include <OpenThreads/Condition>
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/Registry>
 #include <osgDB/ReaderWriter>
+#include <algorithm>
+#include <list>
 
 using namespace osgEarth;
 using namespace osgEarth::Threading;
@@ -111,6 +116,463 @@ CacheSettings::toString() const
 
 //------------------------------------------------------------------------
 
+#undef  LC
+#define LC "[WriteBehindQueue] "
+
+namespace osgEarth
+{
+    /**
+     * Queue of cache writes persisted by background threads. Holds at most
+     * (approximately) maxBytes of data; when full, the oldest queued writes
+     * are dropped. Queued and in-progress writes are visible to readers.
+     * The queue writes its own copy of each object, so callers may keep
+     * using theirs.
+     */
+    class WriteBehindQueue : public osg::Referenced
+    {
+    public:
+        WriteBehindQueue(unsigned maxBytes, unsigned numThreads);
+
+        //! Queues a write of a copy of the object to a bin.
+        void push(CacheBin* bin, const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo);
+
+        //! Finds the newest pending write for a key and returns a copy of its
+        //! object; returns false if there is none.
+        bool find(CacheBin* bin, const std::string& key, ReadResult& out);
+
+        //! Refreshes the timestamp of the pending write for a key; returns false
+        //! if there is none.
+        bool touch(CacheBin* bin, const std::string& key);
+
+        //! Discards the pending writes for a key and waits for any in progress.
+        void cancel(CacheBin* bin, const std::string& key);
+
+        //! Discards the pending writes for a bin and waits for any in progress.
+        void cancelAll(CacheBin* bin);
+
+        //! Blocks until all queued writes are persisted.
+        void flush();
+
+        //! Persists all queued writes and stops the background threads;
+        //! writes after this happen immediately on the calling thread.
+        void stop();
+
+        //! Runs a background thread's write loop.
+        void run();
+
+    protected:
+        virtual ~WriteBehindQueue();
+
+    private:
+        struct Write : public osg::Referenced
+        {
+            osg::ref_ptr<CacheBin>               _bin;
+            std::string                          _key;
+            osg::ref_ptr<const osg::Object>      _object;
+            Config                               _meta;
+            osg::ref_ptr<const osgDB::Options>   _dbo;
+            TimeStamp                            _time;
+            unsigned                             _bytes;
+        };
+
+        typedef std::list< osg::ref_ptr<Write> > Queue;
+        typedef std::pair<CacheBin*, std::string> WriteKey;
+        typedef std::map<WriteKey, Queue::iterator> Queued;
+
+        struct Worker : public OpenThreads::Thread
+        {
+            Worker(WriteBehindQueue* queue) : _queue(queue) { }
+            void run() { _queue->run(); }
+            WriteBehindQueue* _queue;
+        };
+
+        Queue                  _queue;    // writes waiting for a thread, oldest first
+        Queued                 _queued;   // index into _queue, newest write per key
+        std::vector<Write*>    _active;   // writes in progress
+        unsigned               _bytes;
+        unsigned               _maxBytes;
+        unsigned               _numDropped;
+        bool                   _done;
+        std::vector<Worker*>   _workers;
+        Threading::Mutex       _mutex;
+        OpenThreads::Condition _writeQueued;
+        OpenThreads::Condition _writeDone;
+
+        static unsigned estimateSize(const osg::Object* object);
+        void dequeue(Queue::iterator i);
+        bool isActive(CacheBin* bin, const std::string* key) const;
+    };
+}
+
+WriteBehindQueue::WriteBehindQueue(unsigned maxBytes, unsigned numThreads) :
+_bytes     ( 0u ),
+_maxBytes  ( maxBytes ),
+_numDropped( 0u ),
+_done      ( false )
+{
+    for(unsigned i=0; i<osg::maximum(numThreads, 1u); ++i)
+    {
+        Worker* worker = new Worker(this);
+        _workers.push_back(worker);
+        worker->start();
+    }
+}
+
+WriteBehindQueue::~WriteBehindQueue()
+{
+    stop();
+}
+
+unsigned
+WriteBehindQueue::estimateSize(const osg::Object* object)
+{
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if (image)
+        return image->getTotalSizeInBytesIncludingMipmaps();
+
+    const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+    if (hf)
+        return hf->getNumColumns() * hf->getNumRows() * sizeof(float);
+
+    const StringObject* str = dynamic_cast<const StringObject*>(object);
+    if (str)
+        return str->getString().size();
+
+    return 4096u;
+}
+
+void
+WriteBehindQueue::dequeue(Queue::iterator i)
+{
+    // assumes the mutex is locked.
+    Write* write = i->get();
+    Queued::iterator q = _queued.find(WriteKey(write->_bin.get(), write->_key));
+    if (q != _queued.end() && q->second == i)
+        _queued.erase(q);
+
+    _bytes -= write->_bytes;
+    _queue.erase(i);
+
+    // flush() may be waiting for the queue to empty.
+    _writeDone.broadcast();
+}
+
+bool
+WriteBehindQueue::isActive(CacheBin* bin, const std::string* key) const
+{
+    // assumes the mutex is locked.
+    for(std::vector<Write*>::const_iterator i = _active.begin(); i != _active.end(); ++i)
+    {
+        if ((*i)->_bin.get() == bin && (key == 0L || (*i)->_key == *key))
+            return true;
+    }
+    return false;
+}
+
+void
+WriteBehindQueue::push(CacheBin* bin, const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo)
+{
+    // copy the object now, since the caller may change it before it's written.
+    osg::ref_ptr<osg::Object> copy = object->clone(osg::CopyOp::DEEP_COPY_ALL);
+    unsigned bytes = estimateSize(copy.get());
+
+    _mutex.lock();
+
+    if (_done)
+    {
+        // stopped, so write immediately.
+        _mutex.unlock();
+        bin->write(key, copy.get(), meta, dbo);
+        return;
+    }
+
+    // a newer write replaces one still waiting in the queue:
+    Queued::iterator q = _queued.find(WriteKey(bin, key));
+    if (q != _queued.end())
+    {
+        dequeue(q->second);
+    }
+
+    // backpressure: drop the oldest writes to make room.
+    while (!_queue.empty() && _bytes + bytes > _maxBytes)
+    {
+        OE_DEBUG << LC << "Queue full; dropped write \"" << _queue.front()->_key << "\"" << std::endl;
+        dequeue(_queue.begin());
+        ++_numDropped;
+    }
+
+    Write* write = new Write();
+    write->_bin        = bin;
+    write->_key        = key;
+    write->_object     = copy.get();
+    write->_meta       = meta;
+    write->_dbo        = dbo;
+    write->_time       = DateTime().asTimeStamp();
+    write->_bytes      = bytes;
+
+    _queued[WriteKey(bin, key)] = _queue.insert(_queue.end(), write);
+    _bytes += bytes;
+
+    _writeQueued.signal();
+    _mutex.unlock();
+}
+
+bool
+WriteBehindQueue::find(CacheBin* bin, const std::string& key, ReadResult& out)
+{
+    osg::ref_ptr<const Write> write;
+    TimeStamp time = 0;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        Queued::const_iterator q = _queued.find(WriteKey(bin, key));
+        if (q != _queued.end())
+        {
+            write = q->second->get();
+        }
+        else
+        {
+            // the newest write may already be in progress:
+            for(std::vector<Write*>::const_reverse_iterator i = _active.rbegin(); i != _active.rend() && !write.valid(); ++i)
+            {
+                if ((*i)->_bin.get() == bin && (*i)->_key == key)
+                    write = *i;
+            }
+        }
+
+        // touch() may refresh it:
+        if (write.valid())
+            time = write->_time;
+    }
+
+    if (!write.valid())
+        return false;
+
+    // the object is still waiting to be written, so the caller gets a copy
+    // it is free to modify.
+    out = ReadResult(write->_object->clone(osg::CopyOp::DEEP_COPY_ALL), write->_meta);
+    out.setLastModifiedTime(time);
+    out.setIsFromCache(true);
+    return true;
+}
+
+bool
+WriteBehindQueue::touch(CacheBin* bin, const std::string& key)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    Queued::iterator q = _queued.find(WriteKey(bin, key));
+    if (q != _queued.end())
+    {
+        (*q->second)->_time = DateTime().asTimeStamp();
+        return true;
+    }
+
+    // one in progress gets the bin's own timestamp when it's written.
+    return isActive(bin, &key);
+}
+
+void
+WriteBehindQueue::cancel(CacheBin* bin, const std::string& key)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    Queued::iterator q = _queued.find(WriteKey(bin, key));
+    if (q != _queued.end())
+    {
+        dequeue(q->second);
+    }
+
+    while (isActive(bin, &key))
+    {
+        _writeDone.wait(&_mutex);
+    }
+}
+
+void
+WriteBehindQueue::cancelAll(CacheBin* bin)
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    for(Queue::iterator i = _queue.begin(); i != _queue.end(); )
+    {
+        Queue::iterator next = i;
+        ++next;
+        if ((*i)->_bin.get() == bin)
+            dequeue(i);
+        i = next;
+    }
+
+    while (isActive(bin, 0L))
+    {
+        _writeDone.wait(&_mutex);
+    }
+}
+
+void
+WriteBehindQueue::flush()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    while (!_queue.empty() || !_active.empty())
+    {
+        _writeDone.wait(&_mutex);
+    }
+}
+
+void
+WriteBehindQueue::stop()
+{
+    std::vector<Worker*> workers;
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+        _done = true;
+        _writeQueued.broadcast();
+        workers.swap(_workers);
+    }
+
+    // the workers drain the queue before they exit.
+    for(unsigned i=0; i<workers.size(); ++i)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+
+    if (_numDropped > 0u)
+    {
+        OE_INFO << LC << _numDropped << " writes were dropped because the queue was full" << std::endl;
+        _numDropped = 0u;
+    }
+}
+
+void
+WriteBehindQueue::run()
+{
+    Threading::ScopedMutexLock lock(_mutex);
+
+    while (true)
+    {
+        while (_queue.empty() && !_done)
+        {
+            _writeQueued.wait(&_mutex);
+        }
+
+        if (_queue.empty())
+        {
+            break;
+        }
+
+        osg::ref_ptr<Write> write = _queue.front().get();
+        dequeue(_queue.begin());
+        _active.push_back(write.get());
+
+        _mutex.unlock();
+        write->_bin->write(write->_key, write->_object.get(), write->_meta, write->_dbo.get());
+        _mutex.lock();
+
+        _active.erase(std::find(_active.begin(), _active.end(), write.get()));
+        _writeDone.broadcast();
+    }
+}
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    /**
+     * Cache bin that hands its writes to a WriteBehindQueue and otherwise
+     * delegates to the actual bin. Reads check the queue first, so they
+     * see the bin's own pending writes.
+     */
+    class WriteBehindCacheBin : public CacheBin
+    {
+    public:
+        WriteBehindCacheBin(CacheBin* bin, WriteBehindQueue* queue) :
+            CacheBin(bin->getID()), _bin(bin), _queue(queue)
+        {
+            setHashKeys(bin->getHashKeys());
+        }
+
+        ReadResult readObject(const std::string& key, const osgDB::Options* dbo)
+        {
+            ReadResult r;
+            if (_queue->find(_bin.get(), key, r))
+                return r;
+            return _bin->readObject(key, dbo);
+        }
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* dbo)
+        {
+            ReadResult r;
+            if (_queue->find(_bin.get(), key, r))
+                return r.get<osg::Image>() ? r : ReadResult();
+            return _bin->readImage(key, dbo);
+        }
+
+        ReadResult readString(const std::string& key, const osgDB::Options* dbo)
+        {
+            ReadResult r;
+            if (_queue->find(_bin.get(), key, r))
+                return r.get<StringObject>() ? r : ReadResult();
+            return _bin->readString(key, dbo);
+        }
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* dbo)
+        {
+            if (!object)
+                return false;
+            _queue->push(_bin.get(), key, object, meta, dbo);
+            return true;
+        }
+
+        RecordStatus getRecordStatus(const std::string& key)
+        {
+            ReadResult r;
+            if (_queue->find(_bin.get(), key, r))
+                return STATUS_OK;
+            return _bin->getRecordStatus(key);
+        }
+
+        bool remove(const std::string& key)
+        {
+            _queue->cancel(_bin.get(), key);
+            return _bin->remove(key);
+        }
+
+        bool touch(const std::string& key)
+        {
+            if (_queue->touch(_bin.get(), key))
+                return true;
+            return _bin->touch(key);
+        }
+
+        Config readMetadata()                    { return _bin->readMetadata(); }
+        bool writeMetadata(const Config& meta)   { return _bin->writeMetadata(meta); }
+        bool compact()                           { return _bin->compact(); }
+        unsigned getStorageSize()                { return _bin->getStorageSize(); }
+
+        bool clear()
+        {
+            _queue->cancelAll(_bin.get());
+            return _bin->clear();
+        }
+
+        std::string getHashedKey(const std::string& key) const
+        {
+            return _bin->getHashedKey(key);
+        }
+
+    private:
+        osg::ref_ptr<CacheBin>         _bin;
+        osg::ref_ptr<WriteBehindQueue> _queue;
+    };
+}
+
+//------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[Cache] "
+
 Cache::Cache( const CacheOptions& options ) :
 _ok     ( true ),
 _options( options )
@@ -120,6 +582,8 @@ _options( options )
 
 Cache::~Cache()
 {
+    if (_writeBehindQueue.valid())
+        _writeBehindQueue->stop();
 }
 
 Cache::Cache( const Cache& rhs, const osg::CopyOp& op ) :
@@ -140,6 +604,34 @@ void
 Cache::removeBin( CacheBin* bin )
 {
     _bins.remove( bin );
+    _writeBehindBins.remove( bin );
+}
+
+CacheBin*
+Cache::openBin( const std::string& binID )
+{
+    CacheBin* bin = addBin( binID );
+    if ( !bin || _options.writeBehind() != true )
+        return bin;
+
+    {
+        Threading::ScopedMutexLock lock( _writeBehindMutex );
+        if ( !_writeBehindQueue.valid() )
+        {
+            _writeBehindQueue = new WriteBehindQueue(
+                _options.writeBehindMaxBytes().get(),
+                _options.writeBehindThreads().get() );
+        }
+    }
+
+    return _writeBehindBins.getOrCreate( binID, new WriteBehindCacheBin(bin, _writeBehindQueue.get()) );
+}
+
+void
+Cache::flush()
+{
+    if ( _writeBehindQueue.valid() )
+        _writeBehindQueue->flush();
 }
 
 //------------------------------------------------------------------------
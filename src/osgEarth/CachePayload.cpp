@@ -0,0 +1,107 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/CachePayload>
+#include <osgEarth/IOTypes>
+#include <osgEarth/UniformTile>
+#include <osgEarth/StringUtils>
+#include <istream>
+#include <string.h>
+
+using namespace osgEarth;
+
+namespace
+{
+    // A shared payload is replaced by a reference:
+    //   [4]  magic
+    //   [32] content hash, which keys the record holding the payload
+    const char     CONTENT_REF_MAGIC[4] = { 'o', 'e', 'c', 'r' };
+    const unsigned CONTENT_HASH_SIZE    = 32u;
+    const unsigned CONTENT_REF_SIZE     = 4u + CONTENT_HASH_SIZE;
+
+    const std::string CONTENT_KEY_PREFIX = "#content/";
+
+    // Payloads smaller than this aren't worth sharing.
+    const unsigned MIN_SHARED_SIZE = 1024u;
+
+    // Content hashes remembered per bin before starting over.
+    const unsigned MAX_SEEN_CONTENT = 65536u;
+}
+
+osg::Object*
+CachePayload::decode(const char* payload, unsigned size, const Reader& reader, std::string& out_error)
+{
+    if ( UniformTile::isDescriptor(payload, size) )
+    {
+        osg::ref_ptr<osg::Object> object = UniformTile::decode(payload, size);
+        if ( !object.valid() || !reader.accepts(object.get()) )
+        {
+            out_error = "bad uniform tile";
+            return 0L;
+        }
+        return object.release();
+    }
+
+    // decode the OSGB stream into an object, straight from the record.
+    MemoryStreamBuffer buf(payload, size);
+    std::istream datastream(&buf);
+    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
+    if ( !r.success() )
+    {
+        out_error = r.message();
+        return 0L;
+    }
+    return r.takeObject();
+}
+
+bool
+CachePayload::SharedContent::isRepeated(const std::string& payload, std::string& out_key)
+{
+    if ( payload.size() < MIN_SHARED_SIZE )
+        return false;
+
+    std::string hash = hashContent( payload.data(), payload.size() );
+    {
+        // the first time we see a payload, it's stored in place.
+        Threading::ScopedMutexLock lock( _seenMutex );
+        if ( _seen.size() >= MAX_SEEN_CONTENT )
+            _seen.clear();
+        if ( _seen.insert(hash).second )
+            return false;
+    }
+
+    out_key = CONTENT_KEY_PREFIX + hash;
+    return true;
+}
+
+void
+CachePayload::SharedContent::makeReference(const std::string& key, std::string& payload)
+{
+    payload.assign( CONTENT_REF_MAGIC, 4 );
+    payload.append( key, CONTENT_KEY_PREFIX.size(), CONTENT_HASH_SIZE );
+}
+
+bool
+CachePayload::SharedContent::isReference(const char* payload, unsigned size, std::string& out_key)
+{
+    if ( size != CONTENT_REF_SIZE || memcmp(payload, CONTENT_REF_MAGIC, 4) != 0 )
+        return false;
+
+    out_key = CONTENT_KEY_PREFIX + std::string(payload + 4, CONTENT_HASH_SIZE);
+    return true;
+}
@@ -35,6 +35,21 @@ namespace osgEarth {
     REGISTER_OSGEARTH_LAYER(elevation, osgEarth::ElevationLayer);
 }
 
+namespace
+{
+    // Copy of a tile's heightfield for a coalesced request to own. The
+    // normal map is shared; it's only ever written while it's created.
+    GeoHeightField copyOf(const GeoHeightField& hf)
+    {
+        if ( !hf.valid() )
+            return hf;
+        return GeoHeightField(
+            osg::clone(hf.getHeightField(), osg::CopyOp::SHALLOW_COPY),
+            const_cast<NormalMap*>(hf.getNormalMap()),
+            hf.getExtent() );
+    }
+}
+
 //#define ANALYZE
 
 //------------------------------------------------------------------------
@@ -260,10 +275,18 @@ ElevationLayer::createHeightFieldFromTileSource(const TileKey&    key,
     }
 
     // If the key is blacklisted, fail.
-    if ( source->getBlacklist()->contains( key ))
+    TileBlacklist::Reason reason;
+    if ( source->getBlacklist()->contains( key, reason ))
     {
         OE_DEBUG << LC << "Tile " << key.str() << " is blacklisted " << std::endl;
-        if (progress) progress->message() = "blacklisted";
+        if (progress)
+        {
+            progress->message() = "blacklisted";
+
+            // an earlier recoverable error: ask the caller to come back later.
+            if ( reason == TileBlacklist::REASON_ERROR )
+                progress->setNeedsRetry( true );
+        }
         return 0L;
     }
 
@@ -297,7 +320,8 @@ ElevationLayer::createHeightFieldFromTileSource(const TileKey&    key,
         }
         
         // Blacklist the tile if it is the same projection as the source and
-        // we can't get it and it wasn't cancelled
+        // we can't get it and it wasn't cancelled. A recoverable error only
+        // holds the tile back for a short while.
         if (!result.valid())
         {
             if ( progress == 0L ||
@@ -305,6 +329,10 @@ ElevationLayer::createHeightFieldFromTileSource(const TileKey&    key,
             {
                 source->getBlacklist()->add( key );
             }
+            else if ( !progress->isCanceled() )
+            {
+                source->getBlacklist()->add( key, TileBlacklist::REASON_ERROR );
+            }
         }
     }
 
@@ -482,6 +510,49 @@ ElevationLayer::createHeightField(const TileKey&    key,
         return GeoHeightField::INVALID;
     }
 
+    // cache key combines the key with the full signature (incl vdatum)
+    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
+
+    // Concurrent requests for the same tile wait on a single fetch.
+    InFlightHeightFields::Scope flight(_inFlight, cacheKey);
+    if ( !flight.isLeader() )
+    {
+        while ( !flight.wait(100u) )
+        {
+            if ( progress && progress->isCanceled() )
+                return GeoHeightField::INVALID;
+        }
+
+        if ( flight.succeeded() )
+        {
+            countCoalescedRequest();
+            return copyOf( flight.result() );
+        }
+
+        // the first fetch was abandoned, so do it again.
+        countDuplicateRequest();
+        return fetchHeightField( key, cacheKey, progress );
+    }
+
+    GeoHeightField result = fetchHeightField( key, cacheKey, progress );
+
+    // Don't share a failure that was caused by the leader's cancelation;
+    // let the waiting callers fetch the tile themselves.
+    if ( result.valid() || !progress || !progress->isCanceled() )
+    {
+        // Followers copy a private snapshot, so in-place changes to one
+        // tile's result don't leak into another's.
+        flight.resolve( flight.close() > 0u ? copyOf(result) : result );
+    }
+
+    return result;
+}
+
+GeoHeightField
+ElevationLayer::fetchHeightField(const TileKey&     key,
+                                 const std::string& cacheKey,
+                                 ProgressCallback*  progress)
+{
     GeoHeightField result;
     osg::ref_ptr<osg::HeightField> hf;
     osg::ref_ptr<NormalMap> normalMap;
@@ -489,8 +560,6 @@ ElevationLayer::createHeightField(const TileKey&    key,
     // Check the memory cache first
     bool fromMemCache = false;
 
-    // cache key combines the key with the full signature (incl vdatum)
-    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getFullSignature();
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
 
     if ( _memCache.valid() )
@@ -633,15 +702,9 @@ ElevationLayer::createHeightField(const TileKey&    key,
         }
     }
 
-    // write to mem cache if needed:
-    if ( result.valid() && !fromMemCache && _memCache.valid() )
-    {
-        CacheBin* bin = _memCache->getOrCreateDefaultBin();
-        bin->write(cacheKey, result.getHeightField(), 0L);
-    }
-
-    // post-processing:
-    if ( result.valid() )
+    // post-processing (mem cache entries are already post-processed, and
+    // may be shared, so never modify them in place):
+    if ( result.valid() && !fromMemCache )
     {
         if ( options().noDataPolicy() == NODATA_MSL )
         {
@@ -667,6 +730,13 @@ ElevationLayer::createHeightField(const TileKey&    key,
         }
     }
 
+    // write to mem cache if needed:
+    if ( result.valid() && !fromMemCache && _memCache.valid() )
+    {
+        CacheBin* bin = _memCache->getOrCreateDefaultBin();
+        bin->write(cacheKey, result.getHeightField(), 0L);
+    }
+
     return result;
 }
 
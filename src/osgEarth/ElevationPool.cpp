@@ -31,7 +31,6 @@ using namespace osgEarth;
 
 
 ElevationPool::ElevationPool() :
-_entries(0u),
 _maxEntries( 128u ),
 _tileSize( 257u )
 {
@@ -58,15 +57,16 @@ ElevationPool::~ElevationPool()
 void
 ElevationPool::setMap(const Map* map)
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
-    _map = map;
+    {
+        Threading::ScopedMutexLock lock(_mapMutex);
+        _map = map;
+    }
     clearImpl();
 }
 
 void
 ElevationPool::clear()
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
     clearImpl();
 }
 
@@ -82,15 +82,16 @@ ElevationPool::stopThreading()
 void
 ElevationPool::setElevationLayers(const ElevationLayerVector& layers)
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
-    _layers = layers;
+    {
+        Threading::ScopedMutexLock lock(_mapMutex);
+        _layers = layers;
+    }
     clearImpl();
 }
 
 void
 ElevationPool::setTileSize(unsigned value)
 {
-    Threading::ScopedMutexLock lock(_tilesMutex);
     _tileSize = value;
     clearImpl();
 }
@@ -133,20 +134,12 @@ ElevationPool::fetchTileFromMap(const TileKey& key, const ElevationLayerVector&
     // Initialize the heightfield to nodata
     hf->getFloatArray()->assign( hf->getFloatArray()->size(), NO_DATA_VALUE );
 
+    // the envelope's layers are a copy of the user-specified layers, or the map's.
     TileKey keyToUse = key;
     while( !tile->_hf.valid() && keyToUse.valid() )
     {
-        bool ok;
-        if (_layers.empty())
-        {
-            OE_TEST << LC << "Populating from envelope (" << keyToUse.str() << ")\n";
-            ok = layers.populateHeightFieldAndNormalMap(hf.get(), 0L, keyToUse, 0L, INTERP_BILINEAR, 0L);
-        }
-        else
-        {
-            OE_TEST << LC << "Populating from layers (" << keyToUse.str() << ")\n";
-            ok = _layers.populateHeightFieldAndNormalMap(hf.get(), 0L, keyToUse, 0L, INTERP_BILINEAR, 0L);
-        }
+        OE_TEST << LC << "Populating from envelope (" << keyToUse.str() << ")\n";
+        bool ok = layers.populateHeightFieldAndNormalMap(hf.get(), 0L, keyToUse, 0L, INTERP_BILINEAR, 0L);
 
         if (ok)
         {
@@ -163,56 +156,84 @@ ElevationPool::fetchTileFromMap(const TileKey& key, const ElevationLayerVector&
 }
 
 void
-ElevationPool::popMRU()
+ElevationPool::insert(Shard& shard, Tile* tile)
 {
-    // first rememeber the key of the item we're about the pop:
-    TileKey key = _mru.back()->_key;
+    unsigned capacity = osg::maximum(1u, (_maxEntries + NUM_SHARDS - 1u) / NUM_SHARDS);
 
-    // establish a temporary observer on the item:
-    osg::observer_ptr<Tile> temp = _mru.back().get();
-
-    // pop the Tile from the MRU:
-    _mru.pop_back();
+    // the capacity may have shrunk since the last insert:
+    while (shard._ring.size() > capacity)
+    {
+        shard._tiles.erase(shard._ring.back()->_key);
+        shard._ring.pop_back();
+    }
+    if (shard._hand >= shard._ring.size())
+        shard._hand = 0u;
 
-    // if our observer went to NULL, we know there are no more pointers
-    // to that Tile in the MRU, and we can remove it from the main list:
-    if (!temp.valid())
+    if (shard._ring.size() < capacity)
     {
-        _tiles.erase(key);
+        shard._ring.push_back(tile);
     }
+    else
+    {
+        // sweep the clock hand until we find a tile that hasn't been used since
+        // the last sweep. Skip tiles that are still loading, unless that's all
+        // there is after two full turns.
+        unsigned size = shard._ring.size();
+        for (unsigned sweep = 0; ; ++sweep)
+        {
+            unsigned slot = shard._hand;
+            shard._hand = (shard._hand + 1u) % size;
+
+            Tile* victim = shard._ring[slot].get();
+            if (sweep < 2u*size)
+            {
+                if (victim->_used)
+                {
+                    victim->_used = false;
+                    continue;
+                }
+                if (victim->_status == STATUS_IN_PROGRESS)
+                {
+                    continue;
+                }
+            }
+
+            // envelopes may still reference the victim; it destructs when they're done.
+            shard._tiles.erase(victim->_key);
+            shard._ring[slot] = tile;
+            break;
+        }
+    }
+
+    shard._tiles[tile->_key] = tile;
 }
 
 bool
 ElevationPool::tryTile(const TileKey& key, const ElevationLayerVector& layers, osg::ref_ptr<Tile>& out)
 {
-    // first see whether the tile is available
-    _tilesMutex.lock();
+    Shard& shard = getShard(key);
 
-    // locate the tile in the local tile cache:
-    osg::observer_ptr<Tile>& tile_obs = _tiles[key];
+    // first see whether the tile is available
+    shard._mutex.lock();
 
     osg::ref_ptr<Tile> tile;
 
-    // Get a safe pointer to it. If this is NULL, we need to create and
-    // fetch a new tile from the Map.
-    if (!tile_obs.lock(tile))
+    // locate the tile in the local tile cache. If it's not there, we need to
+    // create and fetch a new tile from the Map.
+    Shard::Tiles::iterator i = shard._tiles.find(key);
+    if (i != shard._tiles.end())
+    {
+        tile = i->second.get();
+
+        // Mark this tile as recently used:
+        tile->_used = true;
+    }
+    else
     {
         // a new tile; status -> EMPTY
         tile = new Tile();
         tile->_key = key;
-
-        // update the LRU:
-        _mru.push_front(tile.get());
-
-        // prune the MRU if necessary:
-        if (++_entries > _maxEntries )
-        {
-            popMRU();
-            --_entries;
-        }
-
-        // add to the main cache (after putting it on the LRU).
-        tile_obs = tile;
+        insert(shard, tile.get());
     }
        
     // This means the tile object exists but has yet to be populated:
@@ -220,7 +241,7 @@ ElevationPool::tryTile(const TileKey& key, const ElevationLayerVector& layers, o
     {
         OE_TEST << "  getTile(" << key.str() << ") -> fetch from map\n";
         tile->_status.exchange(STATUS_IN_PROGRESS);
-        _tilesMutex.unlock();
+        shard._mutex.unlock();
 
         bool ok = fetchTileFromMap(key, layers, tile.get());
         tile->_status.exchange( ok ? STATUS_AVAILABLE : STATUS_FAIL );
@@ -233,19 +254,8 @@ ElevationPool::tryTile(const TileKey& key, const ElevationLayerVector& layers, o
     else if ( tile->_status == STATUS_AVAILABLE )
     {
         OE_TEST << "  getTile(" << key.str() << ") -> available\n";
+        shard._mutex.unlock();
         out = tile.get();
-
-        // Mark this tile as recently used:
-        _mru.push_front(tile.get());
-
-        // prune the MRU if necessary
-        if (++_entries > _maxEntries)
-        {
-            popMRU();
-            --_entries;
-        }
-
-        _tilesMutex.unlock();
         return true;
     }
 
@@ -253,7 +263,7 @@ ElevationPool::tryTile(const TileKey& key, const ElevationLayerVector& layers, o
     else if ( tile->_status == STATUS_FAIL )
     {
         OE_TEST << "  getTile(" << key.str() << ") -> fail\n";
-        _tilesMutex.unlock();
+        shard._mutex.unlock();
         out = 0L;
         return false;
     }
@@ -263,7 +273,7 @@ ElevationPool::tryTile(const TileKey& key, const ElevationLayerVector& layers, o
     else //if ( tile->_status == STATUS_IN_PROGRESS )
     {
         OE_DEBUG << "  getTile(" << key.str() << ") -> in progress...waiting\n";
-        _tilesMutex.unlock();
+        shard._mutex.unlock();
         out = 0L;
         return true;            // out:NULL => check back later please.
     }
@@ -272,10 +282,14 @@ ElevationPool::tryTile(const TileKey& key, const ElevationLayerVector& layers, o
 void
 ElevationPool::clearImpl()
 {
-    // assumes the tiles lock is taken.
-    _tiles.clear();
-    _mru.clear();
-    _entries = 0u;
+    for (unsigned i = 0; i < NUM_SHARDS; ++i)
+    {
+        Shard& shard = _shards[i];
+        Threading::ScopedMutexLock lock(shard._mutex);
+        shard._tiles.clear();
+        shard._ring.clear();
+        shard._hand = 0u;
+    }
 }
 
 bool
@@ -322,10 +336,18 @@ ElevationPool::createEnvelope(const SpatialReference* srs, unsigned lod)
     e->_lod = lod;
     e->_pool = this;
 
+    Threading::ScopedMutexLock lock(_mapMutex);
+
     // user-specified layers?
     if (_layers.size() > 0)
     {
         e->_layers = _layers;
+
+        osg::ref_ptr<const Map> map;
+        if (_map.lock(map))
+        {
+            e->_mapProfile = map->getProfile();
+        }
     }
 
     // full map layers:
@@ -435,6 +457,19 @@ ElevationEnvelope::getElevationAndResolution(double x, double y)
     return std::make_pair(elevation, resolution);
 }
 
+ElevationPool::Tile*
+ElevationEnvelope::findTile(double x, double y, ElevationPool::Tile* after) const
+{
+    for(ElevationPool::QuerySet::const_iterator tile_ref = after ? _tiles.upper_bound(after) : _tiles.begin();
+        tile_ref != _tiles.end();
+        ++tile_ref)
+    {
+        if (tile_ref->get()->_bounds.contains(x, y))
+            return tile_ref->get();
+    }
+    return 0L;
+}
+
 unsigned
 ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
                                  std::vector<float>& output)
@@ -443,17 +478,80 @@ ElevationEnvelope::getElevations(const std::vector<osg::Vec3d>& input,
 
     unsigned count = 0u;
 
-    output.reserve(input.size());
-    output.clear();
+    output.assign(input.size(), NO_DATA_VALUE);
 
-    // for each input point:
-    for (std::vector<osg::Vec3d>::const_iterator v = input.begin(); v != input.end(); ++v)
+    if (input.empty() || !_mapProfile.valid())
+        return 0u;
+
+    // transform all the points into the map SRS at once. If some of them
+    // fail, fall back on sampling one point at a time.
+    std::vector<osg::Vec3d> points(input);
+    if (!_inputSRS->transform(points, _mapProfile->getSRS()))
     {
-        float elevation, resolution;
-        sample(v->x(), v->y(), elevation, resolution);
-        output.push_back(elevation);
-        if (elevation != NO_DATA_VALUE)
-            ++count;
+        for (unsigned i = 0; i < input.size(); ++i)
+        {
+            float resolution;
+            if (sample(input[i].x(), input[i].y(), output[i], resolution))
+                ++count;
+        }
+        return count;
+    }
+
+    // find the tile for each point. Points outside the query set are grouped
+    // by tile key, so each missing tile is fetched from the pool only once.
+    std::vector<ElevationPool::Tile*> pointTiles(points.size(), 0L);
+    TileKeyMap< std::vector<unsigned> >::type missing;
+
+    for (unsigned i = 0; i < points.size(); ++i)
+    {
+        pointTiles[i] = findTile(points[i].x(), points[i].y());
+        if (pointTiles[i] == 0L)
+        {
+            TileKey key = _mapProfile->createTileKey(points[i].x(), points[i].y(), _lod);
+            if (key.valid())
+                missing[key].push_back(i);
+        }
+    }
+
+    // references to the fetched tiles, in case the query set already had an
+    // equivalent tile and didn't take ours:
+    std::vector< osg::ref_ptr<ElevationPool::Tile> > fetched;
+
+    osg::ref_ptr<ElevationPool> pool;
+    if (!missing.empty() && _pool.lock(pool))
+    {
+        for (TileKeyMap< std::vector<unsigned> >::type::const_iterator m = missing.begin(); m != missing.end(); ++m)
+        {
+            osg::ref_ptr<ElevationPool::Tile> tile;
+            if (pool->getTile(m->first, _layers, tile) && tile.valid())
+            {
+                // Got the new tile; put it in the query set:
+                _tiles.insert(tile.get());
+                fetched.push_back(tile.get());
+
+                for (std::vector<unsigned>::const_iterator i = m->second.begin(); i != m->second.end(); ++i)
+                    pointTiles[*i] = tile.get();
+            }
+        }
+    }
+
+    // sample all the points in one pass. If a point's tile has no data there,
+    // fall back on the lower resolution tiles in the query set that contain it.
+    for (unsigned i = 0; i < points.size(); ++i)
+    {
+        for (ElevationPool::Tile* tile = pointTiles[i];
+             tile != 0L;
+             tile = findTile(points[i].x(), points[i].y(), tile))
+        {
+            float elevation;
+            if (tile->_hf.getElevation(0L, points[i].x(), points[i].y(), INTERP_BILINEAR, 0L, elevation) &&
+                elevation != NO_DATA_VALUE)
+            {
+                output[i] = elevation;
+                ++count;
+                break;
+            }
+        }
     }
 
     if (count < input.size())
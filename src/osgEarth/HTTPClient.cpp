@@ -27,12 +27,15 @@
 #include <osgDB/FileNameUtils>
 #include <osg/Notify>
 #include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Condition>
 #include <string.h>
 #include <sstream>
 #include <fstream>
 #include <iterator>
 #include <iostream>
 #include <algorithm>
+#include <set>
 #include <curl/curl.h>
 
 // Whether to use WinInet instead of cURL - CMAKE option
@@ -116,24 +119,40 @@ namespace osgEarth
 {
     struct StreamObject
     {
-        StreamObject(std::ostream* stream) : _stream(stream) { }
+        StreamObject(HTTPResponse::Part* part) : _part(part) { }
 
         void write(const char* ptr, size_t realsize)
         {
-            if (_stream) _stream->write(ptr, realsize);
+            if (_part) _part->append(ptr, realsize);
         }
 
         void writeHeader(const char* ptr, size_t realsize)
         {
-            std::string header(ptr);
-            StringTokenizer tok(":");
-            StringVector tized;
-            tok.tokenize(header, tized);
-            if ( tized.size() >= 2 )
-                _headers[tized[0]] = tized[1];
+            // split on the first colon only; values like dates and URLs
+            // contain colons, and validators like ETags must stay verbatim.
+            std::string header(ptr, realsize);
+            std::string::size_type colon = header.find(':');
+            if ( colon != std::string::npos && colon > 0 )
+            {
+                std::string name  = trim(header.substr(0, colon));
+                std::string value = trim(header.substr(colon+1));
+
+                // size the body buffer up front so it never has to grow.
+                if ( _part && ciEquals(name, "Content-Length") )
+                {
+                    size_t length = as<size_t>(value, 0u);
+                    if ( length > 0u && length <= MAX_PRESIZED_BODY )
+                        _part->reserve(length);
+                }
+
+                _headers[name] = value;
+            }
         }
 
-        std::ostream* _stream;
+        // a Content-Length beyond this is not trusted to pre-size a buffer
+        static const size_t MAX_PRESIZED_BODY = 64u*1024u*1024u;
+
+        HTTPResponse::Part* _part;
         Headers _headers;
         std::string     _resultMimeType;
     };
@@ -245,6 +264,11 @@ void HTTPRequest::setLastModified( const DateTime &lastModified)
     addHeader("If-Modified-Since", lastModified.asRFC1123());
 }
 
+void HTTPRequest::setETag( const std::string& etag )
+{
+    addHeader("If-None-Match", etag);
+}
+
 
 std::string
 HTTPRequest::getURL() const
@@ -312,7 +336,7 @@ HTTPResponse::getNumParts() const {
 
 unsigned int
 HTTPResponse::getPartSize( unsigned int n ) const {
-    return _parts[n]->_size;
+    return _parts[n]->_data.size();
 }
 
 const std::string&
@@ -322,14 +346,13 @@ HTTPResponse::getPartHeader( unsigned int n, const std::string& name ) const {
 
 std::istream&
 HTTPResponse::getPartStream( unsigned int n ) const {
-    return _parts[n]->_stream;
+    return _parts[n]->stream();
 }
 
 std::string
 HTTPResponse::getPartAsString( unsigned int n ) const {
-    std::string streamStr;
-    streamStr = _parts[n]->_stream.str();
-    return streamStr;
+    const std::vector<char>& data = _parts[n]->_data;
+    return data.empty() ? std::string() : std::string(&data[0], data.size());
 }
 
 const std::string&
@@ -353,6 +376,136 @@ HTTPResponse::getHeadersAsConfig() const
 
 /****************************************************************************/
 
+namespace
+{
+    /**
+     * Recycles response body buffers, so a fetch writes into memory that was
+     * already grown by an earlier one instead of allocating its own.
+     * Only tile-sized buffers are kept.
+     */
+    class BodyBufferPool
+    {
+    public:
+        BodyBufferPool() { _free.reserve(MAX_BUFFERS); }
+
+        void acquire(std::vector<char>& out)
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            if ( !_free.empty() )
+            {
+                out.swap( _free.back() );
+                _free.pop_back();
+            }
+        }
+
+        void release(std::vector<char>& in)
+        {
+            if ( in.capacity() == 0u || in.capacity() > MAX_CAPACITY )
+                return;
+
+            in.clear();
+            Threading::ScopedMutexLock lock(_mutex);
+            if ( _free.size() < MAX_BUFFERS )
+            {
+                _free.push_back( std::vector<char>() );
+                _free.back().swap( in );
+            }
+        }
+
+    private:
+        static const unsigned MAX_BUFFERS  = 32u;
+        static const size_t   MAX_CAPACITY = 1024u*1024u;
+
+        std::vector< std::vector<char> > _free;
+        Threading::Mutex                 _mutex;
+    };
+
+    // never destroyed; responses may outlive static destruction.
+    BodyBufferPool* s_bodyBufferPool = new BodyBufferPool();
+}
+
+HTTPResponse::Part::Part() :
+_stream     ( &_buffer ),
+_streamValid( false )
+{
+    s_bodyBufferPool->acquire( _data );
+}
+
+HTTPResponse::Part::~Part()
+{
+    s_bodyBufferPool->release( _data );
+}
+
+void
+HTTPResponse::Part::reserve(std::size_t size)
+{
+    _data.reserve(size);
+    _streamValid = false;
+}
+
+void
+HTTPResponse::Part::append(const char* data, std::size_t size)
+{
+    _data.insert(_data.end(), data, data+size);
+    _streamValid = false;
+}
+
+std::istream&
+HTTPResponse::Part::stream()
+{
+    if ( !_streamValid )
+    {
+        _buffer.setView(_data.empty() ? 0L : &_data[0], _data.size());
+        _stream.clear();
+        _streamValid = true;
+    }
+    return _stream;
+}
+
+/****************************************************************************/
+
+AsyncReadResult::AsyncReadResult(const HTTPRequest&    request,
+                                 Type                  type,
+                                 const osgDB::Options* dbOptions,
+                                 ProgressCallback*     progress) :
+_request  ( request ),
+_type     ( type ),
+_dbOptions( dbOptions ),
+_progress ( progress ),
+_decoded  ( false ),
+_addStats ( false )
+{
+    //nop
+}
+
+AsyncReadResult::~AsyncReadResult()
+{
+    //nop
+}
+
+ReadResult
+AsyncReadResult::getResult()
+{
+    Threading::ScopedMutexLock lock( _mutex );
+    if ( !_decoded )
+    {
+        // the engine thread leaves the stats to us, since they aren't thread-safe.
+        if ( _addStats && _progress.valid() )
+        {
+            _progress->stats()["http_get_time"] += _response.getDuration();
+            _progress->stats()["http_get_count"] += 1;
+            if ( _response.isCancelled() )
+                _progress->stats()["http_cancel_count"] += 1;
+        }
+
+        _result = HTTPClient::decodeResponse( _type, _request, _response, _dbOptions.get(), _progress.get() );
+        _decoded = true;
+    }
+    return _result;
+}
+
+/****************************************************************************/
+
 #define QUOTE_(X) #X
 #define QUOTE(X) QUOTE_(X)
 #define USER_AGENT "osgearth" QUOTE(OSGEARTH_MAJOR_VERSION) "." QUOTE(OSGEARTH_MINOR_VERSION)
@@ -381,6 +534,8 @@ namespace
     static osg::ref_ptr< URLRewriter > s_rewriter;
 
     static osg::ref_ptr< CurlConfigHandler > s_curlConfigHandler;
+
+    static int                         s_maxAsyncHostConnections = 8;
 }
 
 HTTPClient&
@@ -546,6 +701,16 @@ void HTTPClient::setCurlConfighandler(CurlConfigHandler* handler)
     s_curlConfigHandler = handler;
 }
 
+int HTTPClient::getMaxAsyncHostConnections()
+{
+    return s_maxAsyncHostConnections;
+}
+
+void HTTPClient::setMaxAsyncHostConnections( int value )
+{
+    s_maxAsyncHostConnections = value;
+}
+
 void
 HTTPClient::globalInit()
 {
@@ -553,7 +718,7 @@ HTTPClient::globalInit()
 }
 
 void
-HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port) const
+HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host, std::string& proxy_port)
 {
     // try to set proxy host/port by reading the CURL proxy options
     if ( options )
@@ -575,17 +740,80 @@ HTTPClient::readOptions(const osgDB::Options* options, std::string& proxy_host,
     }
 }
 
+void
+HTTPClient::getProxySettings(const osgDB::Options* options, std::string& proxy_addr, std::string& proxy_auth)
+{
+    std::string proxy_host;
+    std::string proxy_port = "8080";
+
+    //Try to get the proxy settings from the global settings
+    if (s_proxySettings.isSet())
+    {
+        proxy_host = s_proxySettings.get().hostName();
+        std::stringstream buf;
+        buf << s_proxySettings.get().port();
+        proxy_port = buf.str();
+
+        std::string proxy_username = s_proxySettings.get().userName();
+        std::string proxy_password = s_proxySettings.get().password();
+        if (!proxy_username.empty() && !proxy_password.empty())
+        {
+            proxy_auth = proxy_username + std::string(":") + proxy_password;
+        }
+    }
+
+    //Try to get the proxy settings from the local options that are passed in.
+    readOptions( options, proxy_host, proxy_port );
+
+    optional< ProxySettings > proxySettings;
+    ProxySettings::fromOptions( options, proxySettings );
+    if (proxySettings.isSet())
+    {
+        proxy_host = proxySettings.get().hostName();
+        proxy_port = toString<int>(proxySettings.get().port());
+        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
+    }
+
+    //Try to get the proxy settings from the environment variable
+    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
+    if (proxyEnvAddress) //Env Proxy Settings
+    {
+        proxy_host = std::string(proxyEnvAddress);
+
+        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
+        if (proxyEnvPort)
+        {
+            proxy_port = std::string( proxyEnvPort );
+        }
+    }
+
+    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
+    if (proxyEnvAuth)
+    {
+        proxy_auth = std::string(proxyEnvAuth);
+    }
+
+    if ( !proxy_host.empty() )
+    {
+        std::stringstream buf;
+        buf << proxy_host << ":" << proxy_port;
+        proxy_addr = buf.str();
+    }
+}
+
 bool
 HTTPClient::decodeMultipartStream(const std::string&   boundary,
                                   HTTPResponse::Part*  input,
-                                  HTTPResponse::Parts& output) const
+                                  HTTPResponse::Parts& output)
 {
     std::string bstr = std::string("--") + boundary;
     std::string line;
     char tempbuf[256];
 
+    std::istream& input_stream = input->stream();
+
     // first thing in the stream should be the boundary.
-    input->_stream.read( tempbuf, bstr.length() );
+    input_stream.read( tempbuf, bstr.length() );
     tempbuf[bstr.length()] = 0;
     line = tempbuf;
     if ( line != bstr )
@@ -603,7 +831,7 @@ HTTPClient::decodeMultipartStream(const std::string&   boundary,
         osg::ref_ptr<HTTPResponse::Part> next_part = new HTTPResponse::Part();
 
         // first finish off the boundary.
-        std::getline( input->_stream, line );
+        std::getline( input_stream, line );
         if ( line == "--" )
         {
             done = true;
@@ -614,7 +842,7 @@ HTTPClient::decodeMultipartStream(const std::string&   boundary,
             line = " ";
             while( line.length() > 0 && !done )
             {
-                std::getline( input->_stream, line );
+                std::getline( input_stream, line );
 
                 // check for EOS:
                 if ( line == "--" )
@@ -641,19 +869,15 @@ HTTPClient::decodeMultipartStream(const std::string&   boundary,
             while( bstr_ptr < bstr.length() )
             {
                 char b;
-                input->_stream.read( &b, 1 );
+                input_stream.read( &b, 1 );
                 if ( b == bstr[bstr_ptr] )
                 {
                     bstr_ptr++;
                 }
                 else
                 {
-                    for( unsigned int i=0; i<bstr_ptr; i++ )
-                    {
-                        next_part->_stream << bstr[i];
-                    }
-                    next_part->_stream << b;
-                    next_part->_size += bstr_ptr + 1;
+                    next_part->append( bstr.data(), bstr_ptr );
+                    next_part->append( &b, 1 );
                     bstr_ptr = 0;
                 }
             }
@@ -938,7 +1162,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
         DWORD numBytesRead = 0;
         while( InternetReadFile(hRequest, buffer, 4096, &numBytesRead) && numBytesRead )
         {
-            part->_stream << std::string(buffer, numBytesRead);
+            part->append(buffer, numBytesRead);
         }
 
         response._parts.push_back( part.get() );
@@ -964,6 +1188,20 @@ HTTPClient::doGet(const HTTPRequest&    request,
     return response;
 }
 
+Threading::Future<AsyncReadResult>
+HTTPClient::readAsync(const HTTPRequest&     request,
+                      AsyncReadResult::Type  type,
+                      const osgDB::Options*  options,
+                      ProgressCallback*      progress)
+{
+    // WinInet has no multi interface, so read in the calling thread.
+    Threading::Promise<AsyncReadResult> promise;
+    osg::ref_ptr<AsyncReadResult> result = new AsyncReadResult(request, type, options, progress);
+    result->_response = getClient().doGet( request, options, progress );
+    promise.resolve( result.get() );
+    return promise.getFuture();
+}
+
 #else // OSGEARTH_USE_WININET_FOR_HTTP
 
 HTTPResponse
@@ -984,71 +1222,15 @@ HTTPClient::doGet(const HTTPRequest&    request,
             options->getAuthenticationMap() :
             osgDB::Registry::instance()->getAuthenticationMap();
 
-    std::string proxy_host;
-    std::string proxy_port = "8080";
-
-    std::string proxy_auth;
-
     //TODO: don't do all this proxy setup on every GET. Just do it once per client, or only when
     // the proxy information changes.
-
-    //Try to get the proxy settings from the global settings
-    if (s_proxySettings.isSet())
-    {
-        proxy_host = s_proxySettings.get().hostName();
-        std::stringstream buf;
-        buf << s_proxySettings.get().port();
-        proxy_port = buf.str();
-
-        std::string proxy_username = s_proxySettings.get().userName();
-        std::string proxy_password = s_proxySettings.get().password();
-        if (!proxy_username.empty() && !proxy_password.empty())
-        {
-            proxy_auth = proxy_username + std::string(":") + proxy_password;
-        }
-    }
-
-    //Try to get the proxy settings from the local options that are passed in.
-    readOptions( options, proxy_host, proxy_port );
-
-    optional< ProxySettings > proxySettings;
-    ProxySettings::fromOptions( options, proxySettings );
-    if (proxySettings.isSet())
-    {
-        proxy_host = proxySettings.get().hostName();
-        proxy_port = toString<int>(proxySettings.get().port());
-        OE_DEBUG << LC << "Read proxy settings from options " << proxy_host << " " << proxy_port << std::endl;
-    }
-
-    //Try to get the proxy settings from the environment variable
-    const char* proxyEnvAddress = getenv("OSG_CURL_PROXY");
-    if (proxyEnvAddress) //Env Proxy Settings
-    {
-        proxy_host = std::string(proxyEnvAddress);
-
-        const char* proxyEnvPort = getenv("OSG_CURL_PROXYPORT"); //Searching Proxy Port on Env
-        if (proxyEnvPort)
-        {
-            proxy_port = std::string( proxyEnvPort );
-        }
-    }
-
-    const char* proxyEnvAuth = getenv("OSGEARTH_CURL_PROXYAUTH");
-    if (proxyEnvAuth)
-    {
-        proxy_auth = std::string(proxyEnvAuth);
-    }
+    std::string proxy_addr;
+    std::string proxy_auth;
+    getProxySettings( options, proxy_addr, proxy_auth );
 
     // Set up proxy server:
-    std::string proxy_addr;
-    if ( !proxy_host.empty() )
+    if ( !proxy_addr.empty() )
     {
-        std::stringstream buf;
-        buf << proxy_host << ":" << proxy_port;
-        std::string bufStr;
-        bufStr = buf.str();
-        proxy_addr = bufStr;
-
         if ( s_HTTP_DEBUG )
         {
             OE_NOTICE << LC << "Using proxy: " << proxy_addr << std::endl;
@@ -1141,7 +1323,7 @@ HTTPClient::doGet(const HTTPRequest&    request,
     curl_easy_setopt(_curl_handle, CURLOPT_HTTPHEADER, headers);
 
     osg::ref_ptr<HTTPResponse::Part> part = new HTTPResponse::Part();
-    StreamObject sp( &part->_stream );
+    StreamObject sp( part.get() );
 
     //Take a temporary ref to the callback (why? dangerous.)
     //osg::ref_ptr<ProgressCallback> progressCallback = callback;
@@ -1335,252 +1517,536 @@ HTTPClient::doGet(const HTTPRequest&    request,
     return response;
 }
 
-#endif // USE_WININET
+/****************************************************************************/
 
-bool
-HTTPClient::doDownload(const std::string& url, const std::string& filename)
+namespace
 {
-    initialize();
-
-    // download the data
-    HTTPResponse response = this->doGet( HTTPRequest(url) );
-
-    if ( response.isOK() )
-    {
-        unsigned int part_num = response.getNumParts() > 1? 1 : 0;
-        std::istream& input_stream = response.getPartStream( part_num );
-
-        std::ofstream fout;
-        fout.open(filename.c_str(), std::ios::out | std::ios::binary);
+    // Longest the engine waits on the network before checking for new work,
+    // when curl can't wake it up early.
+    const int ASYNC_POLL_MS = 10;
 
-        input_stream.seekg (0, std::ios::end);
-        int length = input_stream.tellg();
-        input_stream.seekg (0, std::ios::beg);
+    // Idle transfer handles kept for reuse.
+    const unsigned MAX_IDLE_HANDLES = 64u;
+}
 
-        char *buffer = new char[length];
-        input_stream.read(buffer, length);
-        fout.write(buffer, length);
-        delete[] buffer;
-        fout.close();
-        return true;
-    }
-    else
+/**
+ * Drives all readAsync transfers from one thread, through a single curl
+ * multi handle. The multi handle owns the connection cache, so connections
+ * (and TLS sessions) are reused by every transfer no matter which thread
+ * started it, and concurrent transfers to an HTTP/2 server share one
+ * connection.
+ */
+class HTTPClient::AsyncEngine : public OpenThreads::Thread
+{
+public:
+    /** The engine, started on first use. */
+    static AsyncEngine* get()
     {
-        OE_WARN << LC << "Error downloading file " << filename
-            << " (" << response.getCode() << ")" << std::endl;
-        return false;
+        Threading::ScopedMutexLock lock( s_instanceMutex );
+        if ( !s_instance._engine )
+        {
+            s_instance._engine = new AsyncEngine();
+            s_instance._engine->start();
+        }
+        return s_instance._engine;
     }
-}
 
-namespace
-{
-    osgDB::ReaderWriter*
-    getReader( const std::string& url, const HTTPResponse& response )
+    Threading::Future<AsyncReadResult> submit(const HTTPRequest& request, const std::string& url, AsyncReadResult::Type type, const osgDB::Options* options, ProgressCallback* progress)
     {
-        osgDB::ReaderWriter* reader = 0L;
+        Job* job = new Job();
+        job->_result = new AsyncReadResult( request, type, options, progress );
+        job->_url = url;
+        job->_part = new HTTPResponse::Part();
+        job->_stream._part = job->_part.get();
+        job->_start = osg::Timer::instance()->tick();
 
-        // try extension first:
-        std::string ext = osgDB::getFileExtension( url );
-        if ( !ext.empty() )
+        Threading::Future<AsyncReadResult> future = job->_promise.getFuture();
+
+        // simulated failure (for testing)
+        if ( _simResponseCode >= 0 )
         {
-            reader = osgDB::Registry::instance()->getReaderWriterForExtension( ext );
+            job->_result->_response._response_code = _simResponseCode;
+            job->_result->_response._cancelled = _simResponseCode == 408;
+            job->_promise.resolve( job->_result.get() );
+            delete job;
+            return future;
         }
 
-        if ( !reader )
+        for(Headers::const_iterator i = request.getHeaders().begin(); i != request.getHeaders().end(); ++i)
         {
-            // try to look up a reader by mime-type first:
-            std::string mimeType = response.getMimeType();
-            if ( !mimeType.empty() )
-            {
-                reader = osgDB::Registry::instance()->getReaderWriterForMimeType(mimeType);
-            }
+            job->_headers = curl_slist_append( job->_headers, (i->first + ": " + i->second).c_str() );
         }
 
-        if ( !reader && s_HTTP_DEBUG )
+        // Disable the default Pragma: no-cache that curl adds by default.
+        job->_headers = curl_slist_append( job->_headers, "Pragma: " );
+
+        const osgDB::AuthenticationMap* authenticationMap = (options && options->getAuthenticationMap()) ?
+            options->getAuthenticationMap() :
+            osgDB::Registry::instance()->getAuthenticationMap();
+
+        const osgDB::AuthenticationDetails* details = authenticationMap ?
+            authenticationMap->getAuthenticationDetails( url ) :
+            0L;
+
+        if ( details )
         {
-            OE_WARN << LC << "Cannot find an OSG plugin to read response data (ext="
-                << ext << "; mime-type=" << response.getMimeType()
-                << ")" << std::endl;
+            job->_userpwd = details->username + ":" + details->password;
+            job->_httpAuthentication = details->httpAuthentication;
+        }
 
-            if ( endsWith(response.getMimeType(), "xml", false) )
-            {
-                OE_WARN << LC << "Content:\n" << response.getPartAsString(0) << "\n";
-            }
+        getProxySettings( options, job->_proxyAddr, job->_proxyAuth );
+
+        {
+            Threading::ScopedMutexLock lock( _queueMutex );
+            _queue.push_back( job );
+            _jobQueued.signal();
         }
 
-        return reader;
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_wakeup( _multi );
+#endif
+
+        return future;
     }
-}
 
-ReadResult
-HTTPClient::doReadImage(const HTTPRequest&    request,
-                        const osgDB::Options* options,
-                        ProgressCallback*     callback)
-{
-    initialize();
+    void run()
+    {
+        std::vector<Job*> incoming;
 
-    ReadResult result;
+        while( true )
+        {
+            {
+                Threading::ScopedMutexLock lock( _queueMutex );
 
-    HTTPResponse response = this->doGet(request, options, callback);
+                // nothing in flight, so sleep until there's work.
+                while( _queue.empty() && _active == 0u && !_done )
+                    _jobQueued.wait( &_queueMutex );
 
-    if (response.isOK())
-    {
-        osgDB::ReaderWriter* reader = getReader(request.getURL(), response);
-        if (!reader)
-        {
-            result = ReadResult(ReadResult::RESULT_NO_READER);
-        }
+                if ( _done )
+                    break;
 
-        else
-        {
-            osgDB::ReaderWriter::ReadResult rr = reader->readImage(response.getPartStream(0), options);
-            if ( rr.validImage() )
+                incoming.swap( _queue );
+            }
+
+            for(std::vector<Job*>::iterator i = incoming.begin(); i != incoming.end(); ++i)
             {
-                result = ReadResult(rr.takeImage());
+                startJob( *i );
             }
-            else
+            incoming.clear();
+
+            int running = 0;
+            curl_multi_perform( _multi, &running );
+
+            int remaining = 0;
+            while( CURLMsg* msg = curl_multi_info_read(_multi, &remaining) )
             {
-                if ( s_HTTP_DEBUG )
+                if ( msg->msg == CURLMSG_DONE )
                 {
-                    OE_WARN << LC << reader->className()
-                        << " failed to read image from " << request.getURL()
-                        << "; message = " << rr.message()
-                        <<  std::endl;
+                    Job* job = 0L;
+                    curl_easy_getinfo( msg->easy_handle, CURLINFO_PRIVATE, (char**)&job );
+                    finishJob( job, msg->data.result );
                 }
-                result = ReadResult(ReadResult::RESULT_READER_ERROR);
-                result.setErrorDetail( rr.message() );
+            }
+
+            if ( _active > 0u )
+            {
+#if LIBCURL_VERSION_NUM >= 0x074400
+                curl_multi_poll( _multi, 0L, 0, 1000, 0L );
+#else
+                curl_multi_wait( _multi, 0L, 0, ASYNC_POLL_MS, 0L );
+#endif
             }
         }
 
-        // last-modified (file time)
-        result.setLastModifiedTime( response._lastModified ); //getCurlFileTime(_curl_handle) );
+        // abandon whatever is still in flight.
+        for(std::set<Job*>::iterator i = _jobs.begin(); i != _jobs.end(); ++i)
+        {
+            Job* job = *i;
+            curl_multi_remove_handle( _multi, job->_handle );
+            curl_easy_cleanup( job->_handle );
+            job->_handle = 0L;
+            job->_result->_response._cancelled = true;
+            job->_promise.resolve( job->_result.get() );
+            delete job;
+        }
+        _jobs.clear();
 
-        // Time of query
-        result.setDuration( response.getDuration() );
-    }
-    else
-    {
-        result = ReadResult(
-            response.isCancelled()                           ? ReadResult::RESULT_CANCELED :
-            response.getCode() == HTTPResponse::NOT_FOUND    ? ReadResult::RESULT_NOT_FOUND :
-            response.getCode() == HTTPResponse::SERVER_ERROR ? ReadResult::RESULT_SERVER_ERROR :
-            response.getCode() == HTTPResponse::NOT_MODIFIED ? ReadResult::RESULT_NOT_MODIFIED :
-                                                               ReadResult::RESULT_UNKNOWN_ERROR );
+        Threading::ScopedMutexLock lock( _queueMutex );
+        for(std::vector<Job*>::iterator i = _queue.begin(); i != _queue.end(); ++i)
+        {
+            (*i)->_result->_response._cancelled = true;
+            (*i)->_promise.resolve( (*i)->_result.get() );
+            delete *i;
+        }
+        _queue.clear();
+    }
+
+private:
+    struct Job
+    {
+        Job() : _handle(0L), _headers(0L), _httpAuthentication(0L), _stream(0L) { }
+        ~Job() { if (_headers) curl_slist_free_all(_headers); }
+
+        Threading::Promise<AsyncReadResult> _promise;
+        osg::ref_ptr<AsyncReadResult>       _result;
+        osg::ref_ptr<HTTPResponse::Part>    _part;
+        CURL*                               _handle;
+        curl_slist*                         _headers;
+        std::string                         _url;
+        std::string                         _userpwd;
+        long                                _httpAuthentication;
+        std::string                         _proxyAddr;
+        std::string                         _proxyAuth;
+        StreamObject                        _stream;
+        osg::Timer_t                        _start;
+    };
 
-        //If we have an error but it's recoverable, like a server error or timeout then set the callback to retry.
-        if (HTTPClient::isRecoverable( result.code() ) )
+    // Deletes the engine at exit, after finishing it off.
+    struct Instance
+    {
+        Instance() : _engine(0L) { }
+        ~Instance()
         {
-            if (callback)
+            if ( _engine )
             {
-                if ( s_HTTP_DEBUG )
-                {
-                    if (response.isCancelled())
-                        OE_NOTICE << LC << "Request was cancelled" << std::endl;
-                    else
-                        OE_NOTICE << LC << "Error in HTTPClient for " << request.getURL() << " but it's recoverable" << std::endl;
-                }
-                callback->setNeedsRetry( true );
+                _engine->stop();
+                delete _engine;
             }
         }
-    }
+        AsyncEngine* _engine;
+    };
 
-    // encode headers
-    result.setMetadata( response.getHeadersAsConfig() );
+    static Instance         s_instance;
+    static Threading::Mutex s_instanceMutex;
 
-    // set the source name
-    if ( result.getImage() )
-        result.getImage()->setName( request.getURL() );
+    AsyncEngine() :
+        _done           ( false ),
+        _active         ( 0u ),
+        _simResponseCode( -1L ),
+        _timeout        ( s_timeout ),
+        _connectTimeout ( s_connectTimeout )
+    {
+        _multi = curl_multi_init();
 
-    return result;
-}
+        curl_multi_setopt( _multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)s_maxAsyncHostConnections );
 
-ReadResult
-HTTPClient::doReadNode(const HTTPRequest&    request,
-                       const osgDB::Options* options,
-                       ProgressCallback*     callback)
-{
-    initialize();
+#if LIBCURL_VERSION_NUM >= 0x072B00
+        // share HTTP/2 connections between transfers to the same host.
+        curl_multi_setopt( _multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+#endif
 
-    ReadResult result;
+        _userAgent = s_userAgent;
+        const char* userAgentEnv = ::getenv("OSGEARTH_USERAGENT");
+        if ( userAgentEnv )
+            _userAgent = std::string(userAgentEnv);
 
-    HTTPResponse response = this->doGet(request, options, callback);
+        const char* simCode = ::getenv("OSGEARTH_SIMULATE_HTTP_RESPONSE_CODE");
+        if ( simCode )
+            _simResponseCode = osgEarth::as<long>(std::string(simCode), 404L);
+
+        if ( ::getenv("OSGEARTH_HTTP_DISABLE") )
+            _simResponseCode = 503L; // SERVICE UNAVAILABLE
+
+        const char* timeoutEnv = ::getenv("OSGEARTH_HTTP_TIMEOUT");
+        if ( timeoutEnv )
+            _timeout = osgEarth::as<long>(std::string(timeoutEnv), 0);
+
+        const char* connectTimeoutEnv = ::getenv("OSGEARTH_HTTP_CONNECTTIMEOUT");
+        if ( connectTimeoutEnv )
+            _connectTimeout = osgEarth::as<long>(std::string(connectTimeoutEnv), 0);
+    }
 
-    if (response.isOK())
+    ~AsyncEngine()
+    {
+        for(std::vector<CURL*>::iterator i = _idleHandles.begin(); i != _idleHandles.end(); ++i)
+            curl_easy_cleanup( *i );
+
+        curl_multi_cleanup( _multi );
+    }
+
+    void stop()
     {
-        osgDB::ReaderWriter* reader = getReader(request.getURL(), response);
-        if (!reader)
         {
-            result = ReadResult(ReadResult::RESULT_NO_READER);
+            Threading::ScopedMutexLock lock( _queueMutex );
+            _done = true;
+            _jobQueued.signal();
         }
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_wakeup( _multi );
+#endif
+        join();
+    }
+
+    // Cancels a transfer when its ProgressCallback is canceled, or when no
+    // one is waiting for the result anymore. This runs on the engine thread,
+    // so it only reads the atomic flag that cancel() sets; an override of
+    // isCanceled() or reportProgress() might not be thread-safe.
+    static int progressCallback(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow)
+    {
+        Job* job = (Job*)clientp;
+        if ( job->_promise.isAbandoned() )
+            return 1;
 
+        ProgressCallback* progress = job->_result->_progress.get();
+        return progress && progress->ProgressCallback::isCanceled() ? 1 : 0;
+    }
+
+    void startJob(Job* job)
+    {
+        CURL* handle;
+        if ( !_idleHandles.empty() )
+        {
+            handle = _idleHandles.back();
+            _idleHandles.pop_back();
+            curl_easy_reset( handle );
+        }
         else
         {
-            osgDB::ReaderWriter::ReadResult rr = reader->readNode(response.getPartStream(0), options);
-            if ( rr.validNode() )
+            handle = curl_easy_init();
+        }
+        job->_handle = handle;
+
+        curl_easy_setopt( handle, CURLOPT_PRIVATE, (void*)job );
+        curl_easy_setopt( handle, CURLOPT_URL, job->_url.c_str() );
+        curl_easy_setopt( handle, CURLOPT_USERAGENT, _userAgent.c_str() );
+        curl_easy_setopt( handle, CURLOPT_WRITEFUNCTION, osgEarth::StreamObjectReadCallback );
+        curl_easy_setopt( handle, CURLOPT_WRITEDATA, (void*)&job->_stream );
+        curl_easy_setopt( handle, CURLOPT_HEADERFUNCTION, osgEarth::StreamObjectHeaderCallback );
+        curl_easy_setopt( handle, CURLOPT_HEADERDATA, (void*)&job->_stream );
+        curl_easy_setopt( handle, CURLOPT_HTTPHEADER, job->_headers );
+        curl_easy_setopt( handle, CURLOPT_FOLLOWLOCATION, 1L );
+        curl_easy_setopt( handle, CURLOPT_MAXREDIRS, 5L );
+        curl_easy_setopt( handle, CURLOPT_FILETIME, 1L );
+        curl_easy_setopt( handle, CURLOPT_ENCODING, "" );
+        curl_easy_setopt( handle, CURLOPT_TIMEOUT, _timeout );
+        curl_easy_setopt( handle, CURLOPT_CONNECTTIMEOUT, _connectTimeout );
+        curl_easy_setopt( handle, CURLOPT_NOSIGNAL, 1L );
+        curl_easy_setopt( handle, CURLOPT_SSL_VERIFYPEER, 0L );
+        curl_easy_setopt( handle, CURLOPT_PROGRESSFUNCTION, &AsyncEngine::progressCallback );
+        curl_easy_setopt( handle, CURLOPT_PROGRESSDATA, (void*)job );
+        curl_easy_setopt( handle, CURLOPT_NOPROGRESS, 0L );
+
+#if LIBCURL_VERSION_NUM >= 0x072F00
+        // HTTP/2 over TLS when the server offers it, HTTP/1.1 otherwise.
+        curl_easy_setopt( handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS );
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072B00
+        // wait for a connection that can multiplex rather than opening another.
+        curl_easy_setopt( handle, CURLOPT_PIPEWAIT, 1L );
+#endif
+
+        if ( !job->_proxyAddr.empty() )
+        {
+            curl_easy_setopt( handle, CURLOPT_PROXY, job->_proxyAddr.c_str() );
+            if ( !job->_proxyAuth.empty() )
+                curl_easy_setopt( handle, CURLOPT_PROXYUSERPWD, job->_proxyAuth.c_str() );
+        }
+
+        if ( !job->_userpwd.empty() )
+        {
+            curl_easy_setopt( handle, CURLOPT_USERPWD, job->_userpwd.c_str() );
+#if LIBCURL_VERSION_NUM >= 0x070a07
+            if ( job->_httpAuthentication != 0L )
+                curl_easy_setopt( handle, CURLOPT_HTTPAUTH, job->_httpAuthentication );
+#endif
+        }
+
+        osg::ref_ptr< CurlConfigHandler > curlConfigHandler = getCurlConfigHandler();
+        if ( curlConfigHandler.valid() )
+        {
+            curlConfigHandler->onInitialize( handle );
+            curlConfigHandler->onGet( handle );
+        }
+
+        _jobs.insert( job );
+        ++_active;
+        curl_multi_add_handle( _multi, handle );
+    }
+
+    void finishJob(Job* job, CURLcode res)
+    {
+        CURL* handle = job->_handle;
+        HTTPResponse& response = job->_result->_response;
+
+        curl_easy_getinfo( handle, CURLINFO_RESPONSE_CODE, &response._response_code );
+
+        char* content_type_cp = 0L;
+        curl_easy_getinfo( handle, CURLINFO_CONTENT_TYPE, &content_type_cp );
+        if ( content_type_cp != 0L )
+            response._mimeType = content_type_cp;
+
+        response._lastModified = getCurlFileTime( handle );
+
+        if ( res == CURLE_OK )
+        {
+            if (response._mimeType.length() > 9 &&
+                ::strstr( response._mimeType.c_str(), "multipart" ) == response._mimeType.c_str() )
             {
-                result = ReadResult(rr.takeNode());
+                //TODO: parse out the "wcs" -- this is WCS-specific
+                decodeMultipartStream( "wcs", job->_part.get(), response._parts );
             }
             else
             {
-                if ( s_HTTP_DEBUG )
-                {
-                    OE_WARN << LC << reader->className()
-                        << " failed to read node from " << request.getURL()
-                        << "; message = " << rr.message()
-                        <<  std::endl;
-                }
-                result = ReadResult(ReadResult::RESULT_READER_ERROR);
-                result.setErrorDetail( rr.message() );
+                job->_part->_headers = job->_stream._headers;
+                response._parts.push_back( job->_part.get() );
             }
         }
+        else if ( res == CURLE_ABORTED_BY_CALLBACK || res == CURLE_OPERATION_TIMEDOUT )
+        {
+            response._cancelled = true;
+        }
+        else
+        {
+            response._message = curl_easy_strerror( res );
+        }
+
+        // getResult() adds these to the progress stats on the caller's thread.
+        response._duration_s = osg::Timer::instance()->delta_s( job->_start, osg::Timer::instance()->tick() );
+        job->_result->_addStats = true;
+
+        if ( s_HTTP_DEBUG )
+        {
+            OE_NOTICE << LC
+                << "GET(" << response._response_code << ") async " << response._mimeType << ": \""
+                << job->_url << "\" t=" << std::setprecision(4) << response._duration_s << "s" << std::endl;
+        }
+
+        curl_multi_remove_handle( _multi, handle );
+        if ( _idleHandles.size() < MAX_IDLE_HANDLES )
+            _idleHandles.push_back( handle );
+        else
+            curl_easy_cleanup( handle );
+
+        _jobs.erase( job );
+        --_active;
+
+        job->_promise.resolve( job->_result.get() );
+        delete job;
+    }
+
+    CURLM*                  _multi;
+    std::vector<Job*>       _queue;          // submitted, not yet started
+    Threading::Mutex        _queueMutex;
+    OpenThreads::Condition  _jobQueued;
+    bool                    _done;
+
+    // engine thread only:
+    std::set<Job*>          _jobs;           // in flight
+    unsigned                _active;
+    std::vector<CURL*>      _idleHandles;
+
+    std::string             _userAgent;
+    long                    _simResponseCode;
+    long                    _timeout;
+    long                    _connectTimeout;
+};
+
+HTTPClient::AsyncEngine::Instance HTTPClient::AsyncEngine::s_instance;
+Threading::Mutex                  HTTPClient::AsyncEngine::s_instanceMutex;
+
+Threading::Future<AsyncReadResult>
+HTTPClient::readAsync(const HTTPRequest&     request,
+                      AsyncReadResult::Type  type,
+                      const osgDB::Options*  options,
+                      ProgressCallback*      progress)
+{
+    std::string url = request.getURL();
 
-        // last-modified (file time)
-        result.setLastModifiedTime( response._lastModified ); //getCurlFileTime(_curl_handle) );
+    // Rewrite the url if the url rewriter is available
+    osg::ref_ptr< URLRewriter > rewriter = getURLRewriter();
+    if ( rewriter.valid() )
+    {
+        url = rewriter->rewrite( url );
+    }
+
+    return AsyncEngine::get()->submit( request, url, type, options, progress );
+}
+
+#endif // USE_WININET
+
+bool
+HTTPClient::doDownload(const std::string& url, const std::string& filename)
+{
+    initialize();
+
+    // download the data
+    HTTPResponse response = this->doGet( HTTPRequest(url) );
+
+    if ( response.isOK() )
+    {
+        unsigned int part_num = response.getNumParts() > 1? 1 : 0;
+        const std::vector<char>& data = response._parts[part_num]->_data;
+
+        std::ofstream fout;
+        fout.open(filename.c_str(), std::ios::out | std::ios::binary);
+        if ( !data.empty() )
+            fout.write(&data[0], data.size());
+        fout.close();
+        return true;
     }
     else
     {
-        result = ReadResult(
-            response.isCancelled()                           ? ReadResult::RESULT_CANCELED :
-            response.getCode() == HTTPResponse::NOT_FOUND    ? ReadResult::RESULT_NOT_FOUND :
-            response.getCode() == HTTPResponse::SERVER_ERROR ? ReadResult::RESULT_SERVER_ERROR :
-            response.getCode() == HTTPResponse::NOT_MODIFIED ? ReadResult::RESULT_NOT_MODIFIED :
-                                                               ReadResult::RESULT_UNKNOWN_ERROR );
+        OE_WARN << LC << "Error downloading file " << filename
+            << " (" << response.getCode() << ")" << std::endl;
+        return false;
+    }
+}
 
-        //If we have an error but it's recoverable, like a server error or timeout then set the callback to retry.
-        if (HTTPClient::isRecoverable( result.code() ) )
+namespace
+{
+    osgDB::ReaderWriter*
+    getReader( const std::string& url, const HTTPResponse& response )
+    {
+        osgDB::ReaderWriter* reader = 0L;
+
+        // try extension first:
+        std::string ext = osgDB::getFileExtension( url );
+        if ( !ext.empty() )
         {
-            if (callback)
+            reader = osgDB::Registry::instance()->getReaderWriterForExtension( ext );
+        }
+
+        if ( !reader )
+        {
+            // try to look up a reader by mime-type first:
+            std::string mimeType = response.getMimeType();
+            if ( !mimeType.empty() )
             {
-                if ( s_HTTP_DEBUG )
-                {
-                    if (response.isCancelled())
-                        OE_NOTICE << LC << "Request was cancelled" << std::endl;
-                    else
-                        OE_NOTICE << LC << "Error in HTTPClient for " << request.getURL() << " but it's recoverable" << std::endl;
-                }
-                callback->setNeedsRetry( true );
+                reader = osgDB::Registry::instance()->getReaderWriterForMimeType(mimeType);
             }
         }
-    }
 
-    // encode headers
-    result.setMetadata( response.getHeadersAsConfig() );
+        if ( !reader && s_HTTP_DEBUG )
+        {
+            OE_WARN << LC << "Cannot find an OSG plugin to read response data (ext="
+                << ext << "; mime-type=" << response.getMimeType()
+                << ")" << std::endl;
 
-    return result;
+            if ( endsWith(response.getMimeType(), "xml", false) )
+            {
+                OE_WARN << LC << "Content:\n" << response.getPartAsString(0) << "\n";
+            }
+        }
+
+        return reader;
+    }
 }
 
 ReadResult
-HTTPClient::doReadObject(const HTTPRequest&    request,
-                         const osgDB::Options* options,
-                         ProgressCallback*     callback)
+HTTPClient::decodeResponse(AsyncReadResult::Type  type,
+                           const HTTPRequest&     request,
+                           const HTTPResponse&    response,
+                           const osgDB::Options*  options,
+                           ProgressCallback*      callback)
 {
-    initialize();
-
     ReadResult result;
 
-    HTTPResponse response = this->doGet(request, options, callback);
+    if ( response.isOK() && type == AsyncReadResult::STRING )
+    {
+        result = ReadResult( new StringObject(response.getPartAsString(0)) );
+    }
 
-    if (response.isOK())
+    else if ( response.isOK() )
     {
         osgDB::ReaderWriter* reader = getReader(request.getURL(), response);
         if (!reader)
@@ -1590,8 +2056,16 @@ HTTPClient::doReadObject(const HTTPRequest&    request,
 
         else
         {
-            osgDB::ReaderWriter::ReadResult rr = reader->readObject(response.getPartStream(0), options);
-            if ( rr.validObject() )
+            osgDB::ReaderWriter::ReadResult rr =
+                type == AsyncReadResult::IMAGE ? reader->readImage(response.getPartStream(0), options) :
+                type == AsyncReadResult::NODE  ? reader->readNode(response.getPartStream(0), options) :
+                                                 reader->readObject(response.getPartStream(0), options);
+
+            bool valid =
+                type == AsyncReadResult::IMAGE ? rr.validImage() :
+                type == AsyncReadResult::NODE  ? rr.validNode() :
+                                                 rr.validObject();
+            if ( valid )
             {
                 result = ReadResult(rr.takeObject());
             }
@@ -1600,7 +2074,9 @@ HTTPClient::doReadObject(const HTTPRequest&    request,
                 if ( s_HTTP_DEBUG )
                 {
                     OE_WARN << LC << reader->className()
-                        << " failed to read object from " << request.getURL()
+                        << " failed to read "
+                        << (type == AsyncReadResult::IMAGE ? "image" : type == AsyncReadResult::NODE ? "node" : "object")
+                        << " from " << request.getURL()
                         << "; message = " << rr.message()
                         <<  std::endl;
                 }
@@ -1609,57 +2085,13 @@ HTTPClient::doReadObject(const HTTPRequest&    request,
             }
         }
 
-        // last-modified (file time)
-        result.setLastModifiedTime( response._lastModified ); //getCurlFileTime(_curl_handle) );
-    }
-    else
-    {
-        result = ReadResult(
-            response.isCancelled() ? ReadResult::RESULT_CANCELED :
-            response.getCode() == HTTPResponse::NOT_FOUND ? ReadResult::RESULT_NOT_FOUND :
-            response.getCode() == HTTPResponse::SERVER_ERROR ? ReadResult::RESULT_SERVER_ERROR :
-            response.getCode() == HTTPResponse::NOT_MODIFIED ? ReadResult::RESULT_NOT_MODIFIED :
-            ReadResult::RESULT_UNKNOWN_ERROR );
-
-        //If we have an error but it's recoverable, like a server error or timeout then set the callback to retry.
-        if (HTTPClient::isRecoverable( result.code() ) )
-        {
-            if (callback)
-            {
-                if ( s_HTTP_DEBUG )
-                {
-                    if (response.isCancelled())
-                        OE_NOTICE << LC << "Request was cancelled" << std::endl;
-                    else
-                        OE_NOTICE << LC << "Error in HTTPClient for " << request.getURL() << " but it's recoverable" << std::endl;
-                }
-                callback->setNeedsRetry( true );
-            }
-        }
-    }
-
-    result.setMetadata( response.getHeadersAsConfig() );
-
-    return result;
-}
-
-
-ReadResult
-HTTPClient::doReadString(const HTTPRequest&    request,
-                         const osgDB::Options* options,
-                         ProgressCallback*     callback )
-{
-    initialize();
-
-    ReadResult result;
-
-    HTTPResponse response = this->doGet( request, options, callback );
-    if ( response.isOK() )
-    {
-        result = ReadResult( new StringObject(response.getPartAsString(0)) );
+        // Time of query
+        if ( type == AsyncReadResult::IMAGE )
+            result.setDuration( response.getDuration() );
     }
 
-    else if ( response.getCode() >= 400 && response.getCode() < 500 && response.getCode() != 404 )
+    else if ( type == AsyncReadResult::STRING &&
+              response.getCode() >= 400 && response.getCode() < 500 && response.getCode() != 404 )
     {
         // for request errors, return an error result with the part data intact
         // so the user can parse it as needed. We only do this for readString.
@@ -1671,7 +2103,7 @@ HTTPClient::doReadString(const HTTPRequest&    request,
     else
     {
         result = ReadResult(
-            response.isCancelled() ?                           ReadResult::RESULT_CANCELED :
+            response.isCancelled()                           ? ReadResult::RESULT_CANCELED :
             response.getCode() == HTTPResponse::NOT_FOUND    ? ReadResult::RESULT_NOT_FOUND :
             response.getCode() == HTTPResponse::SERVER_ERROR ? ReadResult::RESULT_SERVER_ERROR :
             response.getCode() == HTTPResponse::NOT_MODIFIED ? ReadResult::RESULT_NOT_MODIFIED :
@@ -1698,7 +2130,60 @@ HTTPClient::doReadString(const HTTPRequest&    request,
     result.setMetadata( response.getHeadersAsConfig() );
 
     // last-modified (file time)
-    result.setLastModifiedTime( response._lastModified ); //getCurlFileTime(_curl_handle) );
+    if ( response.isOK() || type == AsyncReadResult::STRING )
+        result.setLastModifiedTime( response._lastModified );
+
+    // set the source name
+    if ( result.getImage() )
+        result.getImage()->setName( request.getURL() );
 
     return result;
 }
+
+ReadResult
+HTTPClient::doReadImage(const HTTPRequest&    request,
+                        const osgDB::Options* options,
+                        ProgressCallback*     callback)
+{
+    initialize();
+
+    HTTPResponse response = this->doGet(request, options, callback);
+
+    return decodeResponse(AsyncReadResult::IMAGE, request, response, options, callback);
+}
+
+ReadResult
+HTTPClient::doReadNode(const HTTPRequest&    request,
+                       const osgDB::Options* options,
+                       ProgressCallback*     callback)
+{
+    initialize();
+
+    HTTPResponse response = this->doGet(request, options, callback);
+
+    return decodeResponse(AsyncReadResult::NODE, request, response, options, callback);
+}
+
+ReadResult
+HTTPClient::doReadObject(const HTTPRequest&    request,
+                         const osgDB::Options* options,
+                         ProgressCallback*     callback)
+{
+    initialize();
+
+    HTTPResponse response = this->doGet(request, options, callback);
+
+    return decodeResponse(AsyncReadResult::OBJECT, request, response, options, callback);
+}
+
+ReadResult
+HTTPClient::doReadString(const HTTPRequest&    request,
+                         const osgDB::Options* options,
+                         ProgressCallback*     callback )
+{
+    initialize();
+
+    HTTPResponse response = this->doGet( request, options, callback );
+
+    return decodeResponse(AsyncReadResult::STRING, request, response, options, callback);
+}
@@ -53,6 +53,50 @@ void StringObject::setString( const std::string& value )
 
 //------------------------------------------------------------------------
 
+MemoryStreamBuffer::MemoryStreamBuffer()
+{
+    //nop
+}
+
+MemoryStreamBuffer::MemoryStreamBuffer( const char* data, std::size_t size )
+{
+    setView( data, size );
+}
+
+void
+MemoryStreamBuffer::setView( const char* data, std::size_t size )
+{
+    // the get area is never written through, so casting away const is safe.
+    char* p = const_cast<char*>( data );
+    setg( p, p, p + size );
+}
+
+MemoryStreamBuffer::pos_type
+MemoryStreamBuffer::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which )
+{
+    if ( (which & std::ios_base::in) == 0 )
+        return pos_type(off_type(-1));
+
+    char* pos =
+        dir == std::ios_base::beg ? eback() + off :
+        dir == std::ios_base::cur ? gptr()  + off :
+                                    egptr() + off;
+
+    if ( pos < eback() || pos > egptr() )
+        return pos_type(off_type(-1));
+
+    setg( eback(), pos, egptr() );
+    return pos_type(off_type(pos - eback()));
+}
+
+MemoryStreamBuffer::pos_type
+MemoryStreamBuffer::seekpos( pos_type pos, std::ios_base::openmode which )
+{
+    return seekoff( off_type(pos), std::ios_base::beg, which );
+}
+
+//------------------------------------------------------------------------
+
 URIReadCallback::URIReadCallback()
 {
     //nop
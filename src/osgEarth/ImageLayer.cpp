@@ -47,6 +47,17 @@ namespace osgEarth {
     REGISTER_OSGEARTH_LAYER(image, ImageLayer);
 }
 
+namespace
+{
+    // Copy of a tile's image for a coalesced request to own
+    GeoImage copyOf(const GeoImage& image)
+    {
+        if ( !image.valid() )
+            return image;
+        return GeoImage( osg::clone(image.getImage(), osg::CopyOp::SHALLOW_COPY), image.getExtent() );
+    }
+}
+
 //------------------------------------------------------------------------
 
 ImageLayerOptions::ImageLayerOptions() :
@@ -583,14 +594,54 @@ ImageLayer::createImageInKeyProfile(const TileKey&    key,
         return GeoImage::INVALID;
     }
 
+    // the cache key combines the Key and the horizontal profile.
+    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature();
+
+    // Concurrent requests for the same tile wait on a single fetch.
+    InFlightImages::Scope flight(_inFlight, cacheKey);
+    if ( !flight.isLeader() )
+    {
+        while ( !flight.wait(100u) )
+        {
+            if ( progress && progress->isCanceled() )
+                return GeoImage::INVALID;
+        }
+
+        if ( flight.succeeded() )
+        {
+            countCoalescedRequest();
+            return copyOf( flight.result() );
+        }
+
+        // the first fetch was abandoned, so do it again.
+        countDuplicateRequest();
+        return fetchImageInKeyProfile( key, cacheKey, progress );
+    }
+
+    GeoImage result = fetchImageInKeyProfile( key, cacheKey, progress );
+
+    // Don't share a failure that was caused by the leader's cancelation;
+    // let the waiting callers fetch the tile themselves.
+    if ( result.valid() || !progress || !progress->isCanceled() )
+    {
+        // Followers copy a private snapshot, so in-place changes to one
+        // tile's result don't leak into another's.
+        flight.resolve( flight.close() > 0u ? copyOf(result) : result );
+    }
+
+    return result;
+}
 
+GeoImage
+ImageLayer::fetchImageInKeyProfile(const TileKey&     key,
+                                   const std::string& cacheKey,
+                                   ProgressCallback*  progress)
+{
     GeoImage result;
 
     OE_DEBUG << LC << "create image for \"" << key.str() << "\", ext= "
         << key.getExtent().toString() << std::endl;
 
-    // the cache key combines the Key and the horizontal profile.
-    std::string cacheKey = Stringify() << key.str() << "_" << key.getProfile()->getHorizSignature();
     const CachePolicy& policy = getCacheSettings()->cachePolicy().get();
     
     // Check the layer L2 cache first
@@ -742,9 +793,15 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
     osg::ref_ptr<TileSource::ImageOperation> op = getOrCreatePreCacheOp();
 
     // Fail is the image is blacklisted.
-    if ( source->getBlacklist()->contains(key) )
+    TileBlacklist::Reason reason;
+    if ( source->getBlacklist()->contains(key, reason) )
     {
         OE_DEBUG << LC << "createImageFromTileSource: blacklisted(" << key.str() << ")" << std::endl;
+
+        // an earlier recoverable error: ask the caller to come back later.
+        if ( reason == TileBlacklist::REASON_ERROR && progress )
+            progress->setNeedsRetry( true );
+
         return GeoImage::INVALID;
     }
 
@@ -770,9 +827,9 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
         ImageUtils::featherAlphaRegions( result.get() );
     }    
     
-    // If image creation failed (but was not intentionally canceled and 
-    // didn't time out or end for any other recoverable reason), then
-    // blacklist this tile for future requests.
+    // If image creation failed (but was not intentionally canceled), then
+    // blacklist this tile for future requests. A recoverable error, like a
+    // timeout, only holds the tile back for a short while.
     if (result == 0L)
     {
         if ( progress == 0L ||
@@ -780,6 +837,10 @@ ImageLayer::createImageFromTileSource(const TileKey&    key,
         {
             source->getBlacklist()->add( key );
         }
+        else if ( !progress->isCanceled() )
+        {
+            source->getBlacklist()->add( key, TileBlacklist::REASON_ERROR );
+        }
     }
 
     return GeoImage(result.get(), key.getExtent());
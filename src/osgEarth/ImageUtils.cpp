@@ -1117,6 +1117,39 @@ ImageUtils::isSingleColorImage(const osg::Image* image, float threshold)
     return true;
 }
 
+bool
+ImageUtils::isUniformImage(const osg::Image* image)
+{
+    if ( !image || !image->data() || image->isCompressed() || image->isMipmap() )
+        return false;
+
+    unsigned bits = image->getPixelSizeInBits();
+    if ( bits == 0 || (bits % 8) != 0 )
+        return false;
+
+    const unsigned pixelBytes = bits / 8;
+    const unsigned rowBytes = pixelBytes * image->s();
+    const unsigned char* first = image->data(0, 0, 0);
+
+    // the first row against its first pixel...
+    for(unsigned s=1; s<(unsigned)image->s(); ++s)
+    {
+        if ( memcmp(first + s*pixelBytes, first, pixelBytes) != 0 )
+            return false;
+    }
+
+    // ...then every other row against the first row.
+    for(unsigned r=0; r<(unsigned)image->r(); ++r)
+    {
+        for(unsigned t=0; t<(unsigned)image->t(); ++t)
+        {
+            if ( (r > 0 || t > 0) && memcmp(image->data(0, t, r), first, rowBytes) != 0 )
+                return false;
+        }
+    }
+    return true;
+}
+
 bool
 ImageUtils::computeTextureCompressionMode(const osg::Image*                 image,
                                           osg::Texture::InternalFormatMode& out_mode)
@@ -144,7 +144,7 @@ Layer::setReadOptions(const osgDB::Options* readOptions)
         std::string binID = getCacheID();
 
         // make our cacheing bin!
-        CacheBin* bin = _cacheSettings->getCache()->addBin(binID);
+        CacheBin* bin = _cacheSettings->getCache()->openBin(binID);
         if (bin)
         {
             OE_INFO << LC << "Cache bin is [" << binID << "]\n";
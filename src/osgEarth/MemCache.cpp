@@ -20,6 +20,8 @@
 #include <osgEarth/StringUtils>
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/Containers>
+#include <osg/Image>
+#include <osg/Shape>
 
 using namespace osgEarth;
 
@@ -32,13 +34,44 @@ namespace
     typedef std::pair<osg::ref_ptr<const osg::Object>, Config> MemCacheEntry;
     typedef LRUCache<std::string, MemCacheEntry> MemCacheLRU;
 
+    // Approximate memory footprint of a cached object, for byte-budgeted bins.
+    unsigned getSizeInBytes(const osg::Object* object)
+    {
+        unsigned size = sizeof(MemCacheEntry);
+
+        const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+        if ( image )
+        {
+            return size + sizeof(osg::Image) + image->getTotalSizeInBytesIncludingMipmaps();
+        }
+
+        const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+        if ( hf )
+        {
+            return size + sizeof(osg::HeightField) + hf->getNumColumns()*hf->getNumRows()*sizeof(float);
+        }
+
+        const StringObject* so = dynamic_cast<const StringObject*>(object);
+        if ( so )
+        {
+            return size + sizeof(StringObject) + so->getString().size();
+        }
+
+        // unknown object type; assume it is small.
+        return size + sizeof(osg::Object);
+    }
+
     struct MemCacheBin : public CacheBin
     {
-        MemCacheBin( const std::string& id, unsigned maxSize )
+        MemCacheBin( const std::string& id, unsigned maxSize, unsigned maxBytes, bool share )
             : CacheBin( id ),
-              _lru    ( true /* MT-safe */, maxSize )
+              _lru    ( true /* MT-safe */, maxSize ),
+              _share  ( share )
         {
-            //nop
+            if ( maxBytes > 0 )
+            {
+                _lru.setMaxCost( maxBytes );
+            }
         }
 
         ReadResult readObject(const std::string& key, const osgDB::Options*)
@@ -46,15 +79,17 @@ namespace
             MemCacheLRU::Record rec;
             _lru.get(key, rec);
 
-            // clone required since the cache is in memory
-
             if ( rec.valid() )
             {
                 //OE_INFO << LC << "hits: " << _lru.getStats()._hitRatio*100.0f << "%" << std::endl;
 
-                return ReadResult( 
-                   osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL),
-                   rec.value().second );
+                // In shared mode the cached object is frozen and returned by
+                // reference; otherwise clone it since the cache is in memory.
+                osg::Object* object = _share ?
+                    const_cast<osg::Object*>(rec.value().first.get()) :
+                    osg::clone(rec.value().first.get(), osg::CopyOp::DEEP_COPY_ALL);
+
+                return ReadResult( object, rec.value().second );
             }
             else
             {
@@ -77,8 +112,12 @@ namespace
         {
             if ( object ) 
             {
-                osg::ref_ptr<const osg::Object> cloned = osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
-                _lru.insert( key, std::make_pair(cloned.get(), meta) );
+                osg::ref_ptr<const osg::Object> entry = _share ?
+                    object :
+                    osg::clone(object, osg::CopyOp::DEEP_COPY_ALL);
+
+                unsigned cost = _lru.getMaxCost() > 0 ? getSizeInBytes(object) : 1u;
+                _lru.insert( key, std::make_pair(entry, meta), cost );
                 return true;
             }
             else
@@ -116,6 +155,7 @@ namespace
         }
 
         MemCacheLRU _lru;
+        bool        _share;
     };
     
 
@@ -125,7 +165,9 @@ namespace
 //------------------------------------------------------------------------
 
 MemCache::MemCache( unsigned maxBinSize ) :
-_maxBinSize( std::max(maxBinSize, 1u) )
+_maxBinSize  ( std::max(maxBinSize, 1u) ),
+_maxBinBytes ( 0u ),
+_shareObjects( false )
 {
     //nop
 }
@@ -133,7 +175,7 @@ _maxBinSize( std::max(maxBinSize, 1u) )
 CacheBin*
 MemCache::addBin( const std::string& binID )
 {
-    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize) );
+    return _bins.getOrCreate( binID, new MemCacheBin(binID, _maxBinSize, _maxBinBytes, _shareObjects) );
 }
 
 CacheBin*
@@ -154,7 +196,7 @@ MemCache::getOrCreateDefaultBin()
         // double check
         if ( !_defaultBin.valid() )
         {
-            _defaultBin = new MemCacheBin("__default", _maxBinSize);
+            _defaultBin = new MemCacheBin("__default", _maxBinSize, _maxBinBytes, _shareObjects);
         }
     }
 
@@ -167,5 +209,7 @@ MemCache::dumpStats(const std::string& binID)
 {
     MemCacheBin* bin = static_cast<MemCacheBin*>(getBin(binID));
     CacheStats stats = bin->_lru.getStats();
-    OE_INFO << LC << "hit ratio = " << stats._hitRatio << std::endl;
+    OE_INFO << LC << "hit ratio = " << stats._hitRatio
+        << ", entries = " << stats._entries
+        << ", bytes = " << bin->_lru.getCost() << std::endl;
 }
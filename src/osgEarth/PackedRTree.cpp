@@ -0,0 +1,192 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/PackedRTree>
+#include <algorithm>
+
+using namespace osgEarth;
+
+namespace
+{
+    // entries per node
+    const unsigned NODE_SIZE = 16;
+
+    // Distance of (x, y) along a Hilbert curve filling a 65536x65536 grid.
+    unsigned hilbert(unsigned x, unsigned y)
+    {
+        unsigned d = 0;
+        for(unsigned s = 1u << 15; s > 0; s >>= 1)
+        {
+            unsigned rx = (x & s) > 0 ? 1u : 0u;
+            unsigned ry = (y & s) > 0 ? 1u : 0u;
+            d += s * s * ((3u * rx) ^ ry);
+            if ( ry == 0 )
+            {
+                if ( rx == 1 )
+                {
+                    x = 0xFFFFu - x;
+                    y = 0xFFFFu - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+}
+
+PackedRTree::PackedRTree()
+{
+    //nop
+}
+
+void
+PackedRTree::build(const std::vector<Bounds>& input)
+{
+    _bounds = Bounds();
+    _boxes.clear();
+    _entries.clear();
+    _levelEnds.clear();
+
+    std::vector<unsigned> valid;
+    for(unsigned i = 0; i < input.size(); ++i)
+    {
+        if ( input[i].isValid() )
+        {
+            valid.push_back( i );
+            _bounds.expandBy( input[i] );
+        }
+    }
+
+    unsigned numLeaves = valid.size();
+    if ( numLeaves == 0 )
+        return;
+
+    // sort the leaves by the Hilbert distance of their centers:
+    double w = _bounds.xMax() - _bounds.xMin(), h = _bounds.yMax() - _bounds.yMin();
+    double sx = w > 0.0 ? 65535.0/w : 0.0, sy = h > 0.0 ? 65535.0/h : 0.0;
+    std::vector< std::pair<unsigned, unsigned> > order( numLeaves );
+    for(unsigned i = 0; i < numLeaves; ++i)
+    {
+        const Bounds& b = input[valid[i]];
+        unsigned x = (unsigned)(sx * (0.5*(b.xMin() + b.xMax()) - _bounds.xMin()));
+        unsigned y = (unsigned)(sy * (0.5*(b.yMin() + b.yMax()) - _bounds.yMin()));
+        order[i] = std::make_pair( hilbert(x, y), valid[i] );
+    }
+    std::sort( order.begin(), order.end() );
+
+    // size of each level, from the leaves up to a single root:
+    unsigned count = numLeaves, numEntries = numLeaves;
+    _levelEnds.push_back( numEntries );
+    do {
+        count = (count + NODE_SIZE - 1) / NODE_SIZE;
+        numEntries += count;
+        _levelEnds.push_back( numEntries );
+    } while( count > 1 );
+
+    _boxes.resize( numEntries*4 );
+    _entries.resize( numEntries );
+    for(unsigned i = 0; i < numLeaves; ++i)
+    {
+        const Bounds& b = input[order[i].second];
+        _boxes[i*4+0] = b.xMin();
+        _boxes[i*4+1] = b.yMin();
+        _boxes[i*4+2] = b.xMax();
+        _boxes[i*4+3] = b.yMax();
+        _entries[i] = order[i].second;
+    }
+
+    // each node covers up to NODE_SIZE consecutive entries of the level below:
+    unsigned child = 0, parent = numLeaves;
+    for(unsigned level = 0; level + 1 < _levelEnds.size(); ++level)
+    {
+        unsigned end = _levelEnds[level];
+        while( child < end )
+        {
+            double* box = &_boxes[parent*4];
+            const double* first = &_boxes[child*4];
+            std::copy( first, first + 4, box );
+            _entries[parent] = child;
+
+            unsigned last = std::min(child + NODE_SIZE, end);
+            for(++child; child < last; ++child)
+            {
+                const double* c = &_boxes[child*4];
+                box[0] = std::min(box[0], c[0]);
+                box[1] = std::min(box[1], c[1]);
+                box[2] = std::max(box[2], c[2]);
+                box[3] = std::max(box[3], c[3]);
+            }
+            ++parent;
+        }
+    }
+}
+
+void
+PackedRTree::query(const Bounds& bounds, std::vector<unsigned>& hits) const
+{
+    query( bounds.xMin(), bounds.yMin(), bounds.xMax(), bounds.yMax(), hits );
+}
+
+void
+PackedRTree::query(double x, double y, std::vector<unsigned>& hits) const
+{
+    query( x, y, x, y, hits );
+}
+
+void
+PackedRTree::query(double xmin, double ymin, double xmax, double ymax, std::vector<unsigned>& hits) const
+{
+    if ( empty() )
+        return;
+
+    unsigned first = hits.size();
+    unsigned numLeaves = _levelEnds.front();
+    unsigned node = _levelEnds.back() - 1;
+
+    // nodes still to visit; holds at most NODE_SIZE entries per level
+    unsigned stack[16 * NODE_SIZE];
+    unsigned depth = 0;
+
+    for(;;)
+    {
+        unsigned end = std::min(node + NODE_SIZE, levelEnd(node));
+        for(unsigned i = node; i < end; ++i)
+        {
+            const double* box = &_boxes[i*4];
+            if ( box[2] < xmin || box[0] > xmax || box[3] < ymin || box[1] > ymax )
+                continue;
+
+            if ( node < numLeaves )
+                hits.push_back( _entries[i] );
+            else
+                stack[depth++] = _entries[i];
+        }
+
+        if ( depth == 0 )
+            break;
+        node = stack[--depth];
+    }
+
+    std::sort( hits.begin() + first, hits.end() );
+}
+
+unsigned
+PackedRTree::levelEnd(unsigned entry) const
+{
+    return *std::upper_bound( _levelEnds.begin(), _levelEnds.end(), entry );
+}
@@ -24,7 +24,7 @@ using namespace osgEarth;
 
 ProgressCallback::ProgressCallback() :
 osg::Referenced( true ),
-_canceled      ( false ),
+_canceled      ( 0u ),
 _failed        ( false ),
 _needsRetry    ( false ),
 _collectStats  ( false )
@@ -23,10 +23,12 @@
 #include <osgEarth/LocalTangentPlane>
 #include <osgEarth/ECEF>
 #include <osgEarth/ThreadingUtils>
+#include <osgEarth/Containers>
 #include <osg/Notify>
 #include <ogr_api.h>
 #include <ogr_spatialref.h>
 #include <cpl_conv.h>
+#include <OpenThreads/Atomic>
 #include <algorithm>
 
 #define LC "[SpatialReference] "
@@ -37,6 +39,69 @@ using namespace osgEarth;
 
 namespace
 {
+    OpenThreads::Atomic s_uidGen;
+
+    /**
+     * Cache of OGR coordinate transformation handles belonging to one thread,
+     * keyed by the unique IDs of the source and target SRS. An OGR handle may
+     * only be used by one thread at a time, so giving each thread its own lets
+     * transforms run concurrently without locking. SRS IDs are never reused,
+     * so a stale entry can never be mistaken for a live one.
+     */
+    struct TransformHandleCache
+    {
+        typedef std::map<std::pair<unsigned,unsigned>, void*> Handles;
+        Handles _handles;
+
+        // Keeps a thread that visits many short-lived SRS's from growing without bound
+        enum { MAX_HANDLES = 128 };
+
+        void* get(const SpatialReference* in, unsigned inUID, const SpatialReference* out, unsigned outUID)
+        {
+            std::pair<unsigned,unsigned> key(inUID, outUID);
+            Handles::const_iterator i = _handles.find(key);
+            if ( i != _handles.end() )
+                return i->second;
+
+            if ( _handles.size() >= MAX_HANDLES )
+                clear();
+
+            OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
+            void* handle;
+            {
+                // creation reads the shared OGR spatial references
+                GDAL_SCOPED_LOCK;
+                handle = OCTNewCoordinateTransformation( in->getHandle(), out->getHandle() );
+            }
+            _handles[key] = handle;
+            return handle;
+        }
+
+        void clear()
+        {
+            GDAL_SCOPED_LOCK;
+            destroyHandles();
+        }
+
+        void destroyHandles()
+        {
+            for (Handles::iterator i = _handles.begin(); i != _handles.end(); ++i)
+            {
+                if ( i->second )
+                    OCTDestroyCoordinateTransformation( i->second );
+            }
+            _handles.clear();
+        }
+
+        // Only runs at exit, when the GDAL mutex may already be gone.
+        ~TransformHandleCache() { destroyHandles(); }
+    };
+
+    PerThreadObject<TransformHandleCache> s_transformHandleCaches;
+
+    // Saves taking the lock in s_transformHandleCaches on every transform.
+    OE_THREAD_LOCAL TransformHandleCache* s_transformHandleCache = 0L;
+
     std::string
     getOGRAttrValue( void* _handle, const std::string& name, int child_num, bool lowercase =false)
     {
@@ -49,27 +114,139 @@ namespace
         return "";
     } 
 
+    /**
+     * Batch kernels for the most common transformations, which bypass OGR.
+     * They work on separate coordinate arrays (structure-of-arrays) with
+     * branch-free loop bodies that the compiler can vectorize; the cost is
+     * dominated by the transcendental functions, for which SSE/AVX have
+     * no instructions of their own.
+     */
+    namespace Kernels
+    {
+        const double WEB_MERCATOR_RADIUS = 6378137.0;
+
+        // PROJ's adjlon: wraps longitudes beyond +/-180 (with a little slack) into range
+        inline double wrapLongitude(double lon)
+        {
+            if ( fabs(lon) <= 180.0 + 1e-10 )
+                return lon;
+            return lon - 360.0 * floor((lon + 180.0) / 360.0);
+        }
+
+        // Returns false, leaving the input untouched, if any point is at a pole
+        // or not a number (where OGR would fail).
+        bool geographicToWebMercator(double* x, double* y, unsigned count)
+        {
+            const double maxLat = 90.0 - 1e-8;
+            for(unsigned i=0; i<count; ++i)
+            {
+                if ( !(fabs(y[i]) < maxLat) || x[i] != x[i] )
+                    return false;
+            }
+
+            const double k = osg::DegreesToRadians(1.0) * WEB_MERCATOR_RADIUS;
+            const double h = osg::DegreesToRadians(0.5);
+            for(unsigned i=0; i<count; ++i)
+            {
+                x[i] = k * wrapLongitude(x[i]);
+                y[i] = WEB_MERCATOR_RADIUS * log(tan(osg::PI_4 + h * y[i]));
+            }
+            return true;
+        }
+
+        bool webMercatorToGeographic(double* x, double* y, unsigned count)
+        {
+            for(unsigned i=0; i<count; ++i)
+            {
+                if ( x[i] != x[i] || y[i] != y[i] )
+                    return false;
+            }
+
+            const double k = osg::RadiansToDegrees(1.0) / WEB_MERCATOR_RADIUS;
+            const double r2d = osg::RadiansToDegrees(1.0);
+            for(unsigned i=0; i<count; ++i)
+            {
+                x[i] = wrapLongitude(k * x[i]);
+                y[i] = r2d * (2.0 * atan(exp(y[i] / WEB_MERCATOR_RADIUS)) - osg::PI_2);
+            }
+            return true;
+        }
+
+        // lon/lat in degrees, height in meters -> ECEF (same math as osg::EllipsoidModel)
+        void geodeticToGeocentric(double* x, double* y, double* z, unsigned count, double a, double b)
+        {
+            const double e2 = 1.0 - (b*b)/(a*a);
+            const double d2r = osg::DegreesToRadians(1.0);
+            for(unsigned i=0; i<count; ++i)
+            {
+                double lon = d2r * x[i], lat = d2r * y[i], hae = z[i];
+                double sinLat = sin(lat), cosLat = cos(lat);
+                double N = a / sqrt(1.0 - e2*sinLat*sinLat);
+                x[i] = (N + hae) * cosLat * cos(lon);
+                y[i] = (N + hae) * cosLat * sin(lon);
+                z[i] = (N*(1.0-e2) + hae) * sinLat;
+            }
+        }
+
+        // ECEF -> lon/lat in degrees, height in meters (Bowring, as in osg::EllipsoidModel)
+        void geocentricToGeodetic(double* x, double* y, double* z, unsigned count, double a, double b)
+        {
+            const double e2 = 1.0 - (b*b)/(a*a);
+            const double ed2 = (a*a - b*b)/(b*b);
+            const double r2d = osg::RadiansToDegrees(1.0);
+            for(unsigned i=0; i<count; ++i)
+            {
+                double X = x[i], Y = y[i], Z = z[i];
+                double p = sqrt(X*X + Y*Y);
+                double theta = atan2(Z*a, p*b);
+                double sinTheta = sin(theta), cosTheta = cos(theta);
+                double lat = atan((Z + ed2*b*sinTheta*sinTheta*sinTheta) / (p - e2*a*cosTheta*cosTheta*cosTheta));
+                double sinLat = sin(lat);
+                double N = a / sqrt(1.0 - e2*sinLat*sinLat);
+                x[i] = r2d * atan2(Y, X);
+                y[i] = r2d * lat;
+                z[i] = p/cos(lat) - N;
+            }
+        }
+    }
+
     void geodeticToGeocentric(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
-        for( unsigned i=0; i<points.size(); ++i )
+        unsigned count = points.size();
+        if ( count == 0 )
+            return;
+
+        std::vector<double> x(count), y(count), z(count);
+        for( unsigned i=0; i<count; ++i )
+        {
+            x[i] = points[i].x(), y[i] = points[i].y(), z[i] = points[i].z();
+        }
+
+        Kernels::geodeticToGeocentric( &x[0], &y[0], &z[0], count, em->getRadiusEquator(), em->getRadiusPolar() );
+
+        for( unsigned i=0; i<count; ++i )
         {
-            double x, y, z;
-            em->convertLatLongHeightToXYZ(
-                osg::DegreesToRadians( points[i].y() ), osg::DegreesToRadians( points[i].x() ), points[i].z(),
-                x, y, z );
-            points[i].set( x, y, z );
+            points[i].set( x[i], y[i], z[i] );
         }
     }
 
     void geocentricToGeodetic(std::vector<osg::Vec3d>& points, const osg::EllipsoidModel* em)
     {
-        for( unsigned i=0; i<points.size(); ++i )
+        unsigned count = points.size();
+        if ( count == 0 )
+            return;
+
+        std::vector<double> x(count), y(count), z(count);
+        for( unsigned i=0; i<count; ++i )
+        {
+            x[i] = points[i].x(), y[i] = points[i].y(), z[i] = points[i].z();
+        }
+
+        Kernels::geocentricToGeodetic( &x[0], &y[0], &z[0], count, em->getRadiusEquator(), em->getRadiusPolar() );
+
+        for( unsigned i=0; i<count; ++i )
         {
-            double lat, lon, alt;
-            em->convertXYZToLatLongHeight(
-                points[i].x(), points[i].y(), points[i].z(),
-                lat, lon, alt );
-            points[i].set( osg::RadiansToDegrees(lon), osg::RadiansToDegrees(lat), alt );
+            points[i].set( x[i], y[i], z[i] );
         }
     }
 }
@@ -364,6 +541,8 @@ _owns_handle    ( true ),
 _init_type      ( init_type ),
 _is_geographic  ( false ),
 _is_geocentric  ( false ),
+_is_wgs84_lonlat( false ),
+_is_web_mercator( false ),
 _is_mercator    ( false ),
 _is_north_polar ( false ), 
 _is_south_polar ( false ),
@@ -373,7 +552,8 @@ _is_user_defined( false ),
 _is_ltp         ( false ),
 _is_plate_carre ( false ),
 _is_spherical_mercator( false ),
-_ellipsoidId(0u)
+_ellipsoidId(0u),
+_uid            ( ++s_uidGen )
 {
     // nop
 }
@@ -385,7 +565,10 @@ _handle        ( handle ),
 _owns_handle   ( ownsHandle ),
 _is_ltp        ( false ),
 _is_plate_carre( false ),
-_is_geocentric ( false )
+_is_geocentric ( false ),
+_is_wgs84_lonlat( false ),
+_is_web_mercator( false ),
+_uid           ( ++s_uidGen )
 {
     //nop
 }
@@ -403,11 +586,6 @@ SpatialReference::~SpatialReference()
             OE_DEBUG << LC << "Destroying [unitialized SRS]" << std::endl;
         }
 
-        for (TransformHandleCache::iterator itr = _transformHandleCache.begin(); itr != _transformHandleCache.end(); ++itr)
-        {
-            OCTDestroyCoordinateTransformation(itr->second);
-        }
-
         if ( _owns_handle )
         {
             OSRDestroySpatialReference( _handle );
@@ -1030,7 +1208,14 @@ SpatialReference::transform(std::vector<osg::Vec3d>& points,
         y[i] = points[i].y();
     }
 
-    success = inputSRS->transformXYPointArrays( x, y, count, outputSRS );
+    // well-known pairs have native kernels; otherwise use OGR.
+    if ( inputSRS->_is_wgs84_lonlat && outputSRS->_is_web_mercator )
+        success = Kernels::geographicToWebMercator( x, y, count );
+    else if ( inputSRS->_is_web_mercator && outputSRS->_is_wgs84_lonlat )
+        success = Kernels::webMercatorToGeographic( x, y, count );
+
+    if ( !success )
+        success = inputSRS->transformXYPointArrays( x, y, count, outputSRS );
 
     if ( success )
     {
@@ -1093,26 +1278,15 @@ SpatialReference::transformXYPointArrays(double*  x,
                                          unsigned count,
                                          const SpatialReference* out_srs) const
 {  
-    // Transform the X and Y values inside an exclusive GDAL/OGR lock
-    GDAL_SCOPED_LOCK;
-
     //OE_INFO << LC << "Attempt transfrom from \n"
     //    << "    " << getHorizInitString() << "\n"
     //    << " -> " << out_srs->getHorizInitString() << std::endl;
 
-    void* xform_handle = NULL;
-    TransformHandleCache::const_iterator itr = _transformHandleCache.find(out_srs->getWKT());
-    if (itr != _transformHandleCache.end())
-    {
-        //OE_DEBUG << LC << "using cached transform handle" << std::endl;
-        xform_handle = itr->second;
-    }
-    else
-    {
-        OE_DEBUG << LC << "allocating new OCT Transform" << std::endl;
-        xform_handle = OCTNewCoordinateTransformation( _handle, out_srs->_handle);
-        const_cast<SpatialReference*>(this)->_transformHandleCache[out_srs->getWKT()] = xform_handle;
-    }
+    // Each thread transforms with its own OGR handle, so no global lock is needed.
+    if ( !s_transformHandleCache )
+        s_transformHandleCache = &s_transformHandleCaches.get();
+
+    void* xform_handle = s_transformHandleCache->get( this, _uid, out_srs, out_srs->_uid );
 
     if ( !xform_handle )
     {
@@ -1525,6 +1699,33 @@ SpatialReference::_init()
         CPLFree( proj4buf );
     }
 
+    // Identify the SRS's that transform() can handle natively. This looks at the
+    // OGR handle itself, since that's what OGR would otherwise transform.
+    bool handleIsGeographic = OSRIsGeographic( _handle ) != 0;
+    double primeMeridian = as<double>( getOGRAttrValue( _handle, "PRIMEM", 1 ), 0.0 );
+
+    _is_wgs84_lonlat =
+        handleIsGeographic &&
+        _datum == "wgs_1984" &&
+        osg::equivalent( semi_major_axis, 6378137.0, 1e-6 ) &&
+        osg::equivalent( semi_minor_axis, 6356752.314245, 1e-5 ) &&
+        primeMeridian == 0.0 &&
+        osg::equivalent( unitMultiplier, osg::DegreesToRadians(1.0), 1e-12 );
+
+    // Spherical mercator is only a pure formula of WGS84 lon/lat when there is no
+    // datum shift (nadgrids=@null) and no false origin, scaling or unit conversion.
+    _is_web_mercator =
+        _is_spherical_mercator &&
+        !handleIsGeographic &&
+        osg::equivalent( semi_major_axis, 6378137.0, 1e-6 ) &&
+        _proj4.find( "+nadgrids=@null" ) != std::string::npos &&
+        OSRGetProjParm( _handle, SRS_PP_CENTRAL_MERIDIAN, 0.0, 0L ) == 0.0 &&
+        OSRGetProjParm( _handle, SRS_PP_FALSE_EASTING,    0.0, 0L ) == 0.0 &&
+        OSRGetProjParm( _handle, SRS_PP_FALSE_NORTHING,   0.0, 0L ) == 0.0 &&
+        OSRGetProjParm( _handle, SRS_PP_SCALE_FACTOR,     1.0, 0L ) == 1.0 &&
+        OSRGetProjParm( _handle, SRS_PP_STANDARD_PARALLEL_1, 0.0, 0L ) == 0.0 &&
+        unitMultiplier == 1.0;
+
     // Try to extract the OGC well-known-text (WKT) string:
     char* wktbuf;
     if ( OSRExportToWkt( _handle, &wktbuf ) == OGRERR_NONE )
@@ -216,6 +216,52 @@ osgEarth::hashToString(const std::string& input)
     return Stringify() << std::hex << std::setw(8) << std::setfill('0') << hashString(input);
 }
 
+/** FNV-1a and MurmurHash64A side by side; two unrelated 64-bit hashes
+    make an accidental collision vanishingly unlikely. */
+std::string
+osgEarth::hashContent(const char* data, unsigned size)
+{
+    // FNV-1a (64-bit)
+    unsigned long long fnv = 0xcbf29ce484222325ULL;
+    for(unsigned i=0; i<size; ++i)
+    {
+        fnv ^= (unsigned char)data[i];
+        fnv *= 0x100000001b3ULL;
+    }
+
+    // MurmurHash64A
+    const unsigned long long m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    unsigned long long h = 0x9e3779b97f4a7c15ULL ^ (size * m);
+
+    unsigned i = 0;
+    for( ; i+8 <= size; i += 8)
+    {
+        unsigned long long k;
+        memcpy(&k, data+i, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    unsigned long long tail = 0;
+    for(unsigned j=0; i+j<size; ++j)
+        tail |= (unsigned long long)(unsigned char)data[i+j] << (8*j);
+    if ( i < size )
+    {
+        h ^= tail;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return Stringify() << std::hex << std::setfill('0') << std::setw(16) << fnv << std::setw(16) << h;
+}
+
 
 /** Parses an HTML color ("#rrggbb" or "#rrggbbaa") into an OSG color. */
 osg::Vec4f
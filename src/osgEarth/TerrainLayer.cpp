@@ -24,6 +24,7 @@
 #include <osgEarth/URI>
 #include <osgEarth/MemCache>
 #include <osgEarth/CacheBin>
+#include <osgEarth/Metrics>
 #include <osgDB/WriteFile>
 #include <osg/Version>
 #include <OpenThreads/ScopedLock>
@@ -311,6 +312,21 @@ TerrainLayer::open()
         if ( l2CacheSize > 0 )
         {
             _memCache = new MemCache( l2CacheSize );
+
+            if ( options().driver()->L2CacheMaxBytes().isSet() )
+            {
+                _memCache->setMaxBinBytes( options().driver()->L2CacheMaxBytes().get() );
+            }
+
+            // Shared mode returns cached tiles by reference (no copies).
+            bool l2Shared = options().driver()->L2CacheShared().get();
+            char const* l2SharedEnv = ::getenv( "OSGEARTH_L2_CACHE_SHARED" );
+            if ( l2SharedEnv )
+            {
+                l2Shared = as<bool>( std::string(l2SharedEnv), false );
+                OE_INFO << LC << "L2 cache sharing set from environment = " << l2Shared << "\n";
+            }
+            _memCache->setShareObjects( l2Shared );
         }
 
         // create the unique cache ID for the cache bin.
@@ -336,6 +352,9 @@ TerrainLayer::open()
             hashConf.remove("cache_policy");
             hashConf.remove("visible");
             hashConf.remove("l2_cache_size");
+            hashConf.remove("l2_cache_max_bytes");
+            hashConf.remove("l2_cache_shared");
+            hashConf.remove("max_dataset_handles");
 
             OE_DEBUG << "hashConfFinal = " << hashConf.toJSON(true) << std::endl;
 
@@ -388,7 +407,7 @@ TerrainLayer::open()
         // hasn't already been created.
         if (_cacheSettings->isCacheEnabled() && _cacheSettings->getCacheBin() == 0L)
         {
-            CacheBin* bin = _cacheSettings->getCache()->addBin(_runtimeCacheId);
+            CacheBin* bin = _cacheSettings->getCache()->openBin(_runtimeCacheId);
             if (bin)
             {
                 _cacheSettings->setCacheBin(bin);
@@ -396,6 +415,14 @@ TerrainLayer::open()
             }
         }
 
+        // Keep the tile source's blacklist in the cache bin, so tiles known
+        // to have no data aren't requested again in the next session.
+        if (_tileSource.valid() && _cacheSettings->isCacheEnabled() && _cacheSettings->getCacheBin())
+        {
+            const CachePolicy& cp = _cacheSettings->cachePolicy().get();
+            _tileSource->getBlacklist()->setCacheBin(_cacheSettings->getCacheBin(), cp.isCacheReadable(), cp.isCacheWriteable());
+        }
+
         OE_INFO << LC << _cacheSettings->toString() << "\n";
 
         // Done!
@@ -755,7 +782,7 @@ TerrainLayer::createAndOpenTileSource()
                 OE_INFO << LC << "driver says min valid timestamp = " << DateTime(*cp.minTime()).asRFC1123() << "\n";
             }
             
-            CacheBin* bin = _cacheSettings->getCache()->addBin(_runtimeCacheId);
+            CacheBin* bin = _cacheSettings->getCache()->openBin(_runtimeCacheId);
             if (bin)
             {
                 _cacheSettings->setCacheBin(bin);
@@ -1015,6 +1042,32 @@ TerrainLayer::dirtyDataExtents()
     _dataExtentsUnion = GeoExtent::INVALID;
 }
 
+void
+TerrainLayer::countCoalescedRequest()
+{
+    ++_numCoalescedRequests;
+    reportRequestMetrics();
+}
+
+void
+TerrainLayer::countDuplicateRequest()
+{
+    ++_numDuplicateRequests;
+    reportRequestMetrics();
+}
+
+void
+TerrainLayer::reportRequestMetrics()
+{
+    if (Metrics::enabled())
+    {
+        Metrics::counter(
+            Stringify() << "TileRequests " << getName(),
+            "Coalesced", (double)getNumCoalescedRequests(),
+            "Duplicate", (double)getNumDuplicateRequests());
+    }
+}
+
 const GeoExtent&
 TerrainLayer::getDataExtentsUnion() const
 {
@@ -50,7 +50,8 @@ _debug( false ),
 _binNumber( 0 ),
 _castShadows(true),
 _rangeMode(osg::LOD::DISTANCE_FROM_EYE_POINT),
-_tilePixelSize(256)
+_tilePixelSize(256),
+_parallelLayerFetch(false)
 {
     fromConfig( _conf );
 }
@@ -84,6 +85,7 @@ TerrainOptions::getConfig() const
     conf.set( "min_expiry_frames", _minExpiryFrames);
     conf.set("cast_shadows", _castShadows);
     conf.set("tile_pixel_size", _tilePixelSize);
+    conf.set("parallel_layer_fetch", _parallelLayerFetch);
     conf.set("range_mode", "PIXEL_SIZE_ON_SCREEN", _rangeMode, osg::LOD::PIXEL_SIZE_ON_SCREEN);
     conf.set("range_mode", "DISTANCE_FROM_EYE_POINT", _rangeMode, osg::LOD::DISTANCE_FROM_EYE_POINT);
 
@@ -130,6 +132,7 @@ TerrainOptions::fromConfig( const Config& conf )
     conf.getIfSet( "min_expiry_frames", _minExpiryFrames);
     conf.getIfSet("cast_shadows", _castShadows);
     conf.getIfSet("tile_pixel_size", _tilePixelSize);
+    conf.getIfSet("parallel_layer_fetch", _parallelLayerFetch);
     conf.getIfSet("range_mode", "PIXEL_SIZE_ON_SCREEN", _rangeMode, osg::LOD::PIXEL_SIZE_ON_SCREEN);
     conf.getIfSet("range_mode", "DISTANCE_FROM_EYE_POINT", _rangeMode, osg::LOD::DISTANCE_FROM_EYE_POINT);
 
@@ -23,8 +23,10 @@
 #include <osgEarth/PatchLayer>
 #include <osgEarth/MapOptions>
 #include <osgEarth/Map>
+#include <osgEarth/TaskService>
 
 #include <osg/Texture2D>
+#include <OpenThreads/Atomic>
 
 #define LC "[TerrainTileModelFactory] "
 
@@ -77,6 +79,138 @@ TerrainTileModelFactory::createTileModel(const Map*                       map,
     return model.release();
 }
 
+namespace
+{
+    /**
+     * Progress for one branch of a parallel layer fetch. It reports the tile's
+     * cancelation so every branch stops when the tile does, but keeps its own
+     * stats and flags (which are not thread-safe) until merged back after the join.
+     */
+    struct BranchProgressCallback : public ProgressCallback
+    {
+        BranchProgressCallback(ProgressCallback* parent) : _parent(parent)
+        {
+            collectStats() = parent->collectStats();
+        }
+
+        bool isCanceled()
+        {
+            return ProgressCallback::isCanceled() || _parent->isCanceled();
+        }
+
+        void mergeInto(ProgressCallback* parent)
+        {
+            for (Stats::const_iterator i = stats().begin(); i != stats().end(); ++i)
+                parent->stats()[i->first] += i->second;
+
+            if (needsRetry())
+                parent->setNeedsRetry(true);
+
+            if (ProgressCallback::isCanceled())
+                parent->cancel();
+        }
+
+        osg::ref_ptr<ProgressCallback> _parent;
+    };
+
+    OpenThreads::Mutex s_layerFetchServiceMutex;
+    osg::observer_ptr<TaskService> s_layerFetchService;
+
+    /** Task service in the Registry's shared pool that runs parallel layer fetches */
+    TaskService* getLayerFetchService()
+    {
+        Threading::ScopedMutexLock lock(s_layerFetchServiceMutex);
+        osg::ref_ptr<TaskService> service;
+        if (!s_layerFetchService.lock(service))
+        {
+            TaskServiceManager* tsm = Registry::instance()->getTaskServiceManager();
+            service = tsm->add(Registry::instance()->createUID());
+            service->setName("TerrainTileModelFactory");
+            s_layerFetchService = service.get();
+        }
+        return service.get();
+    }
+}
+
+/**
+ * Image layer fetches for one tile, run by the calling thread and by helper
+ * tasks in the shared pool. Each worker claims the next unclaimed fetch until
+ * none are left, so the fetch completes even if no helper ever runs.
+ */
+struct TerrainTileModelFactory::ColorLayerBatch : public osg::Referenced
+{
+    struct Fetch
+    {
+        osg::ref_ptr<ImageLayer>              layer;
+        osg::ref_ptr<osg::Texture>            texture;
+        osg::Matrixf                          textureMatrix;
+        osg::ref_ptr<BranchProgressCallback>  progress;
+    };
+
+    ColorLayerBatch(const TerrainTileModelFactory* factory, const TileKey& key, unsigned numFetches) :
+        _factory(factory), _key(key), _fetches(numFetches), _done(numFetches) { }
+
+    /** Runs the next unclaimed fetch; returns false when there are none left */
+    bool runNext()
+    {
+        unsigned i = (++_next) - 1u;
+        if (i >= _fetches.size())
+            return false;
+
+        Fetch& fetch = _fetches[i];
+        if (!fetch.progress->isCanceled())
+        {
+            fetch.texture = _factory->createImageLayerTexture(
+                fetch.layer.get(), _key, fetch.textureMatrix, fetch.progress.get());
+        }
+        _done.notify();
+        return true;
+    }
+
+    /** Helper task for the worker pool */
+    struct Task : public TaskRequest
+    {
+        Task(ColorLayerBatch* batch) : _batch(batch) { }
+        void operator()(ProgressCallback*) { while (_batch->runNext()); }
+        osg::ref_ptr<ColorLayerBatch> _batch;
+    };
+
+    const TerrainTileModelFactory* _factory;
+    TileKey                        _key;
+    std::vector<Fetch>             _fetches;
+    OpenThreads::Atomic            _next;
+    Threading::MultiEvent          _done;
+};
+
+osg::Texture*
+TerrainTileModelFactory::createImageLayerTexture(ImageLayer*       imageLayer,
+                                                 const TileKey&    key,
+                                                 osg::Matrixf&     textureMatrix,
+                                                 ProgressCallback* progress) const
+{
+    osg::Texture* tex = 0L;
+
+    if (imageLayer->createTextureSupported())
+    {
+        tex = imageLayer->createTexture( key, progress, textureMatrix );
+    }
+
+    else
+    {
+        GeoImage geoImage = imageLayer->createImage( key, progress );
+           
+        if ( geoImage.valid() )
+        {
+            if ( imageLayer->isCoverage() )
+                tex = createCoverageTexture(geoImage.getImage(), imageLayer);
+            else
+                tex = createImageTexture(geoImage.getImage(), imageLayer);
+        }
+    }
+
+    return tex;
+}
+
 void
 TerrainTileModelFactory::addColorLayers(TerrainTileModel* model,
                                         const Map* map,
@@ -87,11 +221,14 @@ TerrainTileModelFactory::addColorLayers(TerrainTileModel* model,
 {
     OE_START_TIMER(fetch_image_layers);
 
-    int order = 0;
-
     LayerVector layers;
     map->getLayers(layers);
 
+    // Collect the layers to process, in order.
+    LayerVector colorLayers;
+    std::vector<int> fetchIndex; // index into the batch, or -1 if no fetch is needed
+    unsigned numFetches = 0u;
+
     for (LayerVector::const_iterator i = layers.begin(); i != layers.end(); ++i)
     {
         Layer* layer = i->get();
@@ -105,43 +242,86 @@ TerrainTileModelFactory::addColorLayers(TerrainTileModel* model,
         if (!filter.accept(layer))
             continue;
 
+        ImageLayer* imageLayer = dynamic_cast<ImageLayer*>(layer);
+        bool fetch =
+            imageLayer &&
+            imageLayer->isKeyInLegalRange(key) &&
+            imageLayer->mayHaveDataInExtent(key.getExtent());
+
+        colorLayers.push_back(layer);
+        fetchIndex.push_back(fetch ? (int)numFetches++ : -1);
+    }
+
+    // Fetch the image layer data. In parallel mode, the calling thread works
+    // alongside helper tasks and the join waits for all fetches to finish.
+    osg::ref_ptr<ColorLayerBatch> batch = new ColorLayerBatch(this, key, numFetches);
+    bool parallel = _options.parallelLayerFetch() == true && numFetches > 1u;
+
+    for (unsigned i = 0; i < colorLayers.size(); ++i)
+    {
+        if (fetchIndex[i] >= 0)
+        {
+            ColorLayerBatch::Fetch& fetch = batch->_fetches[fetchIndex[i]];
+            fetch.layer = static_cast<ImageLayer*>(colorLayers[i].get());
+            if (parallel)
+                fetch.progress = new BranchProgressCallback(progress ? progress : new ProgressCallback());
+        }
+    }
+
+    if (parallel)
+    {
+        TaskService* service = getLayerFetchService();
+        unsigned numHelpers = osg::minimum(numFetches - 1u, (unsigned)osg::maximum(service->getNumThreads(), 1));
+        for (unsigned i = 0; i < numHelpers; ++i)
+        {
+            service->add(new ColorLayerBatch::Task(batch.get()));
+        }
+
+        while (batch->runNext());
+        batch->_done.wait();
+
+        if (progress)
+        {
+            for (unsigned i = 0; i < batch->_fetches.size(); ++i)
+                batch->_fetches[i].progress->mergeInto(progress);
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < batch->_fetches.size(); ++i)
+        {
+            ColorLayerBatch::Fetch& fetch = batch->_fetches[i];
+            fetch.texture = createImageLayerTexture(fetch.layer.get(), key, fetch.textureMatrix, progress);
+        }
+    }
+
+    // Assemble the layer models in map order.
+    for (unsigned i = 0; i < colorLayers.size(); ++i)
+    {
+        Layer* layer = colorLayers[i].get();
         ImageLayer* imageLayer = dynamic_cast<ImageLayer*>(layer);
         if (imageLayer)
         {
-            osg::Texture* tex = 0L;
+            osg::ref_ptr<osg::Texture> tex;
             osg::Matrixf textureMatrix;
 
-            if (imageLayer->isKeyInLegalRange(key) && imageLayer->mayHaveDataInExtent(key.getExtent()))
+            if (fetchIndex[i] >= 0)
             {
-                if (imageLayer->createTextureSupported())
-                {
-                    tex = imageLayer->createTexture( key, progress, textureMatrix );
-                }
-
-                else
-                {
-                    GeoImage geoImage = imageLayer->createImage( key, progress );
-           
-                    if ( geoImage.valid() )
-                    {
-                        if ( imageLayer->isCoverage() )
-                            tex = createCoverageTexture(geoImage.getImage(), imageLayer);
-                        else
-                            tex = createImageTexture(geoImage.getImage(), imageLayer);
-                    }
-                }
+                ColorLayerBatch::Fetch& fetch = batch->_fetches[fetchIndex[i]];
+                tex = fetch.texture.get();
+                textureMatrix = fetch.textureMatrix;
             }
         
             // if this is the first LOD, and the engine requires that the first LOD
             // be populated, make an empty texture if we didn't get one.
-            if (tex == 0L &&
+            if (!tex.valid() &&
                 _options.firstLOD() == key.getLOD() &&
                 reqs && reqs->fullDataAtFirstLodRequired())
             {
                 tex = _emptyTexture.get();
             }
          
-            if (tex)
+            if (tex.valid())
             {
                 tex->setName(model->getKey().str());
 
@@ -149,7 +329,7 @@ TerrainTileModelFactory::addColorLayers(TerrainTileModel* model,
 
                 layerModel->setImageLayer(imageLayer);
 
-                layerModel->setTexture(tex);
+                layerModel->setTexture(tex.get());
                 layerModel->setMatrix(new osg::RefMatrixf(textureMatrix));
 
                 model->colorLayers().push_back(layerModel);
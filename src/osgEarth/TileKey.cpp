@@ -28,12 +28,45 @@ TileKey TileKey::INVALID( 0, 0, 0, 0L );
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    // Spreads the low 29 bits of v so there is a zero bit between each one.
+    inline uint64_t spreadBits(uint64_t v)
+    {
+        v &= 0x1fffffffULL;
+        v = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+        v = (v | (v << 8))  & 0x00ff00ff00ff00ffULL;
+        v = (v | (v << 4))  & 0x0f0f0f0f0f0f0f0fULL;
+        v = (v | (v << 2))  & 0x3333333333333333ULL;
+        v = (v | (v << 1))  & 0x5555555555555555ULL;
+        return v;
+    }
+
+    inline uint64_t packId(unsigned lod, unsigned x, unsigned y)
+    {
+        return ((uint64_t)(lod & 0x3f) << 58) | spreadBits(x) | (spreadBits(y) << 1);
+    }
+
+    // appends the decimal form of v to buf, returning the new end
+    inline char* appendUnsigned(char* buf, unsigned v)
+    {
+        char tmp[10];
+        int n = 0;
+        do { tmp[n++] = (char)('0' + v % 10u); v /= 10u; } while (v > 0u);
+        while (n > 0) *buf++ = tmp[--n];
+        return buf;
+    }
+}
+
+//------------------------------------------------------------------------
+
 TileKey::TileKey(unsigned int lod, unsigned int tile_x, unsigned int tile_y, const Profile* profile)
 {
     _x = tile_x;
     _y = tile_y;
     _lod = lod;
     _profile = profile;
+    _id = packId(lod, tile_x, tile_y);
 
     double width, height;
     if ( _profile.valid() )
@@ -46,18 +79,15 @@ TileKey::TileKey(unsigned int lod, unsigned int tile_x, unsigned int tile_y, con
         double ymin = ymax - height;
 
         _extent = GeoExtent( _profile->getSRS(), xmin, ymin, xmax, ymax );
-
-        _key = Stringify() << _lod << "/" << _x << "/" << _y;
     }
     else
     {
         _extent = GeoExtent::INVALID;
-        _key = "invalid";
     }
 }
 
 TileKey::TileKey( const TileKey& rhs ) :
-_key( rhs._key ),
+_id(rhs._id),
 _lod(rhs._lod),
 _x(rhs._x),
 _y(rhs._y),
@@ -67,6 +97,21 @@ _extent( rhs._extent )
     //NOP
 }
 
+std::string
+TileKey::str() const
+{
+    if ( !_profile.valid() )
+        return "invalid";
+
+    char buf[40];
+    char* end = appendUnsigned(buf, _lod);
+    *end++ = '/';
+    end = appendUnsigned(end, _x);
+    *end++ = '/';
+    end = appendUnsigned(end, _y);
+    return std::string(buf, end);
+}
+
 const Profile*
 TileKey::getProfile() const
 {
@@ -26,10 +26,14 @@
 #include <osgEarth/ThreadingUtils>
 #include <osgEarth/MemCache>
 #include <osgEarth/Progress>
+#include <osgEarth/CacheBin>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
 #include <osgDB/ReadFile>
 #include <osgDB/WriteFile>
+#include <fstream>
+#include <sstream>
+#include <ctime>
 
 #define LC "[TileSource] "
 
@@ -40,43 +44,222 @@ using namespace osgEarth;
 
 //------------------------------------------------------------------------
 
+namespace
+{
+    // record holding a persisted blacklist in a layer's cache bin
+    const char* BLACKLIST_CACHE_KEY = "_blacklist";
+
+    // minimum seconds between saves to the cache bin
+    const TimeStamp BLACKLIST_SAVE_INTERVAL = 60;
+
+    // entries kept in memory; see purge().
+    const unsigned BLACKLIST_MAX_ENTRIES = 250000;
+}
+
 TileBlacklist::TileBlacklist() :
-_tiles(true, 1024)
+_maxAge      ( 3600u ),
+_retryDelay  ( 30u ),
+_inherit     ( false ),
+_writeable   ( false ),
+_dirty       ( false ),
+_lastSave    ( 0 ),
+_hits        ( 0u ),
+_inferredHits( 0u )
 {
     //NOP
 }
 
+TileBlacklist::~TileBlacklist()
+{
+    flush();
+
+    if ( _hits > 0u || _inferredHits > 0u )
+    {
+        OE_INFO << LC << "Blacklist avoided " << (unsigned)_hits << " requests for listed tiles and "
+            << (unsigned)_inferredHits << " for tiles under a tile with no data" << std::endl;
+    }
+}
+
 void
-TileBlacklist::add(const TileKey& key)
+TileBlacklist::add(const TileKey& key, Reason reason)
 {
-    _tiles.insert(key, true);
+    TimeStamp now = (TimeStamp)::time(0L);
+    unsigned ttl = reason == REASON_NO_DATA ? _maxAge : _retryDelay;
+
+    Entry entry;
+    entry._expires = ttl > 0u ? now + (TimeStamp)ttl : 0;
+    entry._reason  = reason;
+
+    bool save = false;
+    {
+        Threading::ScopedWriteLock lock( _mutex );
+
+        if ( _entries.size() >= BLACKLIST_MAX_ENTRIES )
+            purge( now );
+
+        _entries[TileKey(key.getLOD(), key.getTileX(), key.getTileY(), 0L)] = entry;
+
+        _dirty = true;
+        save = _bin.valid() && _writeable && now - _lastSave >= BLACKLIST_SAVE_INTERVAL;
+    }
+
     OE_DEBUG << "Added " << key.str() << " to blacklist" << std::endl;
+
+    if ( save )
+        flush();
 }
 
 void
 TileBlacklist::remove(const TileKey& key)
 {
-    _tiles.erase(key);
+    {
+        Threading::ScopedWriteLock lock( _mutex );
+        _dirty = _entries.erase(key) > 0 || _dirty;
+    }
     OE_DEBUG << "Removed " << key.str() << " from blacklist" << std::endl;
 }
 
 void
 TileBlacklist::clear()
 {
-    _tiles.clear();
+    {
+        Threading::ScopedWriteLock lock( _mutex );
+        _entries.clear();
+        _dirty = true;
+    }
     OE_DEBUG << "Cleared blacklist" << std::endl;
 }
 
+bool
+TileBlacklist::find(const TileKey& key, TimeStamp now, Entry& out) const
+{
+    Entries::const_iterator i = _entries.find(key);
+    if ( i == _entries.end() )
+        return false;
+    if ( i->second._expires != 0 && i->second._expires <= now )
+        return false;
+    out = i->second;
+    return true;
+}
+
 bool
 TileBlacklist::contains(const TileKey& key) const
 {
-    return _tiles.has(key);
+    Reason reason;
+    return contains(key, reason);
 }
 
-TileBlacklist*
-TileBlacklist::read(std::istream &in)
+bool
+TileBlacklist::contains(const TileKey& key, Reason& out_reason) const
 {
-    osg::ref_ptr< TileBlacklist > result = new TileBlacklist();
+    Threading::ScopedReadLock lock( _mutex );
+
+    if ( _entries.empty() )
+        return false;
+
+    TimeStamp now = (TimeStamp)::time(0L);
+    Entry entry;
+
+    if ( find(key, now, entry) )
+    {
+        ++_hits;
+        out_reason = entry._reason;
+        return true;
+    }
+
+    // a tile with no data implies none in its descendants. The keys carry no
+    // profile so walking up the tree doesn't compute extents.
+    if ( _inherit )
+    {
+        unsigned x = key.getTileX(), y = key.getTileY();
+        for(int lod = (int)key.getLOD()-1; lod >= 0; --lod)
+        {
+            x >>= 1;
+            y >>= 1;
+            if ( find(TileKey(lod, x, y, 0L), now, entry) && entry._reason == REASON_NO_DATA )
+            {
+                ++_inferredHits;
+                out_reason = REASON_NO_DATA;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void
+TileBlacklist::purge(TimeStamp now)
+{
+    for(Entries::iterator i = _entries.begin(); i != _entries.end(); )
+    {
+        if ( i->second._expires != 0 && i->second._expires <= now )
+            _entries.erase(i++);
+        else
+            ++i;
+    }
+
+    // still full: drop the deepest tiles first, since they matter least
+    // and an ancestor with no data may cover them anyway.
+    if ( _entries.size() >= BLACKLIST_MAX_ENTRIES )
+    {
+        while ( _entries.size() > BLACKLIST_MAX_ENTRIES*3/4 )
+        {
+            _entries.erase( --_entries.end() );
+        }
+    }
+}
+
+void
+TileBlacklist::setCacheBin(CacheBin* bin, bool readable, bool writeable)
+{
+    if ( bin && readable )
+    {
+        ReadResult r = bin->readString(BLACKLIST_CACHE_KEY, 0L);
+        if ( r.succeeded() )
+        {
+            std::istringstream in( r.getString() );
+            readEntries( in );
+            OE_INFO << LC << "Read blacklist from cache bin " << bin->getID() << std::endl;
+        }
+    }
+
+    Threading::ScopedWriteLock lock( _mutex );
+    _bin       = bin;
+    _writeable = writeable;
+    _lastSave  = (TimeStamp)::time(0L);
+}
+
+void
+TileBlacklist::flush()
+{
+    Threading::ScopedMutexLock saveLock( _saveMutex );
+
+    std::ostringstream buf;
+    osg::ref_ptr<CacheBin> bin;
+    {
+        Threading::ScopedWriteLock lock( _mutex );
+        if ( !_dirty || !_bin.valid() || !_writeable )
+            return;
+
+        purge( (TimeStamp)::time(0L) );
+        bin = _bin.get();
+        _dirty = false;
+        _lastSave = (TimeStamp)::time(0L);
+    }
+
+    write( buf );
+
+    osg::ref_ptr<StringObject> data = new StringObject( buf.str() );
+    bin->write( BLACKLIST_CACHE_KEY, data.get(), 0L );
+}
+
+void
+TileBlacklist::readEntries(std::istream &in)
+{
+    TimeStamp now = (TimeStamp)::time(0L);
+
+    Threading::ScopedWriteLock lock( _mutex );
 
     while (!in.eof())
     {
@@ -84,15 +267,30 @@ TileBlacklist::read(std::istream &in)
         std::getline(in, line);
         if (!line.empty())
         {
-            int z, x, y;
-            if (sscanf(line.c_str(), "%d %d %d", &z, &x, &y) == 3)
+            // "lod x y" lists a tile with no data for good (the original
+            // format); "lod x y expires reason" adds the expiry and reason.
+            int z, x, y, reason = REASON_NO_DATA;
+            long long expires = 0;
+            int n = sscanf(line.c_str(), "%d %d %d %lld %d", &z, &x, &y, &expires, &reason);
+            if (n == 3 || n == 5)
             {
-                result->add(TileKey(z, x, y, 0L));
-            }
+                if ( expires != 0 && (TimeStamp)expires <= now )
+                    continue;
 
+                Entry entry;
+                entry._expires = (TimeStamp)expires;
+                entry._reason  = reason == REASON_ERROR ? REASON_ERROR : REASON_NO_DATA;
+                _entries[TileKey(z, x, y, 0L)] = entry;
+            }
         }
     }
+}
 
+TileBlacklist*
+TileBlacklist::read(std::istream &in)
+{
+    osg::ref_ptr< TileBlacklist > result = new TileBlacklist();
+    result->readEntries( in );
     return result.release();
 }
 
@@ -120,21 +318,15 @@ TileBlacklist::write(const std::string &filename) const
     write(out);
 }
 
-namespace {
-    struct WriteFunctor : public LRUCache<TileKey,bool>::Functor {
-        std::ostream& _out;
-        WriteFunctor(std::ostream& out) : _out(out) { }
-        void operator()(const TileKey& key, const bool& value) {
-            _out << key.getLOD() << ' ' << key.getTileX() << ' ' << key.getTileY() << std::endl;
-        }
-    };
-}
-
 void
 TileBlacklist::write(std::ostream &output) const
 {
-    WriteFunctor writer(output);
-    _tiles.iterate(writer);
+    Threading::ScopedReadLock lock( _mutex );
+    for(Entries::const_iterator i = _entries.begin(); i != _entries.end(); ++i)
+    {
+        output << i->first.getLOD() << ' ' << i->first.getTileX() << ' ' << i->first.getTileY() << ' '
+            << (long long)i->second._expires << ' ' << (int)i->second._reason << std::endl;
+    }
 }
 
 
@@ -143,7 +335,12 @@ TileBlacklist::write(std::ostream &output) const
 
 TileSourceOptions::TileSourceOptions( const ConfigOptions& options ) :
 DriverConfigOptions   ( options ),
+_blacklistMaxAge      ( 3600u ),
+_blacklistRetryDelay  ( 30u ),
+_blacklistInherit     ( false ),
 _L2CacheSize          ( 16 ),
+_L2CacheMaxBytes      ( 0u ),
+_L2CacheShared        ( false ),
 _bilinearReprojection ( true ),
 _coverage             ( false )
 { 
@@ -156,7 +353,12 @@ TileSourceOptions::getConfig() const
 {
     Config conf = DriverConfigOptions::getConfig();
     conf.set( "blacklist_filename", _blacklistFilename);
+    conf.set( "blacklist_max_age", _blacklistMaxAge );
+    conf.set( "blacklist_retry_delay", _blacklistRetryDelay );
+    conf.set( "blacklist_inherit", _blacklistInherit );
     conf.set( "l2_cache_size", _L2CacheSize );
+    conf.set( "l2_cache_max_bytes", _L2CacheMaxBytes );
+    conf.set( "l2_cache_shared", _L2CacheShared );
     conf.set( "bilinear_reprojection", _bilinearReprojection );
     conf.set( "coverage", _coverage );
     conf.set( "osg_option_string", _osgOptionString );
@@ -177,7 +379,12 @@ void
 TileSourceOptions::fromConfig( const Config& conf )
 {
     conf.getIfSet( "blacklist_filename", _blacklistFilename);
+    conf.getIfSet( "blacklist_max_age", _blacklistMaxAge );
+    conf.getIfSet( "blacklist_retry_delay", _blacklistRetryDelay );
+    conf.getIfSet( "blacklist_inherit", _blacklistInherit );
     conf.getIfSet( "l2_cache_size", _L2CacheSize );
+    conf.getIfSet( "l2_cache_max_bytes", _L2CacheMaxBytes );
+    conf.getIfSet( "l2_cache_shared", _L2CacheShared );
     conf.getIfSet( "bilinear_reprojection", _bilinearReprojection );
     conf.getIfSet( "coverage", _coverage );
     conf.getIfSet( "osg_option_string", _osgOptionString );
@@ -226,6 +433,10 @@ _maxValidValue(  32000.0f )
         //Initialize the blacklist if we couldn't read it.
         _blacklist = new TileBlacklist();
     }
+
+    _blacklist->setMaxAge( _options.blacklistMaxAge().get() );
+    _blacklist->setRetryDelay( _options.blacklistRetryDelay().get() );
+    _blacklist->setInherit( _options.blacklistInherit().get() );
 }
 
 TileSource::~TileSource()
@@ -63,15 +63,16 @@ namespace
 //------------------------------------------------------------------------
 
 URIStream::URIStream( const URI& uri ) :
-_fileStream( 0L )
+_fileStream( 0L ),
+_response  ( 0L )
 {
     if ( osgDB::containsServerAddress(uri.full()) )
     {
         HTTPResponse res = HTTPClient::get( uri.full() );
-        if ( res.isOK() )
+        if ( res.isOK() && res.getNumParts() > 0 )
         {
-            std::string buf = res.getPartAsString(0);
-            _bufStream.str(buf);
+            // keep the response and read its body in place.
+            _response = new HTTPResponse( res );
         }
     }
     else
@@ -84,6 +85,8 @@ URIStream::~URIStream()
 {
     if ( _fileStream )
         delete _fileStream;
+    if ( _response )
+        delete _response;
 }
 
 URIStream::operator std::istream& ()
@@ -92,6 +95,8 @@ URIStream::operator std::istream& ()
 
     if ( _fileStream )
         return *_fileStream;
+    else if ( _response )
+        return _response->getPartStream(0);
     else
         return _bufStream;
 }
@@ -283,6 +288,48 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------
+    // Conditional requests
+
+    /**
+     * Finds a response header recorded in a cached result's metadata.
+     * Header names are case-insensitive (and come in lower case over HTTP/2).
+     */
+    std::string getCachedHeader( const Config& meta, const std::string& name )
+    {
+        for( ConfigSet::const_iterator i = meta.children().begin(); i != meta.children().end(); ++i )
+        {
+            if ( ciEquals(i->key(), name) )
+                return i->value();
+        }
+        return "";
+    }
+
+    /**
+     * Makes a request conditional on the validators the server sent with a
+     * cached response, so unchanged content comes back as a bodiless 304.
+     * Falls back on the cache timestamp when the server sent neither.
+     */
+    void setValidators( HTTPRequest& req, const ReadResult& cached )
+    {
+        std::string etag = getCachedHeader( cached.metadata(), "ETag" );
+        if ( !etag.empty() )
+        {
+            req.setETag( etag );
+        }
+
+        // send the server's own date back verbatim; our clocks may disagree.
+        std::string lastModified = getCachedHeader( cached.metadata(), "Last-Modified" );
+        if ( !lastModified.empty() )
+        {
+            req.addHeader( "If-Modified-Since", lastModified );
+        }
+        else if ( etag.empty() && cached.lastModifiedTime() > 0 )
+        {
+            req.setLastModified( cached.lastModifiedTime() );
+        }
+    }
+
     //--------------------------------------------------------------------
     // Read functors (used by the doRead method)
 
@@ -291,15 +338,7 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_OBJECTS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readObject(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readObject(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
-        {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
-            return HTTPClient::readObject(req, opt, p);
-        }
+        ReadResult fromHTTP( const HTTPRequest& req, const osgDB::Options* opt, ProgressCallback* p ) { return HTTPClient::readObject(req, opt, p); }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) {
             return ReadResult(osgDB::readRefObjectFile(uri, opt).get());
         }
@@ -310,15 +349,7 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_NODES) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readNode(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key ) { return bin->readObject(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
-        {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
-            return HTTPClient::readNode(req, opt, p);
-        }
+        ReadResult fromHTTP( const HTTPRequest& req, const osgDB::Options* opt, ProgressCallback* p ) { return HTTPClient::readNode(req, opt, p); }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) {
             return ReadResult(osgDB::readRefNodeFile(uri, opt));
         }
@@ -339,14 +370,9 @@ namespace
             if ( r.getImage() ) r.getImage()->setFileName( key );
             return r;
         }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified ) { 
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
+        ReadResult fromHTTP( const HTTPRequest& req, const osgDB::Options* opt, ProgressCallback* p ) { 
             ReadResult r = HTTPClient::readImage(req, opt, p);
-            if ( r.getImage() ) r.getImage()->setFileName( uri );
+            if ( r.getImage() ) r.getImage()->setFileName( req.getURL() );
             return r;
         }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { 
@@ -361,15 +387,7 @@ namespace
         bool callbackRequestsCaching( URIReadCallback* cb ) const { return !cb || ((cb->cachingSupport() & URIReadCallback::CACHE_STRINGS) != 0); }
         ReadResult fromCallback( URIReadCallback* cb, const std::string& uri, const osgDB::Options* opt ) { return cb->readString(uri, opt); }
         ReadResult fromCache( CacheBin* bin, const std::string& key) { return bin->readString(key, 0L); }
-        ReadResult fromHTTP( const std::string& uri, const osgDB::Options* opt, ProgressCallback* p, TimeStamp lastModified )
-        {
-            HTTPRequest req(uri);            
-            if (lastModified > 0)
-            {
-                req.setLastModified(lastModified);
-            }
-            return HTTPClient::readString(req, opt, p);
-        }
+        ReadResult fromHTTP( const HTTPRequest& req, const osgDB::Options* opt, ProgressCallback* p ) { return HTTPClient::readString(req, opt, p); }
         ReadResult fromFile( const std::string& uri, const osgDB::Options* opt ) { return readStringFile(uri, opt); }
     };
 
@@ -491,8 +509,8 @@ namespace
                             Registry::instance()->cloneOrCreateOptions( localOptions.get() );
                         remoteOptions->getDatabasePathList().push_front( osgDB::getFilePath(uri.full()) );
 
-                        // Store the existing object from the cache if there is one.
-                        osg::ref_ptr< osg::Object > object = result.getObject();
+                        // Keep the expired result from the cache, to revalidate it.
+                        ReadResult cachedResult = result;
 
                         // try to use the callback if it's set. Callback ignores the caching policy.
                         if ( cb )
@@ -511,11 +529,18 @@ namespace
                             // still no data, go to the source:
                             if ( (result.empty() || expired) && cp->usage() != CachePolicy::USAGE_CACHE_ONLY )
                             {                                
-                                ReadResult remoteResult = reader.fromHTTP( uri.full(), remoteOptions.get(), progress, result.lastModifiedTime() );
-                                if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED)
+                                HTTPRequest request( uri.full() );
+                                if ( expired )
+                                    setValidators( request, cachedResult );
+
+                                ReadResult remoteResult = reader.fromHTTP( request, remoteOptions.get(), progress );
+                                if (remoteResult.code() == ReadResult::RESULT_NOT_MODIFIED && expired)
                                 {                                    
                                     OE_DEBUG << LC << uri.full() << " not modified, using cached result" << std::endl;
+                                    result = cachedResult;
+
                                     // Touch the cached item to update it's last modified timestamp so it doesn't expire again immediately.
+                                    // The stored validators stay as they were.
                                     if (bin)
                                         bin->touch( uri.cacheKey() );
                                 }
@@ -0,0 +1,241 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarth/UniformTile>
+#include <osgEarth/ImageUtils>
+#include <osg/Image>
+#include <osg/Shape>
+#include <algorithm>
+#include <string.h>
+
+using namespace osgEarth;
+
+namespace
+{
+    // Descriptor layout (little-endian):
+    //   [4] magic
+    //   [1] kind
+    //   image:       s, t, r, pixelFormat, dataType, internalFormat, packing, origin (4 each),
+    //                then one pixel (the rest of the descriptor)
+    //   heightfield: columns, rows, border width (4 each),
+    //                origin x/y/z, x interval, y interval (8 each),
+    //                skirt height, height (4 each)
+    const char     MAGIC[4]         = { 'o', 'e', 'u', 't' };
+    const unsigned HEADER_SIZE      = 5u;
+    const char     KIND_IMAGE       = 1;
+    const char     KIND_HEIGHTFIELD = 2;
+
+    const unsigned IMAGE_SIZE       = HEADER_SIZE + 8u*4u;
+    const unsigned HEIGHTFIELD_SIZE = HEADER_SIZE + 3u*4u + 5u*8u + 2u*4u;
+
+    // the largest pixel we'll describe (4 x 64-bit channels)
+    const unsigned MAX_PIXEL_BYTES  = 32u;
+
+    void put32(std::string& out, unsigned value)
+    {
+        for(unsigned i=0; i<4u; ++i)
+            out.push_back((char)((value >> (8u*i)) & 0xff));
+    }
+
+    unsigned get32(const char*& in)
+    {
+        unsigned value = 0u;
+        for(unsigned i=0; i<4u; ++i)
+            value |= (unsigned)(unsigned char)in[i] << (8u*i);
+        in += 4;
+        return value;
+    }
+
+    void putFloat(std::string& out, float value)
+    {
+        unsigned bits;
+        memcpy(&bits, &value, 4);
+        put32(out, bits);
+    }
+
+    float getFloat(const char*& in)
+    {
+        unsigned bits = get32(in);
+        float value;
+        memcpy(&value, &bits, 4);
+        return value;
+    }
+
+    void putDouble(std::string& out, double value)
+    {
+        unsigned long long bits;
+        memcpy(&bits, &value, 8);
+        put32(out, (unsigned)(bits & 0xffffffffu));
+        put32(out, (unsigned)(bits >> 32));
+    }
+
+    double getDouble(const char*& in)
+    {
+        unsigned long long lo = get32(in);
+        unsigned long long hi = get32(in);
+        unsigned long long bits = lo | (hi << 32);
+        double value;
+        memcpy(&value, &bits, 8);
+        return value;
+    }
+
+    bool isUniform(const osg::HeightField* hf)
+    {
+        const osg::FloatArray* heights = hf->getFloatArray();
+        if ( !heights || heights->empty() )
+            return false;
+
+        const float* data = &heights->front();
+        for(unsigned i=1; i<heights->size(); ++i)
+        {
+            if ( memcmp(&data[i], &data[0], sizeof(float)) != 0 )
+                return false;
+        }
+        return true;
+    }
+}
+
+bool
+UniformTile::encode(const osg::Object* object, std::string& out)
+{
+    // the descriptor has no room for user data (like the flag set by
+    // ImageUtils::markAsUnNormalized), so leave such objects to OSGB.
+    if ( !object || object->getUserDataContainer() )
+        return false;
+
+    const osg::Image* image = dynamic_cast<const osg::Image*>(object);
+    if ( image )
+    {
+        unsigned pixelBytes = image->getPixelSizeInBits() / 8u;
+        if ( pixelBytes > MAX_PIXEL_BYTES || !ImageUtils::isUniformImage(image) )
+            return false;
+
+        out.clear();
+        out.append(MAGIC, 4);
+        out.push_back(KIND_IMAGE);
+        put32(out, image->s());
+        put32(out, image->t());
+        put32(out, image->r());
+        put32(out, image->getPixelFormat());
+        put32(out, image->getDataType());
+        put32(out, image->getInternalTextureFormat());
+        put32(out, image->getPacking());
+        put32(out, image->getOrigin());
+        out.append((const char*)image->data(), pixelBytes);
+        return true;
+    }
+
+    const osg::HeightField* hf = dynamic_cast<const osg::HeightField*>(object);
+    if ( hf )
+    {
+        if ( !isUniform(hf) || !hf->getRotation().zeroRotation() )
+            return false;
+
+        out.clear();
+        out.append(MAGIC, 4);
+        out.push_back(KIND_HEIGHTFIELD);
+        put32(out, hf->getNumColumns());
+        put32(out, hf->getNumRows());
+        put32(out, hf->getBorderWidth());
+        putDouble(out, hf->getOrigin().x());
+        putDouble(out, hf->getOrigin().y());
+        putDouble(out, hf->getOrigin().z());
+        putDouble(out, hf->getXInterval());
+        putDouble(out, hf->getYInterval());
+        putFloat(out, hf->getSkirtHeight());
+        putFloat(out, hf->getFloatArray()->front());
+        return true;
+    }
+
+    return false;
+}
+
+bool
+UniformTile::isDescriptor(const char* data, unsigned size)
+{
+    return data && size > HEADER_SIZE && memcmp(data, MAGIC, 4) == 0;
+}
+
+osg::Object*
+UniformTile::decode(const char* data, unsigned size)
+{
+    if ( !isDescriptor(data, size) )
+        return 0L;
+
+    const char* in = data + HEADER_SIZE;
+
+    if ( data[4] == KIND_IMAGE && size > IMAGE_SIZE )
+    {
+        int s = get32(in), t = get32(in), r = get32(in);
+        GLenum pixelFormat    = get32(in);
+        GLenum dataType       = get32(in);
+        GLint  internalFormat = get32(in);
+        unsigned packing      = get32(in);
+        unsigned origin       = get32(in);
+
+        unsigned pixelBytes = size - IMAGE_SIZE;
+        if ( s <= 0 || t <= 0 || r <= 0 || pixelBytes > MAX_PIXEL_BYTES )
+            return 0L;
+
+        osg::ref_ptr<osg::Image> image = new osg::Image();
+        image->allocateImage(s, t, r, pixelFormat, dataType, packing);
+        if ( !image->data() || image->getPixelSizeInBits() != pixelBytes*8u )
+            return 0L;
+
+        image->setInternalTextureFormat(internalFormat);
+        image->setOrigin((osg::Image::Origin)origin);
+
+        // fill the first row, then copy it to the others.
+        unsigned char* first = image->data(0, 0, 0);
+        for(int i=0; i<s; ++i)
+            memcpy(first + i*pixelBytes, in, pixelBytes);
+
+        for(int k=0; k<r; ++k)
+            for(int j=0; j<t; ++j)
+                if ( k > 0 || j > 0 )
+                    memcpy(image->data(0, j, k), first, s*pixelBytes);
+
+        return image.release();
+    }
+
+    if ( data[4] == KIND_HEIGHTFIELD && size == HEIGHTFIELD_SIZE )
+    {
+        unsigned cols   = get32(in);
+        unsigned rows   = get32(in);
+        unsigned border = get32(in);
+        double ox = getDouble(in), oy = getDouble(in), oz = getDouble(in);
+        double dx = getDouble(in), dy = getDouble(in);
+        float skirt  = getFloat(in);
+        float height = getFloat(in);
+
+        if ( cols == 0u || rows == 0u )
+            return 0L;
+
+        osg::HeightField* hf = new osg::HeightField();
+        hf->allocate(cols, rows);
+        hf->setBorderWidth(border);
+        hf->setOrigin(osg::Vec3(ox, oy, oz));
+        hf->setXInterval(dx);
+        hf->setYInterval(dy);
+        hf->setSkirtHeight(skirt);
+        std::fill(hf->getFloatArray()->begin(), hf->getFloatArray()->end(), height);
+        return hf;
+    }
+
+    return 0L;
+}
@@ -25,22 +25,41 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/StringUtils>
 #include <osgEarth/Registry>
+#include <osgEarth/DateTime>
+#include <osgEarth/UniformTile>
 #include <osgDB/FileUtils>
 #include <osgDB/FileNameUtils>
+#include <OpenThreads/Atomic>
 #include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
 #include <sys/stat.h>
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers;
 using namespace osgEarth::Threading;
 
-#ifndef _WIN32
+#ifdef _WIN32
+#   include <windows.h>
+#   include <process.h>
+#   define getpid _getpid
+#else
 #   include <unistd.h>
 #endif
 
 #define OSG_FORMAT "osgb"
 #define OSG_EXT   ".osgb"
 
+// version 2 entry files: a header with the metadata, then the OSGB payload
+#define ENTRY_EXT ".oec"
+
+// marks a bin that was created with the version 2 layout
+#define LAYOUT_MARKER "osgearth_cache_v2"
+
+// number of lock stripes per bin
+#define NUM_STRIPES 64
+
 namespace
 {
     /** 
@@ -76,6 +95,17 @@ namespace
     /** 
      * Cache bin implementation for a FileSystemCache.
      * You don't need to create this object directly; use FileSystemCache::createBin instead.
+     *
+     * Each entry is one file holding a small header (write time and metadata)
+     * followed by the OSGB payload. Files live two hashed directory levels
+     * below the bin (256 x 256 folders) and are replaced atomically by writing
+     * a temporary file and renaming it. Concurrent access is serialized per
+     * key through a set of lock stripes, so writing one entry does not block
+     * readers of the others.
+     *
+     * Bins written by the previous layout (a .osgb file plus a .meta sidecar)
+     * are still readable; each such entry moves to the new layout the first
+     * time it is read.
     */
     class FileSystemCacheBin : public CacheBin
     {
@@ -117,6 +147,22 @@ namespace
 
         const osgDB::Options* mergeOptions(const osgDB::Options* in);
 
+        ReadResult read(const std::string& key, const osgDB::Options* dbo, bool image);
+
+        // full path of a key's entry file
+        std::string entryPath(const std::string& key, unsigned hash) const;
+
+        // writes an entry file, replacing any existing one
+        bool writeEntry(const std::string& key, unsigned hash, TimeStamp time, const Config& meta, const std::string& payload);
+
+        // path (minus extension) of a key in the previous layout
+        std::string legacyPath(const std::string& key) const;
+
+        // moves a key's entry from the previous layout to the current one
+        bool migrateLegacy(const std::string& key, unsigned hash);
+
+        Threading::ReadWriteMutex& stripe(unsigned hash) { return _stripes[hash % NUM_STRIPES]; }
+
         bool                              _ok;
         bool                              _binPathExists;
         std::string                       _metaPath;       // full path to the bin's metadata file
@@ -124,18 +170,97 @@ namespace
         std::string                       _compressorName;
         osg::ref_ptr<osgDB::ReaderWriter> _rw;
         osg::ref_ptr<osgDB::Options>      _zlibOptions;
-        mutable Threading::ReadWriteMutex _mutex;
+        mutable Threading::ReadWriteMutex _mutex;          // bin metadata and clear()
+        Threading::ReadWriteMutex         _stripes[NUM_STRIPES];
+        OpenThreads::Atomic               _hasLegacy;      // nonzero if the bin may hold entries in the previous layout
+
+        bool hasLegacy() const { return (unsigned)_hasLegacy != 0u; }
     };
 
-    void writeMeta( const std::string& fullPath, const Config& meta )
+    // Entry file header:
+    //   [4]  magic
+    //   [8]  write time (seconds UTC, little-endian)
+    //   [4]  metadata length N (little-endian)
+    //   [N]  metadata (JSON)
+    // followed by the OSGB payload.
+    const char     ENTRY_MAGIC[4]    = { 'o', 'e', 'f', '2' };
+    const unsigned ENTRY_HEADER_SIZE = 16u;
+
+    void putFixed(std::string& out, uint64_t value, unsigned bytes)
     {
-        std::ofstream outmeta( fullPath.c_str() );
-        if ( outmeta.is_open() )
+        for(unsigned i=0; i<bytes; ++i)
+            out.push_back((char)((value >> (8u*i)) & 0xff));
+    }
+
+    uint64_t getFixed(const char* in, unsigned bytes)
+    {
+        uint64_t value = 0u;
+        for(unsigned i=0; i<bytes; ++i)
+            value |= (uint64_t)(unsigned char)in[i] << (8u*i);
+        return value;
+    }
+
+    /** Reads an entry header, leaving the stream at the start of the payload. */
+    bool readHeader(std::istream& in, TimeStamp& time, Config& meta)
+    {
+        char header[ENTRY_HEADER_SIZE];
+        if ( !in.read(header, ENTRY_HEADER_SIZE) || memcmp(header, ENTRY_MAGIC, 4) != 0 )
+            return false;
+
+        time = (TimeStamp)(int64_t)getFixed(header+4, 8);
+
+        unsigned metaSize = (unsigned)getFixed(header+12, 4);
+        if ( metaSize > 0u )
         {
-            outmeta << meta.toJSON();
-            outmeta.flush();
-            outmeta.close();
+            std::string json(metaSize, '\0');
+            if ( !in.read(&json[0], metaSize) )
+                return false;
+            meta.fromJSON( json );
         }
+        return true;
+    }
+
+    /** Decodes the rest of the stream if it holds a uniform-tile descriptor;
+        otherwise leaves the stream where it was. */
+    bool readUniformTile(std::istream& in, osg::ref_ptr<osg::Object>& out)
+    {
+        std::istream::pos_type start = in.tellg();
+
+        // descriptors are tiny, so anything this big is an OSGB stream.
+        char buf[128];
+        in.read(buf, sizeof(buf));
+        unsigned size = (unsigned)in.gcount();
+        if ( size < sizeof(buf) && UniformTile::isDescriptor(buf, size) )
+        {
+            out = UniformTile::decode(buf, size);
+            return true;
+        }
+
+        in.clear();
+        in.seekg(start);
+        return false;
+    }
+
+    /** Renames a file, replacing the target if it exists. */
+    bool replaceFile(const std::string& from, const std::string& to)
+    {
+#ifdef _WIN32
+        return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return ::rename(from.c_str(), to.c_str()) == 0;
+#endif
+    }
+
+    /** Reads a whole file into a string. */
+    bool readFile(const std::string& path, std::string& out)
+    {
+        std::ifstream in( path.c_str(), std::ios_base::in | std::ios_base::binary );
+        if ( !in.is_open() )
+            return false;
+        std::stringstream buf;
+        buf << in.rdbuf();
+        out = buf.str();
+        return true;
     }
 
     void readMeta( const std::string& fullPath, Config& meta )
@@ -213,18 +338,50 @@ namespace
     std::string
     FileSystemCacheBin::getHashedKey(const std::string& key) const
     {
+        return entryPath(key, osgEarth::hashString(key));
+    }
+
+    std::string
+    FileSystemCacheBin::entryPath(const std::string& key, unsigned hash) const
+    {
+        // two levels of 256 folders keep each folder small even in very large caches.
+        std::string name;
+        if ( getHashKeys() )
+        {
+            name = Stringify() << std::hex << std::setfill('0') << std::setw(8) << hash;
+        }
+        else
+        {
+            name = osgEarth::toLegalFileName(key);
+            osgEarth::replaceIn(name, "/", "{2f}");
+            osgEarth::replaceIn(name, "\\", "{5c}");
+        }
+
+        std::string fanout = Stringify()
+            << std::hex << std::setfill('0')
+            << std::setw(2) << ((hash >> 24) & 0xff) << "/"
+            << std::setw(2) << ((hash >> 16) & 0xff);
+
+        return osgDB::concatPaths( osgDB::concatPaths(_binPath, fanout), name + ENTRY_EXT );
+    }
+
+    std::string
+    FileSystemCacheBin::legacyPath(const std::string& key) const
+    {
+        std::string hashed;
         if ( getHashKeys() )
         {
             unsigned hash = osgEarth::hashString(key);
             unsigned b1 = (hash & 0xfff00000) >> 20;
             unsigned b2 = (hash & 0x000fff00) >> 8;
             unsigned b3 = (hash & 0x000000ff);
-            return Stringify() << std::hex << std::setfill('0') << std::setw(3) << b1 << "/" << b2 << "/" << std::setw(2) << b3;
+            hashed = Stringify() << std::hex << std::setfill('0') << std::setw(3) << b1 << "/" << b2 << "/" << std::setw(2) << b3;
         }
         else
         {
-            return osgEarth::toLegalFileName(key);
+            hashed = osgEarth::toLegalFileName(key);
         }
+        return URI( hashed, _metaPath ).full();
     }
 
     bool
@@ -265,6 +422,8 @@ namespace
         }
         else if ( !_binPathExists )
         {
+            bool created = !osgDB::fileExists(_binPath);
+
             osgEarth::makeDirectoryForFile( _metaPath );
 
             if ( osgDB::fileExists(_binPath) )
@@ -272,6 +431,13 @@ namespace
                 // ready to go
                 _binPathExists = true;
                 _ok = true;
+
+                // a new bin can't hold anything in the old layout.
+                if ( created )
+                {
+                    std::ofstream marker( osgDB::concatPaths(_binPath, LAYOUT_MARKER).c_str() );
+                    _hasLegacy.exchange( 0u );
+                }
             }
             else
             {
@@ -291,11 +457,24 @@ namespace
                                            const std::string&   rootPath) :
     CacheBin            ( binID ),
     _binPathExists      ( false ),
-    _ok( true )
+    _ok( true ),
+    _hasLegacy          ( 0u )
     {
         _binPath = osgDB::concatPaths( rootPath, binID );
         _metaPath = osgDB::concatPaths( _binPath, "osgearth_cacheinfo.json" );
 
+        // an existing bin without the layout marker was written by an older version.
+        if ( osgDB::fileExists( _binPath ) &&
+             !osgDB::fileExists( osgDB::concatPaths(_binPath, LAYOUT_MARKER) ) )
+        {
+            _hasLegacy.exchange( 1u );
+        }
+
+        if ( hasLegacy() )
+        {
+            OE_INFO << LC << "Bin [" << binID << "] uses the previous layout; entries will be migrated as they are read" << std::endl;
+        }
+
         _rw = osgDB::Registry::instance()->getReaderWriterForExtension(OSG_FORMAT);
 
         _zlibOptions = Registry::instance()->cloneOrCreateOptions();
@@ -340,75 +519,148 @@ namespace
     ReadResult
     FileSystemCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
     {
-        if ( !binValidForReading() ) 
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        return read(key, readOptions, true);
+    }
 
-        // mangle "key" into a legal path name
-        URI fileURI( getHashedKey(key), _metaPath );
-        std::string path = fileURI.full() + OSG_EXT;
+    ReadResult
+    FileSystemCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+    {
+        return read(key, readOptions, false);
+    }
 
-        if ( !osgDB::fileExists(path) )
-            return ReadResult( ReadResult::RESULT_NOT_FOUND );
+    ReadResult
+    FileSystemCacheBin::read(const std::string& key, const osgDB::Options* readOptions, bool image)
+    {
+        if ( !binValidForReading() ) 
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
 
-        osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);     
+        unsigned hash = osgEarth::hashString(key);
+        std::string path = entryPath(key, hash);
 
         osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
 
-        osgDB::ReaderWriter::ReadResult r;
+        for(int attempt = 0; attempt < 2; ++attempt)
         {
-            ScopedReadLock lock(_mutex);
+            {
+                // the shared lock keeps the file in place while we read it.
+                ScopedReadLock lock( stripe(hash) );
 
-            r = _rw->readImage( path, dbo.get() );
-            if ( !r.success() )
-                return ReadResult();
+                // opening the file doubles as the existence check.
+                std::ifstream in( path.c_str(), std::ios_base::in | std::ios_base::binary );
+                if ( in.is_open() )
+                {
+                    TimeStamp timeStamp;
+                    Config meta;
+                    if ( !readHeader(in, timeStamp, meta) )
+                    {
+                        OE_WARN << LC << "Corrupt cache entry \"" << key << "\" in bin [" << getID() << "]" << std::endl;
+                        return ReadResult();
+                    }
 
-            // read metadata
-            Config meta;
-            std::string metafile = fileURI.full() + ".meta";
-            if ( osgDB::fileExists(metafile) )
-                readMeta( metafile, meta );
+                    osg::ref_ptr<osg::Object> object;
+                    if ( readUniformTile(in, object) )
+                    {
+                        if ( !object.valid() || (image && !dynamic_cast<osg::Image*>(object.get())) )
+                            return ReadResult();
+                    }
+                    else
+                    {
+                        osgDB::ReaderWriter::ReadResult r = image ?
+                            _rw->readImage( in, dbo.get() ) :
+                            _rw->readObject( in, dbo.get() );
 
-            ReadResult rr( r.getImage(), meta );
-            rr.setLastModifiedTime(timeStamp);
-            return rr;            
+                        if ( !r.success() )
+                            return ReadResult();
+
+                        object = image ? (osg::Object*)r.getImage() : r.getObject();
+                    }
+
+                    ReadResult rr( object.get(), meta );
+                    rr.setLastModifiedTime(timeStamp);
+                    return rr;
+                }
+            }
+
+            // not found; it may still be in the previous layout.
+            if ( attempt > 0 || !hasLegacy() || !migrateLegacy(key, hash) )
+                break;
         }
+
+        return ReadResult( ReadResult::RESULT_NOT_FOUND );
     }
 
-    ReadResult
-    FileSystemCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+    bool
+    FileSystemCacheBin::migrateLegacy(const std::string& key, unsigned hash)
     {
-        if ( !binValidForReading() ) 
-            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        std::string base = legacyPath(key);
+        std::string oldPath = base + OSG_EXT;
 
-        // mangle "key" into a legal path name
-        URI fileURI( getHashedKey(key), _metaPath );
-        std::string path = fileURI.full() + OSG_EXT;
+        // the old payload is an OSGB stream already, so it moves over as-is.
+        std::string payload;
+        if ( !readFile(oldPath, payload) )
+            return false;
 
-        if ( !osgDB::fileExists(path) )
-            return ReadResult( ReadResult::RESULT_NOT_FOUND );
+        Config meta;
+        std::string metaPath = base + ".meta";
+        readMeta( metaPath, meta );
 
-        osgEarth::TimeStamp timeStamp = osgEarth::getLastModifiedTime(path);
+        if ( !writeEntry(key, hash, osgEarth::getLastModifiedTime(oldPath), meta, payload) )
+            return false;
 
-        osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(readOptions);
+        ::unlink( oldPath.c_str() );
+        ::unlink( metaPath.c_str() );
+        return true;
+    }
+
+    bool
+    FileSystemCacheBin::writeEntry(const std::string& key, unsigned hash, TimeStamp time, const Config& meta, const std::string& payload)
+    {
+        static OpenThreads::Atomic s_tempCounter;
+
+        std::string path = entryPath(key, hash);
+        std::string temp = Stringify() << path << "." << getpid() << "." << (unsigned)++s_tempCounter << ".tmp";
 
-        osgDB::ReaderWriter::ReadResult r;
+        std::string header;
+        std::string json = meta.empty() ? std::string() : meta.toJSON(false);
+        header.append(ENTRY_MAGIC, 4);
+        putFixed(header, (uint64_t)(int64_t)time, 8);
+        putFixed(header, json.size(), 4);
+        header.append(json);
+
+        // write the whole entry to a temporary file...
         {
-            ScopedReadLock lock(_mutex);
+            std::ofstream out( temp.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+            if ( !out.is_open() )
+            {
+                // first entry in this folder; make a home for it.
+                osgEarth::makeDirectoryForFile( path );
+                out.open( temp.c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc );
+                if ( !out.is_open() )
+                    return false;
+            }
 
-            r = _rw->readObject( path, dbo.get() );
-            if ( !r.success() )
-                return ReadResult();
+            out.write( header.data(), header.size() );
+            out.write( payload.data(), payload.size() );
+            out.close();
 
-            // read metadata
-            Config meta;
-            std::string metafile = fileURI.full() + ".meta";
-            if ( osgDB::fileExists(metafile) )
-                readMeta( metafile, meta );
+            if ( out.fail() )
+            {
+                ::unlink( temp.c_str() );
+                return false;
+            }
+        }
 
-            ReadResult rr( r.getObject(), meta );
-            rr.setLastModifiedTime(timeStamp);
-            return rr;            
+        // ...then swap it in, so readers never see a partial entry.
+        bool ok;
+        {
+            ScopedWriteLock lock( stripe(hash) );
+            ok = replaceFile( temp, path );
         }
+
+        if ( !ok )
+            ::unlink( temp.c_str() );
+
+        return ok;
     }
 
     ReadResult
@@ -434,52 +686,50 @@ namespace
         if ( !binValidForWriting() || !object ) 
             return false;
 
-        // convert the key into a legal filename:
-        URI fileURI( getHashedKey(key), _metaPath );
-        
-        osgDB::ReaderWriter::WriteResult r;
+        osgDB::ReaderWriter::WriteResult r(osgDB::ReaderWriter::WriteResult::FILE_SAVED);
 
-        bool objWriteOK = false;
+        // encode outside of any lock; this is the expensive part.
+        // A tile that's all one value only needs a descriptor.
+        std::string payload;
+        if ( !UniformTile::encode(object, payload) )
         {
-            // prevent cache contention:
-            ScopedWriteLock lock(_mutex);
-
-            // make a home for it..
-            if ( !osgDB::fileExists( osgDB::getFilePath(fileURI.full()) ) )
-                osgEarth::makeDirectoryForFile( fileURI.full() );
-
+            std::stringstream buf;
             osg::ref_ptr<const osgDB::Options> dbo = mergeOptions(writeOptions);
 
             if ( dynamic_cast<const osg::Image*>(object) )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeImage( *static_cast<const osg::Image*>(object), filename, dbo.get() );
-                objWriteOK = r.success();
+                r = _rw->writeImage( *static_cast<const osg::Image*>(object), buf, dbo.get() );
             }
             else if ( dynamic_cast<const osg::Node*>(object) )
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeNode(*static_cast<const osg::Node*>(object), filename, dbo.get());
-                objWriteOK = r.success();
+                r = _rw->writeNode(*static_cast<const osg::Node*>(object), buf, dbo.get());
             }
             else
             {
-                std::string filename = fileURI.full() + OSG_EXT;
-                r = _rw->writeObject(*object, filename, dbo.get());
-                objWriteOK = r.success();
+                r = _rw->writeObject(*object, buf, dbo.get());
             }
+            payload = buf.str();
+        }
 
-            // write metadata
-            if ( !meta.empty() && objWriteOK )
-            {
-                std::string metaname = fileURI.full() + ".meta";
-                writeMeta( metaname, meta );
-            }
+        bool objWriteOK = r.success();
+
+        unsigned hash = osgEarth::hashString(key);
+        if ( objWriteOK )
+        {
+            objWriteOK = writeEntry( key, hash, DateTime().asTimeStamp(), meta, payload );
         }
 
         if ( objWriteOK )
         {
-            OE_DEBUG << LC << "Wrote \"" << key << "\" to cache bin [" << getID() << "] path=" << fileURI.full() << "." << OSG_EXT << std::endl;
+            // drop any stale copy in the previous layout.
+            if ( hasLegacy() )
+            {
+                std::string base = legacyPath(key);
+                ::unlink( (base + OSG_EXT).c_str() );
+                ::unlink( (base + ".meta").c_str() );
+            }
+
+            OE_DEBUG << LC << "Wrote \"" << key << "\" to cache bin [" << getID() << "] path=" << entryPath(key, hash) << std::endl;
         }
         else
         {
@@ -496,34 +746,68 @@ namespace
         if ( !binValidForReading() ) 
             return STATUS_NOT_FOUND;
 
-        URI fileURI( getHashedKey(key), _metaPath );
-        std::string path( fileURI.full() + OSG_EXT );
-        if ( !osgDB::fileExists(path) )
-            return STATUS_NOT_FOUND;
+        if ( osgDB::fileExists(getHashedKey(key)) )
+            return STATUS_OK;
+
+        if ( hasLegacy() && osgDB::fileExists(legacyPath(key) + OSG_EXT) )
+            return STATUS_OK;
 
-        return STATUS_OK;
+        return STATUS_NOT_FOUND;
     }
 
     bool
     FileSystemCacheBin::remove(const std::string& key)
     {
         if ( !binValidForReading() ) return false;
-        URI fileURI( getHashedKey(key), _metaPath );
-        std::string path( fileURI.full() + OSG_EXT );
 
-        ScopedWriteLock lock(_mutex);
-        return ::unlink( path.c_str() ) == 0;
+        unsigned hash = osgEarth::hashString(key);
+        std::string path = entryPath(key, hash);
+
+        bool ok;
+        {
+            ScopedWriteLock lock( stripe(hash) );
+            ok = ::unlink( path.c_str() ) == 0;
+        }
+
+        if ( hasLegacy() )
+        {
+            std::string base = legacyPath(key);
+            ok = (::unlink( (base + OSG_EXT).c_str() ) == 0) || ok;
+            ::unlink( (base + ".meta").c_str() );
+        }
+
+        return ok;
     }
 
     bool
     FileSystemCacheBin::touch(const std::string& key)
     {
         if ( !binValidForReading() ) return false;
-        URI fileURI( getHashedKey(key), _metaPath );
-        std::string path( fileURI.full() + OSG_EXT );
 
-        ScopedWriteLock lock(_mutex);
-        return osgEarth::touchFile( path );
+        unsigned hash = osgEarth::hashString(key);
+        std::string path = entryPath(key, hash);
+
+        if ( hasLegacy() )
+            migrateLegacy(key, hash);
+
+        // rewrite the time in the header.
+        std::string stamp;
+        putFixed(stamp, (uint64_t)(int64_t)DateTime().asTimeStamp(), 8);
+
+        ScopedWriteLock lock( stripe(hash) );
+
+        std::fstream f( path.c_str(), std::ios_base::in | std::ios_base::out | std::ios_base::binary );
+        if ( !f.is_open() )
+            return false;
+
+        char magic[4];
+        if ( !f.read(magic, 4) || memcmp(magic, ENTRY_MAGIC, 4) != 0 )
+            return false;
+
+        f.seekp(4);
+        f.write(stamp.data(), 8);
+        f.close();
+        return !f.fail();
     }
 
     bool
@@ -552,7 +836,7 @@ namespace
                 }
                 else if ( type == osgDB::REGULAR_FILE )
                 {
-                    if ( full != _metaPath )
+                    if ( full != _metaPath && i->compare(LAYOUT_MARKER) != 0 )
                     {
                         ok = ::unlink( full.c_str() );
                         OE_DEBUG << LC << "Unlink: " << full << std::endl;
@@ -575,7 +859,15 @@ namespace
 
         ScopedWriteLock lock(_mutex);
         std::string binDir = osgDB::getFilePath( _metaPath );
-        return purgeDirectory( binDir );
+        bool ok = purgeDirectory( binDir );
+
+        // nothing is left in the previous layout.
+        if ( ok )
+        {
+            std::ofstream marker( osgDB::concatPaths(_binPath, LAYOUT_MARKER).c_str() );
+            _hasLegacy.exchange( 0u );
+        }
+        return ok;
     }
 
     Config
@@ -35,7 +35,7 @@
 
 #define OSGEARTH_ENV_CACHE_MAX_SIZE_MB "OSGEARTH_CACHE_MAX_SIZE_MB"
 
-#define LEVELDB_CACHE_VERSION 1
+#define LEVELDB_CACHE_VERSION 2
 
 using namespace osgEarth;
 using namespace osgEarth::Drivers::LevelDBCache;
@@ -103,6 +103,9 @@ _active        ( true )
 
 LevelDBCacheImpl::~LevelDBCacheImpl()
 {
+    // persist any queued write-behind writes while the database is still open
+    flush();
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -20,6 +20,8 @@
 #include <osgEarth/Cache>
 #include <osgEarth/Registry>
 #include <osgEarth/Random>
+#include <osgEarth/UniformTile>
+#include <osgEarth/StringUtils>
 #include <osgDB/Registry>
 #include <leveldb/write_batch.h>
 #include <string>
@@ -34,38 +36,113 @@ namespace
 {
     void encodeMeta(const Config& meta, std::string& out)
     {
-        out = Stringify() << meta.toJSON(false);
+        out = meta.toJSON(false);
     }
 
     void decodeMeta(const std::string& in, Config& meta)
     {
-        std::istringstream inmeta(in);
-        inmeta >> std::noskipws;
-        std::stringstream buf;
-        buf << inmeta.rdbuf();
-        std::string bufStr;
-        bufStr = buf.str();
-        meta.fromJSON( bufStr );
+        meta.fromJSON( in );
     }
 
-    void blend(std::string& data, unsigned seed)
+    // XORs the data with a keyed pseudo-random sequence, in place.
+    // Applying it twice restores the original data.
+    void blend(char* data, unsigned size, unsigned seed)
     {
         osgEarth::Random prng(seed, osgEarth::Random::METHOD_FAST);
-        unsigned paddedSize = data.size();
-        if ( data.size() % 4 > 0 ) paddedSize += 4 - (data.size() % 4);
-        char* buf = new char[paddedSize];
-        memcpy(buf, data.c_str(), data.size());
-        unsigned* ptr = (unsigned*)buf;
-        for(unsigned i=0; i<paddedSize/4; ++i, ++ptr)
-            (*ptr) ^= prng.next(INT_MAX);
-        data = std::string(buf, data.size());
-        delete [] buf;
+        for(unsigned i=0; i<size; i += 4)
+        {
+            unsigned word = 0u;
+            unsigned len = osg::minimum(4u, size-i);
+            memcpy(&word, data+i, len);
+            word ^= prng.next(INT_MAX);
+            memcpy(data+i, &word, len);
+        }
     }
 
-    void unblend(std::string& data, unsigned seed)
+    void unblend(char* data, unsigned size, unsigned seed)
+    {
+        blend(data, size, seed);
+    }
+
+    // A (version 2) record holds everything about an entry in one value:
+    //   [4]  magic
+    //   [8]  write time (seconds UTC, little-endian)
+    //   [4]  metadata length N (little-endian)
+    //   [N]  metadata (JSON)
+    //   [..] payload (OSGB stream, blended if the cache is keyed)
+    const char     RECORD_MAGIC[4]    = { 'o', 'e', 'c', '2' };
+    const unsigned RECORD_HEADER_SIZE = 16u;
+
+    void putFixed(std::string& out, uint64_t value, unsigned bytes)
+    {
+        for(unsigned i=0; i<bytes; ++i)
+            out.push_back((char)((value >> (8u*i)) & 0xff));
+    }
+
+    uint64_t getFixed(const char* in, unsigned bytes)
+    {
+        uint64_t value = 0u;
+        for(unsigned i=0; i<bytes; ++i)
+            value |= (uint64_t)(unsigned char)in[i] << (8u*i);
+        return value;
+    }
+
+    void encodeRecord(TimeStamp time, const std::string& meta, const std::string& payload, std::string& out)
+    {
+        out.clear();
+        out.reserve(RECORD_HEADER_SIZE + meta.size() + payload.size());
+        out.append(RECORD_MAGIC, 4);
+        putFixed(out, (uint64_t)(int64_t)time, 8);
+        putFixed(out, meta.size(), 4);
+        out.append(meta);
+        out.append(payload);
+    }
+
+    // Parts of a record; these point into the record's memory.
+    struct RecordView
+    {
+        TimeStamp      time;
+        leveldb::Slice meta;
+        leveldb::Slice payload;
+    };
+
+    bool decodeRecord(const leveldb::Slice& in, RecordView& out)
+    {
+        if (in.size() < RECORD_HEADER_SIZE || memcmp(in.data(), RECORD_MAGIC, 4) != 0)
+            return false;
+
+        unsigned metaSize = (unsigned)getFixed(in.data()+12, 4);
+        if (in.size() < RECORD_HEADER_SIZE + metaSize)
+            return false;
+
+        out.time    = (TimeStamp)(int64_t)getFixed(in.data()+4, 8);
+        out.meta    = leveldb::Slice(in.data()+RECORD_HEADER_SIZE, metaSize);
+        out.payload = leveldb::Slice(in.data()+RECORD_HEADER_SIZE+metaSize, in.size()-RECORD_HEADER_SIZE-metaSize);
+        return true;
+    }
+
+    // Deletes a leveldb iterator when it goes out of scope.
+    struct ScopedIterator
+    {
+        ScopedIterator(leveldb::Iterator* it) : _it(it) { }
+        ~ScopedIterator() { delete _it; }
+        leveldb::Iterator* operator->() const { return _it; }
+        leveldb::Iterator* _it;
+    };
+
+    // Positions the iterator at an exact key; false if there's no such entry.
+    bool seek(ScopedIterator& it, const std::string& key)
     {
-        blend(data, seed);
+        it->Seek(key);
+        return it->Valid() && it->key() == leveldb::Slice(key);
     }
+
+    // Number of accessed records, and seconds, between recency flushes.
+    const unsigned RECENCY_FLUSH_COUNT   = 1024u;
+    const unsigned RECENCY_FLUSH_SECONDS = 10u;
+
+    // Records migrated per write batch.
+    const unsigned MIGRATION_BATCH_SIZE = 256u;
 }
 
 //------------------------------------------------------------------------
@@ -76,6 +153,7 @@ namespace
 #undef  OE_TEST
 #define OE_TEST OE_NOTICE
 
+// time field of a version 1 metadata record
 #define TIME_FIELD "leveldb.time"
 
 
@@ -85,7 +163,8 @@ LevelDBCacheBin::LevelDBCacheBin(const std::string& binID,
 osgEarth::CacheBin( binID ),
 _db               ( db ),
 _tracker          ( tracker ),
-_debug            ( false )
+_debug            ( false ),
+_lastRecencyFlush ( DateTime().asTimeStamp() )
 {
     // reader to parse data:
     _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
@@ -93,11 +172,15 @@ _debug            ( false )
     
     if ( ::getenv("OSGEARTH_CACHE_DEBUG") )
         _debug = true;
+
+    if ( _db )
+        migrate();
 }
 
 LevelDBCacheBin::~LevelDBCacheBin()
 {
-    // nop
+    if ( _db )
+        flushRecency();
 }
 
 bool
@@ -125,7 +208,7 @@ LevelDBCacheBin::binValidForWriting(bool silent)
 std::string
 LevelDBCacheBin::getHashedKey(const std::string& key) const
 {
-    return dataKey(key);
+    return recordKey(key);
 }
 
 #define SEP std::string("!")
@@ -143,57 +226,57 @@ LevelDBCacheBin::binKey() const
 }
 
 std::string
-LevelDBCacheBin::dataKey(const std::string& key) const
+LevelDBCacheBin::binDataKeyTuple(const std::string& key) const
 {
-    return "d" + SEP + binDataKeyTuple(key);
+    return getID() + SEP + key;
 }
 
 std::string
-LevelDBCacheBin::binDataKeyTuple(const std::string& key) const
+LevelDBCacheBin::recordKey(const std::string& key) const
 {
-    return getID() + SEP + key;
+    return "r" + SEP + binDataKeyTuple(key);
 }
 
 std::string
-LevelDBCacheBin::dataKeyFromTuple(const std::string& tuple) const
+LevelDBCacheBin::recordKeyFromTuple(const std::string& tuple) const
 {
-    return "d" + SEP + tuple;
+    return "r" + SEP + tuple;
 }
 
 std::string
-LevelDBCacheBin::dataBegin() const
+LevelDBCacheBin::recordBegin() const
 {
-    return "d" + SEP + getID() + SEP;
+    return "r" + SEP + getID() + SEP;
 }
 
 std::string
-LevelDBCacheBin::dataEnd() const
+LevelDBCacheBin::recordEnd() const
 {
-    return "d" + SEP + getID() + SEP + "\xff";
+    return "r" + SEP + getID() + SEP + "\xff";
 }
 
 std::string
-LevelDBCacheBin::metaKey(const std::string& key) const
+LevelDBCacheBin::accessKey(const std::string& key) const
 {
-    return "m" + SEP + binDataKeyTuple(key);
+    return "a" + SEP + binDataKeyTuple(key);
 }
 
 std::string
-LevelDBCacheBin::metaKeyFromTuple(const std::string& tuple) const
+LevelDBCacheBin::accessKeyFromTuple(const std::string& tuple) const
 {
-    return "m" + SEP + tuple;
+    return "a" + SEP + tuple;
 }
 
 std::string
-LevelDBCacheBin::metaBegin() const
+LevelDBCacheBin::accessBegin() const
 {
-    return "m" + SEP + getID() + SEP;
+    return "a" + SEP + getID() + SEP;
 }
 
 std::string
-LevelDBCacheBin::metaEnd() const
+LevelDBCacheBin::accessEnd() const
 {
-    return "m" + SEP + getID() + SEP + "\xff";
+    return "a" + SEP + getID() + SEP + "\xff";
 }
 
 std::string
@@ -226,6 +309,87 @@ LevelDBCacheBin::timeEndGlobal() const
     return "t" + SEP + "\xff";
 }
 
+std::string
+LevelDBCacheBin::dataKeyFromTuple(const std::string& tuple) const
+{
+    return "d" + SEP + tuple;
+}
+
+std::string
+LevelDBCacheBin::dataBegin() const
+{
+    return "d" + SEP + getID() + SEP;
+}
+
+std::string
+LevelDBCacheBin::metaKeyFromTuple(const std::string& tuple) const
+{
+    return "m" + SEP + tuple;
+}
+
+void
+LevelDBCacheBin::migrate()
+{
+    // Version 1 stored each entry as a data record ("d!") and a metadata
+    // record ("m!") holding the write time. Fold them into single records.
+    std::string prefix = dataBegin();
+
+    leveldb::Iterator* it = _db->NewIterator(leveldb::ReadOptions());
+    it->Seek(prefix);
+    if ( !it->Valid() || !it->key().starts_with(prefix) )
+    {
+        delete it;
+        return;
+    }
+
+    unsigned count = 0;
+    leveldb::WriteBatch batch;
+    std::string record, metavalue;
+
+    for( ; it->Valid() && it->key().starts_with(prefix); it->Next() )
+    {
+        std::string tuple(it->key().data() + 2, it->key().size() - 2);
+        std::string key = tuple.substr(getID().size() + 1);
+
+        Config metadata;
+        DateTime t;
+        if ( _db->Get(leveldb::ReadOptions(), metaKeyFromTuple(tuple), &metavalue).ok() )
+        {
+            decodeMeta(metavalue, metadata);
+            t = DateTime(metadata.value(TIME_FIELD));
+            metadata.remove(TIME_FIELD);
+        }
+        else
+        {
+            // no time index record exists either; make one.
+            batch.Put( timeKey(t, key), tuple );
+        }
+
+        std::string meta;
+        if ( !metadata.empty() )
+            encodeMeta(metadata, meta);
+
+        // payload is stored as-is; the blend is compatible.
+        encodeRecord(t.asTimeStamp(), meta, it->value().ToString(), record);
+        batch.Put( recordKeyFromTuple(tuple), record );
+        batch.Put( accessKeyFromTuple(tuple), t.asCompactISO8601() );
+        batch.Delete( it->key() );
+        batch.Delete( metaKeyFromTuple(tuple) );
+
+        if ( (++count % MIGRATION_BATCH_SIZE) == 0 )
+        {
+            _db->Write( leveldb::WriteOptions(), &batch );
+            batch.Clear();
+        }
+    }
+    delete it;
+
+    _db->Write( leveldb::WriteOptions(), &batch );
+
+    OE_INFO << LC << "Migrated " << count << " record(s) in bin " << getID()
+        << " to version " << LEVELDB_CACHE_VERSION << std::endl;
+}
+
 ReadResult
 LevelDBCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
 {
@@ -253,68 +417,154 @@ LevelDBCacheBin::read(const std::string& key, const Reader& reader)
 
     ++_tracker->reads;
 
-    Config metadata;
-    leveldb::Status status;
-    leveldb::ReadOptions ro;
-
-    // first read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    TimeStamp lastModified = (TimeStamp)0;
-    if ( status.ok() )
-    {        
-        decodeMeta(metavalue, metadata);
-        DateTime t( metadata.value(TIME_FIELD));
-        lastModified = t.asTimeStamp();
-    }
-        
-    // next read the data record.
-    std::string datakey = dataKey(key);
-    std::string datavalue;
-    status = _db->Get( ro, datakey, &datavalue );
-    if ( !status.ok() )
+    // metadata and data live in the same record. Seek to it instead of
+    // calling Get, so it's decoded where it sits rather than copied out.
+    ScopedIterator it( _db->NewIterator(leveldb::ReadOptions()) );
+    if ( !seek(it, recordKey(key)) )
     {
-        // main record not found for some reason.
         return ReadResult(ReadResult::RESULT_NOT_FOUND);
     }
 
-    // blend the data string
+    RecordView record;
+    if ( !decodeRecord(it->value(), record) )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": corrupt record (" << key << ")" << std::endl;
+        return ReadResult(ReadResult::RESULT_READER_ERROR);
+    }
+
+    // a keyed cache unblends into a copy; otherwise the payload is used as is.
+    const char* payload = record.payload.data();
+    unsigned payloadSize = record.payload.size();
+    std::string unblended;
     if ( _tracker->seed().isSet() )
-        unblend(datavalue, _tracker->seed().value());
+    {
+        unblended.assign(payload, payloadSize);
+        unblend(&unblended[0], payloadSize, _tracker->seed().value());
+        payload = unblended.data();
+    }
+
+    // a shared payload lives in a record of its own.
+    ScopedIterator contentIt( 0L );
+    std::string contentkey;
+    if ( CachePayload::SharedContent::isReference(payload, payloadSize, contentkey) )
+    {
+        contentIt._it = _db->NewIterator(leveldb::ReadOptions());
+
+        RecordView content;
+        if ( !seek(contentIt, recordKey(contentkey)) ||
+             !decodeRecord(contentIt->value(), content) )
+        {
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+        }
+
+        payload = content.payload.data();
+        payloadSize = content.payload.size();
+        if ( _tracker->seed().isSet() )
+        {
+            unblended.assign(payload, payloadSize);
+            unblend(&unblended[0], payloadSize, _tracker->seed().value());
+            payload = unblended.data();
+        }
 
-    // finally, decode the OSGB stream into an object.
-    std::istringstream datastream(datavalue);
-    osgDB::ReaderWriter::ReadResult r = reader.read(datastream);
-    if ( !r.success() )
+        if ( _tracker->hasSizeLimit() )
+            noteAccess( contentkey );
+    }
+
+    std::string error;
+    osg::ref_ptr<osg::Object> object = CachePayload::decode(payload, payloadSize, reader, error);
+    if ( !object.valid() )
     {
         OE_WARN << LC << "Cache read failure!"
             << "\n reader = " << reader.name()
-            << "\n error detail = " << r.message()
-            << "\n data value = " << datavalue
+            << "\n error detail = " << error
             << "\n";
 
         return ReadResult(ReadResult::RESULT_READER_ERROR);
     }
+
+    Config metadata;
+    if ( !record.meta.empty() )
+        decodeMeta(record.meta.ToString(), metadata);
         
     if ( _debug )
     {
         OE_NOTICE << LC << "Bin " << getID() << ": read (" << key << ")\n";
     }
 
-    // if there's a size limit, we need to 'touch' the record.
+    // if there's a size limit, remember the access for the LRU.
     if ( _tracker->hasSizeLimit() )
     {
-        // Room for optimization here since we already have the 
-        // meta/time records around.
-        touch( key );
+        noteAccess( key );
     }
 
     ++_tracker->hits;
-    ReadResult rr(r.getObject(), metadata);
-    rr.setLastModifiedTime(lastModified);    
+    ReadResult rr(object.get(), metadata);
+    rr.setLastModifiedTime(record.time);
     return rr;
 }
 
+void
+LevelDBCacheBin::noteAccess(const std::string& key)
+{
+    TimeStamp now = DateTime().asTimeStamp();
+    bool flush = false;
+    {
+        ScopedMutexLock lock( _recencyMutex );
+        _recency[key] = now;
+        flush =
+            _recency.size() >= RECENCY_FLUSH_COUNT ||
+            now - _lastRecencyFlush >= (TimeStamp)RECENCY_FLUSH_SECONDS;
+    }
+
+    if ( flush )
+        flushRecency();
+}
+
+void
+LevelDBCacheBin::flushRecency()
+{
+    Recency pending;
+    {
+        ScopedMutexLock lock( _recencyMutex );
+        pending.swap( _recency );
+        _lastRecencyFlush = DateTime().asTimeStamp();
+    }
+
+    if ( pending.empty() )
+        return;
+
+    // a write or remove between reading the old time and writing the new
+    // one would orphan a time index entry.
+    ScopedMutexLock lock( _indexMutex );
+
+    // Move each accessed record to its new spot in the time index.
+    // The record itself (and its write time) is left alone.
+    leveldb::WriteBatch batch;
+    std::string oldtime;
+    for(Recency::const_iterator i = pending.begin(); i != pending.end(); ++i)
+    {
+        const std::string& key = i->first;
+
+        // skip records removed since they were read.
+        if ( !_db->Get(leveldb::ReadOptions(), accessKey(key), &oldtime).ok() )
+            continue;
+
+        DateTime newtime(i->second);
+        std::string newtimeISO = newtime.asCompactISO8601();
+        if ( newtimeISO == oldtime )
+            continue;
+
+        batch.Delete( "t" + SEP + oldtime + SEP + binDataKeyTuple(key) );
+        batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
+        batch.Put( accessKey(key), newtimeISO );
+    }
+
+    if ( !_db->Write(leveldb::WriteOptions(), &batch).ok() )
+    {
+        OE_WARN << LC << "Failed to update access times in bin " << getID() << std::endl;
+    }
+}
+
 ReadResult
 LevelDBCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
 {
@@ -338,64 +588,58 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     if ( !binValidForWriting() || !object ) 
         return false;
         
-    osgDB::ReaderWriter::WriteResult r;
-    bool objWriteOK = false;
+    osgDB::ReaderWriter::WriteResult r(osgDB::ReaderWriter::WriteResult::FILE_SAVED);
+    bool objWriteOK = true;
 
-    std::string       data;
-    std::stringstream datastream;
-
-    if ( dynamic_cast<const osg::Image*>(object) )
+    // a tile that's all one value only needs a descriptor.
+    std::string payload;
+    if ( !UniformTile::encode(object, payload) )
     {
-        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
+        std::stringstream datastream;
+
+        if ( dynamic_cast<const osg::Image*>(object) )
         {
-            OE_WARN << LC << "Internal: tried to write image to " << _rw->className() << "\n";
-            return false;
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write image to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeImage( *static_cast<const osg::Image*>(object), datastream, writeOptions );
+            objWriteOK = r.success();
         }
-        r = _rw->writeImage( *static_cast<const osg::Image*>(object), datastream, writeOptions );
-        objWriteOK = r.success();
-    }
-    else if ( dynamic_cast<const osg::Node*>(object) )
-    {
-        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_NODE) == 0 )
+        else if ( dynamic_cast<const osg::Node*>(object) )
         {
-            OE_WARN << LC << "Internal: tried to write node to " << _rw->className() << "\n";
-            return false;
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_NODE) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write node to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, writeOptions );
+            objWriteOK = r.success();
         }
-        r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, writeOptions );
-        objWriteOK = r.success();
-    }
-    else
-    {
-        if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_OBJECT) == 0 )
+        else
         {
-            OE_WARN << LC << "Internal: tried to write an object to " << _rw->className() << "\n";
-            return false;
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_OBJECT) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write an object to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeObject( *object, datastream, writeOptions );
+            objWriteOK = r.success();
         }
-        r = _rw->writeObject( *object, datastream, writeOptions );
-        objWriteOK = r.success();
+
+        payload = datastream.str();
     }
 
     if (objWriteOK)
     {
-        DateTime now;
-        leveldb::WriteBatch batch;
+        shareContent( payload );
 
-        // write the data:
-        data = datastream.str();
-        if ( _tracker->seed().isSet() )
-            blend(data, _tracker->seed().value());
-        batch.Put( dataKey(key), data );
-
-        // write the timestamp index:
-        batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+        std::string metavalue;
+        if ( !meta.empty() )
+            encodeMeta( meta, metavalue );
 
-        // write the metadata:
-        Config metadata(meta);
-        metadata.set( TIME_FIELD, now.asCompactISO8601() );
-        encodeMeta( metadata, data );
-        batch.Put( metaKey(key), data );
-
-        objWriteOK = _db->Write( leveldb::WriteOptions(), &batch ).ok();
+        objWriteOK = writeRecord( key, DateTime().asTimeStamp(), metavalue, payload );
 
         if ( objWriteOK )
         {
@@ -419,6 +663,52 @@ LevelDBCacheBin::write(const std::string& key, const osg::Object* object, const
     return objWriteOK;
 }
 
+bool
+LevelDBCacheBin::writeRecord(const std::string& key, TimeStamp time, const std::string& meta, const std::string& payload)
+{
+    DateTime t(time);
+    leveldb::WriteBatch batch;
+
+    // write the record:
+    std::string record;
+    encodeRecord( time, meta, payload, record );
+    if ( _tracker->seed().isSet() )
+    {
+        blend( &record[RECORD_HEADER_SIZE + meta.size()],
+               record.size() - RECORD_HEADER_SIZE - meta.size(),
+               _tracker->seed().value() );
+    }
+    batch.Put( recordKey(key), record );
+
+    ScopedMutexLock lock( _indexMutex );
+
+    // replace the timestamp index entry of any record we overwrite:
+    std::string oldtime;
+    if ( _db->Get(leveldb::ReadOptions(), accessKey(key), &oldtime).ok() )
+        batch.Delete( "t" + SEP + oldtime + SEP + binDataKeyTuple(key) );
+
+    batch.Put( timeKey(t, key), binDataKeyTuple(key) );
+    batch.Put( accessKey(key), t.asCompactISO8601() );
+
+    return _db->Write( leveldb::WriteOptions(), &batch ).ok();
+}
+
+void
+LevelDBCacheBin::shareContent(std::string& payload)
+{
+    std::string contentkey;
+    if ( !_sharedContent.isRepeated(payload, contentkey) )
+        return;
+
+    if ( getRecordStatus(contentkey) != STATUS_OK )
+    {
+        if ( !writeRecord(contentkey, DateTime().asTimeStamp(), std::string(), payload) )
+            return;
+    }
+
+    CachePayload::SharedContent::makeReference( contentkey, payload );
+}
+
 void
 LevelDBCacheBin::postWrite()
 {
@@ -428,6 +718,9 @@ LevelDBCacheBin::postWrite()
         {
             if ( _tracker->isTimeToPurge() )
             {
+                // purge by the most recent access times we know of.
+                flushRecency();
+
                 this->purgeOldest(_tracker->numToPurge());
 
                 if (_debug)
@@ -461,20 +754,9 @@ LevelDBCacheBin::getRecordStatus(const std::string& key)
     if ( !binValidForReading() ) 
         return STATUS_NOT_FOUND;
 
-    leveldb::Status status;
-    leveldb::ReadOptions ro;
-
-    // read the metadata record.
-    std::string metavalue;
-    status = _db->Get( ro, metaKey(key), &metavalue );
-    if ( status.ok() )
-    {        
-        return STATUS_OK;
-    }
-    else
-    {
-        return STATUS_NOT_FOUND;
-    }
+    // seek instead of Get so the record isn't copied.
+    ScopedIterator it( _db->NewIterator(leveldb::ReadOptions()) );
+    return seek(it, recordKey(key)) ? STATUS_OK : STATUS_NOT_FOUND;
 }
 
 bool
@@ -483,19 +765,17 @@ LevelDBCacheBin::remove(const std::string& key)
     if ( !binValidForReading() )
         return false;
 
-    // first read in the time from the metadata record.
-    std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
-        return false;
+    ScopedMutexLock lock( _indexMutex );
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime t(metadata.value(TIME_FIELD));
+    // find the record's entry in the time index.
+    std::string timevalue;
+    if ( _db->Get(leveldb::ReadOptions(), accessKey(key), &timevalue).ok() == false )
+        return false;
 
     leveldb::WriteBatch batch;
-    batch.Delete( dataKey(key) );
-    batch.Delete( metaKey(key) );
-    batch.Delete( timeKey(t, key) );
+    batch.Delete( recordKey(key) );
+    batch.Delete( accessKey(key) );
+    batch.Delete( "t" + SEP + timevalue + SEP + binDataKeyTuple(key) );
         
     leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
     if ( !status.ok() )
@@ -517,28 +797,36 @@ LevelDBCacheBin::touch(const std::string& key)
     if ( !binValidForWriting() )
         return false;
 
-    // first read in the time from the metadata record.
-    std::string metavalue;
-    if ( _db->Get(leveldb::ReadOptions(), metaKey(key), &metavalue).ok() == false )
+    ScopedMutexLock lock( _indexMutex );
+
+    std::string value;
+    if ( _db->Get(leveldb::ReadOptions(), recordKey(key), &value).ok() == false )
         return false;
 
-    Config metadata;
-    decodeMeta(metavalue, metadata);
-    DateTime oldtime(metadata.value(TIME_FIELD));
-        
-    leveldb::WriteBatch batch;
+    RecordView record;
+    if ( !decodeRecord(value, record) )
+        return false;
+
+    std::string oldtime;
+    _db->Get(leveldb::ReadOptions(), accessKey(key), &oldtime);
 
-    // In a transaction, update the metadata record with the current time.
-    std::string newtime = DateTime().asCompactISO8601();
-    metadata.set(TIME_FIELD, newtime);
-    encodeMeta(metadata, metavalue);
-    batch.Put(metaKey(key), metavalue);
+    // In a transaction, update the record's write time:
+    DateTime now;
+    std::string newtime = now.asCompactISO8601();
+    std::string stamp;
+    putFixed(stamp, (uint64_t)(int64_t)now.asTimeStamp(), 8);
+    value.replace(4, 8, stamp);
+
+    leveldb::WriteBatch batch;
+    batch.Put(recordKey(key), value);
 
     // ...remove the old time index record:
-    batch.Delete( timeKey(oldtime, key) );
+    if ( !oldtime.empty() )
+        batch.Delete( "t" + SEP + oldtime + SEP + binDataKeyTuple(key) );
 
     // ...and write a new time index record.
-    batch.Put( timeKey(newtime, key), binDataKeyTuple(key) );
+    batch.Put( timeKey(now, key), binDataKeyTuple(key) );
+    batch.Put( accessKey(key), newtime );
 
     leveldb::Status status = _db->Write(leveldb::WriteOptions(), &batch);
     if ( !status.ok() )
@@ -557,6 +845,13 @@ LevelDBCacheBin::clear()
 {
     if ( !binValidForWriting() )
         return false;
+
+    {
+        ScopedMutexLock lock( _recencyMutex );
+        _recency.clear();
+    }
+
+    ScopedMutexLock lock( _indexMutex );
     
     leveldb::WriteOptions wo;
     std::string binphrase = binPhrase();
@@ -602,8 +897,8 @@ LevelDBCacheBin::getStorageSize()
     leveldb::Range ranges[3];
     uint64_t       sizes[3];
 
-    ranges[0] = leveldb::Range(dataBegin(), dataEnd());
-    ranges[1] = leveldb::Range(metaBegin(), metaEnd());
+    ranges[0] = leveldb::Range(recordBegin(), recordEnd());
+    ranges[1] = leveldb::Range(accessBegin(), accessEnd());
     ranges[2] = leveldb::Range(timeBegin(), timeEnd());
     sizes[0] = sizes[1] = sizes[2] = 0;
 
@@ -677,9 +972,13 @@ LevelDBCacheBin::purgeOldest(unsigned maxnum)
         // doing this in a WriteBatch did not work. The size of the
         // database would never go down.
         leveldb::WriteOptions wo;
+        _db->Delete( wo, recordKeyFromTuple(tuple) );
+        _db->Delete( wo, accessKeyFromTuple(tuple) );
+        _db->Delete( wo, it->key() );
+
+        // another bin may not have been migrated yet.
         _db->Delete( wo, dataKeyFromTuple(tuple) );
         _db->Delete( wo, metaKeyFromTuple(tuple) );
-        _db->Delete( wo, it->key() );
     }
 
     delete it;
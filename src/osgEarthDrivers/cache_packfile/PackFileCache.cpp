@@ -0,0 +1,149 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackFileCache"
+#include "PackFileCacheBin"
+#include <osgEarth/URI>
+#include <osgEarth/ThreadingUtils>
+#include <osgDB/Registry>
+#include <osgDB/ObjectWrapper>
+
+#define LC "[PackFileCache] "
+
+#define OSGEARTH_ENV_CACHE_MAX_SIZE_MB "OSGEARTH_CACHE_MAX_SIZE_MB"
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::PackFileCache;
+
+
+PackFileCacheImpl::PackFileCacheImpl( const CacheOptions& options ) :
+osgEarth::Cache( options ),
+_options       ( options )
+{
+    // Force OSG to initialize the image wrapper. Failure to do this can result
+    // in a race condition within OSG when the cache is accessed from multiple threads.
+    osgDB::ObjectWrapperManager* owm = osgDB::Registry::instance()->getObjectWrapperManager();
+    owm->findWrapper("osg::Image");
+    owm->findWrapper("osg::HeightField");
+
+    if ( _options.rootPath().isSet() )
+    {
+        _rootPath = URI( *_options.rootPath(), options.referrer() ).full();
+    }
+    else
+    {
+        // read the root path from ENV is necessary:
+        const char* cachePath = ::getenv(OSGEARTH_ENV_CACHE_PATH);
+        if ( cachePath )
+        {
+            _rootPath = cachePath;           
+            OE_INFO << LC << "Cache location set from environment: \"" 
+                << cachePath << "\"" << std::endl;
+        }
+    }
+
+    const char* maxsize = ::getenv(OSGEARTH_ENV_CACHE_MAX_SIZE_MB);
+    if ( maxsize )
+    {
+        unsigned mb = as<unsigned>(std::string(maxsize), 0u);
+        if ( mb > 0 )
+        {
+            _options.maxSizeMB() = mb;
+
+            OE_INFO << LC << "Set max cache size from environment: "
+                << (_options.maxSizeMB().value()) << " MB"
+                << std::endl;
+        }
+        else
+        {
+            OE_WARN << LC 
+                << "Env var \"" OSGEARTH_ENV_CACHE_MAX_SIZE_MB "\" set to an invalid value"
+                << std::endl;
+        }
+    }
+
+    if ( _rootPath.empty() )
+    {
+        _ok = false;
+        OE_WARN << LC << "Illegal: no root path set for cache!" << std::endl;
+        return;
+    }
+
+    _store = new PackFileStore(_options, _rootPath);
+    if ( !_store->open() )
+    {
+        _store = 0L;
+        _ok = false;
+        OE_WARN << LC << "Failed to open a cache at \"" << _rootPath << "\"" << std::endl;
+    }
+}
+
+PackFileCacheImpl::~PackFileCacheImpl()
+{
+    // persist any queued write-behind writes while the store is still open
+    flush();
+
+    if ( _store.valid() )
+    {
+        _store->close();
+    }
+}
+
+CacheBin*
+PackFileCacheImpl::addBin( const std::string& name )
+{
+    return _store.valid() ?
+        _bins.getOrCreate(name, new PackFileCacheBin(name, _store.get())) :
+        0L;
+}
+
+CacheBin*
+PackFileCacheImpl::getOrCreateDefaultBin()
+{    
+    if ( !_store.valid() )
+        return 0L;
+
+    static Threading::Mutex s_defaultBinMutex;
+    if ( !_defaultBin.valid() )
+    {
+        Threading::ScopedMutexLock lock( s_defaultBinMutex );
+        if ( !_defaultBin.valid() ) // double-check
+        {
+            _defaultBin = new PackFileCacheBin("_default", _store.get());
+        }
+    }
+    return _defaultBin.get();
+}
+
+off_t
+PackFileCacheImpl::getApproximateSize() const
+{
+    return _store.valid() ? (off_t)_store->getSize() : 0;
+}
+
+bool
+PackFileCacheImpl::compact()
+{
+    return _store.valid() && _store->compact();
+}
+
+bool
+PackFileCacheImpl::clear()
+{
+    return _store.valid() && _store->clear();
+}
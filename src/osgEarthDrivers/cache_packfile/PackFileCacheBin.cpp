@@ -0,0 +1,308 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackFileCacheBin"
+#include <osgEarth/Cache>
+#include <osgEarth/Registry>
+#include <osgEarth/UniformTile>
+#include <osgEarth/StringUtils>
+#include <osgDB/Registry>
+#include <sstream>
+#include <cstring>
+#include <climits>
+#include <string>
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::PackFileCache;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // Bin metadata lives in a reserved bin, keyed by bin name, so that
+    // clearing a bin keeps its metadata (as the other drivers do).
+    const std::string METADATA_BIN = "_packfile.metadata";
+}
+
+//------------------------------------------------------------------------
+
+#undef  LC
+#define LC "[PackFileCacheBin] "
+
+
+PackFileCacheBin::PackFileCacheBin(const std::string& binID,
+                                   PackFileStore*     store) :
+osgEarth::CacheBin( binID ),
+_store            ( store ),
+_debug            ( false )
+{
+    // reader to parse data:
+    _rw = osgDB::Registry::instance()->getReaderWriterForExtension( "osgb" );
+
+    if ( ::getenv("OSGEARTH_CACHE_DEBUG") )
+        _debug = true;
+}
+
+std::string
+PackFileCacheBin::getHashedKey(const std::string& key) const
+{
+    return getID() + "!" + key;
+}
+
+ReadResult
+PackFileCacheBin::readImage(const std::string& key, const osgDB::Options* readOptions)
+{
+    return read(key, ImageReader(_rw.get(), readOptions));
+}
+
+ReadResult
+PackFileCacheBin::readObject(const std::string& key, const osgDB::Options* readOptions)
+{
+    return read(key, ObjectReader(_rw.get(), readOptions));
+}
+
+ReadResult
+PackFileCacheBin::readNode(const std::string& key, const osgDB::Options* readOptions)
+{
+    return read(key, NodeReader(_rw.get(), readOptions));
+}
+
+ReadResult
+PackFileCacheBin::read(const std::string& key, const Reader& reader)
+{
+    PackFileStore::Record record;
+    if ( !_store->read(getID(), key, record) )
+        return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+    const char* payload = record.payload;
+    unsigned payloadSize = record.payloadSize;
+
+    // a shared payload lives in a record of its own.
+    PackFileStore::Record content;
+    std::string contentkey;
+    if ( CachePayload::SharedContent::isReference(payload, payloadSize, contentkey) )
+    {
+        if ( !_store->read(getID(), contentkey, content) )
+            return ReadResult(ReadResult::RESULT_NOT_FOUND);
+
+        payload = content.payload;
+        payloadSize = content.payloadSize;
+    }
+
+    std::string error;
+    osg::ref_ptr<osg::Object> object = CachePayload::decode(payload, payloadSize, reader, error);
+    if ( !object.valid() )
+    {
+        OE_WARN << LC << "Cache read failure!"
+            << "\n reader = " << reader.name()
+            << "\n error detail = " << error
+            << "\n";
+
+        return ReadResult(ReadResult::RESULT_READER_ERROR);
+    }
+
+    Config metadata;
+    if ( record.metaSize > 0u )
+        metadata.fromJSON( std::string(record.meta, record.metaSize) );
+
+    if ( _debug )
+    {
+        OE_NOTICE << LC << "Bin " << getID() << ": read (" << key << ")\n";
+    }
+
+    ReadResult rr(object.get(), metadata);
+    rr.setLastModifiedTime(record.time);
+    return rr;
+}
+
+ReadResult
+PackFileCacheBin::readString(const std::string& key, const osgDB::Options* readOptions)
+{
+    ReadResult r = readObject(key, readOptions);
+    if ( r.succeeded() )
+    {
+        if ( r.get<StringObject>() )
+            return r;
+        else
+            return ReadResult();
+    }
+    else
+    {
+        return r;
+    }
+}
+
+bool
+PackFileCacheBin::write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options* writeOptions)
+{
+    if ( !object || !_rw.valid() ) 
+        return false;
+        
+    osgDB::ReaderWriter::WriteResult r(osgDB::ReaderWriter::WriteResult::FILE_SAVED);
+    bool objWriteOK = true;
+
+    // a tile that's all one value only needs a descriptor.
+    std::string payload;
+    if ( !UniformTile::encode(object, payload) )
+    {
+        std::stringstream datastream;
+
+        if ( dynamic_cast<const osg::Image*>(object) )
+        {
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_IMAGE) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write image to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeImage( *static_cast<const osg::Image*>(object), datastream, writeOptions );
+            objWriteOK = r.success();
+        }
+        else if ( dynamic_cast<const osg::Node*>(object) )
+        {
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_NODE) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write node to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeNode( *static_cast<const osg::Node*>(object), datastream, writeOptions );
+            objWriteOK = r.success();
+        }
+        else
+        {
+            if ( (_rw->supportedFeatures() & _rw->FEATURE_WRITE_OBJECT) == 0 )
+            {
+                OE_WARN << LC << "Internal: tried to write an object to " << _rw->className() << "\n";
+                return false;
+            }
+            r = _rw->writeObject( *object, datastream, writeOptions );
+            objWriteOK = r.success();
+        }
+
+        payload = datastream.str();
+    }
+
+    if ( objWriteOK )
+    {
+        std::string metavalue;
+        if ( !meta.empty() )
+            metavalue = meta.toJSON(false);
+
+        shareContent( payload );
+
+        objWriteOK = _store->write( getID(), key, DateTime().asTimeStamp(), metavalue, payload );
+
+        if ( objWriteOK && _debug )
+        {
+            OE_NOTICE << LC << "Bin " << getID() << ": wrote (" << key << ")\n";
+        }
+    }
+
+    if ( !objWriteOK )
+    {
+        OE_WARN << LC << "Bin " << getID() << ": FAILED to write (" << key << "); msg = \"" 
+            << r.message() << "\"\n";
+    }
+
+    return objWriteOK;
+}
+
+void
+PackFileCacheBin::shareContent(std::string& payload)
+{
+    std::string contentkey;
+    if ( !_sharedContent.isRepeated(payload, contentkey) )
+        return;
+
+    if ( !_store->exists(getID(), contentkey) )
+    {
+        if ( !_store->write(getID(), contentkey, DateTime().asTimeStamp(), std::string(), payload) )
+            return;
+    }
+
+    CachePayload::SharedContent::makeReference( contentkey, payload );
+}
+
+CacheBin::RecordStatus
+PackFileCacheBin::getRecordStatus(const std::string& key)
+{
+    return _store->exists(getID(), key) ? STATUS_OK : STATUS_NOT_FOUND;
+}
+
+bool
+PackFileCacheBin::remove(const std::string& key)
+{
+    return _store->remove(getID(), key);
+}
+
+bool
+PackFileCacheBin::touch(const std::string& key)
+{
+    return _store->touch(getID(), key);
+}
+
+bool
+PackFileCacheBin::clear()
+{
+    bool ok = _store->clearBin(getID());
+    if ( ok && _debug )
+    {
+        OE_NOTICE << LC << "Cleared bin " << getID() << std::endl;
+    }
+    return ok;
+}
+
+bool
+PackFileCacheBin::compact()
+{
+    return _store->compact();
+}
+
+unsigned
+PackFileCacheBin::getStorageSize()
+{
+    // bins share their segments; report the whole store.
+    return (unsigned)osg::minimum(_store->getSize(), (uint64_t)UINT_MAX);
+}
+
+Config
+PackFileCacheBin::readMetadata()
+{
+    PackFileStore::Record record;
+    if ( !_store->read(METADATA_BIN, getID(), record) )
+        return Config();
+
+    Config binMetadata;
+    binMetadata.fromJSON( std::string(record.payload, record.payloadSize) );
+    return binMetadata;
+}
+
+bool
+PackFileCacheBin::writeMetadata(const Config& conf)
+{
+    // inject the cache version
+    Config mutableConf(conf);
+    mutableConf.set("packfile.cache_version", PACKFILE_CACHE_VERSION);
+
+    if ( !_store->write(METADATA_BIN, getID(), DateTime().asTimeStamp(), std::string(), mutableConf.toJSON(false)) )
+    {
+        OE_WARN << LC << "Failed to write metadata record for bin (" << getID() << ")" << std::endl;
+        return false;
+    }
+
+    return true;
+}
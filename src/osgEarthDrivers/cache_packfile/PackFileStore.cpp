@@ -0,0 +1,1508 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include "PackFileStore"
+#include <osgEarth/Notify>
+#include <osgEarth/StringUtils>
+#include <osgEarth/FileUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Atomic>
+#include <algorithm>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#   include <windows.h>
+#   include <io.h>
+#   define unlink _unlink
+#else
+#   include <sys/types.h>
+#   include <sys/stat.h>
+#   include <sys/mman.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+#define LC "[PackFileStore] "
+
+using namespace osgEarth;
+using namespace osgEarth::Threading;
+using namespace osgEarth::Drivers::PackFileCache;
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    // All on-disk structures use the native byte order; a cache is local
+    // to the machine that wrote it.
+
+    const uint32_t RECORD_MAGIC     = 0x4b50454f; // "OEPK"
+    const uint32_t RECORD_PUT       = 0u;
+    const uint32_t RECORD_TOMBSTONE = 1u;         // removes a key
+    const uint32_t RECORD_CLEAR_BIN = 2u;         // removes everything older in a bin
+
+    /** Header in front of every record in a segment file. */
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t flags;
+        uint64_t seq;          // global write order
+        uint64_t hash;         // hash of the full key
+        int64_t  time;         // write time, seconds UTC
+        uint32_t bin;          // hash of the bin ID
+        uint32_t keySize;      // "bin!key", or the bin ID of a clear
+        uint32_t metaSize;
+        uint32_t payloadSize;
+        uint32_t checksum;     // of the header (with this field zeroed) and the body
+        uint32_t reserved;
+
+        uint64_t recordSize() const {
+            return sizeof(RecordHeader) + (uint64_t)keySize + (uint64_t)metaSize + (uint64_t)payloadSize;
+        }
+    };
+
+    const char     INDEX_MAGIC[8]   = { 'O','E','P','K','I','D','X','1' };
+    const uint64_t INDEX_MIN_SLOTS  = 1u << 16;
+
+    /** Header of the index file. */
+    struct IndexHeader
+    {
+        char     magic[8];
+        uint32_t clean;        // 1 when the index was closed normally
+        uint32_t reserved;
+        uint64_t capacity;     // number of slots (a power of 2)
+        uint64_t count;        // live slots
+        uint64_t deleted;      // deleted slots
+        uint64_t nextSeq;
+        uint64_t pad[2];
+    };
+
+    const uint32_t SLOT_EMPTY     = 0u;
+    const uint32_t SLOT_LIVE      = 1u;
+    const uint32_t SLOT_DELETED   = 2u;
+    const uint32_t SLOT_TOMBSTONE = 3u;           // only during a rebuild
+
+    /** One open-addressing slot of the index. */
+    struct IndexSlot
+    {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t seq;
+        uint32_t segment;
+        uint32_t size;
+        uint32_t bin;
+        uint32_t state;
+    };
+
+    /** FNV-1a, 64 bits */
+    uint64_t hash64(const char* data, size_t size, uint64_t h = 14695981039346656037ULL)
+    {
+        for(size_t i=0; i<size; ++i)
+        {
+            h ^= (unsigned char)data[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    uint64_t hash64(const std::string& s)
+    {
+        return hash64(s.data(), s.size());
+    }
+
+    uint32_t checksum(const RecordHeader& header, const char* body, size_t bodySize)
+    {
+        RecordHeader h = header;
+        h.checksum = 0u;
+        uint64_t c = hash64((const char*)&h, sizeof(h));
+        c = hash64(body, bodySize, c);
+        return (uint32_t)(c ^ (c >> 32));
+    }
+
+    std::string encode(uint32_t flags, uint64_t seq, uint64_t hash, uint32_t bin, TimeStamp time,
+                       const std::string& key, const std::string& meta, const std::string& payload)
+    {
+        RecordHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic       = RECORD_MAGIC;
+        h.flags       = flags;
+        h.seq         = seq;
+        h.hash        = hash;
+        h.time        = (int64_t)time;
+        h.bin         = bin;
+        h.keySize     = key.size();
+        h.metaSize    = meta.size();
+        h.payloadSize = payload.size();
+
+        std::string out;
+        out.reserve(h.recordSize());
+        out.append((const char*)&h, sizeof(h));
+        out.append(key);
+        out.append(meta);
+        out.append(payload);
+
+        h.checksum = checksum(h, out.data()+sizeof(h), out.size()-sizeof(h));
+        memcpy(&out[0], &h, sizeof(h));
+        return out;
+    }
+
+    unsigned now()
+    {
+        return (unsigned)DateTime().asTimeStamp();
+    }
+}
+
+//------------------------------------------------------------------------
+
+namespace osgEarth { namespace Drivers { namespace PackFileCache
+{
+    /** A file read and written at explicit offsets. */
+    class File
+    {
+    public:
+#ifdef _WIN32
+        typedef HANDLE Native;
+        File() : _h(INVALID_HANDLE_VALUE) { }
+        bool valid() const { return _h != INVALID_HANDLE_VALUE; }
+#else
+        typedef int Native;
+        File() : _h(-1) { }
+        bool valid() const { return _h >= 0; }
+#endif
+        ~File() { close(); }
+
+        Native native() const { return _h; }
+
+        bool open(const std::string& path, bool create)
+        {
+            close();
+#ifdef _WIN32
+            // FILE_SHARE_DELETE lets a segment be deleted while readers still hold it.
+            _h = ::CreateFileA(path.c_str(), GENERIC_READ|GENERIC_WRITE,
+                FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, 0,
+                create ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+#else
+            _h = ::open(path.c_str(), O_RDWR | (create ? O_CREAT : 0), 0644);
+#endif
+            return valid();
+        }
+
+        void close()
+        {
+            if ( valid() )
+            {
+#ifdef _WIN32
+                ::CloseHandle(_h);
+                _h = INVALID_HANDLE_VALUE;
+#else
+                ::close(_h);
+                _h = -1;
+#endif
+            }
+        }
+
+        bool read(uint64_t offset, char* data, size_t size) const
+        {
+            while(size > 0)
+            {
+#ifdef _WIN32
+                OVERLAPPED ov;
+                memset(&ov, 0, sizeof(ov));
+                ov.Offset     = (DWORD)(offset & 0xffffffff);
+                ov.OffsetHigh = (DWORD)(offset >> 32);
+                DWORD n = 0;
+                if ( !::ReadFile(_h, data, (DWORD)size, &n, &ov) || n == 0 )
+                    return false;
+#else
+                ssize_t n = ::pread(_h, data, size, (off_t)offset);
+                if ( n <= 0 )
+                    return false;
+#endif
+                data += n; offset += n; size -= n;
+            }
+            return true;
+        }
+
+        bool write(uint64_t offset, const char* data, size_t size)
+        {
+            while(size > 0)
+            {
+#ifdef _WIN32
+                OVERLAPPED ov;
+                memset(&ov, 0, sizeof(ov));
+                ov.Offset     = (DWORD)(offset & 0xffffffff);
+                ov.OffsetHigh = (DWORD)(offset >> 32);
+                DWORD n = 0;
+                if ( !::WriteFile(_h, data, (DWORD)size, &n, &ov) || n == 0 )
+                    return false;
+#else
+                ssize_t n = ::pwrite(_h, data, size, (off_t)offset);
+                if ( n <= 0 )
+                    return false;
+#endif
+                data += n; offset += n; size -= n;
+            }
+            return true;
+        }
+
+        uint64_t size() const
+        {
+#ifdef _WIN32
+            LARGE_INTEGER s;
+            return ::GetFileSizeEx(_h, &s) ? (uint64_t)s.QuadPart : 0u;
+#else
+            struct stat s;
+            return ::fstat(_h, &s) == 0 ? (uint64_t)s.st_size : 0u;
+#endif
+        }
+
+        bool truncate(uint64_t size)
+        {
+#ifdef _WIN32
+            LARGE_INTEGER s;
+            s.QuadPart = (LONGLONG)size;
+            return ::SetFilePointerEx(_h, s, 0, FILE_BEGIN) && ::SetEndOfFile(_h);
+#else
+            return ::ftruncate(_h, (off_t)size) == 0;
+#endif
+        }
+
+        bool sync()
+        {
+#ifdef _WIN32
+            return ::FlushFileBuffers(_h) != 0;
+#else
+            return ::fsync(_h) == 0;
+#endif
+        }
+
+    private:
+        Native _h;
+    };
+
+    /** One append-only segment file. */
+    struct Segment : public osg::Referenced
+    {
+        Segment(unsigned id) : id(id), size(0u), live(0u), sealed(false) { }
+
+        unsigned            id;
+        std::string         path;
+        File                file;
+        uint64_t            size;        // bytes reserved by appends
+        uint64_t            live;        // bytes of records the index points to
+        bool                sealed;      // no longer receiving appends
+        OpenThreads::Atomic pending;     // appends reserved but not yet published
+        OpenThreads::Atomic lastAccess;  // seconds UTC
+    };
+
+    /** The memory-mapped hash index. */
+    class IndexFile
+    {
+    public:
+        IndexFile() : _data(0L), _size(0u)
+#ifdef _WIN32
+            , _mapping(0L)
+#endif
+        { }
+
+        ~IndexFile() { close(); }
+
+        bool create(const std::string& path, uint64_t capacity)
+        {
+            close();
+            _size = sizeof(IndexHeader) + capacity*sizeof(IndexSlot);
+            if ( !_file.open(path, true) || !_file.truncate(0u) || !_file.truncate(_size) || !map() )
+            {
+                close();
+                return false;
+            }
+            // new pages are zero: every slot is SLOT_EMPTY.
+            memcpy(header()->magic, INDEX_MAGIC, 8);
+            header()->capacity = capacity;
+            return true;
+        }
+
+        bool open(const std::string& path)
+        {
+            close();
+            if ( !osgDB::fileExists(path) || !_file.open(path, false) )
+                return false;
+
+            _size = _file.size();
+            if ( _size < sizeof(IndexHeader) || !map() )
+            {
+                close();
+                return false;
+            }
+
+            uint64_t cap = header()->capacity;
+            if ( memcmp(header()->magic, INDEX_MAGIC, 8) != 0 ||
+                 cap == 0u || (cap & (cap-1)) != 0u ||
+                 _size != sizeof(IndexHeader) + cap*sizeof(IndexSlot) )
+            {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close()
+        {
+            if ( _data )
+            {
+#ifdef _WIN32
+                ::UnmapViewOfFile(_data);
+                ::CloseHandle(_mapping);
+                _mapping = 0L;
+#else
+                ::munmap(_data, _size);
+#endif
+                _data = 0L;
+            }
+            _file.close();
+        }
+
+        bool flush()
+        {
+            if ( !_data )
+                return false;
+#ifdef _WIN32
+            return ::FlushViewOfFile(_data, 0) && _file.sync();
+#else
+            return ::msync(_data, _size, MS_SYNC) == 0;
+#endif
+        }
+
+        bool valid() const { return _data != 0L; }
+
+        uint64_t fileSize() const { return _size; }
+
+        IndexHeader* header() { return (IndexHeader*)_data; }
+
+        IndexSlot* begin() { return (IndexSlot*)(_data + sizeof(IndexHeader)); }
+        IndexSlot* end()   { return begin() + header()->capacity; }
+
+        /** Live (or rebuild tombstone) slot for a hash, or NULL. */
+        IndexSlot* find(uint64_t hash)
+        {
+            uint64_t mask = header()->capacity - 1u;
+            IndexSlot* slots = begin();
+            for(uint64_t i = hash & mask, n = 0; n <= mask; i = (i+1u) & mask, ++n)
+            {
+                IndexSlot& slot = slots[i];
+                if ( slot.state == SLOT_EMPTY )
+                    return 0L;
+                if ( slot.hash == hash && (slot.state == SLOT_LIVE || slot.state == SLOT_TOMBSTONE) )
+                    return &slot;
+            }
+            return 0L;
+        }
+
+        /** Slot for a hash, claiming a free one if necessary. */
+        IndexSlot* insert(uint64_t hash)
+        {
+            uint64_t mask = header()->capacity - 1u;
+            IndexSlot* slots = begin();
+            IndexSlot* reuse = 0L;
+            for(uint64_t i = hash & mask, n = 0; n <= mask; i = (i+1u) & mask, ++n)
+            {
+                IndexSlot& slot = slots[i];
+                if ( slot.state == SLOT_EMPTY )
+                {
+                    if ( !reuse )
+                        reuse = &slot;
+                    break;
+                }
+                if ( slot.hash == hash && (slot.state == SLOT_LIVE || slot.state == SLOT_TOMBSTONE) )
+                    return &slot;
+                if ( slot.state == SLOT_DELETED && !reuse )
+                    reuse = &slot;
+            }
+            if ( !reuse )
+                return 0L;
+
+            if ( reuse->state == SLOT_DELETED )
+                --header()->deleted;
+            ++header()->count;
+            memset(reuse, 0, sizeof(IndexSlot));
+            reuse->hash  = hash;
+            reuse->state = SLOT_LIVE;
+            return reuse;
+        }
+
+        void erase(IndexSlot* slot)
+        {
+            slot->state = SLOT_DELETED;
+            --header()->count;
+            ++header()->deleted;
+        }
+
+        bool needsGrowth() const
+        {
+            const IndexHeader* h = (const IndexHeader*)_data;
+            return (h->count + h->deleted + 1u) * 10u > h->capacity * 7u;
+        }
+
+    private:
+        bool map()
+        {
+#ifdef _WIN32
+            _mapping = ::CreateFileMappingA(_file.native(), 0, PAGE_READWRITE,
+                (DWORD)((uint64_t)_size >> 32), (DWORD)(_size & 0xffffffff), 0);
+            if ( !_mapping )
+                return false;
+            _data = (char*)::MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, _size);
+            if ( !_data )
+            {
+                ::CloseHandle(_mapping);
+                _mapping = 0L;
+            }
+#else
+            void* p = ::mmap(0L, _size, PROT_READ|PROT_WRITE, MAP_SHARED, _file.native(), 0);
+            _data = p == MAP_FAILED ? 0L : (char*)p;
+#endif
+            return _data != 0L;
+        }
+
+        File    _file;
+        char*   _data;
+        size_t  _size;
+#ifdef _WIN32
+        HANDLE  _mapping;
+#endif
+    };
+
+    /** Background thread that compacts and evicts segments. */
+    class Compactor : public OpenThreads::Thread
+    {
+    public:
+        Compactor(PackFileStore* store) : _store(store) { }
+
+        void run()
+        {
+            while( (unsigned)_done == 0u )
+            {
+                _wake.wait( _store->getCompactionInterval() * 1000u );
+                _wake.reset();
+                if ( (unsigned)_done == 0u )
+                    _store->maintain( false );
+            }
+        }
+
+        void wake() { _wake.set(); }
+
+        void stop()
+        {
+            _done.exchange( 1u );
+            _wake.set();
+            join();
+        }
+
+    private:
+        PackFileStore*      _store;
+        OpenThreads::Atomic _done;
+        Event               _wake;
+    };
+} } }
+
+//------------------------------------------------------------------------
+
+namespace
+{
+    /** Sequential reader over a segment, reading ahead in large blocks. */
+    struct SegmentScanner
+    {
+        SegmentScanner(const File& file, uint64_t end) : _file(file), _end(end), _start(0u) { }
+
+        /** Points "data" at bytes [offset, offset+size), or returns false past the end. */
+        bool get(uint64_t offset, uint64_t size, const char*& data)
+        {
+            if ( offset + size > _end )
+                return false;
+
+            if ( offset < _start || offset + size > _start + _buf.size() )
+            {
+                uint64_t len = std::min(_end - offset, std::max(size, (uint64_t)(4u << 20)));
+                _buf.resize((size_t)len);
+                if ( !_file.read(offset, &_buf[0], (size_t)len) )
+                {
+                    _buf.clear();
+                    return false;
+                }
+                _start = offset;
+            }
+            data = _buf.data() + (offset - _start);
+            return true;
+        }
+
+        /** Reads the record at "offset"; returns false at the end or at a damaged record. */
+        bool next(uint64_t offset, RecordHeader& header, const char*& record)
+        {
+            const char* h;
+            if ( !get(offset, sizeof(RecordHeader), h) )
+                return false;
+            memcpy(&header, h, sizeof(RecordHeader));
+            if ( header.magic != RECORD_MAGIC )
+                return false;
+            if ( !get(offset, header.recordSize(), record) )
+                return false;
+            return checksum(header, record + sizeof(RecordHeader), header.recordSize() - sizeof(RecordHeader)) == header.checksum;
+        }
+
+        const File& _file;
+        uint64_t    _end;
+        uint64_t    _start;
+        std::string _buf;
+    };
+
+    /** Whether the key of the record at "offset" starts with "prefix". */
+    bool keyHasPrefix(const File& file, uint64_t offset, const std::string& prefix)
+    {
+        std::string buf(sizeof(RecordHeader) + prefix.size(), '\0');
+        if ( !file.read(offset, &buf[0], buf.size()) )
+            return false;
+
+        RecordHeader h;
+        memcpy(&h, buf.data(), sizeof(h));
+        return
+            h.magic == RECORD_MAGIC &&
+            h.keySize >= prefix.size() &&
+            memcmp(buf.data()+sizeof(h), prefix.data(), prefix.size()) == 0;
+    }
+}
+
+//------------------------------------------------------------------------
+
+PackFileStore::PackFileStore(const PackFileCacheOptions& options, const std::string& path) :
+_options      ( options ),
+_path         ( path ),
+_open         ( false ),
+_index        ( 0L ),
+_nextSegmentId( 0u ),
+_nextSeq      ( 1u ),
+_totalBytes   ( 0u ),
+_compactor    ( 0L )
+{
+    _maxBytes     = (uint64_t)options.maxSizeMB().get() * 1048576u;
+    _segmentBytes = (uint64_t)std::max(1u, options.segmentSizeMB().get()) * 1048576u;
+}
+
+PackFileStore::~PackFileStore()
+{
+    close();
+    delete _index;
+}
+
+std::string
+PackFileStore::segmentPath(unsigned id) const
+{
+    return osgDB::concatPaths(_path, Stringify() << "segment_" << std::setw(8) << std::setfill('0') << id << ".pak");
+}
+
+std::string
+PackFileStore::indexPath() const
+{
+    return osgDB::concatPaths(_path, "index.idx");
+}
+
+unsigned
+PackFileStore::getCompactionInterval() const
+{
+    return std::max(1u, _options.compactionInterval().get());
+}
+
+uint64_t
+PackFileStore::allocateSeq()
+{
+    ScopedMutexLock lock( _appendMutex );
+    return _nextSeq++;
+}
+
+bool
+PackFileStore::open()
+{
+    if ( _open )
+        return true;
+
+    if ( !osgDB::fileExists(_path) && !osgEarth::makeDirectory(_path) )
+    {
+        OE_WARN << LC << "Failed to create cache folder " << _path << std::endl;
+        return false;
+    }
+
+    // find the existing segments:
+    osgDB::DirectoryContents files = osgDB::getDirectoryContents(_path);
+    for(osgDB::DirectoryContents::const_iterator f = files.begin(); f != files.end(); ++f)
+    {
+        unsigned id;
+        char tail;
+        if ( f->size() != 20 || sscanf(f->c_str(), "segment_%8u.pa%c", &id, &tail) != 2 || tail != 'k' )
+            continue;
+
+        osg::ref_ptr<Segment> segment = new Segment(id);
+        segment->path = segmentPath(id);
+        if ( !segment->file.open(segment->path, false) )
+        {
+            OE_WARN << LC << "Failed to open " << segment->path << std::endl;
+            continue;
+        }
+        segment->size   = segment->file.size();
+        segment->sealed = true;
+        segment->lastAccess.exchange( (unsigned)osgEarth::getLastModifiedTime(segment->path) );
+        _segments[id] = segment.get();
+        _nextSegmentId = std::max(_nextSegmentId, id+1u);
+    }
+
+    // use the index if it was closed cleanly; otherwise rebuild it from the segments.
+    _index = new IndexFile();
+    if ( _index->open(indexPath()) && _index->header()->clean == 1u )
+    {
+        for(IndexSlot* slot = _index->begin(); slot != _index->end(); ++slot)
+        {
+            if ( slot->state != SLOT_LIVE )
+                continue;
+
+            Segments::iterator s = _segments.find(slot->segment);
+            if ( s != _segments.end() && slot->offset + slot->size <= s->second->size )
+                s->second->live += slot->size;
+            else
+                _index->erase(slot); // segment went missing
+        }
+        _nextSeq = std::max((uint64_t)1u, _index->header()->nextSeq);
+    }
+    else
+    {
+        if ( !_segments.empty() )
+        {
+            OE_WARN << LC << "Cache index at " << _path << " was not closed cleanly; rebuilding it" << std::endl;
+        }
+
+        if ( !rebuildIndex() )
+        {
+            OE_WARN << LC << "Failed to create the cache index at " << indexPath() << std::endl;
+            _segments.clear();
+            return false;
+        }
+    }
+
+    // from now on, a crash leaves the index marked for a rebuild.
+    _index->header()->clean = 0u;
+    _index->flush();
+
+    for(Segments::const_iterator s = _segments.begin(); s != _segments.end(); ++s)
+        _totalBytes += s->second->size;
+
+    // keep appending to the last segment if it has room.
+    if ( !_segments.empty() && _segments.rbegin()->second->size < _segmentBytes )
+    {
+        _active = _segments.rbegin()->second.get();
+        _active->sealed = false;
+    }
+    else if ( !startSegment() )
+    {
+        return false;
+    }
+
+    _open = true;
+
+    _compactor = new Compactor(this);
+    _compactor->start();
+
+    OE_INFO << LC << "Opened " << _path << ": " << _index->header()->count << " records in "
+        << _segments.size() << " segment(s), " << (_totalBytes/1048576u) << " MB" << std::endl;
+
+    return true;
+}
+
+void
+PackFileStore::close()
+{
+    if ( _compactor )
+    {
+        _compactor->stop();
+        delete _compactor;
+        _compactor = 0L;
+    }
+
+    ScopedMutexLock appendLock( _appendMutex );
+    ScopedWriteLock indexLock( _indexMutex );
+
+    if ( !_open )
+        return;
+
+    _open = false;
+
+    for(Segments::iterator s = _segments.begin(); s != _segments.end(); ++s)
+    {
+        if ( !s->second->sealed )
+            s->second->file.sync();
+    }
+
+    _index->header()->nextSeq = _nextSeq;
+    _index->header()->clean = 1u;
+    _index->flush();
+    _index->close();
+
+    _segments.clear();
+    _active = 0L;
+}
+
+bool
+PackFileStore::startSegment()
+{
+    // caller holds the append lock (or has exclusive access during open)
+    osg::ref_ptr<Segment> segment = new Segment(_nextSegmentId);
+    segment->path = segmentPath(segment->id);
+    if ( !segment->file.open(segment->path, true) || !segment->file.truncate(0u) )
+    {
+        OE_WARN << LC << "Failed to create segment " << segment->path << std::endl;
+        return false;
+    }
+    segment->lastAccess.exchange( now() );
+
+    {
+        ScopedWriteLock lock( _indexMutex );
+        _segments[segment->id] = segment.get();
+        if ( _active.valid() )
+            _active->sealed = true;
+    }
+
+    ++_nextSegmentId;
+    _active = segment.get();
+
+    // time to look at the size limit?
+    if ( _maxBytes > 0u && _totalBytes > _maxBytes && _compactor )
+        _compactor->wake();
+
+    return true;
+}
+
+bool
+PackFileStore::rebuildIndex()
+{
+    uint64_t bytes = 0u;
+    for(Segments::const_iterator s = _segments.begin(); s != _segments.end(); ++s)
+        bytes += s->second->size;
+
+    // assume records of a few KB, and leave room to grow.
+    uint64_t capacity = INDEX_MIN_SLOTS;
+    while( capacity < (bytes / 4096u) * 2u )
+        capacity *= 2u;
+
+    std::string path = indexPath();
+    _index->close();
+    ::unlink( path.c_str() );
+    if ( !_index->create(path, capacity) )
+        return false;
+
+    uint64_t maxSeq = 0u;
+    std::map<std::string, uint64_t> clears;
+    for(Segments::iterator s = _segments.begin(); s != _segments.end(); ++s)
+    {
+        scanSegment( s->second.get(), maxSeq, clears );
+    }
+
+    // Look the clears up by bin hash; since bins can share a hash, the bin
+    // ID stored with each key confirms the match.
+    typedef std::multimap<uint32_t, std::pair<std::string, uint64_t> > ClearsByHash;
+    ClearsByHash clearsByHash;
+    for(std::map<std::string, uint64_t>::const_iterator c = clears.begin(); c != clears.end(); ++c)
+    {
+        clearsByHash.insert( std::make_pair((uint32_t)hash64(c->first), std::make_pair(c->first + "!", c->second)) );
+    }
+
+    // drop tombstones and anything older than its bin's last clear; tally live bytes.
+    for(IndexSlot* slot = _index->begin(); slot != _index->end(); ++slot)
+    {
+        if ( slot->state == SLOT_TOMBSTONE )
+        {
+            _index->erase(slot);
+        }
+        else if ( slot->state == SLOT_LIVE )
+        {
+            Segments::iterator seg = _segments.find(slot->segment);
+            bool cleared = false;
+            if ( seg != _segments.end() )
+            {
+                ClearsByHash::const_iterator c   = clearsByHash.lower_bound(slot->bin);
+                ClearsByHash::const_iterator end = clearsByHash.upper_bound(slot->bin);
+                for( ; c != end && !cleared; ++c )
+                {
+                    cleared =
+                        slot->seq < c->second.second &&
+                        keyHasPrefix(seg->second->file, slot->offset, c->second.first);
+                }
+            }
+
+            if ( seg == _segments.end() || cleared )
+                _index->erase(slot);
+            else
+                seg->second->live += slot->size;
+        }
+    }
+
+    _nextSeq = maxSeq + 1u;
+    _index->header()->nextSeq = _nextSeq;
+
+    OE_INFO << LC << "Rebuilt index: " << _index->header()->count << " records" << std::endl;
+    return true;
+}
+
+void
+PackFileStore::scanSegment(Segment* segment, uint64_t& maxSeq, std::map<std::string, uint64_t>& clears)
+{
+    SegmentScanner scanner( segment->file, segment->size );
+
+    uint64_t offset = 0u;
+    RecordHeader h;
+    const char* record;
+    while( scanner.next(offset, h, record) )
+    {
+        maxSeq = std::max(maxSeq, h.seq);
+
+        if ( h.flags == RECORD_CLEAR_BIN )
+        {
+            // applied once the scan is done; only the latest clear of a bin matters.
+            uint64_t& seq = clears[ std::string(record + sizeof(RecordHeader), h.keySize) ];
+            seq = std::max(seq, h.seq);
+        }
+        else
+        {
+            IndexSlot* slot = _index->find(h.hash);
+
+            // newest record of a key wins; a tombstone beats a record of the same sequence.
+            bool apply = !slot ||
+                (h.flags == RECORD_TOMBSTONE ? h.seq >= slot->seq : h.seq > slot->seq);
+
+            if ( apply )
+            {
+                if ( !slot )
+                {
+                    if ( _index->needsGrowth() )
+                        growIndex();
+                    slot = _index->insert(h.hash);
+                }
+                if ( !slot )
+                    break;
+                slot->offset  = offset;
+                slot->seq     = h.seq;
+                slot->segment = segment->id;
+                slot->size    = (uint32_t)h.recordSize();
+                slot->bin     = h.bin;
+                slot->state   = h.flags == RECORD_TOMBSTONE ? SLOT_TOMBSTONE : SLOT_LIVE;
+            }
+        }
+
+        offset += h.recordSize();
+    }
+
+    if ( offset < segment->size )
+    {
+        // an append that never finished; drop it and anything after it.
+        OE_WARN << LC << "Truncating damaged tail of " << segment->path << " at " << offset
+            << " (" << (segment->size - offset) << " bytes)" << std::endl;
+        segment->file.truncate(offset);
+        segment->size = offset;
+    }
+}
+
+bool
+PackFileStore::growIndex()
+{
+    // caller holds the index lock exclusively (or has exclusive access).
+    IndexHeader* old = _index->header();
+
+    uint64_t capacity = old->capacity;
+    while( (old->count + 1u) * 2u > capacity )
+        capacity *= 2u;
+
+    std::string path = indexPath();
+    std::string temp = path + ".new";
+
+    IndexFile* grown = new IndexFile();
+    if ( !grown->create(temp, capacity) )
+    {
+        delete grown;
+        OE_WARN << LC << "Failed to grow the cache index" << std::endl;
+        return false;
+    }
+
+    for(IndexSlot* slot = _index->begin(); slot != _index->end(); ++slot)
+    {
+        if ( slot->state == SLOT_LIVE || slot->state == SLOT_TOMBSTONE )
+        {
+            IndexSlot* copy = grown->insert(slot->hash);
+            *copy = *slot;
+        }
+    }
+    grown->header()->clean   = 0u;
+    grown->header()->nextSeq = old->nextSeq;
+
+    // swap the files; the old one has to be unmapped before it can be replaced on Windows.
+    grown->close();
+    _index->close();
+    delete grown;
+
+#ifdef _WIN32
+    bool renamed = ::MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    bool renamed = ::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+
+    if ( !renamed )
+    {
+        // carry on with the old index, which still has some room.
+        OE_WARN << LC << "Failed to replace the cache index; keeping the old one" << std::endl;
+        ::unlink( temp.c_str() );
+    }
+
+    if ( !_index->open(path) )
+    {
+        OE_WARN << LC << "Failed to reopen the cache index" << std::endl;
+        _open = false;
+        return false;
+    }
+    return renamed;
+}
+
+bool
+PackFileStore::append(const std::string& data, osg::ref_ptr<Segment>& segment, uint64_t& offset)
+{
+    {
+        ScopedMutexLock lock( _appendMutex );
+        if ( !_open || !_active.valid() )
+            return false;
+
+        if ( _active->size > 0u && _active->size + data.size() > _segmentBytes )
+        {
+            if ( !startSegment() )
+                return false;
+        }
+
+        segment = _active.get();
+        segment->lastAccess.exchange( now() );
+        offset  = segment->size;
+        segment->size += data.size();
+        ++segment->pending;
+        _totalBytes += data.size();
+    }
+
+    // write outside the lock; appends to the same segment don't overlap.
+    // The caller releases "pending" once the record is published, so the
+    // segment can't be compacted or evicted out from under the publish.
+    bool ok = segment->file.write(offset, data.data(), data.size());
+
+    if ( !ok )
+    {
+        --segment->pending;
+        OE_WARN << LC << "Failed to write to " << segment->path << std::endl;
+    }
+    return ok;
+}
+
+void
+PackFileStore::publish(const char* record, Segment* segment, uint64_t offset, const Segment* from, uint64_t fromOffset)
+{
+    RecordHeader h;
+    memcpy(&h, record, sizeof(h));
+
+    ScopedWriteLock lock( _indexMutex );
+    if ( !_open )
+        return;
+
+    IndexSlot* slot = _index->find(h.hash);
+
+    if ( from )
+    {
+        // a moved record only replaces the location it was moved from.
+        if ( !slot || slot->segment != from->id || slot->offset != fromOffset )
+            return;
+    }
+    else if ( slot && (h.flags == RECORD_TOMBSTONE ? h.seq < slot->seq : h.seq <= slot->seq) )
+    {
+        // lost a race with a newer write
+        return;
+    }
+
+    if ( slot )
+    {
+        Segments::iterator s = _segments.find(slot->segment);
+        if ( s != _segments.end() )
+            s->second->live -= slot->size;
+    }
+
+    if ( h.flags == RECORD_TOMBSTONE )
+    {
+        if ( slot )
+            _index->erase(slot);
+        return;
+    }
+
+    if ( !slot )
+    {
+        if ( _index->needsGrowth() )
+            growIndex();
+        if ( !_open )
+            return;
+        slot = _index->insert(h.hash);
+        if ( !slot )
+            return;
+    }
+
+    slot->offset  = offset;
+    slot->seq     = h.seq;
+    slot->segment = segment->id;
+    slot->size    = (uint32_t)h.recordSize();
+    slot->bin     = h.bin;
+    slot->state   = SLOT_LIVE;
+    segment->live += slot->size;
+}
+
+bool
+PackFileStore::read(const std::string& bin, const std::string& key, Record& out)
+{
+    std::string fullKey = bin + "!" + key;
+    uint64_t hash = hash64(fullKey);
+
+    IndexSlot slot;
+    osg::ref_ptr<Segment> segment;
+    {
+        ScopedReadLock lock( _indexMutex );
+        if ( !_open )
+            return false;
+
+        IndexSlot* s = _index->find(hash);
+        if ( !s || s->state != SLOT_LIVE )
+            return false;
+        slot = *s;
+
+        Segments::const_iterator i = _segments.find(slot.segment);
+        if ( i == _segments.end() )
+            return false;
+        segment = i->second.get();
+    }
+
+    segment->lastAccess.exchange( now() );
+
+    // one read for the whole record. The segment stays readable even if
+    // it's compacted or evicted in the meantime, since we hold a reference.
+    out.buffer.resize(slot.size);
+    if ( !segment->file.read(slot.offset, &out.buffer[0], slot.size) )
+        return false;
+
+    RecordHeader h;
+    memcpy(&h, out.buffer.data(), sizeof(h));
+    if ( h.magic != RECORD_MAGIC || h.seq != slot.seq || h.recordSize() != slot.size ||
+         h.keySize != fullKey.size() || memcmp(out.buffer.data()+sizeof(h), fullKey.data(), h.keySize) != 0 )
+    {
+        // damaged, or a different key with the same hash.
+        return false;
+    }
+
+    out.time        = (TimeStamp)h.time;
+    out.meta        = out.buffer.data() + sizeof(h) + h.keySize;
+    out.metaSize    = h.metaSize;
+    out.payload     = out.meta + h.metaSize;
+    out.payloadSize = h.payloadSize;
+    return true;
+}
+
+bool
+PackFileStore::exists(const std::string& bin, const std::string& key)
+{
+    uint64_t hash = hash64(bin + "!" + key);
+
+    ScopedReadLock lock( _indexMutex );
+    if ( !_open )
+        return false;
+
+    IndexSlot* slot = _index->find(hash);
+    return slot && slot->state == SLOT_LIVE;
+}
+
+bool
+PackFileStore::write(const std::string& bin, const std::string& key, TimeStamp time, const std::string& meta, const std::string& payload)
+{
+    std::string fullKey = bin + "!" + key;
+
+    std::string data = encode(
+        RECORD_PUT, allocateSeq(), hash64(fullKey), (uint32_t)hash64(bin), time,
+        fullKey, meta, payload);
+
+    osg::ref_ptr<Segment> segment;
+    uint64_t offset;
+    if ( !append(data, segment, offset) )
+        return false;
+
+    publish(data.data(), segment.get(), offset, 0L, 0u);
+    --segment->pending;
+    return true;
+}
+
+bool
+PackFileStore::remove(const std::string& bin, const std::string& key)
+{
+    if ( !exists(bin, key) )
+        return false;
+
+    std::string fullKey = bin + "!" + key;
+
+    // the tombstone keeps a rebuild from bringing the record back.
+    std::string data = encode(
+        RECORD_TOMBSTONE, allocateSeq(), hash64(fullKey), (uint32_t)hash64(bin), (TimeStamp)now(),
+        std::string(), std::string(), std::string());
+
+    osg::ref_ptr<Segment> segment;
+    uint64_t offset;
+    if ( !append(data, segment, offset) )
+        return false;
+
+    publish(data.data(), segment.get(), offset, 0L, 0u);
+    --segment->pending;
+    return true;
+}
+
+bool
+PackFileStore::touch(const std::string& bin, const std::string& key)
+{
+    Record r;
+    if ( !read(bin, key, r) )
+        return false;
+
+    return write(bin, key, (TimeStamp)now(),
+        std::string(r.meta, r.metaSize),
+        std::string(r.payload, r.payloadSize));
+}
+
+bool
+PackFileStore::clearBin(const std::string& bin)
+{
+    uint32_t binHash = (uint32_t)hash64(bin);
+    uint64_t seq = allocateSeq();
+
+    // the record carries the bin ID so a rebuild can tell bins with the same hash apart.
+    std::string data = encode(
+        RECORD_CLEAR_BIN, seq, 0u, binHash, (TimeStamp)now(),
+        bin, std::string(), std::string());
+
+    osg::ref_ptr<Segment> segment;
+    uint64_t offset;
+    if ( !append(data, segment, offset) )
+        return false;
+
+    // nothing to publish; the index is updated below.
+    --segment->pending;
+
+    // Find the bin's records by hash, then confirm each one by the bin ID
+    // stored with its key; that takes a read from disk, so not under the lock.
+    std::vector<std::pair<IndexSlot, osg::ref_ptr<Segment> > > candidates;
+    {
+        ScopedReadLock lock( _indexMutex );
+        if ( !_open )
+            return false;
+
+        for(IndexSlot* slot = _index->begin(); slot != _index->end(); ++slot)
+        {
+            if ( slot->state == SLOT_LIVE && slot->bin == binHash && slot->seq < seq )
+            {
+                Segments::const_iterator s = _segments.find(slot->segment);
+                if ( s != _segments.end() )
+                    candidates.push_back( std::make_pair(*slot, s->second) );
+            }
+        }
+    }
+
+    std::string prefix = bin + "!";
+    std::vector<IndexSlot> cleared;
+    for(unsigned i=0; i<candidates.size(); ++i)
+    {
+        if ( keyHasPrefix(candidates[i].second->file, candidates[i].first.offset, prefix) )
+            cleared.push_back( candidates[i].first );
+    }
+
+    ScopedWriteLock lock( _indexMutex );
+    if ( !_open )
+        return false;
+
+    for(unsigned i=0; i<cleared.size(); ++i)
+    {
+        // skip records that were replaced or moved in the meantime.
+        IndexSlot* slot = _index->find(cleared[i].hash);
+        if ( slot && slot->state == SLOT_LIVE && slot->segment == cleared[i].segment && slot->offset == cleared[i].offset )
+        {
+            Segments::iterator s = _segments.find(slot->segment);
+            if ( s != _segments.end() )
+                s->second->live -= slot->size;
+            _index->erase(slot);
+        }
+    }
+    return true;
+}
+
+bool
+PackFileStore::clear()
+{
+    ScopedMutexLock maintainLock( _maintainMutex );
+    ScopedMutexLock appendLock( _appendMutex );
+    {
+        ScopedWriteLock indexLock( _indexMutex );
+        if ( !_open )
+            return false;
+
+        for(Segments::iterator s = _segments.begin(); s != _segments.end(); ++s)
+            ::unlink( s->second->path.c_str() );
+
+        _segments.clear();
+        _active = 0L;
+        _totalBytes = 0u;
+
+        if ( !_index->create(indexPath(), INDEX_MIN_SLOTS) )
+        {
+            OE_WARN << LC << "Failed to recreate the cache index" << std::endl;
+            _open = false;
+            return false;
+        }
+        _index->header()->nextSeq = _nextSeq;
+    }
+
+    return startSegment();
+}
+
+bool
+PackFileStore::compact()
+{
+    maintain( true );
+    return true;
+}
+
+uint64_t
+PackFileStore::getSize() const
+{
+    ScopedMutexLock lock( _appendMutex );
+    return _totalBytes + (_index && _index->valid() ? _index->fileSize() : 0u);
+}
+
+void
+PackFileStore::maintain(bool force)
+{
+    ScopedMutexLock lock( _maintainMutex );
+
+    // Evict least recently used segments until we're under the limit.
+    while( _maxBytes > 0u )
+    {
+        {
+            ScopedMutexLock appendLock( _appendMutex );
+            if ( _totalBytes <= _maxBytes )
+                break;
+        }
+
+        osg::ref_ptr<Segment> victim;
+        {
+            ScopedReadLock indexLock( _indexMutex );
+            for(Segments::const_iterator s = _segments.begin(); s != _segments.end(); ++s)
+            {
+                Segment* seg = s->second.get();
+                if ( seg->sealed && (unsigned)seg->pending == 0u &&
+                     (!victim.valid() || (unsigned)seg->lastAccess < (unsigned)victim->lastAccess) )
+                {
+                    victim = seg;
+                }
+            }
+        }
+
+        if ( !victim.valid() || !evictSegment(victim.get()) )
+            break;
+    }
+
+    // Compact sealed segments that are mostly dead, emptiest first.
+    float threshold = _options.compactionThreshold().get();
+
+    std::vector<std::pair<float, osg::ref_ptr<Segment> > > candidates;
+    {
+        ScopedReadLock indexLock( _indexMutex );
+        for(Segments::const_iterator s = _segments.begin(); s != _segments.end(); ++s)
+        {
+            Segment* seg = s->second.get();
+            if ( !seg->sealed || (unsigned)seg->pending > 0u || seg->size == 0u || seg->live >= seg->size )
+                continue;
+
+            float dead = (float)(seg->size - seg->live) / (float)seg->size;
+            if ( force || dead >= threshold )
+                candidates.push_back( std::make_pair(dead, seg) );
+        }
+    }
+
+    std::sort( candidates.begin(), candidates.end() );
+    for(std::vector<std::pair<float, osg::ref_ptr<Segment> > >::reverse_iterator c = candidates.rbegin(); c != candidates.rend(); ++c)
+    {
+        if ( !compactSegment(c->second.get()) )
+            break;
+    }
+}
+
+bool
+PackFileStore::compactSegment(Segment* segment)
+{
+    bool hasOlder;
+    {
+        ScopedReadLock lock( _indexMutex );
+        hasOlder = !_segments.empty() && _segments.begin()->first < segment->id;
+    }
+
+    // Copy the records the index still points to, in batches, to the active segment.
+    // Tombstones and clears must survive as long as an older segment might
+    // hold a record they cancel.
+    SegmentScanner scanner( segment->file, segment->size );
+    std::string batch;
+    std::vector<uint64_t> sources, positions;
+
+    uint64_t offset = 0u;
+    RecordHeader h;
+    const char* record;
+    bool ok = true;
+    while( ok && offset < segment->size )
+    {
+        if ( !scanner.next(offset, h, record) )
+        {
+            OE_WARN << LC << "Damaged record in " << segment->path << " at " << offset << "; not compacting it" << std::endl;
+            return false;
+        }
+
+        bool keep;
+        if ( h.flags == RECORD_PUT )
+        {
+            ScopedReadLock lock( _indexMutex );
+            IndexSlot* slot = _index->find(h.hash);
+            keep = slot && slot->state == SLOT_LIVE && slot->segment == segment->id && slot->offset == offset;
+        }
+        else
+        {
+            keep = hasOlder;
+        }
+
+        if ( keep )
+        {
+            sources.push_back(offset);
+            positions.push_back(batch.size());
+            batch.append(record, (size_t)h.recordSize());
+        }
+
+        offset += h.recordSize();
+
+        if ( batch.size() >= (4u << 20) || (offset >= segment->size && !batch.empty()) )
+        {
+            osg::ref_ptr<Segment> target;
+            uint64_t base;
+            ok = append(batch, target, base);
+            if ( ok )
+            {
+                for(unsigned i=0; i<sources.size(); ++i)
+                {
+                    const char* moved = batch.data() + positions[i];
+                    RecordHeader mh;
+                    memcpy(&mh, moved, sizeof(mh));
+                    if ( mh.flags == RECORD_PUT )
+                        publish(moved, target.get(), base + positions[i], segment, sources[i]);
+                }
+                --target->pending;
+            }
+            batch.clear();
+            sources.clear();
+            positions.clear();
+        }
+    }
+
+    // removeSegment makes sure, under the index lock, that nothing still points here.
+    if ( !ok || !removeSegment(segment) )
+        return false;
+
+    OE_DEBUG << LC << "Compacted " << segment->path << std::endl;
+    return true;
+}
+
+bool
+PackFileStore::evictSegment(Segment* segment)
+{
+    // Only an older segment can hold earlier versions of the records being
+    // evicted; if there is one, write tombstones so a rebuild can't bring
+    // those back. Each carries its record's own sequence number, so it never
+    // cancels a newer write.
+    std::string tombstones;
+    {
+        ScopedReadLock lock( _indexMutex );
+        bool hasOlder = !_segments.empty() && _segments.begin()->first < segment->id;
+        if ( hasOlder )
+        {
+            for(IndexSlot* slot = _index->begin(); slot != _index->end(); ++slot)
+            {
+                if ( slot->state == SLOT_LIVE && slot->segment == segment->id )
+                {
+                    tombstones += encode(
+                        RECORD_TOMBSTONE, slot->seq, slot->hash, slot->bin, (TimeStamp)now(),
+                        std::string(), std::string(), std::string());
+                }
+            }
+        }
+    }
+
+    if ( !tombstones.empty() )
+    {
+        osg::ref_ptr<Segment> target;
+        uint64_t offset;
+        if ( !append(tombstones, target, offset) )
+            return false;
+        --target->pending;
+    }
+
+    {
+        ScopedWriteLock lock( _indexMutex );
+        for(IndexSlot* slot = _index->begin(); slot != _index->end(); ++slot)
+        {
+            if ( slot->state == SLOT_LIVE && slot->segment == segment->id )
+                _index->erase(slot);
+        }
+        segment->live = 0u;
+    }
+
+    if ( !removeSegment(segment) )
+        return false;
+
+    OE_DEBUG << LC << "Evicted " << segment->path << std::endl;
+    return true;
+}
+
+bool
+PackFileStore::removeSegment(Segment* segment)
+{
+    osg::ref_ptr<Segment> hold = segment;
+
+    ScopedMutexLock appendLock( _appendMutex );
+    {
+        ScopedWriteLock indexLock( _indexMutex );
+        if ( segment->live > 0u || _segments.erase(segment->id) == 0u )
+            return false;
+    }
+    _totalBytes -= segment->size;
+
+    // readers that already hold the segment can finish; the file goes away when they're done.
+    ::unlink( segment->path.c_str() );
+    return true;
+}
@@ -105,6 +105,9 @@ _active        ( true )
 
 RocksDBCacheImpl::~RocksDBCacheImpl()
 {
+    // persist any queued write-behind writes while the database is still open
+    flush();
+
     if ( _db )
     {
         // problem. This destructor causes a lockup sometimes. Perhaps try
@@ -44,8 +44,8 @@ namespace
         LoadTileData* _req;
         MyProgress(LoadTileData* req) : _req(req) {}
         bool isCanceled() {
-            if (_canceled == false && _req->isIdle())
-                _canceled = true;
+            if (!ProgressCallback::isCanceled() && _req->isIdle())
+                cancel();
             return ProgressCallback::isCanceled();
         }
     };
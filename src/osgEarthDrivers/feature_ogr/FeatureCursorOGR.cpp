@@ -19,6 +19,7 @@
 #include "FeatureCursorOGR"
 #include <osgEarthFeatures/OgrUtils>
 #include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/FeatureBatch>
 #include <osgEarthFeatures/FilterContext>
 #include <osgEarth/Registry>
 #include <osg/Math>
@@ -237,12 +238,19 @@ FeatureCursorOGR::readChunk()
     while( _queue.size() < _chunkSize && !_resultSetEndReached )
     {
         FeatureList filterList;
+
+        // the features of a chunk store their attributes in one batch,
+        // so the field names are resolved once per chunk
+        osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+        std::vector<unsigned> fields;
+        OgrUtils::mapFields( OGR_L_GetLayerDefn(_resultSetHandle), batch.get(), fields );
+
         while( filterList.size() < _chunkSize && !_resultSetEndReached )
         {
             OGRFeatureH handle = OGR_L_GetNextFeature( _resultSetHandle );
             if ( handle )
             {
-                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get() );
+                osg::ref_ptr<Feature> feature = OgrUtils::createFeature( handle, _profile.get(), batch.get(), fields );
 
                 if (feature.valid())
                 {
@@ -25,12 +25,15 @@
 #include <osgEarthFeatures/FeatureCursor>
 #include <osgEarthFeatures/FeatureSource>
 #include <osgEarthFeatures/FilterContext>
+#include <osgEarthFeatures/PreparedBoundaries>
 
 #include <osgEarthSymbology/Geometry>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
 
+#include <vector>
+
 #define LC "[Intersect FeatureFilter] "
 
 using namespace osgEarth;
@@ -45,6 +48,8 @@ class IntersectFeatureFilter : public FeatureFilter, public IntersectFeatureFilt
 private:
     osg::ref_ptr< FeatureSource > _featureSource;
 
+    osg::ref_ptr< PreparedBoundariesCache > _boundaries;
+
 public:
     IntersectFeatureFilter(const ConfigOptions& options)
         : FeatureFilter(), IntersectFeatureFilterOptions(options)
@@ -64,101 +69,43 @@ public: // FeatureFilter
         if (s.isError())
             return s;
 
-        return Status::OK();
-    }
+        _boundaries = new PreparedBoundariesCache( _featureSource.get() );
 
-    /**
-     * Gets all the features that intersect the extent
-     */
-    void getFeatures(const GeoExtent& extent, FeatureList& features)
-    {
-        GeoExtent localExtent = extent.transform( _featureSource->getFeatureProfile()->getSRS() );
-        Query query;
-        query.bounds() = localExtent.bounds();
-        if (localExtent.intersects( _featureSource->getFeatureProfile()->getExtent()))
-        {
-            osg::ref_ptr< FeatureCursor > cursor = _featureSource->createFeatureCursor( query );
-            if (cursor)
-            {
-                cursor->fill( features );
-            }
-        }     
+        return Status::OK();
     }
 
     FilterContext push(FeatureList& input, FilterContext& context)
     {
         if (_featureSource.valid())
         {
-            // Get any features that intersect this query.
-            FeatureList boundaries;
-            getFeatures(context.extent().get(), boundaries );
-            
-            
-            // The list of output features
-            FeatureList output;
-
-            if (boundaries.empty())
+            osg::ref_ptr<PreparedBoundaries> boundaries = _boundaries->get( context.extent().get(), context.profile()->getSRS() );
+
+            // Test the centroids of all the features in one batch.
+            std::vector<Feature*>    candidates;
+            std::vector<osg::Vec2d>  centroids;
+            candidates.reserve( input.size() );
+            centroids.reserve( input.size() );
+            for(FeatureList::const_iterator f = input.begin(); f != input.end(); ++f)
             {
-                // No intersecting features.  If contains is false, then just the output to the input.
-                if (contains() == false)
+                Feature* feature = f->get();
+                if ( feature && feature->getGeometry() )
                 {
-                    output = input;
+                    candidates.push_back( feature );
+                    centroids.push_back( feature->getGeometry()->getBounds().center2d() );
                 }
             }
-            else
-            {
-                // Transform the boundaries into the coordinate system of the features
-                for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
-                {
-                    itr->get()->transform( context.profile()->getSRS() );
-                }
 
-                for(FeatureList::const_iterator f = input.begin(); f != input.end(); ++f)
+            std::vector<bool> inside;
+            boundaries->contains( centroids, inside );
+
+            // The list of output features: those inside the boundaries if contains is true,
+            // otherwise those outside them.
+            FeatureList output;
+            for(unsigned i = 0; i < candidates.size(); ++i)
+            {
+                if ( inside[i] == *contains() )
                 {
-                    Feature* feature = f->get();
-                    if ( feature && feature->getGeometry() )
-                    {
-                        osg::Vec2d c = feature->getGeometry()->getBounds().center2d();
-
-                        if ( contains() == true )
-                        {
-                            // coarsest:
-                            if (_featureSource->getFeatureProfile()->getExtent().contains(GeoPoint(feature->getSRS(), c.x(), c.y())))
-                            {
-                                for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
-                                {
-                                    Ring* ring = dynamic_cast< Ring*>(itr->get()->getGeometry());
-                                    if (ring && ring->contains2D(c.x(), c.y()))
-                                    {
-                                        output.push_back( feature );
-                                    }
-                                }                        
-                            }
-                        }
-
-                        else
-                        {    
-                            bool contained = false;
-
-                            // coarsest:
-                            if (_featureSource->getFeatureProfile()->getExtent().contains(GeoPoint(feature->getSRS(), c.x(), c.y())))
-                            {
-                                for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
-                                {
-                                    Ring* ring = dynamic_cast< Ring*>(itr->get()->getGeometry());
-                                    if (ring && ring->contains2D(c.x(), c.y()))
-                                    {                             
-                                        contained = true;
-                                        break;
-                                    }
-                                }
-                            }
-                            if ( !contained )
-                            {
-                                output.push_back( feature );
-                            }
-                        }
-                    }
+                    output.push_back( candidates[i] );
                 }
             }
 
@@ -26,6 +26,9 @@
 #include <osgEarth/ImageUtils>
 #include <osgEarth/URI>
 #include <osgEarth/HeightFieldUtils>
+#include <osgEarth/ThreadingUtils>
+
+#include <OpenThreads/Thread>
 
 #include <osgDB/FileNameUtils>
 #include <osgDB/FileUtils>
@@ -35,6 +38,8 @@
 #include <osgDB/ImageOptions>
 
 #include <sstream>
+#include <limits>
+#include <climits>
 #include <stdlib.h>
 #include <memory.h>
 
@@ -680,7 +685,9 @@ public:
       _warpedDS(NULL),
       _options(options),
       _maxDataLevel(30),
-      _linearUnits(1.0)
+      _linearUnits(1.0),
+      _warpPolar(false),
+      _handleClock(0u)
     {
     }
 
@@ -688,6 +695,12 @@ public:
     {
         GDAL_SCOPED_LOCK;
 
+        // Close any per-thread dataset handles
+        for (unsigned i = 0; i < _handles.size(); ++i)
+        {
+            closeHandle(_handles[i]);
+        }
+
         // Close the _warpedDS dataset if :
         // - it exists
         // - and is different from _srcDS
@@ -825,6 +838,7 @@ public:
                         _srcDS = (GDALDataset*)GDALOpen(result.getString().c_str(), GA_ReadOnly );
                         if (_srcDS)
                         {
+                            _openName = result.getString();
                             OE_INFO << LC << INDENT << "Read VRT from cache!" << std::endl;
                         }
                     }
@@ -841,6 +855,13 @@ public:
 
                     if (_srcDS)
                     {
+                        // The in-memory VRT has no file name, so reopen it from its XML.
+                        char** vrtXML = _srcDS->GetMetadata("xml:VRT");
+                        if (vrtXML && vrtXML[0])
+                        {
+                            _openName = vrtXML[0];
+                        }
+
                         //Cache the VRT so we don't have to build it next time.
                         if (_cacheBin)
                         {
@@ -886,6 +907,7 @@ public:
 
                 if (_srcDS)
                 {
+                    _openName = files[0];
 
                     char **subDatasets = _srcDS->GetMetadata( "SUBDATASETS");
                     int numSubDatasets = CSLCount( subDatasets );
@@ -900,6 +922,7 @@ public:
                         char *pszSubdatasetName = CPLStrdup( CSLFetchNameValue( subDatasets, buf.str().c_str() ) );
                         GDALClose( _srcDS );
                         _srcDS = (GDALDataset*)GDALOpen( pszSubdatasetName, GA_ReadOnly ) ;
+                        _openName = pszSubdatasetName;
                         CPLFree( pszSubdatasetName );
                     }
                 }
@@ -1030,27 +1053,12 @@ public:
 
         if ( requiresReprojection || (profile && !profile->getSRS()->isEquivalentTo( src_srs.get() )) )
         {
-            if ( profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar()) )
-            {
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    profile->getSRS()->getWKT().c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    NULL);
-            }
-            else
-            {
-                std::string destWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
-                _warpedDS = (GDALDataset*)GDALAutoCreateWarpedVRT(
-                    _srcDS,
-                    src_srs->getWKT().c_str(),
-                    destWKT.c_str(),
-                    GRA_NearestNeighbour,
-                    5.0,
-                    0);
-            }
+            // Remember the warp parameters so per-thread handles can recreate the same VRT.
+            _warpSrcWKT = src_srs->getWKT();
+            _warpPolar = profile && profile->getSRS()->isGeographic() && (src_srs->isNorthPolar() || src_srs->isSouthPolar());
+            _warpDestWKT = profile ? profile->getSRS()->getWKT() : src_srs->getWKT();
+
+            _warpedDS = createWarpedVRT(_srcDS);
 
             if ( _warpedDS )
             {
@@ -1226,6 +1234,18 @@ public:
 
         //Set the profile
         setProfile( profile );
+
+        // Set up the pool of per-thread dataset handles. An external dataset cannot
+        // be reopened, so in that case every read uses the shared handle under the lock.
+        unsigned maxHandles = _options.maxDatasetHandles().isSet() ?
+            _options.maxDatasetHandles().get() :
+            (unsigned)osg::maximum(1, OpenThreads::GetNumberOfProcessors());
+
+        if (!_openName.empty() && maxHandles > 0u)
+        {
+            _handles.resize(maxHandles);
+            OE_INFO << LC << "Using up to " << maxHandles << " dataset handles for concurrent reads" << std::endl;
+        }
         OE_DEBUG << LC << INDENT << "Set Profile to " << (profile ? profile->toString() : "NULL") <<  std::endl;
 
         return STATUS_OK;
@@ -1233,12 +1253,185 @@ public:
 
 
     /**
-    * Finds a raster band based on color interpretation
+    * Creates a warping VRT over the source dataset using the warp parameters
+    * established in initialize(). Caller must hold the GDAL lock.
     */
-    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    GDALDataset* createWarpedVRT(GDALDataset* srcDS) const
+    {
+        if (_warpPolar)
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRTforPolarStereographic(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                NULL);
+        }
+        else
+        {
+            return (GDALDataset*)GDALAutoCreateWarpedVRT(
+                srcDS,
+                _warpSrcWKT.c_str(),
+                _warpDestWKT.c_str(),
+                GRA_NearestNeighbour,
+                5.0,
+                0);
+        }
+    }
+
+    /**
+    * A private source dataset (and warping VRT, if any) that one thread at a
+    * time can read without holding the global GDAL lock.
+    */
+    struct DatasetHandle
+    {
+        DatasetHandle() : srcDS(0L), warpedDS(0L), threadId(0u), lastUsed(0u), inUse(false) { }
+        GDALDataset* srcDS;
+        GDALDataset* warpedDS;
+        unsigned     threadId;
+        unsigned     lastUsed;
+        bool         inUse;
+    };
+
+    bool openHandle(DatasetHandle& handle)
     {
+        // Opening datasets and creating warpers touches GDAL global state.
         GDAL_SCOPED_LOCK;
 
+        handle.srcDS = (GDALDataset*)GDALOpen(_openName.c_str(), GA_ReadOnly);
+        if (!handle.srcDS)
+            return false;
+
+        handle.warpedDS = _warpDestWKT.empty() ? handle.srcDS : createWarpedVRT(handle.srcDS);
+        if (!handle.warpedDS)
+        {
+            GDALClose(handle.srcDS);
+            handle.srcDS = 0L;
+            return false;
+        }
+        return true;
+    }
+
+    void closeHandle(DatasetHandle& handle)
+    {
+        GDAL_SCOPED_LOCK;
+        if (handle.warpedDS && handle.warpedDS != handle.srcDS)
+            GDALClose(handle.warpedDS);
+        if (handle.srcDS)
+            GDALClose(handle.srcDS);
+        handle.srcDS = 0L;
+        handle.warpedDS = 0L;
+    }
+
+    /**
+    * Checks out a dataset handle for the duration of a tile read. Each thread
+    * gets its own handle, opened lazily; once the pool is full, a thread takes
+    * over the least recently used idle handle. If every handle is busy (or the
+    * pool is disabled) the shared dataset is used under the global GDAL lock.
+    */
+    class ScopedDataset
+    {
+    public:
+        ScopedDataset(GDALTileSource* source) :
+            _source(source),
+            _handle(0L),
+            _dataset(0L)
+        {
+            if (!_source->_handles.empty())
+                acquire();
+
+            if (!_handle)
+            {
+                getGDALMutex().lock();
+                _dataset = _source->_warpedDS;
+            }
+        }
+
+        ~ScopedDataset()
+        {
+            if (_handle)
+            {
+                Threading::ScopedMutexLock lock(_source->_handlesMutex);
+                _handle->inUse = false;
+            }
+            else
+            {
+                getGDALMutex().unlock();
+            }
+        }
+
+        GDALDataset* get() const { return _dataset; }
+
+    private:
+        void acquire()
+        {
+            std::vector<DatasetHandle>& handles = _source->_handles;
+            unsigned threadId = Threading::getCurrentThreadId();
+            bool needsOpen = false;
+            {
+                Threading::ScopedMutexLock lock(_source->_handlesMutex);
+
+                DatasetHandle* empty = 0L;
+                DatasetHandle* lru = 0L;
+                for (unsigned i = 0; i < handles.size(); ++i)
+                {
+                    DatasetHandle& h = handles[i];
+                    if (h.inUse)
+                        continue;
+                    if (!h.srcDS)
+                    {
+                        if (!empty) empty = &h;
+                    }
+                    else if (h.threadId == threadId)
+                    {
+                        _handle = &h;
+                        break;
+                    }
+                    else if (!lru || h.lastUsed < lru->lastUsed)
+                    {
+                        lru = &h;
+                    }
+                }
+
+                if (!_handle)
+                {
+                    // prefer opening a new handle over stealing another thread's:
+                    _handle = empty ? empty : lru;
+                    needsOpen = (_handle == empty);
+                }
+
+                if (_handle)
+                {
+                    _handle->inUse = true;
+                    _handle->threadId = threadId;
+                    _handle->lastUsed = ++_source->_handleClock;
+                }
+            }
+
+            // Open outside the pool mutex so other threads can check out handles meanwhile.
+            if (_handle && needsOpen && !_source->openHandle(*_handle))
+            {
+                OE_WARN << LC << "Failed to open dataset handle; reads will be serialized" << std::endl;
+                Threading::ScopedMutexLock lock(_source->_handlesMutex);
+                _handle->inUse = false;
+                _handle = 0L;
+            }
+
+            if (_handle)
+                _dataset = _handle->warpedDS;
+        }
+
+        GDALTileSource* _source;
+        DatasetHandle*  _handle;
+        GDALDataset*    _dataset;
+    };
+
+    /**
+    * Finds a raster band based on color interpretation
+    */
+    static GDALRasterBand* findBandByColorInterp(GDALDataset *ds, GDALColorInterp colorInterp)
+    {
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetColorInterpretation() == colorInterp) return ds->GetRasterBand(i);
@@ -1248,8 +1441,6 @@ public:
 
     static GDALRasterBand* findBandByDataType(GDALDataset *ds, GDALDataType dataType)
     {
-        GDAL_SCOPED_LOCK;
-
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
             if (ds->GetRasterBand(i)->GetRasterDataType() == dataType) return ds->GetRasterBand(i);
@@ -1421,7 +1612,10 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        // Read through a dataset handle private to this thread instead of
+        // serializing on the global GDAL lock.
+        ScopedDataset dataset( this );
+        GDALDataset* warpedDS = dataset.get();
 
         int tileSize = getPixelsPerTile(); //_options.tileSize().value();
 
@@ -1486,8 +1680,8 @@ public:
         int height = (int)(src_max_y - src_min_y);
 
 
-        int rasterWidth = _warpedDS->GetRasterXSize();
-        int rasterHeight = _warpedDS->GetRasterYSize();
+        int rasterWidth = warpedDS->GetRasterXSize();
+        int rasterHeight = warpedDS->GetRasterYSize();
         if (off_x + width > rasterWidth || off_y + height > rasterHeight)
         {
             OE_WARN << LC << "Read window outside of bounds of dataset.  Source Dimensions=" << rasterWidth << "x" << rasterHeight << " Read Window=" << off_x << ", " << off_y << " " << width << "x" << height << std::endl;
@@ -1521,44 +1715,44 @@ public:
 
 
 
-        GDALRasterBand* bandRed = findBandByColorInterp(_warpedDS, GCI_RedBand);
-        GDALRasterBand* bandGreen = findBandByColorInterp(_warpedDS, GCI_GreenBand);
-        GDALRasterBand* bandBlue = findBandByColorInterp(_warpedDS, GCI_BlueBand);
-        GDALRasterBand* bandAlpha = findBandByColorInterp(_warpedDS, GCI_AlphaBand);
+        GDALRasterBand* bandRed = findBandByColorInterp(warpedDS, GCI_RedBand);
+        GDALRasterBand* bandGreen = findBandByColorInterp(warpedDS, GCI_GreenBand);
+        GDALRasterBand* bandBlue = findBandByColorInterp(warpedDS, GCI_BlueBand);
+        GDALRasterBand* bandAlpha = findBandByColorInterp(warpedDS, GCI_AlphaBand);
 
-        GDALRasterBand* bandGray = findBandByColorInterp(_warpedDS, GCI_GrayIndex);
+        GDALRasterBand* bandGray = findBandByColorInterp(warpedDS, GCI_GrayIndex);
 
-        GDALRasterBand* bandPalette = findBandByColorInterp(_warpedDS, GCI_PaletteIndex);
+        GDALRasterBand* bandPalette = findBandByColorInterp(warpedDS, GCI_PaletteIndex);
 
         if (!bandRed && !bandGreen && !bandBlue && !bandAlpha && !bandGray && !bandPalette)
         {
             OE_DEBUG << LC << "Could not determine bands based on color interpretation, using band count" << std::endl;
             //We couldn't find any valid bands based on the color interp, so just make an educated guess based on the number of bands in the file
             //RGB = 3 bands
-            if (_warpedDS->GetRasterCount() == 3)
+            if (warpedDS->GetRasterCount() == 3)
             {
-                bandRed   = _warpedDS->GetRasterBand( 1 );
-                bandGreen = _warpedDS->GetRasterBand( 2 );
-                bandBlue  = _warpedDS->GetRasterBand( 3 );
+                bandRed   = warpedDS->GetRasterBand( 1 );
+                bandGreen = warpedDS->GetRasterBand( 2 );
+                bandBlue  = warpedDS->GetRasterBand( 3 );
             }
             //RGBA = 4 bands
-            else if (_warpedDS->GetRasterCount() == 4)
+            else if (warpedDS->GetRasterCount() == 4)
             {
-                bandRed   = _warpedDS->GetRasterBand( 1 );
-                bandGreen = _warpedDS->GetRasterBand( 2 );
-                bandBlue  = _warpedDS->GetRasterBand( 3 );
-                bandAlpha = _warpedDS->GetRasterBand( 4 );
+                bandRed   = warpedDS->GetRasterBand( 1 );
+                bandGreen = warpedDS->GetRasterBand( 2 );
+                bandBlue  = warpedDS->GetRasterBand( 3 );
+                bandAlpha = warpedDS->GetRasterBand( 4 );
             }
             //Gray = 1 band
-            else if (_warpedDS->GetRasterCount() == 1)
+            else if (warpedDS->GetRasterCount() == 1)
             {
-                bandGray = _warpedDS->GetRasterBand( 1 );
+                bandGray = warpedDS->GetRasterBand( 1 );
             }
             //Gray + alpha = 2 bands
-            else if (_warpedDS->GetRasterCount() == 2)
+            else if (warpedDS->GetRasterCount() == 2)
             {
-                bandGray  = _warpedDS->GetRasterBand( 1 );
-                bandAlpha = _warpedDS->GetRasterBand( 2 );
+                bandGray  = warpedDS->GetRasterBand( 1 );
+                bandAlpha = warpedDS->GetRasterBand( 2 );
             }
         }
 
@@ -1855,7 +2049,7 @@ public:
         return image.release();
     }
 
-    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    float getBandNoDataValue(GDALRasterBand* band)
     {
         float bandNoData = -32767.0f;
         int success;
@@ -1864,7 +2058,16 @@ public:
         {
             bandNoData = value;
         }
+        return bandNoData;
+    }
 
+    bool isValidValue_noLock(float v, GDALRasterBand* band)
+    {
+        return isValidValue(v, getBandNoDataValue(band));
+    }
+
+    bool isValidValue(float v, float bandNoData)
+    {
         //Check to see if the value is equal to the bands specified no data
         if (bandNoData == v) return false;
         //Check to see if the value is equal to the user specified nodata value
@@ -1879,7 +2082,8 @@ public:
 
     bool isValidValue(float v, GDALRasterBand* band)
     {
-        GDAL_SCOPED_LOCK;
+        // The band belongs to a dataset handle owned by the calling thread
+        // (or is read under the global lock), so no locking is needed here.
         return isValidValue_noLock( v, band );
     }
 
@@ -2002,6 +2206,175 @@ public:
         return result;
     }
 
+    /**
+    * Converts a pixel coordinate to a sample coordinate (pixel centers at integers),
+    * snapping to the edge within half a pixel like getInterpolatedValue does.
+    * Returns false if the sample lies outside the raster.
+    */
+    static bool toSampleCoord(double& v, int size)
+    {
+        v -= 0.5;
+        if (v < 0 && v >= -0.5)
+            v = 0;
+        else if (v > size-1 && v <= size-0.5)
+            v = size-1;
+        return v >= 0 && v <= size-1;
+    }
+
+    /**
+    * Sample positions along one axis of the heightfield: the two source pixels
+    * bracketing each post (the same pixel when the post is on a pixel center)
+    * and the weight of the second one. Posts outside the raster have a negative
+    * first index.
+    */
+    struct SampleAxis
+    {
+        std::vector<int>   i0, i1;
+        std::vector<float> w;
+        int min, max;
+
+        void init(unsigned n) { i0.assign(n, -1); i1.assign(n, -1); w.assign(n, 0.0f); min = INT_MAX; max = -1; }
+
+        void set(unsigned i, double v, int size)
+        {
+            if (!toSampleCoord(v, size))
+                return;
+            i0[i] = (int)floor(v);
+            i1[i] = osg::minimum((int)ceil(v), size-1);
+            w[i]  = (float)(v - (double)i0[i]);
+            min = osg::minimum(min, i0[i]);
+            max = osg::maximum(max, i1[i]);
+        }
+
+        bool empty() const { return max < 0; }
+    };
+
+    /**
+    * Fills a heightfield by reading the source window that covers the tile once
+    * (with a one-pixel apron) and bilinearly interpolating every post from that
+    * buffer, rather than issuing four single-pixel RasterIO calls per post.
+    *
+    * Returns false if the transform is not axis-aligned or the window is too large
+    * to buffer (e.g. a low LOD over a large raster); the caller then falls back to
+    * per-post sampling.
+    */
+    bool sampleHeightField(GDALDataset* ds, GDALRasterBand* band,
+                           double xmin, double ymin, double xmax, double ymax,
+                           osg::HeightField* hf)
+    {
+        // The posts form a separable grid only when the transform has no rotation terms.
+        if (_invtransform[2] != 0.0 || _invtransform[4] != 0.0)
+            return false;
+
+        const int rasterWidth  = ds->GetRasterXSize();
+        const int rasterHeight = ds->GetRasterYSize();
+        const unsigned cols = hf->getNumColumns();
+        const unsigned rows = hf->getNumRows();
+
+        double dx = (xmax - xmin) / (cols-1);
+        double dy = (ymax - ymin) / (rows-1);
+
+        SampleAxis xAxis, yAxis;
+        xAxis.init(cols);
+        yAxis.init(rows);
+
+        double c, r;
+        for (unsigned i = 0; i < cols; ++i)
+        {
+            geoToPixel(xmin + dx*(double)i, ymin, c, r);
+            xAxis.set(i, c, rasterWidth);
+        }
+        for (unsigned j = 0; j < rows; ++j)
+        {
+            geoToPixel(xmin, ymin + dy*(double)j, c, r);
+            yAxis.set(j, r, rasterHeight);
+        }
+
+        std::vector<float>& heights = hf->getHeightList();
+
+        if (xAxis.empty() || yAxis.empty())
+        {
+            std::fill(heights.begin(), heights.end(), NO_DATA_VALUE);
+            return true;
+        }
+
+        // Covering window plus a one-pixel apron, clamped to the raster.
+        int winColMin = osg::maximum(xAxis.min - 1, 0);
+        int winColMax = osg::minimum(xAxis.max + 1, rasterWidth - 1);
+        int winRowMin = osg::maximum(yAxis.min - 1, 0);
+        int winRowMax = osg::minimum(yAxis.max + 1, rasterHeight - 1);
+        int winCols = winColMax - winColMin + 1;
+        int winRows = winRowMax - winRowMin + 1;
+
+        // Past a few source pixels per post the buffered read costs more than it saves.
+        if ((double)winCols * (double)winRows > 16.0 * (double)cols * (double)rows)
+            return false;
+
+        std::vector<float> buffer(winCols * winRows);
+        if (!rasterIO(band, GF_Read, winColMin, winRowMin, winCols, winRows, &buffer[0], winCols, winRows, GDT_Float32, 0, 0))
+            return false;
+
+        // Mark invalid source pixels with NaN so they propagate through the
+        // interpolation and any post touching one becomes NO_DATA.
+        const float bandNoData = getBandNoDataValue(band);
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        for (std::vector<float>::iterator v = buffer.begin(); v != buffer.end(); ++v)
+        {
+            if (!isValidValue(*v, bandNoData))
+                *v = nan;
+        }
+
+        // Rebase the column indices into the window once, for the inner loop.
+        for (unsigned i = 0; i < cols; ++i)
+        {
+            if (xAxis.i0[i] >= 0)
+            {
+                xAxis.i0[i] -= winColMin;
+                xAxis.i1[i] -= winColMin;
+            }
+        }
+
+        const float units = (float)_linearUnits;
+
+        for (unsigned j = 0; j < rows; ++j)
+        {
+            float* out = &heights[j*cols];
+
+            if (yAxis.i0[j] < 0)
+            {
+                std::fill(out, out + cols, NO_DATA_VALUE);
+                continue;
+            }
+
+            const float* row0 = &buffer[(yAxis.i0[j] - winRowMin) * winCols];
+            const float* row1 = &buffer[(yAxis.i1[j] - winRowMin) * winCols];
+            const float wy = yAxis.w[j];
+
+            for (unsigned i = 0; i < cols; ++i)
+            {
+                const int i0 = xAxis.i0[i];
+                if (i0 < 0)
+                {
+                    out[i] = NO_DATA_VALUE;
+                    continue;
+                }
+
+                const int i1 = xAxis.i1[i];
+                const float wx = xAxis.w[i];
+
+                // Bilinear; "average" uses the same weights. A NaN neighbor voids
+                // the post even at zero weight, as in getInterpolatedValue.
+                float h0 = row0[i0] + wx * (row0[i1] - row0[i0]);
+                float h1 = row1[i0] + wx * (row1[i1] - row1[i0]);
+                float h  = h0 + wy * (h1 - h0);
+
+                out[i] = (h == h) ? h * units : NO_DATA_VALUE;
+            }
+        }
+
+        return true;
+    }
+
     osg::HeightField* createHeightField( const TileKey&        key,
                                          ProgressCallback*     progress)
     {
@@ -2011,7 +2384,8 @@ public:
             return NULL;
         }
 
-        GDAL_SCOPED_LOCK;
+        ScopedDataset dataset( this );
+        GDALDataset* warpedDS = dataset.get();
 
         int tileSize = getPixelsPerTile();
 
@@ -2026,11 +2400,11 @@ public:
             key.getExtent().getBounds(xmin, ymin, xmax, ymax);
 
             // Try to find a FLOAT band
-            GDALRasterBand* band = findBandByDataType(_warpedDS, GDT_Float32);
+            GDALRasterBand* band = findBandByDataType(warpedDS, GDT_Float32);
             if (band == NULL)
             {
                 // Just get first band
-                band = _warpedDS->GetRasterBand(1);
+                band = warpedDS->GetRasterBand(1);
             }
 
             if (_options.interpolation() == INTERP_NEAREST)
@@ -2049,9 +2423,9 @@ public:
                 int iNumRows = iRowMax - iRowMin + 1;
 
                 int iWinColMin = max(0, iColMin);
-                int iWinColMax = min(_warpedDS->GetRasterXSize()-1, iColMax);
+                int iWinColMax = min(warpedDS->GetRasterXSize()-1, iColMax);
                 int iWinRowMin = max(0, iRowMin);
-                int iWinRowMax = min(_warpedDS->GetRasterYSize()-1, iRowMax);
+                int iWinRowMax = min(warpedDS->GetRasterYSize()-1, iRowMax);
                 int iNumWinCols = iWinColMax - iWinColMin + 1;
                 int iNumWinRows = iWinRowMax - iWinRowMin + 1;
 
@@ -2075,7 +2449,7 @@ public:
                     }
                 }
             }
-            else
+            else if (!sampleHeightField(warpedDS, band, xmin, ymin, xmax, ymax, hf.get()))
             {
                 double dx = (xmax - xmin) / (tileSize-1);
                 double dy = (ymax - ymin) / (tileSize-1);
@@ -2119,6 +2493,16 @@ private:
 
     const GDALOptions _options;
 
+    // How to reopen the source for per-thread handles; empty if it cannot be reopened
+    std::string _openName;
+    std::string _warpSrcWKT;
+    std::string _warpDestWKT;
+    bool        _warpPolar;
+
+    std::vector<DatasetHandle> _handles;
+    Threading::Mutex           _handlesMutex;
+    unsigned                   _handleClock;
+
     osg::ref_ptr< CacheBin > _cacheBin;
     osg::ref_ptr< osgDB::Options > _dbOptions;
 
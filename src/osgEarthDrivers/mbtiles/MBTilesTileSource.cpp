@@ -24,7 +24,11 @@
 
 #include <osgEarth/Registry>
 #include <osgEarth/ImageUtils>
+#include <osgEarth/IOTypes>
+#include <osgEarth/StringUtils>
 #include <osgDB/FileUtils>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Condition>
 
 #include <sstream>
 #include <iomanip>
@@ -53,21 +57,353 @@ namespace
         }
         return rw;
     }
+
+    const char* SELECT_TILE_SQL = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
+
+    const char* INSERT_TILE_SQL = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
+
+    // With the deduplicated schema, each distinct tile is stored once in
+    // "images" under its content hash, and "map" points the tile keys at it.
+    const char* INSERT_IMAGE_SQL = "INSERT OR IGNORE INTO images (tile_id, tile_data) VALUES (?, ?)";
+
+    const char* INSERT_MAP_SQL = "INSERT OR REPLACE INTO map (zoom_level, tile_column, tile_row, tile_id) VALUES (?, ?, ?, ?)";
+
+    const char* SELECT_MAP_SQL = "SELECT tile_id FROM map WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?";
+
+    // An image is orphaned when every tile that used it is rewritten.
+    const char* DELETE_ORPHANS_SQL = "DELETE FROM images WHERE tile_id NOT IN (SELECT tile_id FROM map)";
+
+    // Unique index on the tile keys, in either schema
+    const char* tileIndexName(bool deduplicate)
+    {
+        return deduplicate ? "map_index" : "tile_index";
+    }
+
+    // How long a read waits on a writer's lock before giving up
+    const int READ_BUSY_TIMEOUT_MS = 5000;
+
+    // Page size for a database created for bulk writes. Tiles are much
+    // bigger than the default page, so larger pages shorten their
+    // overflow chains.
+    const int BULK_PAGE_SIZE = 16384;
+
+    // Longest a queued tile waits for its transaction, in bulk write mode
+    const unsigned BULK_COMMIT_INTERVAL_MS = 1000u;
+
+    bool exec(sqlite3* db, const std::string& sql)
+    {
+        char* errorMsg = 0L;
+        if ( SQLITE_OK != sqlite3_exec(db, sql.c_str(), 0L, 0L, &errorMsg) )
+        {
+            OE_WARN << LC << "Failed query: " << sql << "; " << (errorMsg ? errorMsg : "") << std::endl;
+            sqlite3_free( errorMsg );
+            return false;
+        }
+        return true;
+    }
+
+    bool prepare(sqlite3* db, const char* sql, sqlite3_stmt** stmt)
+    {
+        if ( SQLITE_OK != sqlite3_prepare_v2(db, sql, -1, stmt, 0L) )
+        {
+            OE_WARN << LC << "Failed to prepare SQL: " << sql << "; " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Prepared statements that store a tile in either schema.
+     */
+    struct TileInsert
+    {
+        sqlite3*      _db;
+        sqlite3_stmt* _tiles;
+        sqlite3_stmt* _images;
+        sqlite3_stmt* _map;
+        sqlite3_stmt* _previous;
+        bool          _orphaned;   // a rewritten tile may have left an unused image
+
+        // Rewrites are only detected with the key index in place; without
+        // it the lookup is a full scan, and the index build collects the
+        // orphans instead.
+        TileInsert(sqlite3* db, bool deduplicate, bool indexed) :
+            _db(db), _tiles(0L), _images(0L), _map(0L), _previous(0L), _orphaned(false)
+        {
+            if ( deduplicate )
+            {
+                prepare(_db, INSERT_IMAGE_SQL, &_images);
+                prepare(_db, INSERT_MAP_SQL, &_map);
+                if ( indexed )
+                    prepare(_db, SELECT_MAP_SQL, &_previous);
+            }
+            else
+            {
+                prepare(_db, INSERT_TILE_SQL, &_tiles);
+            }
+        }
+
+        ~TileInsert()
+        {
+            sqlite3_finalize( _tiles );
+            sqlite3_finalize( _images );
+            sqlite3_finalize( _map );
+            sqlite3_finalize( _previous );
+        }
+
+        bool valid() const
+        {
+            return _tiles != 0L || (_images != 0L && _map != 0L);
+        }
+
+        /** Stores one tile; returns the sqlite result code (SQLITE_DONE on success). */
+        int insert(int z, int x, int y, const std::string& data)
+        {
+            if ( _tiles )
+            {
+                sqlite3_bind_int ( _tiles, 1, z );
+                sqlite3_bind_int ( _tiles, 2, x );
+                sqlite3_bind_int ( _tiles, 3, y );
+                sqlite3_bind_blob( _tiles, 4, data.data(), data.size(), SQLITE_STATIC );
+                int rc = sqlite3_step( _tiles );
+                sqlite3_reset( _tiles );
+                return rc;
+            }
+
+            // the image goes in first, so a reader never finds a key
+            // without its content.
+            std::string id = hashContent( data.data(), data.size() );
+
+            sqlite3_bind_text( _images, 1, id.data(), id.size(), SQLITE_STATIC );
+            sqlite3_bind_blob( _images, 2, data.data(), data.size(), SQLITE_STATIC );
+            int rc = sqlite3_step( _images );
+            sqlite3_reset( _images );
+            if ( rc != SQLITE_DONE )
+                return rc;
+
+            if ( _previous && !_orphaned )
+            {
+                sqlite3_bind_int( _previous, 1, z );
+                sqlite3_bind_int( _previous, 2, x );
+                sqlite3_bind_int( _previous, 3, y );
+                if ( sqlite3_step(_previous) == SQLITE_ROW )
+                {
+                    const char* previous = (const char*)sqlite3_column_text( _previous, 0 );
+                    _orphaned = previous == 0L || id != previous;
+                }
+                sqlite3_reset( _previous );
+            }
+
+            sqlite3_bind_int ( _map, 1, z );
+            sqlite3_bind_int ( _map, 2, x );
+            sqlite3_bind_int ( _map, 3, y );
+            sqlite3_bind_text( _map, 4, id.data(), id.size(), SQLITE_STATIC );
+            rc = sqlite3_step( _map );
+            sqlite3_reset( _map );
+            return rc;
+        }
+
+        const char* sql() const
+        {
+            return _tiles ? INSERT_TILE_SQL : INSERT_MAP_SQL;
+        }
+    };
 }
 
 //......................................................................
 
+/**
+ * Funnels encoded tiles from any number of threads into one thread that
+ * inserts them in large transactions.
+ */
+class MBTilesTileSource::BulkWriter : public OpenThreads::Thread
+{
+public:
+    BulkWriter(sqlite3* db, Threading::Mutex& dbMutex, unsigned batchSize, bool deduplicate, bool indexed) :
+      _db       ( db ),
+      _dbMutex  ( dbMutex ),
+      _batchSize( osg::maximum(batchSize, 1u) ),
+      _insert   ( db, deduplicate, indexed ),
+      _done     ( false ),
+      _numFailed( 0u )
+    {
+        //nop
+    }
+
+    /** Queues a tile, blocking while the queue is full. Takes the data. */
+    bool push(int z, int x, int y, std::string& data)
+    {
+        Threading::ScopedMutexLock lock(_mutex);
+
+        // allow two batches in the queue: one filling, one waiting
+        while ( _queue.size() >= 2u*_batchSize && !_done )
+            _rowsTaken.wait( &_mutex );
+
+        if ( _done || !_insert.valid() )
+            return false;
+
+        _queue.push_back( Row() );
+        Row& row = _queue.back();
+        row._z = z;
+        row._x = x;
+        row._y = y;
+        row._data.swap( data );
+
+        if ( _queue.size() >= _batchSize )
+            _rowsQueued.signal();
+
+        return true;
+    }
+
+    /** Commits everything queued and stops the thread. */
+    void stop()
+    {
+        {
+            Threading::ScopedMutexLock lock(_mutex);
+            _done = true;
+            _rowsQueued.signal();
+            _rowsTaken.broadcast();
+        }
+        join();
+
+        if ( _numFailed > 0u )
+        {
+            OE_WARN << LC << "Failed to write " << _numFailed << " tile(s)" << std::endl;
+        }
+    }
+
+    /** Whether a rewritten tile may have left an unused image; valid after stop(). */
+    bool orphanedImages() const
+    {
+        return _insert._orphaned;
+    }
+
+    void run()
+    {
+        std::vector<Row> batch;
+        while( true )
+        {
+            {
+                Threading::ScopedMutexLock lock(_mutex);
+                if ( _queue.size() < _batchSize && !_done )
+                    _rowsQueued.wait( &_mutex, BULK_COMMIT_INTERVAL_MS );
+
+                if ( _queue.empty() && _done )
+                    break;
+
+                batch.swap( _queue );
+                _rowsTaken.broadcast();
+            }
+
+            if ( !batch.empty() )
+            {
+                write( batch );
+                batch.clear();
+            }
+        }
+    }
+
+private:
+    struct Row
+    {
+        int         _z, _x, _y;
+        std::string _data;
+    };
+
+    void write(const std::vector<Row>& batch)
+    {
+        Threading::ScopedMutexLock lock(_dbMutex);
+
+        if ( !exec(_db, "BEGIN TRANSACTION") )
+        {
+            _numFailed += batch.size();
+            return;
+        }
+
+        unsigned failed = 0u;
+        for(std::vector<Row>::const_iterator row = batch.begin(); row != batch.end(); ++row)
+        {
+            if ( _insert.insert(row->_z, row->_x, row->_y, row->_data) != SQLITE_DONE )
+            {
+                if ( failed++ == 0u )
+                {
+                    OE_WARN << LC << "Failed query: " << _insert.sql() << "; " << sqlite3_errmsg(_db) << std::endl;
+                }
+            }
+        }
+
+        if ( !exec(_db, "COMMIT TRANSACTION") )
+        {
+            exec(_db, "ROLLBACK TRANSACTION");
+            failed = batch.size();
+        }
+
+        _numFailed += failed;
+    }
+
+    sqlite3*               _db;
+    Threading::Mutex&      _dbMutex;
+    unsigned               _batchSize;
+    TileInsert             _insert;
+    std::vector<Row>       _queue;
+    bool                   _done;
+    unsigned               _numFailed;   // written by the writer thread only
+    Threading::Mutex       _mutex;
+    OpenThreads::Condition _rowsQueued;
+    OpenThreads::Condition _rowsTaken;
+};
+
+//......................................................................
+
 MBTilesTileSource::MBTilesTileSource(const TileSourceOptions& options) :
 TileSource( options ),
 _options  ( options ),
 _database ( NULL ),
 _minLevel ( 0 ),
 _maxLevel ( 20 ),
-_forceRGB ( false )
+_forceRGB ( false ),
+_writer   ( 0L ),
+_deferredIndex( false ),
+_deduplicate( false ),
+_orphanedImages( false )
 {
     //nop
 }
 
+MBTilesTileSource::~MBTilesTileSource()
+{
+    // commit the queued tiles, then build the index we put off.
+    if ( _writer )
+    {
+        _writer->stop();
+        _orphanedImages = _orphanedImages || _writer->orphanedImages();
+        delete _writer;
+        _writer = 0L;
+    }
+
+    if ( _deferredIndex )
+    {
+        createTileIndex();
+    }
+    else if ( _orphanedImages )
+    {
+        Threading::ScopedMutexLock exclusiveLock(_mutex);
+        exec(_database, DELETE_ORPHANS_SQL);
+    }
+
+    for(unsigned i=0; i<_readConnections.size(); ++i)
+    {
+        sqlite3_finalize( _readConnections[i]->_selectTile );
+        sqlite3_close( _readConnections[i]->_db );
+        delete _readConnections[i];
+    }
+
+    if ( _database )
+    {
+        sqlite3_close( _database );
+    }
+}
+
 Status
 MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 {
@@ -85,6 +421,8 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
 
     bool isNewDatabase = readWrite && !osgDB::fileExists(fullFilename);
 
+    _fullFilename = fullFilename;
+
     if ( isNewDatabase )
     {
         // For a NEW database, the profile MUST be set prior to initialization.
@@ -120,11 +458,43 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
             << "Database \"" << fullFilename << "\": " << sqlite3_errmsg(_database) );
     }
 
+    bool bulkWrite = readWrite && _options.bulkWrite() == true;
+
+    // The page size can only change before anything is written.
+    if ( isNewDatabase && bulkWrite )
+    {
+        exec(_database, Stringify() << "PRAGMA page_size=" << BULK_PAGE_SIZE);
+    }
+
+    // Write-ahead logging lets the pooled read connections keep reading
+    // while tiles are being written.
+    if ( readWrite )
+    {
+        if ( SQLITE_OK != sqlite3_exec(_database, "PRAGMA journal_mode=WAL", 0L, 0L, 0L) )
+        {
+            OE_INFO << LC << "Failed to enable WAL mode; reads may wait on writes" << std::endl;
+        }
+
+        sqlite3_busy_timeout( _database, READ_BUSY_TIMEOUT_MS );
+    }
+
+    // With WAL, a commit only needs to sync at checkpoints to be durable
+    // against application crashes; that's plenty for a bulk load.
+    if ( bulkWrite )
+    {
+        exec(_database, "PRAGMA synchronous=NORMAL");
+    }
+
     // New database setup:
     if ( isNewDatabase )
     {
-        // create necessary db tables:
+        // create necessary db tables. A bulk load is faster without the
+        // index, so build it at the end.
+        _deferredIndex = bulkWrite;
+        _deduplicate = _options.deduplicate() == true;
         createTables();
+        if ( !_deferredIndex )
+            createTileIndex();
 
         // write profile to metadata:
         std::string profileJSON = getProfile()->toProfileOptions().getConfig().toJSON(false);
@@ -165,6 +535,24 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
     // If the database pre-existed, read in the information from the metadata.
     else // !isNewDatabase
     {
+        // keep writing in whichever schema the database was created with.
+        _deduplicate = hasTable("map") && hasTable("images");
+
+        // A bulk load that never closed left the index unbuilt (and maybe
+        // duplicate rows); finish the job.
+        if ( !hasTable(tileIndexName(_deduplicate)) )
+        {
+            if ( readWrite )
+            {
+                OE_INFO << LC << "Database has no tile index; building it" << std::endl;
+                createTileIndex();
+            }
+            else
+            {
+                OE_INFO << LC << "Database has no tile index; reads will be slow until it is opened for writing" << std::endl;
+            }
+        }
+
         if ( _options.computeLevels() == true )
         {
             computeLevels();
@@ -285,6 +673,12 @@ MBTilesTileSource::initialize(const osgDB::Options* dbOptions)
     unsigned char *data = _emptyImage->data(0,0);
     memset(data, 0, 4 * size * size);
 
+    if ( bulkWrite )
+    {
+        _writer = new BulkWriter(_database, _mutex, _options.writeBatchSize().get(), _deduplicate, !_deferredIndex);
+        _writer->start();
+    }
+
     return STATUS_OK;
 }
 
@@ -299,12 +693,61 @@ MBTilesTileSource::getCachePolicyHint(const Profile* targetProfile) const
 }
 
 
+MBTilesTileSource::ReadConnection*
+MBTilesTileSource::acquireReadConnection()
+{
+    {
+        Threading::ScopedMutexLock lock(_readPoolMutex);
+        if ( !_readPool.empty() )
+        {
+            ReadConnection* conn = _readPool.back();
+            _readPool.pop_back();
+            return conn;
+        }
+    }
+
+    // None idle; open another one. Each connection is only ever used by
+    // one thread at a time, so sqlite's own mutexing is unnecessary.
+    sqlite3* db = 0L;
+    int rc = sqlite3_open_v2( _fullFilename.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, 0L );
+    if ( rc != SQLITE_OK )
+    {
+        OE_WARN << LC << "Failed to open \"" << _fullFilename << "\" for reading: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close( db );
+        return 0L;
+    }
+
+    sqlite3_busy_timeout( db, READ_BUSY_TIMEOUT_MS );
+
+    sqlite3_stmt* select = 0L;
+    rc = sqlite3_prepare_v2( db, SELECT_TILE_SQL, -1, &select, 0L );
+    if ( rc != SQLITE_OK )
+    {
+        OE_WARN << LC << "Failed to prepare SQL: " << SELECT_TILE_SQL << "; " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close( db );
+        return 0L;
+    }
+
+    ReadConnection* conn = new ReadConnection();
+    conn->_db = db;
+    conn->_selectTile = select;
+
+    Threading::ScopedMutexLock lock(_readPoolMutex);
+    _readConnections.push_back( conn );
+    return conn;
+}
+
+void
+MBTilesTileSource::releaseReadConnection(ReadConnection* conn)
+{
+    Threading::ScopedMutexLock lock(_readPoolMutex);
+    _readPool.push_back( conn );
+}
+
 osg::Image*
 MBTilesTileSource::createImage(const TileKey&    key,
                                ProgressCallback* progress)
 {
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     int z = key.getLevelOfDetail();
     int x = key.getTileX();
     int y = key.getTileY();
@@ -324,78 +767,67 @@ MBTilesTileSource::createImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
-    //Get the image
-    sqlite3_stmt* select = NULL;
-    std::string query = "SELECT tile_data from tiles where zoom_level = ? AND tile_column = ? AND tile_row = ?";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &select, 0L );
-    if ( rc != SQLITE_OK )
-    {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
+    // No lock is held from here on; this thread has the connection to itself.
+    ReadConnection* conn = acquireReadConnection();
+    if ( !conn )
         return NULL;
-    }
-
-    bool valid = true;
 
+    sqlite3_stmt* select = conn->_selectTile;
     sqlite3_bind_int( select, 1, z );
     sqlite3_bind_int( select, 2, x );
     sqlite3_bind_int( select, 3, y );
 
     osg::Image* result = NULL;
-    rc = sqlite3_step( select );
+    int rc = sqlite3_step( select );
     if ( rc == SQLITE_ROW)
     {
-        // the pointer returned from _blob gets freed internally by sqlite, supposedly
+        // The blob stays valid until the statement is reset, so decode
+        // straight from it.
         const char* data = (const char*)sqlite3_column_blob( select, 0 );
         int dataLen = sqlite3_column_bytes( select, 0 );
 
-        std::string dataBuffer( data, dataLen );
-
-        // decompress if necessary:
-        if ( _compressor.valid() )
+        if ( data && dataLen > 0 )
         {
-            std::istringstream inputStream(dataBuffer);
-            std::string value;
-            if ( !_compressor->decompress(inputStream, value) )
+            MemoryStreamBuffer blobBuf(data, dataLen);
+            std::istream blobStream(&blobBuf);
+
+            // decompress if necessary:
+            if ( _compressor.valid() )
             {
-                if ( _options.filename().isSet() )
-                    OE_WARN << LC << "Decompression failed: " << _options.filename()->base() << std::endl;
+                std::string value;
+                if ( !_compressor->decompress(blobStream, value) )
+                {
+                    if ( _options.filename().isSet() )
+                        OE_WARN << LC << "Decompression failed: " << _options.filename()->base() << std::endl;
+                    else
+                        OE_WARN << LC << "Decompression failed" << std::endl;
+                }
                 else
-                    OE_WARN << LC << "Decompression failed" << std::endl;
-                valid = false;
+                {
+                    MemoryStreamBuffer valueBuf(value.data(), value.size());
+                    std::istream valueStream(&valueBuf);
+                    result = ImageUtils::readStream(valueStream, _dbOptions.get());
+                }
             }
             else
             {
-                dataBuffer = value;
+                result = ImageUtils::readStream(blobStream, _dbOptions.get());
             }
         }
-
-        // decode the raw image data:
-        if ( valid )
-        {
-            std::istringstream inputStream(dataBuffer);
-            result = ImageUtils::readStream(inputStream, _dbOptions.get());
-        }
     }
     else
     {
-        OE_DEBUG << LC << "SQL QUERY failed for " << query << ": " << std::endl;
-        valid = false;
+        OE_DEBUG << LC << "SQL QUERY failed for " << SELECT_TILE_SQL << ": " << std::endl;
     }
 
-    sqlite3_finalize( select );
+    sqlite3_reset( select );
+    releaseReadConnection( conn );
     return result;
 }
 
 bool
-MBTilesTileSource::storeImage(const TileKey&    key,
-                              osg::Image*       image,
-                              ProgressCallback* progress)
+MBTilesTileSource::encodeTile(osg::Image* image, std::string& out)
 {
-    if ( (getMode() & MODE_WRITE) == 0 )
-        return false;
-
-    Threading::ScopedMutexLock exclusiveLock(_mutex);
-
     // encode the data stream:
     std::stringstream buf;
     osgDB::ReaderWriter::WriteResult wr;
@@ -415,20 +847,37 @@ MBTilesTileSource::storeImage(const TileKey&    key,
         return false;
     }
 
-    std::string value = buf.str();
+    out = buf.str();
 
     // compress if necessary:
     if ( _compressor.valid() )
     {
         std::ostringstream output;
-        if ( !_compressor->compress(output, value) )
+        if ( !_compressor->compress(output, out) )
         {
             OE_WARN << LC << "Compressor failed" << std::endl;
             return false;
         }
-        value = output.str();
+        out = output.str();
     }
 
+    return true;
+}
+
+bool
+MBTilesTileSource::storeImage(const TileKey&    key,
+                              osg::Image*       image,
+                              ProgressCallback* progress)
+{
+    if ( (getMode() & MODE_WRITE) == 0 )
+        return false;
+
+    // Encoding and compression happen on the calling thread, outside
+    // the lock, so concurrent writers encode in parallel.
+    std::string value;
+    if ( !encodeTile(image, value) )
+        return false;
+
     int z = key.getLOD();
     int x = key.getTileX();
     int y = key.getTileY();
@@ -438,47 +887,60 @@ MBTilesTileSource::storeImage(const TileKey&    key,
     key.getProfile()->getNumTiles(key.getLevelOfDetail(), numCols, numRows);
     y  = numRows - y - 1;
 
-    // Prep the insert statement:
-    sqlite3_stmt* insert = NULL;
-    std::string query = "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)";
-    int rc = sqlite3_prepare_v2( _database, query.c_str(), -1, &insert, 0L );
-    if ( rc != SQLITE_OK )
+    // in bulk mode the writer thread takes it from here.
+    if ( _writer )
     {
-        OE_WARN << LC << "Failed to prepare SQL: " << query << "; " << sqlite3_errmsg(_database) << std::endl;
-        return false;
+        return _writer->push(z, x, y, value);
     }
 
-    // bind parameters:
-    sqlite3_bind_int( insert, 1, z );
-    sqlite3_bind_int( insert, 2, x );
-    sqlite3_bind_int( insert, 3, y );
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
 
-    // bind the data blob:
-    sqlite3_bind_blob( insert, 4, value.c_str(), value.length(), SQLITE_STATIC );
+    // Prep the insert statement(s):
+    TileInsert insert( _database, _deduplicate, !_deferredIndex );
+    if ( !insert.valid() )
+        return false;
 
     // run the sql.
     bool ok = true;
+    int rc;
     int tries = 0;
     do {
-        rc = sqlite3_step(insert);
+        rc = insert.insert(z, x, y, value);
     }
     while (++tries < 100 && (rc == SQLITE_BUSY || rc == SQLITE_LOCKED));
 
     if (SQLITE_OK != rc && SQLITE_DONE != rc)
     {
 #if SQLITE_VERSION_NUMBER >= 3007015
-        OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(_database) << std::endl;
+        OE_WARN << LC << "Failed query: " << insert.sql() << "(" << rc << ")" << sqlite3_errstr(rc) << "; " << sqlite3_errmsg(_database) << std::endl;
 #else
-        OE_WARN << LC << "Failed query: " << query << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(_database) << std::endl;
+        OE_WARN << LC << "Failed query: " << insert.sql() << "(" << rc << ")" << rc << "; " << sqlite3_errmsg(_database) << std::endl;
 #endif
         ok = false;
     }
 
-    sqlite3_finalize( insert );
+    _orphanedImages = _orphanedImages || insert._orphaned;
 
     return ok;
 }
 
+bool
+MBTilesTileSource::hasTable(const std::string& name)
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    sqlite3_stmt* select = 0L;
+    if ( !prepare(_database, "SELECT count(*) FROM sqlite_master WHERE name = ?", &select) )
+        return false;
+
+    sqlite3_bind_text( select, 1, name.c_str(), name.length(), SQLITE_STATIC );
+
+    bool found = sqlite3_step(select) == SQLITE_ROW && sqlite3_column_int(select, 0) > 0;
+
+    sqlite3_finalize( select );
+    return found;
+}
+
 bool
 MBTilesTileSource::getMetaData(const std::string& key, std::string& value)
 {
@@ -599,6 +1061,42 @@ MBTilesTileSource::createTables()
         return false;
     }
 
+    if ( _deduplicate )
+    {
+        // "tiles" becomes a view over the split tables, so readers that
+        // only know the basic schema still work.
+        // The unique index on images can't wait for the end of a bulk
+        // load, since it's what makes a repeated image insert a no-op.
+        const char* split[] = {
+            "CREATE TABLE IF NOT EXISTS map ("
+            " zoom_level integer,"
+            " tile_column integer,"
+            " tile_row integer,"
+            " tile_id text)",
+
+            "CREATE TABLE IF NOT EXISTS images ("
+            " tile_id text,"
+            " tile_data blob)",
+
+            "CREATE UNIQUE INDEX IF NOT EXISTS images_id ON images (tile_id)",
+
+            "CREATE VIEW IF NOT EXISTS tiles AS SELECT"
+            " map.zoom_level AS zoom_level,"
+            " map.tile_column AS tile_column,"
+            " map.tile_row AS tile_row,"
+            " images.tile_data AS tile_data"
+            " FROM map JOIN images ON images.tile_id = map.tile_id"
+        };
+
+        for(unsigned i=0; i<sizeof(split)/sizeof(split[0]); ++i)
+        {
+            if ( !exec(_database, split[i]) )
+                return false;
+        }
+
+        return true;
+    }
+
     query =
         "CREATE TABLE IF NOT EXISTS tiles ("
         " zoom_level integer,"
@@ -615,20 +1113,47 @@ MBTilesTileSource::createTables()
         return false;
     }
 
-    // create an index
-    query =
-        "CREATE UNIQUE INDEX tile_index ON tiles ("
+    // TODO: support "grids" and "grid_data" tables if necessary.
+
+    return true;
+}
+
+bool
+MBTilesTileSource::createTileIndex()
+{
+    Threading::ScopedMutexLock exclusiveLock(_mutex);
+
+    // with the deduplicated schema, the keys live in "map".
+    std::string table = _deduplicate ? "map" : "tiles";
+
+    std::string query = Stringify() <<
+        "CREATE UNIQUE INDEX IF NOT EXISTS " << tileIndexName(_deduplicate) << " ON " << table << " ("
         " zoom_level, tile_column, tile_row)";
 
+    char* errorMsg = 0L;
+
     if (SQLITE_OK != sqlite3_exec(_database, query.c_str(), 0L, 0L, &errorMsg))
     {
-        OE_WARN << LC << "Failed to create index on table [tiles]: " << errorMsg << std::endl;
         sqlite3_free( errorMsg );
-        // keep going...
-        // return false;
-    }
 
-    // TODO: support "grids" and "grid_data" tables if necessary.
+        // Without the index, a tile written twice during a bulk load left
+        // two rows. Keep the newest one and try again.
+        std::string dedupe = Stringify() <<
+            "DELETE FROM " << table << " WHERE rowid NOT IN ("
+            " SELECT max(rowid) FROM " << table << " GROUP BY zoom_level, tile_column, tile_row)";
+
+        if (SQLITE_OK != sqlite3_exec(_database, dedupe.c_str(), 0L, 0L, 0L) ||
+            SQLITE_OK != sqlite3_exec(_database, query.c_str(), 0L, 0L, &errorMsg))
+        {
+            OE_WARN << LC << "Failed to create index on table [" << table << "]: " << (errorMsg ? errorMsg : "") << std::endl;
+            sqlite3_free( errorMsg );
+            return false;
+        }
+
+        // the rows dropped may have been the last users of their images.
+        if ( _deduplicate )
+            exec(_database, DELETE_ORPHANS_SQL);
+    }
 
     return true;
 }
@@ -78,8 +78,8 @@ CropFilter::push( FeatureList& input, FilterContext& context )
     {
 #ifdef OSGEARTH_HAVE_GEOS
 
-        // create the intersection polygon:
-        osg::ref_ptr<Symbology::Polygon> poly;
+        // create the intersection polygon, prepared once for all the features:
+        osg::ref_ptr<Symbology::PreparedCropPolygon> poly;
         
         for( FeatureList::iterator i = input.begin(); i != input.end();  )
         {
@@ -108,11 +108,12 @@ CropFilter::push( FeatureList& input, FilterContext& context )
                 {
                     if ( !poly.valid() )
                     {
-                        poly = new Symbology::Polygon();
-                        poly->push_back( osg::Vec3d( extent.xMin(), extent.yMin(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMax(), extent.yMin(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMax(), extent.yMax(), 0 ));
-                        poly->push_back( osg::Vec3d( extent.xMin(), extent.yMax(), 0 ));
+                        osg::ref_ptr<Symbology::Polygon> rect = new Symbology::Polygon();
+                        rect->push_back( osg::Vec3d( extent.xMin(), extent.yMin(), 0 ));
+                        rect->push_back( osg::Vec3d( extent.xMax(), extent.yMin(), 0 ));
+                        rect->push_back( osg::Vec3d( extent.xMax(), extent.yMax(), 0 ));
+                        rect->push_back( osg::Vec3d( extent.xMin(), extent.yMax(), 0 ));
+                        poly = new Symbology::PreparedCropPolygon( rect.get() );
                     }
 
                     osg::ref_ptr<Geometry> croppedGeometry;
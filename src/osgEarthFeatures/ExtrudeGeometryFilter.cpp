@@ -985,7 +985,21 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
     Random wallSkinPRNG( _wallSkinSymbol.valid()? *_wallSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
     Random roofSkinPRNG( _roofSkinSymbol.valid()? *_roofSkinSymbol->randomSeed() : 0, Random::METHOD_FAST );
 
-    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f )
+    // evaluate the height expression for all the features at once, unless
+    // a script may change the attributes along the way
+    std::vector<double> heights;
+    bool batchHeights =
+        !_heightCallback.valid() &&
+        _heightExpr.isSet() &&
+        !_extrusionSymbol->script().isSet();
+
+    if ( batchHeights )
+    {
+        Feature::evalBatch( _heightExpr.mutable_value(), features, &context, heights );
+    }
+
+    unsigned featureIndex = 0;
+    for( FeatureList::iterator f = features.begin(); f != features.end(); ++f, ++featureIndex )
     {
         Feature* input = f->get();
 
@@ -1029,6 +1043,10 @@ ExtrudeGeometryFilter::process( FeatureList& features, FilterContext& context )
             {
                 height = _heightCallback->operator()(input, context);
             }
+            else if ( batchHeights )
+            {
+                height = heights[featureIndex];
+            }
             else if ( _heightExpr.isSet() )
             {
                 height = input->eval( _heightExpr.mutable_value(), &context );
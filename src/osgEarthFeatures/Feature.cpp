@@ -17,6 +17,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
 #include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/FeatureBatch>
 #include <osgEarthFeatures/FilterContext>
 #include <osgEarthFeatures/GeometryUtils>
 #include <osgEarthFeatures/ScriptEngine>
@@ -168,7 +169,9 @@ AttributeValue::getBool( bool defaultValue ) const
 
 Feature::Feature( FeatureID fid ) :
 _fid( fid ),
-_srs( 0L )
+_srs( 0L ),
+_row( 0u ),
+_attrsCopied( false )
 //_cachedBoundingPolytopeValid( false )
 {
     //NOP
@@ -177,7 +180,9 @@ _srs( 0L )
 Feature::Feature( Geometry* geom, const SpatialReference* srs, const Style& style, FeatureID fid ) :
 _geom ( geom ),
 _srs  ( srs ),
-_fid  ( fid )
+_fid  ( fid ),
+_row  ( 0u ),
+_attrsCopied( false )
 {
     if ( !style.empty() )
         _style = style;
@@ -187,11 +192,18 @@ _fid  ( fid )
 
 Feature::Feature( const Feature& rhs, const osg::CopyOp& copyOp ) :
 _fid      ( rhs._fid ),
-_attrs    ( rhs._attrs ),
 _style    ( rhs._style ),
 _geoInterp( rhs._geoInterp ),
-_srs      ( rhs._srs.get() )
+_srs      ( rhs._srs.get() ),
+_batch    ( rhs._batch.get() ),
+_row      ( rhs._row ),
+_attrsCopied( false )
 {
+    // a batch row is copied from the batch when needed, since another
+    // thread may be copying it into rhs right now.
+    if ( !_batch.valid() )
+        _attrs = rhs._attrs;
+
     if ( rhs._geom.valid() )
         _geom = rhs._geom->clone();
 
@@ -247,9 +259,31 @@ Feature::dirty()
     //_cachedBoundingPolytopeValid = false;
 }
 
+void
+Feature::detach()
+{
+    if ( _batch.valid() )
+    {
+        if ( !_attrsCopied )
+            _batch->getAttrs( _row, _attrs );
+        _batch = 0L;
+        _attrsCopied = false;
+    }
+}
+
+const AttributeTable&
+Feature::getAttrs() const
+{
+    // keep the batch, so the named getters still read from it.
+    if ( _batch.valid() )
+        _batch->copyAttrs( _row, _attrs, _attrsCopied );
+    return _attrs;
+}
+
 void
 Feature::set( const std::string& name, const std::string& value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_STRING;
     a.second.stringValue = value;
@@ -259,6 +293,7 @@ Feature::set( const std::string& name, const std::string& value )
 void
 Feature::set( const std::string& name, double value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_DOUBLE;
     a.second.doubleValue = value;
@@ -268,6 +303,7 @@ Feature::set( const std::string& name, double value )
 void
 Feature::set( const std::string& name, int value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_INT;
     a.second.intValue = value;
@@ -277,12 +313,14 @@ Feature::set( const std::string& name, int value )
 void
 Feature::set( const std::string& name, const AttributeValue& value)
 {
+    detach();
     _attrs[ name ] = value;
 }
 
 void
 Feature::set( const std::string& name, bool value )
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.first = ATTRTYPE_BOOL;
     a.second.boolValue = value;
@@ -292,6 +330,7 @@ Feature::set( const std::string& name, bool value )
 void
 Feature::setNull( const std::string& name)
 {
+    detach();
     AttributeValue& a = _attrs[name];    
     a.second.set = false;
 }
@@ -299,6 +338,7 @@ Feature::setNull( const std::string& name)
 void
 Feature::setNull( const std::string& name, AttributeType type)
 {
+    detach();
     AttributeValue& a = _attrs[name];
     a.first = type;    
     a.second.set = false;
@@ -310,12 +350,22 @@ Feature::setNull( const std::string& name, AttributeType type)
 bool
 Feature::hasAttr( const std::string& name ) const
 {
+    if ( _batch.valid() )
+    {
+        int field = _batch->getFieldIndex(name);
+        return field >= 0 && _batch->hasAttr(_row, field);
+    }
     return _attrs.find(toLower(name)) != _attrs.end();
 }
 
 std::string
 Feature::getString( const std::string& name ) const
 {
+    if ( _batch.valid() )
+    {
+        int field = _batch->getFieldIndex(name);
+        return field >= 0 ? _batch->getString(_row, field) : EMPTY_STRING;
+    }
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getString() : EMPTY_STRING;
 }
@@ -323,6 +373,11 @@ Feature::getString( const std::string& name ) const
 double
 Feature::getDouble( const std::string& name, double defaultValue ) const 
 {
+    if ( _batch.valid() )
+    {
+        int field = _batch->getFieldIndex(name);
+        return field >= 0 ? _batch->getDouble(_row, field, defaultValue) : defaultValue;
+    }
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getDouble(defaultValue) : defaultValue;
 }
@@ -330,6 +385,11 @@ Feature::getDouble( const std::string& name, double defaultValue ) const
 int
 Feature::getInt( const std::string& name, int defaultValue ) const 
 {
+    if ( _batch.valid() )
+    {
+        int field = _batch->getFieldIndex(name);
+        return field >= 0 ? _batch->getInt(_row, field, defaultValue) : defaultValue;
+    }
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getInt(defaultValue) : defaultValue;
 }
@@ -337,6 +397,11 @@ Feature::getInt( const std::string& name, int defaultValue ) const
 bool
 Feature::getBool( const std::string& name, bool defaultValue ) const 
 {
+    if ( _batch.valid() )
+    {
+        int field = _batch->getFieldIndex(name);
+        return field >= 0 ? _batch->getBool(_row, field, defaultValue) : defaultValue;
+    }
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.getBool(defaultValue) : defaultValue;
 }
@@ -344,62 +409,141 @@ Feature::getBool( const std::string& name, bool defaultValue ) const
 bool
 Feature::isSet( const std::string& name) const
 {
+    if ( _batch.valid() )
+    {
+        int field = _batch->getFieldIndex(name);
+        return field >= 0 && _batch->isSet(_row, field);
+    }
     AttributeTable::const_iterator i = _attrs.find(toLower(name));
     return i != _attrs.end()? i->second.second.set : false;
 }
 
+bool
+Feature::getVariable(const std::string& name, int field, double& out) const
+{
+    if ( _batch.valid() )
+    {
+        if ( field < 0 || !_batch->hasAttr(_row, field) )
+            return false;
+        out = _batch->getDouble(_row, field, 0.0);
+        return true;
+    }
+
+    AttributeTable::const_iterator ai = _attrs.find(toLower(name));
+    if ( ai == _attrs.end() )
+        return false;
+    out = ai->second.getDouble(0.0);
+    return true;
+}
+
+bool
+Feature::getVariable(const std::string& name, int field, std::string& out) const
+{
+    if ( _batch.valid() )
+    {
+        if ( field < 0 || !_batch->hasAttr(_row, field) )
+            return false;
+        out = _batch->getString(_row, field);
+        return true;
+    }
+
+    AttributeTable::const_iterator ai = _attrs.find(toLower(name));
+    if ( ai == _attrs.end() )
+        return false;
+    out = ai->second.getString();
+    return true;
+}
+
 double
-Feature::eval( NumericExpression& expr, FilterContext const* context ) const
+Feature::getNumericVariable(NumericExpression& expr, unsigned i, const FilterContext* context) const
 {
-    const NumericExpression::Variables& vars = expr.variables();
-    for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
+    const NumericExpression::Variable& var = expr.variables()[i];
+
+    double val = 0.0;
+    int field = _batch.valid() ? expr.binding().fields[i] : -1;
+    if (!getVariable(var.first, field, val) && context && context->getSession())
     {
-      double val = 0.0;
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
+      //No attr found, look for script
+      ScriptEngine* engine = context->getSession()->getScriptEngine();
+      if (engine)
       {
-        val = ai->second.getDouble(0.0);
-      }
-      else if (context && context->getSession())
-      {
-        //No attr found, look for script
-        ScriptEngine* engine = context->getSession()->getScriptEngine();
-        if (engine)
-        {
-          ScriptResult result = engine->run(i->first, this, context);
-          if (result.success())
-            val = result.asDouble();
-          else {
-              OE_WARN << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
-          }
+        ScriptResult result = engine->run(var.first, this, context);
+        if (result.success())
+          val = result.asDouble();
+        else {
+            OE_WARN << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
         }
       }
+    }
+    return val;
+}
 
-      expr.set( *i, val); //osgEarth::as<double>(getAttr(i->first),0.0) );
+double
+Feature::eval( NumericExpression& expr, FilterContext const* context ) const
+{
+    const NumericExpression::Variables& vars = expr.variables();
+
+    // resolve the variables to batch fields once per schema
+    if ( _batch.valid() )
+        _batch->bind( vars, expr.binding() );
+
+    for( unsigned i = 0; i < vars.size(); ++i )
+    {
+      expr.set( vars[i], getNumericVariable(expr, i, context) );
     }
 
     return expr.eval();
 }
 
+void
+Feature::evalBatch(NumericExpression& expr, const FeatureList& features, const FilterContext* context, std::vector<double>& out)
+{
+    const NumericExpression::Variables& vars = expr.variables();
+    unsigned count = features.size();
+
+    out.resize( count );
+    if ( count == 0 )
+        return;
+
+    // one column of values per variable
+    std::vector<double> values( vars.size() * count );
+    unsigned row = 0;
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++row )
+    {
+        const Feature* feature = f->get();
+        if ( feature->_batch.valid() )
+            feature->_batch->bind( vars, expr.binding() );
+
+        for( unsigned i = 0; i < vars.size(); ++i )
+            values[i*count + row] = feature->getNumericVariable( expr, i, context );
+    }
+
+    std::vector<const double*> columns( vars.size() );
+    for( unsigned i = 0; i < vars.size(); ++i )
+        columns[i] = &values[i*count];
+
+    expr.evalBatch( columns.empty() ? 0L : &columns[0], count, &out[0] );
+}
+
 double
 Feature::eval(NumericExpression& expr, Session* session) const
 {
     const NumericExpression::Variables& vars = expr.variables();
-    for( NumericExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
+
+    if ( _batch.valid() )
+        _batch->bind( vars, expr.binding() );
+
+    for( unsigned i = 0; i < vars.size(); ++i )
     {
         double val = 0.0;
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
-        {
-            val = ai->second.getDouble(0.0);
-        }
-        else if (session)
+        int field = _batch.valid() ? expr.binding().fields[i] : -1;
+        if (!getVariable(vars[i].first, field, val) && session)
         {
             //No attr found, look for script
             ScriptEngine* engine = session->getScriptEngine();
             if (engine)
             {
-                ScriptResult result = engine->run(i->first, this);
+                ScriptResult result = engine->run(vars[i].first, this);
                 if (result.success())
                 {
                     val = result.asDouble();
@@ -411,7 +555,7 @@ Feature::eval(NumericExpression& expr, Session* session) const
             }
         }
 
-        expr.set( *i, val );
+        expr.set( vars[i], val );
     }
 
     return expr.eval();
@@ -421,33 +565,33 @@ const std::string&
 Feature::eval( StringExpression& expr, FilterContext const* context ) const
 {
     const StringExpression::Variables& vars = expr.variables();
-    for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
+
+    if ( _batch.valid() )
+        _batch->bind( vars, expr.binding() );
+
+    for( unsigned i = 0; i < vars.size(); ++i )
     {
       std::string val = "";
-      AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-      if (ai != _attrs.end())
-      {
-        val = ai->second.getString();
-      }
-      else if (context && context->getSession())
+      int field = _batch.valid() ? expr.binding().fields[i] : -1;
+      if (!getVariable(vars[i].first, field, val) && context && context->getSession())
       {
         //No attr found, look for script
         ScriptEngine* engine = context->getSession()->getScriptEngine();
         if (engine)
         {
-          ScriptResult result = engine->run(i->first, this, context);
+          ScriptResult result = engine->run(vars[i].first, this, context);
           if (result.success())
             val = result.asString();
           else
           {
             // Couldn't execute it as code, just take it as a string literal.
-            val = i->first;
+            val = vars[i].first;
             OE_DEBUG << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
           }
         }
       }
 
-      expr.set( *i, val );
+      expr.set( vars[i], val );
     }
 
     return expr.eval();
@@ -457,33 +601,33 @@ const std::string&
 Feature::eval(StringExpression& expr, Session* session) const
 {
     const StringExpression::Variables& vars = expr.variables();
-    for( StringExpression::Variables::const_iterator i = vars.begin(); i != vars.end(); ++i )
+
+    if ( _batch.valid() )
+        _batch->bind( vars, expr.binding() );
+
+    for( unsigned i = 0; i < vars.size(); ++i )
     {
         std::string val = "";
-        AttributeTable::const_iterator ai = _attrs.find(toLower(i->first));
-        if (ai != _attrs.end())
-        {
-            val = ai->second.getString();
-        }
-        else if (session)
+        int field = _batch.valid() ? expr.binding().fields[i] : -1;
+        if (!getVariable(vars[i].first, field, val) && session)
         {
             //No attr found, look for script
             ScriptEngine* engine = session->getScriptEngine();
             if (engine)
             {
-                ScriptResult result = engine->run(i->first, this);
+                ScriptResult result = engine->run(vars[i].first, this);
                 if (result.success())
                     val = result.asString();
                 else
                 {
                     // Couldn't execute it as code, just take it as a string literal.
-                    val = i->first;
+                    val = vars[i].first;
                     OE_DEBUG << LC << "Feature Script error on '" << expr.expr() << "': " << result.message() << std::endl;
                 }
             }
         }
 
-        expr.set( *i, val );
+        expr.set( vars[i], val );
     }
 
     return expr.eval();
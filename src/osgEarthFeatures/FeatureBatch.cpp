@@ -0,0 +1,303 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/FeatureBatch>
+#include <osgEarth/StringUtils>
+#include <OpenThreads/Atomic>
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+
+#define LC "[FeatureBatch] "
+
+namespace
+{
+    // schema IDs are global so a binding made against one batch is never
+    // mistaken for a binding against another. Zero means "unbound".
+    OpenThreads::Atomic s_schemaIdGen;
+}
+
+//----------------------------------------------------------------------------
+
+FeatureBatch::FeatureBatch() :
+_numRows ( 0u ),
+_schemaId( ++s_schemaIdGen )
+{
+    //nop
+}
+
+unsigned
+FeatureBatch::addField(const std::string& name)
+{
+    FieldIndex::const_iterator i = _index.find(name);
+    if ( i != _index.end() )
+        return i->second;
+
+    unsigned field = _names.size();
+    _names.push_back( name );
+    _index[_names.back()] = field;
+
+    _columns.push_back( Column() );
+    _columns.back().types.resize( _numRows, (unsigned char)ABSENT );
+
+    _schemaId = ++s_schemaIdGen;
+    return field;
+}
+
+int
+FeatureBatch::getFieldIndex(const std::string& name) const
+{
+    FieldIndex::const_iterator i = _index.find(name);
+    return i != _index.end() ? (int)i->second : -1;
+}
+
+unsigned
+FeatureBatch::addRow()
+{
+    for(std::vector<Column>::iterator c = _columns.begin(); c != _columns.end(); ++c)
+        c->types.push_back( (unsigned char)ABSENT );
+    return _numRows++;
+}
+
+Feature*
+FeatureBatch::createFeature(Geometry* geom, const SpatialReference* srs, FeatureID fid)
+{
+    Feature* feature = new Feature(geom, srs, Style(), fid);
+    feature->_batch = this;
+    feature->_row = addRow();
+    return feature;
+}
+
+std::vector<double>&
+FeatureBatch::numbers(unsigned field)
+{
+    std::vector<double>& v = _columns[field].numbers;
+    if ( v.size() < _numRows )
+        v.resize( _numRows, 0.0 );
+    return v;
+}
+
+std::vector<unsigned>&
+FeatureBatch::strings(unsigned field)
+{
+    std::vector<unsigned>& v = _columns[field].strings;
+    if ( v.size() < _numRows )
+        v.resize( _numRows, 0u );
+    return v;
+}
+
+const char*
+FeatureBatch::getChars(unsigned row, unsigned field) const
+{
+    return &_chars[ _columns[field].strings[row] ];
+}
+
+void
+FeatureBatch::set(unsigned row, unsigned field, const std::string& value)
+{
+    strings(field)[row] = _chars.size();
+    _chars.insert( _chars.end(), value.begin(), value.end() );
+    _chars.push_back( '\0' );
+    _columns[field].types[row] = ATTRTYPE_STRING;
+}
+
+void
+FeatureBatch::set(unsigned row, unsigned field, double value)
+{
+    numbers(field)[row] = value;
+    _columns[field].types[row] = ATTRTYPE_DOUBLE;
+}
+
+void
+FeatureBatch::set(unsigned row, unsigned field, int value)
+{
+    numbers(field)[row] = (double)value;
+    _columns[field].types[row] = ATTRTYPE_INT;
+}
+
+void
+FeatureBatch::set(unsigned row, unsigned field, bool value)
+{
+    numbers(field)[row] = value ? 1.0 : 0.0;
+    _columns[field].types[row] = ATTRTYPE_BOOL;
+}
+
+void
+FeatureBatch::set(unsigned row, unsigned field, const AttributeValue& value)
+{
+    if ( !value.second.set )
+    {
+        setNull(row, field, value.first);
+        return;
+    }
+
+    switch( value.first ) {
+        case ATTRTYPE_STRING: set(row, field, value.second.stringValue); break;
+        case ATTRTYPE_DOUBLE: set(row, field, value.second.doubleValue); break;
+        case ATTRTYPE_INT:    set(row, field, value.second.intValue); break;
+        case ATTRTYPE_BOOL:   set(row, field, value.second.boolValue); break;
+        case ATTRTYPE_UNSPECIFIED: _columns[field].types[row] = ATTRTYPE_UNSPECIFIED; break;
+    }
+}
+
+void
+FeatureBatch::setNull(unsigned row, unsigned field, AttributeType type)
+{
+    _columns[field].types[row] = (unsigned char)(type | NULL_BIT);
+}
+
+bool
+FeatureBatch::hasAttr(unsigned row, unsigned field) const
+{
+    return getTag(row, field) != ABSENT;
+}
+
+bool
+FeatureBatch::isSet(unsigned row, unsigned field) const
+{
+    return (getTag(row, field) & NULL_BIT) == 0;
+}
+
+std::string
+FeatureBatch::getString(unsigned row, unsigned field) const
+{
+    switch( getTag(row, field) ) {
+        case ATTRTYPE_STRING: return getChars(row, field);
+        case ATTRTYPE_DOUBLE: return osgEarth::toString(_columns[field].numbers[row]);
+        case ATTRTYPE_INT:    return osgEarth::toString((int)_columns[field].numbers[row]);
+        case ATTRTYPE_BOOL:   return osgEarth::toString(_columns[field].numbers[row] != 0.0);
+    }
+    return EMPTY_STRING;
+}
+
+double
+FeatureBatch::getDouble(unsigned row, unsigned field, double defaultValue) const
+{
+    switch( getTag(row, field) ) {
+        case ATTRTYPE_STRING: return osgEarth::as<double>(std::string(getChars(row, field)), defaultValue);
+        case ATTRTYPE_DOUBLE:
+        case ATTRTYPE_INT:
+        case ATTRTYPE_BOOL:   return _columns[field].numbers[row];
+    }
+    return defaultValue;
+}
+
+int
+FeatureBatch::getInt(unsigned row, unsigned field, int defaultValue) const
+{
+    switch( getTag(row, field) ) {
+        case ATTRTYPE_STRING: return osgEarth::as<int>(std::string(getChars(row, field)), defaultValue);
+        case ATTRTYPE_DOUBLE:
+        case ATTRTYPE_INT:
+        case ATTRTYPE_BOOL:   return (int)_columns[field].numbers[row];
+    }
+    return defaultValue;
+}
+
+bool
+FeatureBatch::getBool(unsigned row, unsigned field, bool defaultValue) const
+{
+    switch( getTag(row, field) ) {
+        case ATTRTYPE_STRING: return osgEarth::as<bool>(std::string(getChars(row, field)), defaultValue);
+        case ATTRTYPE_DOUBLE:
+        case ATTRTYPE_INT:
+        case ATTRTYPE_BOOL:   return _columns[field].numbers[row] != 0.0;
+    }
+    return defaultValue;
+}
+
+void
+FeatureBatch::getAttrs(unsigned row, AttributeTable& out) const
+{
+    for(unsigned field = 0; field < _columns.size(); ++field)
+    {
+        unsigned char tag = getTag(row, field);
+        if ( tag == ABSENT )
+            continue;
+
+        AttributeValue& a = out[_names[field]];
+        a.first = (AttributeType)(tag & ~NULL_BIT);
+        a.second.set = (tag & NULL_BIT) == 0;
+        a.second.stringValue.clear();
+        a.second.doubleValue = 0.0;
+        a.second.intValue = 0;
+        a.second.boolValue = false;
+
+        if ( !a.second.set )
+            continue;
+
+        switch( a.first ) {
+            case ATTRTYPE_STRING: a.second.stringValue = getChars(row, field); break;
+            case ATTRTYPE_DOUBLE: a.second.doubleValue = _columns[field].numbers[row]; break;
+            case ATTRTYPE_INT:    a.second.intValue = (int)_columns[field].numbers[row]; break;
+            case ATTRTYPE_BOOL:   a.second.boolValue = _columns[field].numbers[row] != 0.0; break;
+            case ATTRTYPE_UNSPECIFIED: break;
+        }
+    }
+}
+
+void
+FeatureBatch::copyAttrs(unsigned row, AttributeTable& out, bool& copied) const
+{
+    Threading::ScopedMutexLock lock( _copyMutex );
+    if ( !copied )
+    {
+        getAttrs( row, out );
+        copied = true;
+    }
+}
+
+void
+FeatureBatch::bind(const std::vector< std::pair<std::string,unsigned> >& variables,
+                   ExpressionBinding& binding) const
+{
+    if ( binding.schema == _schemaId && binding.fields.size() == variables.size() )
+        return;
+
+    binding.fields.resize( variables.size() );
+    for(unsigned i = 0; i < variables.size(); ++i)
+        binding.fields[i] = getFieldIndex( variables[i].first );
+    binding.schema = _schemaId;
+}
+
+void
+FeatureBatch::pack(FeatureList& features)
+{
+    // released here if there are no features to take it
+    osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+
+    for(FeatureList::iterator i = features.begin(); i != features.end(); ++i)
+    {
+        Feature* feature = i->get();
+        if ( !feature )
+            continue;
+
+        const AttributeTable& attrs = feature->getAttrs();
+        unsigned row = batch->addRow();
+
+        for(AttributeTable::const_iterator a = attrs.begin(); a != attrs.end(); ++a)
+        {
+            batch->set( row, batch->addField(a->first), a->second );
+        }
+
+        feature->_attrs.clear();
+        feature->_batch = batch.get();
+        feature->_row = row;
+        feature->_attrsCopied = false;
+    }
+}
@@ -41,9 +41,9 @@ FeatureCursor::fill( FeatureList& list )
 
 //---------------------------------------------------------------------------
 
-FeatureListCursor::FeatureListCursor(const FeatureList& features) :
+FeatureListCursor::FeatureListCursor(const FeatureList& features, bool clone) :
 _features( features ),
-_clone   ( false )
+_clone   ( clone )
 {
     _iter = _features.begin();
 }
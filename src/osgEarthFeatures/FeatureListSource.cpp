@@ -18,19 +18,71 @@
  */
 #include <osgEarthFeatures/FeatureListSource>
 #include <osgEarthFeatures/FeatureCursor>
+#include <osgEarthFeatures/FeatureBatch>
 #include <osgEarthFeatures/Filter>
+#include <osgEarth/PackedRTree>
+#include <vector>
 
+using namespace osgEarth;
 using namespace osgEarth::Features;
 
+/**
+ * Packed R-tree over the geometry bounds of a feature list. Features
+ * without a geometry are left out.
+ */
+class FeatureListSource::SpatialIndex : public osg::Referenced
+{
+public:
+    SpatialIndex(const FeatureList& features)
+    {
+        std::vector<Bounds> boxes;
+        for(FeatureList::const_iterator i = features.begin(); i != features.end(); ++i)
+        {
+            Feature* feature = i->get();
+            if ( feature && feature->getGeometry() )
+            {
+                boxes.push_back( feature->getGeometry()->getBounds() );
+                _features.push_back( feature );
+            }
+        }
+        _tree.build( boxes );
+    }
+
+    /** Appends the features whose 2D bounds intersect "bounds", in list order. */
+    void query(const Bounds& bounds, FeatureList& output) const
+    {
+        std::vector<unsigned> hits;
+        _tree.query( bounds, hits );
+        for(std::vector<unsigned>::const_iterator i = hits.begin(); i != hits.end(); ++i)
+            output.push_back( _features[*i] );
+    }
+
+protected:
+    virtual ~SpatialIndex() { }
+
+private:
+    PackedRTree           _tree;
+    std::vector<Feature*> _features;   // indexed features, in list order
+};
+
+//........................................................................
+
 FeatureListSource::FeatureListSource():
-FeatureSource()
+FeatureSource(),
+_cloneFeatures( true )
 {
     //nop
 }
 
 FeatureListSource::FeatureListSource(const GeoExtent& defaultExtent ) :
 FeatureSource (),
-_defaultExtent( defaultExtent )
+_defaultExtent( defaultExtent ),
+_cloneFeatures( true )
+{
+    //nop
+}
+
+FeatureListSource::~FeatureListSource()
 {
     //nop
 }
@@ -41,15 +93,30 @@ FeatureListSource::createFeatureCursor( const Symbology::Query& query )
     if (getFeatureProfile() == 0L)
         setFeatureProfile(createFeatureProfile());
 
-    //Create a copy of all of the features before returning the cursor.
-    //The processing filters in osgEarth can modify the features as they are operating and we don't want our original data destroyed.
     FeatureList cursorFeatures;
-    for (FeatureList::iterator itr = _features.begin(); itr != _features.end(); ++itr)
+
+    if ( query.bounds().isSet() )
     {
-        Feature* feature = new Feature(*(itr->get()), osg::CopyOp::DEEP_COPY_ALL);        
-        cursorFeatures.push_back( feature );
-    }    
-    return new FeatureListCursor( cursorFeatures );
+        osg::ref_ptr<SpatialIndex> index;
+        {
+            Threading::ScopedMutexLock lock( _indexMutex );
+            if ( !_index.valid() || outOfSyncWith(_indexRevision) )
+            {
+                _index = new SpatialIndex( _features );
+                sync( _indexRevision );
+            }
+            index = _index.get();
+        }
+        index->query( *query.bounds(), cursorFeatures );
+    }
+    else
+    {
+        cursorFeatures = _features;
+    }
+
+    // The processing filters in osgEarth can modify the features as they are operating and
+    // we don't want our original data destroyed, so by default the cursor returns copies.
+    return new FeatureListCursor( cursorFeatures, _cloneFeatures );
 }
 
 const FeatureProfile*
@@ -110,6 +177,12 @@ FeatureListSource::getFeature( FeatureID fid )
     return NULL;
 }
 
+void
+FeatureListSource::packAttributes()
+{
+    FeatureBatch::pack( _features );
+}
+
 bool FeatureListSource::insertFeature(Feature* feature)
 {
     dirtyFeatureProfile();
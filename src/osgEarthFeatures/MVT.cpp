@@ -22,6 +22,7 @@
 #include <osgEarth/FileUtils>
 #include <osgEarth/GeoData>
 #include <osgEarthFeatures/FeatureSource>
+#include <osgEarthFeatures/FeatureBatch>
 #include <osgDB/Registry>
 #include <list>
 #include <stdio.h>
@@ -338,54 +339,69 @@ bool
 
     if (tile.ParseFromString(value))
     {
+        // All the features of the tile store their attributes in one batch.
+        osg::ref_ptr<FeatureBatch> batch = new FeatureBatch();
+        unsigned layerField = batch->addField("mvt_layer");
+        int heightField = -1;
+
         for (unsigned int i = 0; i < tile.layers().size(); i++)
         {
             const mapnik::vector::tile_layer &layer = tile.layers().Get(i);
 
+            // batch field of each layer key, resolved on first use
+            std::vector<int> keyFields(layer.keys().size(), -1);
 
             for (unsigned int j = 0; j < layer.features().size(); j++)
             {
                 const mapnik::vector::tile_feature &feature = layer.features().Get(j);
 
 
-                osg::ref_ptr< Feature > oeFeature = new Feature(0, key.getProfile()->getSRS());
+                osg::ref_ptr< Feature > oeFeature = batch->createFeature(0, key.getProfile()->getSRS());
+                unsigned row = oeFeature->getBatchRow();
 
                 // Set the layer name as "mvt_layer" so we can filter it later
-                oeFeature->set("mvt_layer", layer.name());
+                batch->set(row, layerField, layer.name());
 
                 // Read attributes
                 for (unsigned int k = 0; k < feature.tags().size(); k+=2)
                 {
-                    std::string key = layer.keys().Get(feature.tags().Get(k));
-                    mapnik::vector::tile_value value = layer.values().Get(feature.tags().Get(k+1));
+                    unsigned keyIndex = feature.tags().Get(k);
+                    const std::string& key = layer.keys().Get(keyIndex);
+                    const mapnik::vector::tile_value& value = layer.values().Get(feature.tags().Get(k+1));
+
+                    if (keyFields[keyIndex] < 0)
+                    {
+                        keyFields[keyIndex] = batch->addField(key);
+                    }
+                    unsigned field = keyFields[keyIndex];
 
                     if (value.has_bool_value())
                     {
-                        oeFeature->set(key, value.bool_value());
+                        batch->set(row, field, value.bool_value());
                     }
                     else if (value.has_double_value())
                     {
-                        oeFeature->set(key, value.double_value());
+                        batch->set(row, field, value.double_value());
                     }
                     else if (value.has_float_value())
                     {
-                        oeFeature->set(key, value.float_value());
+                        batch->set(row, field, (double)value.float_value());
                     }
                     else if (value.has_int_value())
                     {
-                        oeFeature->set(key, (int)value.int_value());
+                        batch->set(row, field, (int)value.int_value());
                     }
                     else if (value.has_sint_value())
                     {
-                        oeFeature->set(key, (int)value.sint_value());
+                        batch->set(row, field, (int)value.sint_value());
                     }
                     else if (value.has_string_value())
                     {
-                        oeFeature->set(key, value.string_value());
+                        batch->set(row, field, value.string_value());
                     }
                     else if (value.has_uint_value())
                     {
-                        oeFeature->set(key, (int)value.uint_value());
+                        batch->set(row, field, (int)value.uint_value());
                     }
 
                     // Special path for getting heights from our test dataset.
@@ -405,7 +421,9 @@ bool
                                 float height = as<float>(value, FLT_MAX);
                                 if (height != FLT_MAX)
                                 {
-                                    oeFeature->set("height", height);
+                                    if (heightField < 0)
+                                        heightField = batch->addField("height");
+                                    batch->set(row, (unsigned)heightField, (double)height);
                                 }
                             }
                         }
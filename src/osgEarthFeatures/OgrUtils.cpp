@@ -45,6 +45,66 @@ int IsFieldSet(OGRFeatureH handle, int i)
 #endif
 }
 
+namespace
+{
+    // Sets the attributes of a feature, named after their OGR fields.
+    struct FeatureFields
+    {
+        OGRFeatureH _handle;
+        Feature*    _feature;
+
+        std::string name(int i) const
+        {
+            // get the field name and convert to lower case:
+            return osgEarth::toLower( std::string(OGR_Fld_GetNameRef(OGR_F_GetFieldDefnRef(_handle, i))) );
+        }
+
+        template<typename T> void set(int i, const T& value) { _feature->set( name(i), value ); }
+        void setNull(int i, AttributeType type) { _feature->setNull( name(i), type ); }
+    };
+
+    // Sets the attributes of a batch row, using fields from OgrUtils::mapFields.
+    struct BatchFields
+    {
+        FeatureBatch*                _batch;
+        unsigned                     _row;
+        const std::vector<unsigned>& _fields;
+
+        template<typename T> void set(int i, const T& value) { _batch->set( _row, _fields[i], value ); }
+        void setNull(int i, AttributeType type) { _batch->setNull( _row, _fields[i], type ); }
+    };
+
+    // Copies the first "numAttrs" field values of an OGR feature.
+    template<typename FIELDS>
+    void readFields(OGRFeatureH handle, int numAttrs, FIELDS& out)
+    {
+        for (int i = 0; i < numAttrs; ++i)
+        {
+            // get the field type and set the value appropriately
+            switch( OGR_Fld_GetType(OGR_F_GetFieldDefnRef(handle, i)) )
+            {
+            case OFTInteger:
+                if (IsFieldSet( handle, i ))
+                    out.set( i, OGR_F_GetFieldAsInteger(handle, i) );
+                else
+                    out.setNull( i, ATTRTYPE_INT );
+                break;
+            case OFTReal:
+                if (IsFieldSet( handle, i ))
+                    out.set( i, OGR_F_GetFieldAsDouble(handle, i) );
+                else
+                    out.setNull( i, ATTRTYPE_DOUBLE );
+                break;
+            default:
+                if (IsFieldSet( handle, i ))
+                    out.set( i, std::string(OGR_F_GetFieldAsString(handle, i)) );
+                else
+                    out.setNull( i, ATTRTYPE_STRING );
+            }
+        }
+    }
+}
+
 
 void
 OgrUtils::populate( OGRGeometryH geomHandle, Symbology::Geometry* target, int numPoints )
@@ -338,59 +398,52 @@ OgrUtils::createFeature( OGRFeatureH handle, const SpatialReference* srs )
 
     Feature* feature = new Feature( geom, srs, Style(), fid );
 
-    int numAttrs = OGR_F_GetFieldCount(handle); 
-    for (int i = 0; i < numAttrs; ++i) 
-    { 
-        OGRFieldDefnH field_handle_ref = OGR_F_GetFieldDefnRef( handle, i ); 
+    FeatureFields fields = { handle, feature };
+    readFields( handle, OGR_F_GetFieldCount(handle), fields );
 
-        // get the field name and convert to lower case:
-        const char* field_name = OGR_Fld_GetNameRef( field_handle_ref ); 
-        std::string name = osgEarth::toLower( std::string(field_name) );
+    return feature;
+}
 
-        // get the field type and set the value appropriately
-        OGRFieldType field_type = OGR_Fld_GetType( field_handle_ref );        
-        switch( field_type )
-        {
-        case OFTInteger:
-            {     
-                if (IsFieldSet( handle, i ))
-                {
-                    int value = OGR_F_GetFieldAsInteger( handle, i );
-                    feature->set( name, value );                    
-                }
-                else
-                {
-                    feature->setNull( name, ATTRTYPE_INT );
-                }
-            }
-            break;
-        case OFTReal:
-            {
-                if (IsFieldSet( handle, i ))
-                {
-                    double value = OGR_F_GetFieldAsDouble( handle, i );
-                    feature->set( name, value );
-                }
-                else
-                {
-                    feature->setNull( name, ATTRTYPE_DOUBLE );
-                }
-            }
-            break;
-        default:
-            {
-                if (IsFieldSet( handle, i ))
-                {
-                    const char* value = OGR_F_GetFieldAsString(handle, i);
-                    feature->set( name, std::string(value) );
-                }
-                else
-                {
-                    feature->setNull( name, ATTRTYPE_STRING );
-                }
-            }
-        }
-    } 
+void
+OgrUtils::mapFields( OGRFeatureDefnH defn, FeatureBatch* batch, std::vector<unsigned>& out_fields )
+{
+    out_fields.clear();
+    if ( !defn || !batch )
+        return;
+
+    int numFields = OGR_FD_GetFieldCount( defn );
+    out_fields.reserve( numFields );
+    for (int i = 0; i < numFields; ++i)
+    {
+        OGRFieldDefnH field_handle_ref = OGR_FD_GetFieldDefn( defn, i );
+        out_fields.push_back( batch->addField( osgEarth::toLower(std::string(OGR_Fld_GetNameRef(field_handle_ref))) ) );
+    }
+}
+
+Feature*
+OgrUtils::createFeature( OGRFeatureH handle, const FeatureProfile* profile, FeatureBatch* batch, const std::vector<unsigned>& fields )
+{
+    long fid = OGR_F_GetFID( handle );
+
+    OGRGeometryH geomRef = OGR_F_GetGeometryRef( handle );
+
+    Symbology::Geometry* geom = 0;
+
+    if ( geomRef )
+    {
+        geom = OgrUtils::createGeometry( geomRef );
+    }
+
+    Feature* feature = batch->createFeature( geom, profile ? profile->getSRS() : 0L, fid );
+    if ( profile && profile->geoInterp().isSet() )
+        feature->geoInterp() = profile->geoInterp().get();
+
+    int numAttrs = OGR_F_GetFieldCount(handle);
+    if ( numAttrs > (int)fields.size() )
+        numAttrs = (int)fields.size();
+
+    BatchFields row = { batch, feature->getBatchRow(), fields };
+    readFields( handle, numAttrs, row );
 
     return feature;
 }
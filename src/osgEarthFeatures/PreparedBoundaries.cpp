@@ -0,0 +1,259 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+ * Copyright 2016 Pelican Mapping
+ * http://osgearth.org
+ *
+ * osgEarth is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+#include <osgEarthFeatures/PreparedBoundaries>
+#include <osgEarthFeatures/FeatureCursor>
+#include <algorithm>
+#include <cfloat>
+
+#define LC "[PreparedBoundaries] "
+
+using namespace osgEarth;
+using namespace osgEarth::Features;
+using namespace osgEarth::Symbology;
+
+void
+PreparedBoundaries::add(Geometry* geom)
+{
+    GeometryIterator parts( geom, false );
+    while( parts.hasMore() )
+    {
+        Ring* ring = dynamic_cast<Ring*>( parts.next() );
+        if ( !ring )
+            continue;
+
+        PreparedPolygon polygon;
+        polygon.outer = addRing( ring );
+        polygon.numHoles = 0;
+
+        Polygon* poly = dynamic_cast<Polygon*>( ring );
+        if ( poly )
+        {
+            for(RingCollection::const_iterator h = poly->getHoles().begin(); h != poly->getHoles().end(); ++h)
+            {
+                addRing( h->get() );
+                ++polygon.numHoles;
+            }
+        }
+
+        _polygons.push_back( polygon );
+        _polygonBounds.push_back( ring->getBounds() );
+    }
+}
+
+void
+PreparedBoundaries::build()
+{
+    _tree.build( _polygonBounds );
+}
+
+bool
+PreparedBoundaries::contains(double x, double y, std::vector<unsigned>& hits) const
+{
+    hits.clear();
+    _tree.query( x, y, hits );
+    for(std::vector<unsigned>::const_iterator i = hits.begin(); i != hits.end(); ++i)
+    {
+        const PreparedPolygon& polygon = _polygons[*i];
+        if ( !ringContains(_rings[polygon.outer], x, y) )
+            continue;
+
+        bool inHole = false;
+        for(unsigned h = 0; h < polygon.numHoles && !inHole; ++h)
+            inHole = ringContains(_rings[polygon.outer + 1 + h], x, y);
+
+        if ( !inHole )
+            return true;
+    }
+    return false;
+}
+
+void
+PreparedBoundaries::contains(const std::vector<osg::Vec2d>& points, std::vector<bool>& results) const
+{
+    results.assign( points.size(), false );
+    if ( _tree.empty() )
+        return;
+
+    const Bounds& extent = _tree.getBounds();
+    std::vector<unsigned> hits;
+    for(unsigned i = 0; i < points.size(); ++i)
+    {
+        const osg::Vec2d& p = points[i];
+        if ( p.x() < extent.xMin() || p.x() > extent.xMax() || p.y() < extent.yMin() || p.y() > extent.yMax() )
+            continue;
+        results[i] = contains( p.x(), p.y(), hits );
+    }
+}
+
+unsigned
+PreparedBoundaries::band(const PreparedRing& ring, double y) const
+{
+    return std::min( (unsigned)((y - ring.yMin) * ring.bandScale), ring.numBands - 1 );
+}
+
+unsigned
+PreparedBoundaries::addRing(const Ring* ring)
+{
+    PreparedRing r;
+    r.yMin = DBL_MAX;
+    r.yMax = -DBL_MAX;
+
+    // same edge order as Ring::contains2D, so the arithmetic matches:
+    unsigned firstEdge = _edges.size() / 4;
+    unsigned n = ring->size();
+    for(unsigned i = 0, j = n - 1; i < n; j = i++)
+    {
+        const osg::Vec3d& a = (*ring)[i];
+        const osg::Vec3d& b = (*ring)[j];
+        if ( a.y() == b.y() )
+            continue; // never crosses a horizontal ray
+
+        _edges.push_back( a.x() );
+        _edges.push_back( a.y() );
+        _edges.push_back( b.x() );
+        _edges.push_back( b.y() );
+        r.yMin = osg::minimum( r.yMin, osg::minimum(a.y(), b.y()) );
+        r.yMax = osg::maximum( r.yMax, osg::maximum(a.y(), b.y()) );
+    }
+    unsigned numEdges = _edges.size() / 4 - firstEdge;
+
+    // about 4 edges per band:
+    r.numBands = osg::clampBetween( numEdges / 4u, 1u, 4096u );
+    r.bandScale = r.yMax > r.yMin ? (double)r.numBands / (r.yMax - r.yMin) : 0.0;
+    r.firstBand = _bandStarts.size();
+
+    // each edge goes in every band its Y range overlaps:
+    std::vector<unsigned> counts( r.numBands, 0u );
+    for(unsigned e = firstEdge; e < firstEdge + numEdges; ++e)
+    {
+        const double* edge = &_edges[e*4];
+        unsigned last = band( r, osg::maximum(edge[1], edge[3]) );
+        for(unsigned k = band( r, osg::minimum(edge[1], edge[3]) ); k <= last; ++k)
+            ++counts[k];
+    }
+
+    unsigned offset = _bandEdges.size();
+    for(unsigned k = 0; k < r.numBands; ++k)
+    {
+        _bandStarts.push_back( offset );
+        offset += counts[k];
+    }
+    _bandStarts.push_back( offset );
+    _bandEdges.resize( offset );
+
+    for(unsigned e = firstEdge; e < firstEdge + numEdges; ++e)
+    {
+        const double* edge = &_edges[e*4];
+        unsigned last = band( r, osg::maximum(edge[1], edge[3]) );
+        for(unsigned k = band( r, osg::minimum(edge[1], edge[3]) ); k <= last; ++k)
+            _bandEdges[ _bandStarts[r.firstBand + k + 1] - counts[k]-- ] = e;
+    }
+
+    _rings.push_back( r );
+    return _rings.size() - 1;
+}
+
+bool
+PreparedBoundaries::ringContains(const PreparedRing& r, double x, double y) const
+{
+    if ( y < r.yMin || y >= r.yMax )
+        return false;
+
+    bool result = false;
+    unsigned k = r.firstBand + band( r, y );
+    for(unsigned i = _bandStarts[k]; i < _bandStarts[k+1]; ++i)
+    {
+        // a = ring[i], b = ring[j] in Ring::contains2D
+        const double* e = &_edges[_bandEdges[i]*4];
+        if ((((e[1] <= y) && (y < e[3])) ||
+            ((e[3] <= y) && (y < e[1]))) &&
+            (x < (e[2]-e[0]) * (y-e[1])/(e[3]-e[1])+e[0]))
+        {
+            result = !result;
+        }
+    }
+    return result;
+}
+
+//------------------------------------------------------------------------
+
+PreparedBoundariesCache::PreparedBoundariesCache(FeatureSource* source) :
+_source( source )
+{
+    //nop
+}
+
+osg::ref_ptr<PreparedBoundaries>
+PreparedBoundariesCache::get(const GeoExtent& extent, const SpatialReference* srs)
+{
+    const FeatureProfile* profile = _source->getFeatureProfile();
+    if ( profile && profile->getTiled() )
+    {
+        FeatureList boundaries;
+        GeoExtent localExtent = extent.transform( profile->getSRS() );
+        if ( localExtent.intersects(profile->getExtent()) )
+        {
+            Query query;
+            query.bounds() = localExtent.bounds();
+            osg::ref_ptr<FeatureCursor> cursor = _source->createFeatureCursor( query );
+            if ( cursor.valid() )
+                cursor->fill( boundaries );
+        }
+        return prepare( boundaries, srs );
+    }
+
+    Threading::ScopedMutexLock lock( _preparedMutex );
+
+    if ( !_prepared.valid() || _source->outOfSyncWith(_preparedRevision) || !srs->isEquivalentTo(_preparedSRS.get()) )
+    {
+        Revision revision;
+        _source->sync( revision );
+
+        FeatureList boundaries;
+        osg::ref_ptr<FeatureCursor> cursor = _source->createFeatureCursor( Query() );
+        if ( cursor.valid() )
+            cursor->fill( boundaries );
+
+        _prepared = prepare( boundaries, srs );
+        _preparedSRS = srs;
+        _preparedRevision = revision;
+
+        OE_INFO << LC << "Prepared " << _prepared->getNumPolygons() << " boundary polygons\n";
+    }
+
+    return _prepared;
+}
+
+PreparedBoundaries*
+PreparedBoundariesCache::prepare(FeatureList& boundaries, const SpatialReference* srs)
+{
+    PreparedBoundaries* prepared = new PreparedBoundaries();
+    for (FeatureList::iterator itr = boundaries.begin(); itr != boundaries.end(); ++itr)
+    {
+        Feature* feature = itr->get();
+        if ( feature && feature->getGeometry() )
+        {
+            // Transform the boundaries into the coordinate system of the features
+            feature->transform( srs );
+            prepared->add( feature->getGeometry() );
+        }
+    }
+    prepared->build();
+    return prepared;
+}
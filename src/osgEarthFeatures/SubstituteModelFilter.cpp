@@ -156,7 +156,17 @@ SubstituteModelFilter::process(const FeatureList&           features,
         scaleZEx  = *modelSymbol->scaleZ();
     }
 
-    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f )
+    // evaluate the scale expression for all the features at once, unless
+    // a script may change the attributes along the way
+    std::vector<double> scales;
+    bool batchScales = symbol->scale().isSet() && !symbol->script().isSet();
+    if ( batchScales )
+    {
+        Feature::evalBatch( scaleEx, features, &context, scales );
+    }
+
+    unsigned featureIndex = 0;
+    for( FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++featureIndex )
     {
         Feature* input = f->get();
 
@@ -186,7 +196,7 @@ SubstituteModelFilter::process(const FeatureList&           features,
         osg::Matrixd scaleMatrix;
         if ( symbol->scale().isSet() )
         {
-            scale = input->eval( scaleEx, &context );
+            scale = batchScales ? scales[featureIndex] : input->eval( scaleEx, &context );
             scaleVec.set(scale, scale, scale);
         }
         if ( modelSymbol )
@@ -270,7 +280,7 @@ SubstituteModelFilter::process(const FeatureList&           features,
                     osg::Matrixd scaleMatrix;
                     if ( symbol->scale().isSet() )
                     {
-                        scale = input->eval( scaleEx, &context );
+                        scale = batchScales ? scales[featureIndex] : input->eval( scaleEx, &context );
                         scaleVec.set(scale, scale, scale);
                     }
                     if ( modelSymbol )
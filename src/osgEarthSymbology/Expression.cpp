@@ -29,16 +29,18 @@ using namespace osgEarth::Symbology;
 #define LC "[Expression] "
 
 NumericExpression::NumericExpression() :
-_value(0.0),
-_dirty(true)
+_value    ( 0.0 ),
+_dirty    ( true ),
+_stackSize( 0u )
 {
     //nop
 }
 
 NumericExpression::NumericExpression( const std::string& expr ) : 
-_src  ( expr ),
-_value( 0.0 ),
-_dirty( true )
+_src      ( expr ),
+_value    ( 0.0 ),
+_dirty    ( true ),
+_stackSize( 0u )
 {
     init();
 }
@@ -48,22 +50,27 @@ _src  ( rhs._src ),
 _rpn  ( rhs._rpn ),
 _vars ( rhs._vars ),
 _value( rhs._value ),
-_dirty( rhs._dirty )
+_dirty( rhs._dirty ),
+_binding( rhs._binding ),
+_program( rhs._program ),
+_stackSize( rhs._stackSize )
 {
     //nop
 }
 
 NumericExpression::NumericExpression( double staticValue ) :
-_value( staticValue ),
-_dirty( false )
+_value    ( staticValue ),
+_dirty    ( false ),
+_stackSize( 0u )
 {
     _src = Stringify() << staticValue;
     init();
 }
 
 NumericExpression::NumericExpression( const Config& conf ) :
-_value( 0.0 ),
-_dirty( true )
+_value    ( 0.0 ),
+_dirty    ( true ),
+_stackSize( 0u )
 {
     mergeConfig( conf );
     init();
@@ -99,6 +106,7 @@ NumericExpression::init()
 {
     _vars.clear();
     _rpn.clear();
+    _binding = ExpressionBinding();
 
     StringTokenizer variablesTokenizer( "", "" );
     variablesTokenizer.addDelims( "[]", true );
@@ -264,6 +272,44 @@ NumericExpression::init()
         _rpn.push_back( s.top() );
         s.pop();
     }
+
+    compile();
+}
+
+void
+NumericExpression::compile()
+{
+    _program.clear();
+    _stackSize = 0u;
+
+    // The stack depth at each step does not depend on the variable values,
+    // so an operator that would find fewer than two operands (and do nothing)
+    // is dropped here instead of being checked on every evaluation.
+    unsigned depth = 0u;
+    unsigned var_i = 0u;
+    for( unsigned i=0; i<_rpn.size(); ++i )
+    {
+        const Atom& a = _rpn[i];
+
+        if ( a.first == VARIABLE )
+        {
+            _program.push_back( Instruction(VARIABLE, var_i++) );
+            ++depth;
+        }
+        else if ( !IS_OPERATOR(a) && a.first != MIN && a.first != MAX )
+        {
+            // operands, and anything else the parser left behind, push their value
+            _program.push_back( Instruction(OPERAND, i) );
+            ++depth;
+        }
+        else if ( depth >= 2 )
+        {
+            _program.push_back( Instruction(a.first, 0u) );
+            --depth;
+        }
+
+        _stackSize = std::max( _stackSize, depth );
+    }
 }
 
 void 
@@ -282,86 +328,98 @@ NumericExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stack<double> s;
-
-        for( unsigned i=0; i<_rpn.size(); ++i )
+        // small expressions evaluate on the call stack
+        double local[16];
+        std::vector<double> heap;
+        double* s = local;
+        if ( _stackSize > 16u )
         {
-            const Atom& a = _rpn[i];
+            heap.resize( _stackSize );
+            s = &heap[0];
+        }
 
-            if ( a.first == ADD )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 + op2 );
-                }
-            }
-            else if ( a.first == SUB )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 - op2 );
-                }
-            }
-            else if ( a.first == MULT )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 * op2 );
-                }
-            }
-            else if ( a.first == DIV )
+        unsigned top = 0u;
+        for( Program::const_iterator i = _program.begin(); i != _program.end(); ++i )
+        {
+            switch( i->first )
             {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( op1 / op2 );
-                }
+            case OPERAND:  s[top++] = _rpn[i->second].second; break;
+            case VARIABLE: s[top++] = _rpn[_vars[i->second].second].second; break;
+            case ADD:  --top; s[top-1] += s[top]; break;
+            case SUB:  --top; s[top-1] -= s[top]; break;
+            case MULT: --top; s[top-1] *= s[top]; break;
+            case DIV:  --top; s[top-1] /= s[top]; break;
+            case MOD:  --top; s[top-1] = fmod(s[top-1], s[top]); break;
+            case MIN:  --top; s[top-1] = std::min(s[top-1], s[top]); break;
+            case MAX:  --top; s[top-1] = std::max(s[top-1], s[top]); break;
+            default: break;
             }
-            else if ( a.first == MOD )
-            {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( fmod(op1, op2) );
-                }
-            }
-            else if ( a.first == MIN )
+        }
+
+        const_cast<NumericExpression*>(this)->_value = top > 0 ? s[top-1] : 0.0;
+        const_cast<NumericExpression*>(this)->_dirty = false;
+    }
+
+    return !osg::isNaN( _value ) ? _value : 0.0;
+}
+
+void
+NumericExpression::evalBatch(const double* const* values,
+                             unsigned             count,
+                             double*              out) const
+{
+    // Runs each instruction over a block of records, so every operator is
+    // a simple loop over contiguous values.
+    const unsigned BLOCK = 256u;
+    std::vector<double> stack( std::max(_stackSize, 1u) * BLOCK );
+
+    for( unsigned start = 0; start < count; start += BLOCK )
+    {
+        unsigned n = std::min( BLOCK, count - start );
+        unsigned top = 0u;
+
+        for( Program::const_iterator i = _program.begin(); i != _program.end(); ++i )
+        {
+            if ( i->first == OPERAND )
             {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( std::min(op1, op2) );
-                }
+                double* d = &stack[top++ * BLOCK];
+                double value = _rpn[i->second].second;
+                for( unsigned k=0; k<n; ++k )
+                    d[k] = value;
+                continue;
             }
-            else if ( a.first == MAX )
+            else if ( i->first == VARIABLE )
             {
-                if ( s.size() >= 2 )
-                {
-                    double op2 = s.top(); s.pop();
-                    double op1 = s.top(); s.pop();
-                    s.push( std::max(op1, op2) );
-                }
+                double* d = &stack[top++ * BLOCK];
+                const double* src = values[i->second] + start;
+                for( unsigned k=0; k<n; ++k )
+                    d[k] = src[k];
+                continue;
             }
-            else // OPERAND or VARIABLE
+
+            --top;
+            double*       a = &stack[(top-1) * BLOCK];
+            const double* b = &stack[top * BLOCK];
+
+            switch( i->first )
             {
-                s.push( a.second );
+            case ADD:  for( unsigned k=0; k<n; ++k ) a[k] += b[k]; break;
+            case SUB:  for( unsigned k=0; k<n; ++k ) a[k] -= b[k]; break;
+            case MULT: for( unsigned k=0; k<n; ++k ) a[k] *= b[k]; break;
+            case DIV:  for( unsigned k=0; k<n; ++k ) a[k] /= b[k]; break;
+            case MOD:  for( unsigned k=0; k<n; ++k ) a[k] = fmod(a[k], b[k]); break;
+            case MIN:  for( unsigned k=0; k<n; ++k ) a[k] = std::min(a[k], b[k]); break;
+            case MAX:  for( unsigned k=0; k<n; ++k ) a[k] = std::max(a[k], b[k]); break;
+            default: break;
             }
         }
 
-        const_cast<NumericExpression*>(this)->_value = s.size() > 0 ? s.top() : 0.0;
-        const_cast<NumericExpression*>(this)->_dirty = false;
+        for( unsigned k=0; k<n; ++k )
+        {
+            double value = top > 0 ? stack[(top-1) * BLOCK + k] : 0.0;
+            out[start + k] = !osg::isNaN( value ) ? value : 0.0;
+        }
     }
-
-    return !osg::isNaN( _value ) ? _value : 0.0;
 }
 
 //------------------------------------------------------------------------
@@ -394,7 +452,8 @@ _vars( rhs._vars ),
 _value( rhs._value ),
 _infix( rhs._infix ),
 _dirty( rhs._dirty ),
-_uriContext( rhs._uriContext )
+_uriContext( rhs._uriContext ),
+_binding( rhs._binding )
 {
     //nop
 }
@@ -440,6 +499,8 @@ StringExpression::getConfig() const
 void
 StringExpression::init()
 {
+    _binding = ExpressionBinding();
+
     bool inQuotes = false;
     int inVar = 0;
     int startPos = 0;
@@ -550,11 +611,12 @@ StringExpression::eval() const
 {
     if ( _dirty )
     {
-        std::stringstream buf;
+        // append into the previous result so its storage is reused
+        std::string& value = const_cast<StringExpression*>(this)->_value;
+        value.clear();
         for( AtomVector::const_iterator i = _infix.begin(); i != _infix.end(); ++i )
-            buf << i->second;
+            value.append( i->second );
 
-        const_cast<StringExpression*>(this)->_value = buf.str();
         const_cast<StringExpression*>(this)->_dirty = false;
     }
 
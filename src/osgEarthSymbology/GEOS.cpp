@@ -19,6 +19,8 @@
 #ifdef OSGEARTH_HAVE_GEOS
 
 #include <osgEarthSymbology/GEOS>
+#include <osgEarth/ThreadingUtils>
+#include <osgEarth/Containers>
 #include <osg/Notify>
 
 #include <geos/geom/PrecisionModel.h>
@@ -34,6 +36,7 @@
 #include <geos/geom/LineString.h>
 #include <geos/geom/MultiLineString.h>
 #include <geos/geom/LinearRing.h>
+#include <geos/geom/prep/PreparedGeometryFactory.h>
 #include <geos/operation/valid/IsValidOp.h>
 #include <geos/util/IllegalArgumentException.h>
 
@@ -210,9 +213,22 @@ namespace
         }
         return output;
     }
+
+    PerThreadObject<GEOSContext> s_contexts;
+
+    // this thread's entry in s_contexts
+    OE_THREAD_LOCAL GEOSContext* s_context = 0L;
 }
 
 
+GEOSContext&
+GEOSContext::getThreadContext()
+{
+    if ( !s_context )
+        s_context = &s_contexts.get();
+    return *s_context;
+}
+
 GEOSContext::GEOSContext()
 {
     // double-precison:
@@ -358,5 +374,23 @@ GEOSContext::disposeGeometry(geom::Geometry* input)
     }
 }
 
+const geom::prep::PreparedGeometry*
+GEOSContext::prepareGeometry(const geom::Geometry* input)
+{
+    if ( !input )
+        return 0L;
+#if GEOS_VERSION_AT_LEAST(3,8)
+    return geom::prep::PreparedGeometryFactory::prepare( input ).release();
+#else
+    return geom::prep::PreparedGeometryFactory::prepare( input );
+#endif
+}
+
+void
+GEOSContext::disposePreparedGeometry(const geom::prep::PreparedGeometry* input)
+{
+    delete input;
+}
+
 #endif // OSGEARTH_HAVE_GEOS
 
@@ -41,6 +41,81 @@ using namespace geos::operation;
 
 #define LC "[Geometry] "
 
+#ifdef OSGEARTH_HAVE_GEOS
+namespace
+{
+    /**
+     * Intersects two GEOS geometries and exports the result. Returns true if
+     * the result is valid; an empty result sets output to an empty geometry
+     * and returns false.
+     */
+    bool cropGEOS(GEOSContext& gc, const geom::Geometry* inGeom, const geom::Geometry* cropGeom, osg::ref_ptr<Geometry>& output)
+    {
+        bool success = false;
+
+        geom::Geometry* outGeom = 0L;
+        try {
+            outGeom = overlay::OverlayOp::overlayOp(
+                inGeom,
+                cropGeom,
+                overlay::OverlayOp::opINTERSECTION );
+        }
+        catch (const geos::util::TopologyException& ex) {
+            GEOS_OUT << LC << "Crop(GEOS): "
+                << (ex.what()? ex.what() : " no error message")
+                << std::endl;
+            outGeom = 0L;
+        }
+        catch(const geos::util::GEOSException& ex) {
+            OE_INFO << LC << "Crop(GEOS): "
+                << (ex.what()? ex.what() : " no error message")
+                << std::endl;
+            outGeom = 0L;
+        }
+
+        if ( outGeom )
+        {
+            output = gc.exportGeometry( outGeom );
+
+            if ( output.valid())
+            {
+                if ( output->isValid() )
+                {
+                    success = true;
+                }
+                else
+                {
+                    // GEOS result is invalid
+                    output = 0L;
+                }
+            }
+            else
+            {
+                // set output to empty geometry to indicate the (valid) empty case,
+                // still returning false but allows for check.
+                if (outGeom->getNumPoints() == 0)
+                {
+                    output = new osgEarth::Symbology::Geometry();
+                }
+            }
+
+            gc.disposeGeometry( outGeom );
+        }
+
+        return success;
+    }
+}
+
+struct PreparedCropPolygon::GEOSData
+{
+    GEOSContext*                        context;
+    geom::Geometry*                     geometry;
+    const geom::prep::PreparedGeometry* prepared;
+};
+#else
+struct PreparedCropPolygon::GEOSData { };
+#endif
+
 
 Geometry::Geometry( const Geometry& rhs ) :
 osgEarth::MixinVector<osg::Vec3d,osg::Referenced>( rhs )
@@ -158,7 +233,7 @@ Geometry::buffer(double distance,
 {
 #ifdef OSGEARTH_HAVE_GEOS   
 
-    GEOSContext gc;
+    GEOSContext& gc = GEOSContext::getThreadContext();
 
     geom::Geometry* inGeom = gc.importGeometry( this );
     if ( inGeom )
@@ -238,67 +313,76 @@ Geometry::crop( const Polygon* cropPoly, osg::ref_ptr<Geometry>& output ) const
     bool success = false;
     output = 0L;
 
-    GEOSContext gc;
+    GEOSContext& gc = GEOSContext::getThreadContext();
 
     //Create the GEOS Geometries
     geom::Geometry* inGeom   = gc.importGeometry( this );
     geom::Geometry* cropGeom = gc.importGeometry( cropPoly );
 
-    if ( inGeom )
+    if ( inGeom && cropGeom )
     {    
-        geom::Geometry* outGeom = 0L;
-        try {
-            outGeom = overlay::OverlayOp::overlayOp(
-                inGeom,
-                cropGeom,
-                overlay::OverlayOp::opINTERSECTION );
-        }
-        catch (const geos::util::TopologyException& ex) {
-            GEOS_OUT << LC << "Crop(GEOS): "
-                << (ex.what()? ex.what() : " no error message")
-                << std::endl;
-            outGeom = 0L;
-        }
-        catch(const geos::util::GEOSException& ex) {
-            OE_INFO << LC << "Crop(GEOS): "
-                << (ex.what()? ex.what() : " no error message")
-                << std::endl;
-            outGeom = 0L;
-        }
+        success = cropGEOS( gc, inGeom, cropGeom, output );
+    }
 
-        if ( outGeom )
-        {
-            output = gc.exportGeometry( outGeom );
+    //Destroy the geometry
+    gc.disposeGeometry( cropGeom );
+    gc.disposeGeometry( inGeom );
 
-            if ( output.valid())
+    return success;
+
+#else // OSGEARTH_HAVE_GEOS
+
+    OE_WARN << LC << "Crop failed - GEOS not available" << std::endl;
+    return false;
+
+#endif // OSGEARTH_HAVE_GEOS
+}
+
+bool
+Geometry::crop( const PreparedCropPolygon* cropPoly, osg::ref_ptr<Geometry>& output ) const
+{
+#ifdef OSGEARTH_HAVE_GEOS
+    bool success = false;
+    output = 0L;
+
+    if ( !cropPoly || !cropPoly->_geos )
+        return false;
+
+    GEOSContext& gc = GEOSContext::getThreadContext();
+
+    geom::Geometry* inGeom = gc.importGeometry( this );
+    if ( inGeom )
+    {
+        const geom::prep::PreparedGeometry* prepared = cropPoly->_geos->prepared;
+
+        try
+        {
+            if ( prepared && prepared->disjoint(inGeom) )
             {
-                if ( output->isValid() )
-                {
-                    success = true;
-                }
-                else
-                {
-                    // GEOS result is invalid
+                // the (valid) empty case, as above
+                output = new osgEarth::Symbology::Geometry();
+            }
+            else if ( prepared && prepared->contains(inGeom) )
+            {
+                output = gc.exportGeometry( inGeom );
+                success = output.valid() && output->isValid();
+                if ( !success )
                     output = 0L;
-                }
             }
             else
             {
-                // set output to empty geometry to indicate the (valid) empty case,
-                // still returning false but allows for check.
-                if (outGeom->getNumPoints() == 0)
-                {
-                    output = new osgEarth::Symbology::Geometry();
-                }
+                success = cropGEOS( gc, inGeom, cropPoly->_geos->geometry, output );
             }
-
-            gc.disposeGeometry( outGeom );
         }
-    }
+        catch(const geos::util::GEOSException& ex) {
+            OE_INFO << LC << "Crop(GEOS): "
+                << (ex.what()? ex.what() : " no error message")
+                << std::endl;
+            output = 0L;
+        }
 
-    //Destroy the geometry
-    gc.disposeGeometry( cropGeom );
-    gc.disposeGeometry( inGeom );
+        gc.disposeGeometry( inGeom );
+    }
 
     return success;
 
@@ -329,7 +413,7 @@ Geometry::geounion( const Geometry* other, osg::ref_ptr<Geometry>& output ) cons
     bool success = false;
     output = 0L;
 
-    GEOSContext gc;
+    GEOSContext& gc = GEOSContext::getThreadContext();
 
     //Create the GEOS Geometries
     geom::Geometry* inGeom   = gc.importGeometry( this );
@@ -406,7 +490,7 @@ Geometry::difference( const Polygon* diffPolygon, osg::ref_ptr<Geometry>& output
 {
 #ifdef OSGEARTH_HAVE_GEOS
 
-    GEOSContext gc;
+    GEOSContext& gc = GEOSContext::getThreadContext();
 
     //Create the GEOS Geometries
     geom::Geometry* inGeom   = gc.importGeometry( this );
@@ -467,7 +551,7 @@ Geometry::intersects(
 {
 #ifdef OSGEARTH_HAVE_GEOS
 
-    GEOSContext gc;
+    GEOSContext& gc = GEOSContext::getThreadContext();
 
     //Create the GEOS Geometries
     geom::Geometry* inGeom   = gc.importGeometry( this );
@@ -904,6 +988,47 @@ Polygon::removeColinearPoints()
 
 //----------------------------------------------------------------------------
 
+PreparedCropPolygon::PreparedCropPolygon( const Polygon* polygon ) :
+_polygon( polygon ),
+_geos   ( 0L )
+{
+#ifdef OSGEARTH_HAVE_GEOS
+    GEOSContext& gc = GEOSContext::getThreadContext();
+
+    geom::Geometry* geometry = gc.importGeometry( polygon );
+    if ( geometry )
+    {
+        _geos = new GEOSData();
+        _geos->context  = &gc;
+        _geos->geometry = geometry;
+        _geos->prepared = 0L;
+        try {
+            _geos->prepared = gc.prepareGeometry( geometry );
+        }
+        catch(const geos::util::GEOSException& ex) {
+            // crops still work, through the overlay alone
+            OE_INFO << LC << "PreparedCropPolygon(GEOS): "
+                << (ex.what()? ex.what() : " no error message")
+                << std::endl;
+        }
+    }
+#endif
+}
+
+PreparedCropPolygon::~PreparedCropPolygon()
+{
+#ifdef OSGEARTH_HAVE_GEOS
+    if ( _geos )
+    {
+        _geos->context->disposePreparedGeometry( _geos->prepared );
+        _geos->context->disposeGeometry( _geos->geometry );
+        delete _geos;
+    }
+#endif
+}
+
+//----------------------------------------------------------------------------
+
 MultiGeometry::MultiGeometry( const MultiGeometry& rhs ) :
 Geometry( rhs )
 {
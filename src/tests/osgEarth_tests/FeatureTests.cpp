@@ -23,7 +23,10 @@
 #include <osgEarth/catch.hpp>
 
 #include <osgEarthFeatures/Feature>
+#include <osgEarthFeatures/FeatureBatch>
 #include <osgEarthFeatures/GeometryUtils>
+#include <osgEarthFeatures/FeatureListSource>
+#include <osgEarthFeatures/FeatureCursor>
 
 using namespace osgEarth;
 using namespace osgEarth::Symbology;
@@ -105,3 +108,165 @@ TEST_CASE("Feature handles attributes correctly.") {
         REQUIRE(feature->getBool("bool") == false);
     }
 }
+
+TEST_CASE("FeatureBatch stores attributes in shared columns") {
+    osg::ref_ptr< FeatureBatch > batch = new FeatureBatch();
+    const SpatialReference* srs = osgEarth::SpatialReference::create("wgs84");
+    unsigned name = batch->addField("Name");
+    unsigned height = batch->addField("height");
+
+    osg::ref_ptr< Feature > a = batch->createFeature(new Geometry(), srs);
+    osg::ref_ptr< Feature > b = batch->createFeature(new Geometry(), srs);
+    batch->set(a->getBatchRow(), name, std::string("first"));
+    batch->set(a->getBatchRow(), height, 12);
+    batch->setNull(b->getBatchRow(), height, ATTRTYPE_DOUBLE);
+
+    SECTION("Features read their own row, with case-insensitive names") {
+        REQUIRE(batch->addField("NAME") == name);
+        REQUIRE(a->getString("name") == "first");
+        REQUIRE(a->getDouble("HEIGHT") == 12.0);
+        REQUIRE(a->getString("height") == "12");
+        REQUIRE(b->hasAttr("name") == false);
+        REQUIRE(b->hasAttr("height") == true);
+        REQUIRE(b->isSet("height") == false);
+        REQUIRE(b->getDouble("height", 3.0) == 3.0);
+    }
+
+    SECTION("Expressions see the same values as the getters") {
+        NumericExpression expr("[height] * 2");
+        REQUIRE(a->eval(expr, (Session*)0L) == 24.0);
+        REQUIRE(b->eval(expr, (Session*)0L) == 0.0);
+
+        StringExpression label("[name]");
+        REQUIRE(a->eval(label, (Session*)0L) == "first");
+    }
+
+    SECTION("Setting an attribute copies the row into the feature") {
+        osg::ref_ptr< Feature > copy = osg::clone(a.get(), osg::CopyOp::DEEP_COPY_ALL);
+        REQUIRE(copy->getBatch() == batch.get());
+
+        copy->set("height", 20.0);
+        REQUIRE(copy->getBatch() == 0L);
+        REQUIRE(copy->getDouble("height") == 20.0);
+        REQUIRE(copy->getString("name") == "first");
+        REQUIRE(a->getDouble("height") == 12.0);
+    }
+
+    SECTION("Reading the attribute table keeps the batch") {
+        const Feature* constA = a.get();
+        const AttributeTable& attrs = constA->getAttrs();
+        REQUIRE(a->getBatch() == batch.get());
+        REQUIRE(attrs.size() == 2);
+        REQUIRE(&constA->getAttrs() == &attrs);
+
+        a->set("height", 20.0);
+        REQUIRE(a->getBatch() == 0L);
+        REQUIRE(a->getString("name") == "first");
+        REQUIRE(a->getDouble("height") == 20.0);
+    }
+
+    SECTION("Packing moves attributes into a batch") {
+        FeatureList features;
+        features.push_back(new Feature(new Geometry(), srs));
+        features.back()->set("kind", std::string("road"));
+        features.back()->set("lanes", 4);
+        FeatureBatch::pack(features);
+        REQUIRE(features.back()->getBatch() != 0L);
+        REQUIRE(features.back()->getInt("lanes") == 4);
+        REQUIRE(features.back()->getAttrs().size() == 2);
+    }
+}
+
+TEST_CASE("Feature::evalBatch gives the same results as Feature::eval") {
+    const SpatialReference* srs = osgEarth::SpatialReference::create("wgs84");
+    osg::ref_ptr< FeatureBatch > batch = new FeatureBatch();
+    unsigned a = batch->addField("a");
+    unsigned b = batch->addField("b");
+
+    // alternate between batch rows and features with their own attributes
+    FeatureList features;
+    for (int i = 0; i < 600; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            Feature* feature = batch->createFeature(new Geometry(), srs);
+            if (i % 3 != 0)
+                batch->set(feature->getBatchRow(), a, i);
+            batch->set(feature->getBatchRow(), b, 0.5 * (double)(i % 7));
+            features.push_back(feature);
+        }
+        else
+        {
+            Feature* feature = new Feature(new Geometry(), srs);
+            if (i % 3 != 0)
+                feature->set("a", i);
+            feature->set("b", 0.5 * (double)(i % 7));
+            features.push_back(feature);
+        }
+    }
+
+    NumericExpression expr("max([a], 100) / 2 + [b] * 3 - (([a] % 5))");
+    std::vector<double> results;
+    Feature::evalBatch(expr, features, 0L, results);
+    REQUIRE(results.size() == 600);
+
+    unsigned mismatches = 0;
+    unsigned i = 0;
+    for (FeatureList::const_iterator f = features.begin(); f != features.end(); ++f, ++i)
+    {
+        NumericExpression single("max([a], 100) / 2 + [b] * 3 - (([a] % 5))");
+        if (results[i] != f->get()->eval(single, (FilterContext*)0L))
+            ++mismatches;
+    }
+    REQUIRE(mismatches == 0);
+}
+
+TEST_CASE("FeatureListSource returns only the features within the query bounds") {
+    osg::ref_ptr< FeatureListSource > source = new FeatureListSource();
+    const SpatialReference* srs = osgEarth::SpatialReference::create("wgs84");
+
+    // a 100x50 grid of points, one per degree
+    for (int y = 0; y < 50; ++y)
+    {
+        for (int x = 0; x < 100; ++x)
+        {
+            PointSet* point = new PointSet();
+            point->push_back(osg::Vec3d(x, y, 0));
+            source->insertFeature(new Feature(point, srs, Style(), y*100 + x));
+        }
+    }
+
+    Query query;
+    query.bounds() = Bounds(9.5, 9.5, 19.5, 14.5);
+
+    SECTION("Bounded queries return the features inside, in list order") {
+        osg::ref_ptr< FeatureCursor > cursor = source->createFeatureCursor(query);
+        FeatureList features;
+        cursor->fill(features);
+        REQUIRE(features.size() == 50);
+        REQUIRE(features.front()->getGeometry()->front() == osg::Vec3d(10, 10, 0));
+        REQUIRE(features.back()->getGeometry()->front() == osg::Vec3d(19, 14, 0));
+    }
+
+    SECTION("The index picks up inserted features") {
+        PointSet* point = new PointSet();
+        point->push_back(osg::Vec3d(15, 12.5, 0));
+        source->insertFeature(new Feature(point, srs, Style(), 5000));
+
+        osg::ref_ptr< FeatureCursor > cursor = source->createFeatureCursor(query);
+        FeatureList features;
+        cursor->fill(features);
+        REQUIRE(features.size() == 51);
+    }
+
+    SECTION("Cursors clone features unless told not to") {
+        osg::ref_ptr< FeatureCursor > cursor = source->createFeatureCursor(query);
+        osg::ref_ptr< Feature > clone = cursor->nextFeature();
+        REQUIRE(source->getFeature(clone->getFID()) != clone.get());
+
+        source->setCloneFeatures(false);
+        cursor = source->createFeatureCursor(query);
+        osg::ref_ptr< Feature > shared = cursor->nextFeature();
+        REQUIRE(source->getFeature(shared->getFID()) == shared.get());
+    }
+}
@@ -0,0 +1,211 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/FileUtils>
+#include <osgEarthDrivers/cache_filesystem/FileSystemCache>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <osgDB/WriteFile>
+#include <fstream>
+#include <cstdio>
+
+#ifdef _WIN32
+#   include <direct.h>
+#   define rmdir _rmdir
+#else
+#   include <unistd.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers;
+
+namespace
+{
+    const char* ROOT = "osgearth_tests_fscache";
+
+    void removeTree(const std::string& path)
+    {
+        if ( osgDB::fileType(path) == osgDB::DIRECTORY )
+        {
+            osgDB::DirectoryContents dc = osgDB::getDirectoryContents(path);
+            for(osgDB::DirectoryContents::const_iterator i = dc.begin(); i != dc.end(); ++i)
+            {
+                if ( *i != "." && *i != ".." )
+                    removeTree( osgDB::concatPaths(path, *i) );
+            }
+            ::rmdir( path.c_str() );
+        }
+        else
+        {
+            ::remove( path.c_str() );
+        }
+    }
+
+    Cache* openCache()
+    {
+        FileSystemCacheOptions options;
+        options.rootPath() = ROOT;
+        return CacheFactory::create( options );
+    }
+
+    std::string readBack(CacheBin* bin, const std::string& key)
+    {
+        ReadResult r = bin->readString(key, 0L);
+        return r.succeeded() ? r.getString() : std::string();
+    }
+}
+
+TEST_CASE( "FileSystemCache stores each entry in a single file" ) {
+
+    removeTree( ROOT );
+
+    osg::ref_ptr<Cache> cache = openCache();
+    REQUIRE( cache.valid() );
+    REQUIRE( cache->isOK() );
+
+    CacheBin* bin = cache->addBin( "layout" );
+    REQUIRE( bin != 0L );
+
+    Config meta;
+    meta.add( "source", "test" );
+    osg::ref_ptr<StringObject> hello = new StringObject( "hello" );
+    REQUIRE( bin->write("tile", hello.get(), meta, 0L) );
+
+    std::string path = bin->getHashedKey( "tile" );
+
+    SECTION("A new bin is marked with the current layout") {
+        REQUIRE( osgDB::fileExists(osgDB::concatPaths(osgDB::concatPaths(ROOT, "layout"), "osgearth_cache_v2")) );
+    }
+
+    SECTION("The entry file holds the header and the payload") {
+        REQUIRE( osgDB::getLowerCaseFileExtension(path) == "oec" );
+        REQUIRE( osgDB::fileExists(path) );
+        REQUIRE( !osgDB::fileExists(osgDB::getNameLessExtension(path) + ".meta") );
+
+        std::ifstream in( path.c_str(), std::ios_base::in | std::ios_base::binary );
+        char magic[4];
+        in.read( magic, 4 );
+        REQUIRE( in.good() );
+        REQUIRE( std::string(magic, 4) == "oef2" );
+    }
+
+    SECTION("Reading returns the object, metadata and write time") {
+        ReadResult r = bin->readString( "tile", 0L );
+        REQUIRE( r.succeeded() );
+        REQUIRE( r.getString() == "hello" );
+        REQUIRE( r.metadata().value("source") == "test" );
+        REQUIRE( r.lastModifiedTime() > 0 );
+        REQUIRE( bin->getRecordStatus("tile") == CacheBin::STATUS_OK );
+    }
+
+    SECTION("Rewriting swaps in a new file without leaving temporaries") {
+        osg::ref_ptr<StringObject> world = new StringObject( "world" );
+        REQUIRE( bin->write("tile", world.get(), Config(), 0L) );
+        REQUIRE( readBack(bin, "tile") == "world" );
+
+        osgDB::DirectoryContents dc = osgDB::getDirectoryContents( osgDB::getFilePath(path) );
+        unsigned files = 0u;
+        for(osgDB::DirectoryContents::const_iterator i = dc.begin(); i != dc.end(); ++i)
+        {
+            if ( *i == "." || *i == ".." )
+                continue;
+            REQUIRE( osgDB::getLowerCaseFileExtension(*i) != "tmp" );
+            ++files;
+        }
+        REQUIRE( files == 1u );
+    }
+
+    SECTION("Removing the entry deletes its file") {
+        REQUIRE( bin->remove("tile") );
+        REQUIRE( !osgDB::fileExists(path) );
+        REQUIRE( bin->getRecordStatus("tile") == CacheBin::STATUS_NOT_FOUND );
+    }
+
+    cache = 0L;
+    removeTree( ROOT );
+}
+
+TEST_CASE( "FileSystemCache migrates entries from the previous layout" ) {
+
+    removeTree( ROOT );
+
+    // lay down a bin the way older versions wrote it: an unhashed .osgb
+    // file with a .meta sidecar, and no layout marker.
+    std::string binPath = osgDB::concatPaths( ROOT, "legacy" );
+    REQUIRE( osgDB::makeDirectory(binPath) );
+
+    std::string base = osgDB::concatPaths( binPath, "tile" );
+    osg::ref_ptr<StringObject> old = new StringObject( "old" );
+    REQUIRE( osgDB::writeObjectFile(*old.get(), base + ".osgb") );
+
+    Config oldMeta;
+    oldMeta.add( "source", "legacy" );
+    {
+        std::ofstream out( (base + ".meta").c_str() );
+        out << oldMeta.toJSON();
+    }
+
+    osg::ref_ptr<Cache> cache = openCache();
+    REQUIRE( cache.valid() );
+
+    CacheBin* bin = cache->addBin( "legacy" );
+    REQUIRE( bin != 0L );
+    bin->setHashKeys( false );
+
+    SECTION("Legacy entries are found before they move") {
+        REQUIRE( bin->getRecordStatus("tile") == CacheBin::STATUS_OK );
+        REQUIRE( osgDB::fileExists(base + ".osgb") );
+    }
+
+    SECTION("Reading an entry moves it to the new layout") {
+        ReadResult r = bin->readString( "tile", 0L );
+        REQUIRE( r.succeeded() );
+        REQUIRE( r.getString() == "old" );
+        REQUIRE( r.metadata().value("source") == "legacy" );
+
+        REQUIRE( !osgDB::fileExists(base + ".osgb") );
+        REQUIRE( !osgDB::fileExists(base + ".meta") );
+        REQUIRE( osgDB::fileExists(bin->getHashedKey("tile")) );
+
+        // the second read comes from the new file.
+        REQUIRE( readBack(bin, "tile") == "old" );
+    }
+
+    SECTION("Writing an entry replaces the legacy copy") {
+        osg::ref_ptr<StringObject> fresh = new StringObject( "new" );
+        REQUIRE( bin->write("tile", fresh.get(), Config(), 0L) );
+        REQUIRE( !osgDB::fileExists(base + ".osgb") );
+        REQUIRE( readBack(bin, "tile") == "new" );
+    }
+
+    SECTION("Missing keys are not found in either layout") {
+        REQUIRE( bin->getRecordStatus("other") == CacheBin::STATUS_NOT_FOUND );
+        REQUIRE( !bin->readString("other", 0L).succeeded() );
+    }
+
+    cache = 0L;
+    removeTree( ROOT );
+}
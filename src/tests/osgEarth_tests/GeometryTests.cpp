@@ -0,0 +1,103 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthSymbology/Geometry>
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+
+namespace
+{
+    Polygon* makeBox(double xmin, double ymin, double xmax, double ymax)
+    {
+        Polygon* box = new Polygon();
+        box->push_back( osg::Vec3d(xmin, ymin, 0) );
+        box->push_back( osg::Vec3d(xmax, ymin, 0) );
+        box->push_back( osg::Vec3d(xmax, ymax, 0) );
+        box->push_back( osg::Vec3d(xmin, ymax, 0) );
+        return box;
+    }
+
+    // crops a geometry both ways and requires the same outcome.
+    void requireSameCrop(const Geometry* input, const Polygon* cropPoly, const PreparedCropPolygon* prepared)
+    {
+        osg::ref_ptr<Geometry> plain, fast;
+        bool plainOK = input->crop( cropPoly, plain );
+        bool fastOK = input->crop( prepared, fast );
+
+        REQUIRE( fastOK == plainOK );
+        REQUIRE( fast.valid() == plain.valid() );
+        if ( plain.valid() )
+        {
+            REQUIRE( fast->getTotalPointCount() == plain->getTotalPointCount() );
+            if ( plain->getTotalPointCount() > 0 )
+            {
+                Bounds a = plain->getBounds(), b = fast->getBounds();
+                REQUIRE( b.xMin() == a.xMin() );
+                REQUIRE( b.yMin() == a.yMin() );
+                REQUIRE( b.xMax() == a.xMax() );
+                REQUIRE( b.yMax() == a.yMax() );
+            }
+        }
+    }
+}
+
+TEST_CASE("Cropping to a prepared polygon matches cropping to the polygon") {
+    osg::ref_ptr<Polygon> cropPoly = makeBox(0, 0, 10, 10);
+    osg::ref_ptr<PreparedCropPolygon> prepared = new PreparedCropPolygon( cropPoly.get() );
+
+    SECTION("for a polygon inside") {
+        osg::ref_ptr<Polygon> input = makeBox(2, 2, 4, 4);
+        requireSameCrop( input.get(), cropPoly.get(), prepared.get() );
+    }
+
+    SECTION("for a polygon outside") {
+        osg::ref_ptr<Polygon> input = makeBox(20, 20, 24, 24);
+        requireSameCrop( input.get(), cropPoly.get(), prepared.get() );
+    }
+
+    SECTION("for a polygon straddling the edge") {
+        osg::ref_ptr<Polygon> input = makeBox(5, 5, 15, 8);
+        requireSameCrop( input.get(), cropPoly.get(), prepared.get() );
+    }
+
+    SECTION("for a polygon with a hole straddling the edge") {
+        osg::ref_ptr<Polygon> input = makeBox(5, 2, 15, 8);
+        osg::ref_ptr<Ring> hole = new Ring();
+        hole->push_back( osg::Vec3d(8, 4, 0) );
+        hole->push_back( osg::Vec3d(8, 6, 0) );
+        hole->push_back( osg::Vec3d(12, 6, 0) );
+        hole->push_back( osg::Vec3d(12, 4, 0) );
+        input->getHoles().push_back( hole.get() );
+        requireSameCrop( input.get(), cropPoly.get(), prepared.get() );
+    }
+
+    SECTION("for a line crossing the edge") {
+        osg::ref_ptr<LineString> input = new LineString();
+        input->push_back( osg::Vec3d(-5, 5, 0) );
+        input->push_back( osg::Vec3d(5, 5, 0) );
+        input->push_back( osg::Vec3d(5, 15, 0) );
+        requireSameCrop( input.get(), cropPoly.get(), prepared.get() );
+    }
+}
@@ -0,0 +1,584 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/CachePolicy>
+#include <osgEarth/DateTime>
+#include <osgEarth/HTTPClient>
+#include <osgEarth/Progress>
+#include <osgEarth/StringUtils>
+#include <osgEarth/URI>
+#include <OpenThreads/Atomic>
+#include <OpenThreads/Thread>
+#include <osg/Timer>
+
+#include <cstring>
+#include <list>
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+   typedef SOCKET socket_t;
+#else
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#  include <sys/select.h>
+#  include <netinet/in.h>
+#  include <unistd.h>
+   typedef int socket_t;
+#  define INVALID_SOCKET (-1)
+#  define closesocket ::close
+#endif
+
+#ifdef MSG_NOSIGNAL
+#  define SEND_FLAGS MSG_NOSIGNAL
+#else
+#  define SEND_FLAGS 0
+#endif
+
+using namespace osgEarth;
+
+namespace
+{
+    // A loopback HTTP/1.1 server with canned routes, served from one thread:
+    //   /text/<n>  200, "hello <n>"
+    //   /hold/<n>  200, "hello <n>", but not until release() is called
+    //   /etag/<n>  200, "tag <n>", with validators; 304 if If-None-Match is "v<n>"
+    //   /bad       400, with a body
+    //   /error     500
+    //   anything else is a 404
+    class MockHTTPServer : public OpenThreads::Thread
+    {
+    public:
+        MockHTTPServer() : _listener(INVALID_SOCKET), _port(0)
+        {
+#ifdef _WIN32
+            WSADATA data;
+            WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+            _listener = ::socket(AF_INET, SOCK_STREAM, 0);
+
+            // any free port on the loopback interface
+            sockaddr_in addr;
+            ::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            socklen_t len = sizeof(addr);
+
+            if (_listener != INVALID_SOCKET &&
+                ::bind(_listener, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+                ::listen(_listener, 64) == 0 &&
+                ::getsockname(_listener, (sockaddr*)&addr, &len) == 0)
+            {
+                _port = ntohs(addr.sin_port);
+                start();
+            }
+        }
+
+        ~MockHTTPServer()
+        {
+            _done.exchange(1);
+            if (isRunning())
+                join();
+
+            for (std::list<Connection>::iterator c = _connections.begin(); c != _connections.end(); ++c)
+                closesocket(c->_socket);
+            if (_listener != INVALID_SOCKET)
+                closesocket(_listener);
+#ifdef _WIN32
+            WSACleanup();
+#endif
+        }
+
+        bool valid() const { return _port != 0; }
+
+        std::string url(const std::string& path) const
+        {
+            return Stringify() << "http://127.0.0.1:" << _port << path;
+        }
+
+        // Answers the held requests, and every /hold/ request after them
+        void release() { _released.exchange(1); }
+
+        // Waits until this many requests are held at once
+        bool waitForHeld(unsigned count) const { return waitFor(_held, count); }
+
+        // Waits until the client has closed this many connections with a request still held
+        bool waitForAbandoned(unsigned count) const { return waitFor(_abandoned, count); }
+
+        // Number of /etag/ requests answered, and how many of them were a 304
+        unsigned etagRequests() const { return _etagRequests; }
+        unsigned notModified() const { return _notModified; }
+
+        void run()
+        {
+            while (!_done)
+            {
+                fd_set readable;
+                FD_ZERO(&readable);
+                FD_SET(_listener, &readable);
+                socket_t maxSocket = _listener;
+                for (std::list<Connection>::iterator c = _connections.begin(); c != _connections.end(); ++c)
+                {
+                    FD_SET(c->_socket, &readable);
+                    if (c->_socket > maxSocket)
+                        maxSocket = c->_socket;
+                }
+
+                timeval timeout;
+                timeout.tv_sec = 0;
+                timeout.tv_usec = 20000;
+                if (::select((int)maxSocket + 1, &readable, 0L, 0L, &timeout) < 0)
+                    break;
+
+                for (std::list<Connection>::iterator c = _connections.begin(); c != _connections.end(); )
+                {
+                    bool open = true;
+                    if (FD_ISSET(c->_socket, &readable))
+                    {
+                        char buffer[4096];
+                        int n = ::recv(c->_socket, buffer, sizeof(buffer), 0);
+                        if (n > 0)
+                            c->_input.append(buffer, n);
+                        else
+                            open = false;
+                    }
+
+                    if (open)
+                        open = serve(*c);
+
+                    if (!open)
+                    {
+                        if (!c->_held.empty())
+                        {
+                            --_held;
+                            ++_abandoned;
+                        }
+                        closesocket(c->_socket);
+                        c = _connections.erase(c);
+                    }
+                    else ++c;
+                }
+
+                if (FD_ISSET(_listener, &readable))
+                {
+                    Connection c;
+                    c._socket = ::accept(_listener, 0L, 0L);
+                    if (c._socket != INVALID_SOCKET)
+                        _connections.push_back(c);
+                }
+            }
+        }
+
+    private:
+        struct Connection
+        {
+            socket_t    _socket;
+            std::string _input;
+            std::string _held;  // the request waiting for release(), if any
+        };
+
+        // Answers whatever complete requests the connection has; false if it failed
+        bool serve(Connection& c)
+        {
+            if (!c._held.empty())
+            {
+                if (!_released)
+                    return true;
+
+                std::string request;
+                request.swap(c._held);
+                --_held;
+                if (!answer(c, request))
+                    return false;
+            }
+
+            std::string::size_type end;
+            while (c._held.empty() && (end = c._input.find("\r\n\r\n")) != std::string::npos)
+            {
+                std::string request = c._input.substr(0, end);
+                c._input.erase(0, end + 4);
+                std::string path = getPath(request);
+                if (path.empty())
+                    return false;
+
+                if (startsWith(path, "/hold/") && !_released)
+                {
+                    c._held = request;
+                    ++_held;
+                }
+                else if (!answer(c, request))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool answer(Connection& c, const std::string& request)
+        {
+            std::string path = getPath(request);
+            return
+                startsWith(path, "/etag/")                               ? answerConditional(c, request, path.substr(6)) :
+                startsWith(path, "/text/") || startsWith(path, "/hold/") ? respond(c, 200, "OK", "hello " + path.substr(6)) :
+                path == "/bad"                                           ? respond(c, 400, "Bad Request", "bad request") :
+                path == "/error"                                         ? respond(c, 500, "Internal Server Error", "") :
+                                                                           respond(c, 404, "Not Found", "");
+        }
+
+        // Sends the validators with every response, plus a header whose value has colons in it
+        bool answerConditional(Connection& c, const std::string& request, const std::string& version)
+        {
+            ++_etagRequests;
+            std::string headers = Stringify()
+                << "ETag: \"v" << version << "\"\r\n"
+                << "Last-Modified: Wed, 21 Oct 2015 07:28:00 GMT\r\n"
+                << "X-Link: http://127.0.0.1:80/tag?v=" << version << "\r\n";
+
+            if (getHeader(request, "If-None-Match") == "\"v" + version + "\"")
+            {
+                ++_notModified;
+                return respond(c, 304, "Not Modified", "", headers);
+            }
+            return respond(c, 200, "OK", "tag " + version, headers);
+        }
+
+        bool respond(Connection& c, int code, const std::string& reason, const std::string& body, const std::string& headers = "")
+        {
+            std::string response = Stringify()
+                << "HTTP/1.1 " << code << " " << reason << "\r\n"
+                << "Content-Type: text/plain\r\n"
+                << "Content-Length: " << body.size() << "\r\n"
+                << headers
+                << "\r\n"
+                << body;
+            return ::send(c._socket, response.data(), (int)response.size(), SEND_FLAGS) == (int)response.size();
+        }
+
+        // "GET <path> HTTP/1.1"; empty if the request line is malformed
+        static std::string getPath(const std::string& request)
+        {
+            std::string::size_type first = request.find(' ');
+            std::string::size_type last = request.find(' ', first + 1);
+            if (first == std::string::npos || last == std::string::npos)
+                return "";
+            return request.substr(first + 1, last - first - 1);
+        }
+
+        // Value of a request header; names are case-insensitive
+        static std::string getHeader(const std::string& request, const std::string& name)
+        {
+            std::string::size_type start = request.find("\r\n");
+            while (start != std::string::npos)
+            {
+                start += 2;
+                std::string::size_type end = request.find("\r\n", start);
+                std::string line = request.substr(start, end == std::string::npos ? std::string::npos : end - start);
+                std::string::size_type colon = line.find(':');
+                if (colon != std::string::npos && ciEquals(trim(line.substr(0, colon)), name))
+                    return trim(line.substr(colon + 1));
+                start = end;
+            }
+            return "";
+        }
+
+        static bool waitFor(const OpenThreads::Atomic& counter, unsigned count)
+        {
+            osg::Timer_t start = osg::Timer::instance()->tick();
+            while ((unsigned)counter < count)
+            {
+                if (osg::Timer::instance()->delta_s(start, osg::Timer::instance()->tick()) > 10.0)
+                    return false;
+                OpenThreads::Thread::microSleep(10000);
+            }
+            return true;
+        }
+
+        socket_t               _listener;
+        unsigned short         _port;
+        std::list<Connection>  _connections;  // server thread only
+        OpenThreads::Atomic    _done;
+        OpenThreads::Atomic    _released;
+        OpenThreads::Atomic    _held;
+        OpenThreads::Atomic    _abandoned;
+        OpenThreads::Atomic    _etagRequests;
+        OpenThreads::Atomic    _notModified;
+    };
+
+    ReadResult readString(const HTTPRequest& request)
+    {
+        Threading::Future<AsyncReadResult> future = HTTPClient::readAsync(
+            request, AsyncReadResult::STRING);
+        AsyncReadResult* result = future.get();
+        return result ? result->getResult() : ReadResult(ReadResult::RESULT_UNKNOWN_ERROR);
+    }
+
+    ReadResult readString(const MockHTTPServer& server, const std::string& path)
+    {
+        return readString(HTTPRequest(server.url(path)));
+    }
+
+    // An in-memory bin that keeps each entry's timestamp, so a test can
+    // expire entries and see touch() renew them.
+    class TimedCacheBin : public CacheBin
+    {
+    public:
+        TimedCacheBin() : CacheBin("timed"), _writes(0u), _touches(0u) { }
+
+        // Backdates an entry so that any max-age policy considers it expired
+        void expire(const std::string& key) { _entries[key]._time = 1; }
+
+        const Config& metadata(const std::string& key) { return _entries[key]._meta; }
+
+        unsigned writes() const { return _writes; }
+        unsigned touches() const { return _touches; }
+
+        ReadResult readObject(const std::string& key, const osgDB::Options*)
+        {
+            Entries::const_iterator i = _entries.find(key);
+            if (i == _entries.end())
+                return ReadResult();
+
+            ReadResult r(const_cast<osg::Object*>(i->second._object.get()), i->second._meta);
+            r.setLastModifiedTime(i->second._time);
+            return r;
+        }
+
+        ReadResult readImage(const std::string& key, const osgDB::Options* dbo) { return readObject(key, dbo); }
+
+        ReadResult readString(const std::string& key, const osgDB::Options* dbo) { return readObject(key, dbo); }
+
+        bool write(const std::string& key, const osg::Object* object, const Config& meta, const osgDB::Options*)
+        {
+            Entry& entry = _entries[key];
+            entry._object = object;
+            entry._meta = meta;
+            entry._time = DateTime().asTimeStamp();
+            ++_writes;
+            return true;
+        }
+
+        RecordStatus getRecordStatus(const std::string& key)
+        {
+            return _entries.find(key) != _entries.end() ? STATUS_OK : STATUS_NOT_FOUND;
+        }
+
+        bool remove(const std::string& key) { return _entries.erase(key) > 0; }
+
+        bool touch(const std::string& key)
+        {
+            Entries::iterator i = _entries.find(key);
+            if (i == _entries.end())
+                return false;
+            i->second._time = DateTime().asTimeStamp();
+            ++_touches;
+            return true;
+        }
+
+        std::string getHashedKey(const std::string& key) const { return key; }
+
+    private:
+        struct Entry
+        {
+            Entry() : _time(0) { }
+            osg::ref_ptr<const osg::Object> _object;
+            Config                          _meta;
+            TimeStamp                       _time;
+        };
+        typedef std::map<std::string, Entry> Entries;
+
+        Entries  _entries;
+        unsigned _writes;
+        unsigned _touches;
+    };
+}
+
+TEST_CASE("HTTPClient::readAsync reads from a loopback server") {
+    MockHTTPServer server;
+    REQUIRE(server.valid());
+
+    SECTION("Strings come back with their response") {
+        Threading::Future<AsyncReadResult> future = HTTPClient::readAsync(
+            HTTPRequest(server.url("/text/1")), AsyncReadResult::STRING);
+        AsyncReadResult* result = future.get();
+        REQUIRE(result != 0L);
+        REQUIRE(result->getResponse().getCode() == HTTPResponse::OK);
+
+        ReadResult r = result->getResult();
+        REQUIRE(r.succeeded());
+        REQUIRE(r.getString() == "hello 1");
+    }
+
+    SECTION("Error responses decode into read result codes") {
+        REQUIRE(readString(server, "/missing").code() == ReadResult::RESULT_NOT_FOUND);
+        REQUIRE(readString(server, "/error").code() == ReadResult::RESULT_SERVER_ERROR);
+
+        // request errors keep the body for string reads
+        ReadResult bad = readString(server, "/bad");
+        REQUIRE(bad.code() == ReadResult::RESULT_SERVER_ERROR);
+        REQUIRE(bad.getString() == "bad request");
+    }
+
+#ifndef OSGEARTH_USE_WININET_FOR_HTTP
+    SECTION("Transfers started from one thread run side by side") {
+        const unsigned count = 4u;
+        REQUIRE(HTTPClient::getMaxAsyncHostConnections() >= (int)count);
+
+        std::vector< Threading::Future<AsyncReadResult> > futures;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            futures.push_back(HTTPClient::readAsync(
+                HTTPRequest(server.url("/hold/" + toString(i))), AsyncReadResult::STRING));
+        }
+
+        // every request reaches the server before any of them is answered
+        REQUIRE(server.waitForHeld(count));
+        server.release();
+
+        for (unsigned i = 0; i < count; ++i)
+        {
+            AsyncReadResult* result = futures[i].get();
+            REQUIRE(result != 0L);
+            REQUIRE(result->getResult().getString() == "hello " + toString(i));
+        }
+    }
+
+    SECTION("Dropping every future aborts the transfer") {
+        {
+            Threading::Future<AsyncReadResult> future = HTTPClient::readAsync(
+                HTTPRequest(server.url("/hold/1")), AsyncReadResult::STRING);
+            REQUIRE(server.waitForHeld(1u));
+        }
+        REQUIRE(server.waitForAbandoned(1u));
+    }
+
+    SECTION("Canceling the progress callback cancels the read") {
+        osg::ref_ptr<ProgressCallback> progress = new ProgressCallback();
+        Threading::Future<AsyncReadResult> future = HTTPClient::readAsync(
+            HTTPRequest(server.url("/hold/1")), AsyncReadResult::STRING, 0L, progress.get());
+        REQUIRE(server.waitForHeld(1u));
+
+        progress->cancel();
+        AsyncReadResult* result = future.get();
+        REQUIRE(result != 0L);
+        REQUIRE(result->getResponse().isCancelled());
+        REQUIRE(result->getResult().code() == ReadResult::RESULT_CANCELED);
+        REQUIRE(server.waitForAbandoned(1u));
+
+        // getResult() counted the transfer on this thread
+        REQUIRE(progress->stats("http_get_count") == 1.0);
+        REQUIRE(progress->stats("http_cancel_count") == 1.0);
+    }
+#endif
+}
+
+TEST_CASE("HTTPClient sends and keeps validators verbatim") {
+    MockHTTPServer server;
+    REQUIRE(server.valid());
+
+    SECTION("Response headers keep the colons in their values") {
+        ReadResult r = readString(server, "/etag/1");
+        REQUIRE(r.succeeded());
+        REQUIRE(r.getString() == "tag 1");
+        REQUIRE(r.metadata().value("ETag") == "\"v1\"");
+        REQUIRE(r.metadata().value("Last-Modified") == "Wed, 21 Oct 2015 07:28:00 GMT");
+        REQUIRE(r.metadata().value("X-Link") == "http://127.0.0.1:80/tag?v=1");
+    }
+
+    SECTION("A matching ETag comes back as not modified") {
+        ReadResult first = readString(server, "/etag/1");
+        REQUIRE(first.succeeded());
+
+        HTTPRequest request(server.url("/etag/1"));
+        request.setETag(first.metadata().value("ETag"));
+        ReadResult second = readString(request);
+        REQUIRE(second.code() == ReadResult::RESULT_NOT_MODIFIED);
+        REQUIRE(server.notModified() == 1u);
+    }
+
+    SECTION("A stale ETag gets the new content") {
+        HTTPRequest request(server.url("/etag/2"));
+        request.setETag("\"v1\"");
+        ReadResult r = readString(request);
+        REQUIRE(r.succeeded());
+        REQUIRE(r.getString() == "tag 2");
+        REQUIRE(server.notModified() == 0u);
+    }
+}
+
+TEST_CASE("URI revalidates expired cache entries") {
+    MockHTTPServer server;
+    REQUIRE(server.valid());
+
+    osg::ref_ptr<TimedCacheBin> bin = new TimedCacheBin();
+    osg::ref_ptr<CacheSettings> settings = new CacheSettings();
+    settings->setCacheBin(bin.get());
+    settings->cachePolicy() = CachePolicy(CachePolicy::USAGE_READ_WRITE);
+    settings->cachePolicy()->maxAge() = 3600;
+
+    osg::ref_ptr<osgDB::Options> options = new osgDB::Options();
+    settings->store(options.get());
+
+    URI uri(server.url("/etag/1"));
+    ReadResult first = uri.readString(options.get());
+    REQUIRE(first.succeeded());
+    REQUIRE(first.getString() == "tag 1");
+    REQUIRE(server.etagRequests() == 1u);
+    REQUIRE(bin->writes() == 1u);
+
+    // the response headers are cached along with the content
+    REQUIRE(bin->metadata(uri.cacheKey()).value("ETag") == "\"v1\"");
+    REQUIRE(bin->metadata(uri.cacheKey()).value("X-Link") == "http://127.0.0.1:80/tag?v=1");
+
+    SECTION("A fresh entry is read from the cache") {
+        ReadResult r = uri.readString(options.get());
+        REQUIRE(r.succeeded());
+        REQUIRE(r.isFromCache());
+        REQUIRE(server.etagRequests() == 1u);
+    }
+
+    SECTION("A 304 restores the expired entry and renews it") {
+        bin->expire(uri.cacheKey());
+
+        ReadResult r = uri.readString(options.get());
+        REQUIRE(r.succeeded());
+        REQUIRE(r.isFromCache());
+        REQUIRE(r.getString() == "tag 1");
+
+        // the request carried the cached ETag, and the entry was touched, not rewritten
+        REQUIRE(server.etagRequests() == 2u);
+        REQUIRE(server.notModified() == 1u);
+        REQUIRE(bin->touches() == 1u);
+        REQUIRE(bin->writes() == 1u);
+
+        // so it's fresh again
+        ReadResult again = uri.readString(options.get());
+        REQUIRE(again.isFromCache());
+        REQUIRE(server.etagRequests() == 2u);
+    }
+}
@@ -0,0 +1,272 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/Cache>
+#include <osgEarth/CacheBin>
+#include <osgEarth/StringUtils>
+#include <osgEarthDrivers/cache_packfile/PackFileCacheOptions>
+#include <osgDB/FileUtils>
+#include <osgDB/FileNameUtils>
+#include <OpenThreads/Thread>
+#include <algorithm>
+#include <fstream>
+#include <vector>
+#include <cstdio>
+
+#ifdef _WIN32
+#   include <direct.h>
+#   define rmdir _rmdir
+#else
+#   include <unistd.h>
+#endif
+
+using namespace osgEarth;
+using namespace osgEarth::Drivers::PackFileCache;
+
+namespace
+{
+    const char* ROOT = "osgearth_tests_packfile";
+
+    // records of this size fill a 1 MB segment five at a time.
+    const unsigned RECORD_SIZE = 200000u;
+
+    void removeTree(const std::string& path)
+    {
+        if ( osgDB::fileType(path) == osgDB::DIRECTORY )
+        {
+            osgDB::DirectoryContents dc = osgDB::getDirectoryContents(path);
+            for(osgDB::DirectoryContents::const_iterator i = dc.begin(); i != dc.end(); ++i)
+            {
+                if ( *i != "." && *i != ".." )
+                    removeTree( osgDB::concatPaths(path, *i) );
+            }
+            ::rmdir( path.c_str() );
+        }
+        else
+        {
+            ::remove( path.c_str() );
+        }
+    }
+
+    Cache* openCache(unsigned maxSizeMB =0u)
+    {
+        PackFileCacheOptions options;
+        options.rootPath() = ROOT;
+        options.maxSizeMB() = maxSizeMB;
+        options.segmentSizeMB() = 1u;
+        options.compactionInterval() = 3600u; // only compact when asked
+        return CacheFactory::create( options );
+    }
+
+    /** Simulates a crash: without an index, the next open rebuilds it from the segments. */
+    void dropIndex()
+    {
+        ::remove( osgDB::concatPaths(ROOT, "index.idx").c_str() );
+    }
+
+    std::vector<std::string> segmentFiles()
+    {
+        std::vector<std::string> result;
+        osgDB::DirectoryContents dc = osgDB::getDirectoryContents( ROOT );
+        for(osgDB::DirectoryContents::const_iterator i = dc.begin(); i != dc.end(); ++i)
+        {
+            if ( osgDB::getLowerCaseFileExtension(*i) == "pak" )
+                result.push_back( osgDB::concatPaths(ROOT, *i) );
+        }
+        std::sort( result.begin(), result.end() );
+        return result;
+    }
+
+    /** A distinct value for each key and version, so no two payloads are shared. */
+    std::string valueOf(const std::string& key, unsigned version, unsigned size =0u)
+    {
+        std::string value = Stringify() << key << "/" << version;
+        if ( size > value.size() )
+            value.resize( size, (char)('a' + version) );
+        return value;
+    }
+
+    bool put(CacheBin* bin, const std::string& key, const std::string& value)
+    {
+        osg::ref_ptr<StringObject> object = new StringObject( value );
+        return bin->write( key, object.get(), Config(), 0L );
+    }
+
+    std::string get(CacheBin* bin, const std::string& key)
+    {
+        ReadResult r = bin->readString( key, 0L );
+        return r.succeeded() ? r.getString() : std::string();
+    }
+}
+
+TEST_CASE( "PackFileCache rebuilds its index from the segments" ) {
+
+    removeTree( ROOT );
+    {
+        osg::ref_ptr<Cache> cache = openCache();
+        REQUIRE( cache.valid() );
+        REQUIRE( cache->isOK() );
+
+        CacheBin* tiles = cache->addBin( "tiles" );
+        REQUIRE( put(tiles, "a", valueOf("a", 1)) );
+        REQUIRE( put(tiles, "b", valueOf("b", 1)) );
+        REQUIRE( put(tiles, "b", valueOf("b", 2)) );
+        REQUIRE( put(tiles, "c", valueOf("c", 1)) );
+        REQUIRE( tiles->remove("c") );
+
+        CacheBin* gone = cache->addBin( "gone" );
+        REQUIRE( put(gone, "a", valueOf("gone.a", 1)) );
+        REQUIRE( gone->clear() );
+        REQUIRE( put(gone, "b", valueOf("gone.b", 1)) );
+    }
+    dropIndex();
+
+    SECTION("The latest version of each record survives") {
+        osg::ref_ptr<Cache> cache = openCache();
+        CacheBin* tiles = cache->addBin( "tiles" );
+        REQUIRE( get(tiles, "a") == valueOf("a", 1) );
+        REQUIRE( get(tiles, "b") == valueOf("b", 2) );
+    }
+
+    SECTION("Tombstones survive") {
+        osg::ref_ptr<Cache> cache = openCache();
+        CacheBin* tiles = cache->addBin( "tiles" );
+        REQUIRE( tiles->getRecordStatus("c") == CacheBin::STATUS_NOT_FOUND );
+        REQUIRE( get(tiles, "c").empty() );
+    }
+
+    SECTION("Clearing a bin survives, but only for older records of that bin") {
+        osg::ref_ptr<Cache> cache = openCache();
+        CacheBin* gone = cache->addBin( "gone" );
+        REQUIRE( gone->getRecordStatus("a") == CacheBin::STATUS_NOT_FOUND );
+        REQUIRE( get(gone, "b") == valueOf("gone.b", 1) );
+
+        CacheBin* tiles = cache->addBin( "tiles" );
+        REQUIRE( get(tiles, "a") == valueOf("a", 1) );
+    }
+
+    SECTION("A torn tail is dropped and appends continue after it") {
+        std::vector<std::string> segments = segmentFiles();
+        REQUIRE( !segments.empty() );
+        {
+            std::ofstream out( segments.back().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::app );
+            out << "half of a record";
+        }
+
+        {
+            osg::ref_ptr<Cache> cache = openCache();
+            CacheBin* tiles = cache->addBin( "tiles" );
+            REQUIRE( get(tiles, "a") == valueOf("a", 1) );
+            REQUIRE( put(tiles, "d", valueOf("d", 1)) );
+        }
+        dropIndex();
+
+        osg::ref_ptr<Cache> cache = openCache();
+        CacheBin* tiles = cache->addBin( "tiles" );
+        REQUIRE( get(tiles, "a") == valueOf("a", 1) );
+        REQUIRE( get(tiles, "d") == valueOf("d", 1) );
+    }
+
+    removeTree( ROOT );
+}
+
+TEST_CASE( "PackFileCache compaction drops dead records and keeps live ones" ) {
+
+    removeTree( ROOT );
+    {
+        osg::ref_ptr<Cache> cache = openCache();
+        CacheBin* bin = cache->addBin( "tiles" );
+
+        // two segments, then overwrite most of their records.
+        for(unsigned i=0; i<10; ++i)
+            REQUIRE( put(bin, Stringify() << "k" << i, valueOf(Stringify() << "k" << i, 1, RECORD_SIZE)) );
+        for(unsigned i=0; i<8; ++i)
+            REQUIRE( put(bin, Stringify() << "k" << i, valueOf(Stringify() << "k" << i, 2, RECORD_SIZE)) );
+
+        off_t before = cache->getApproximateSize();
+        std::string first = segmentFiles().front();
+
+        REQUIRE( cache->compact() );
+
+        REQUIRE( cache->getApproximateSize() < before );
+        REQUIRE( !osgDB::fileExists(first) );
+
+        for(unsigned i=0; i<10; ++i)
+        {
+            std::string key = Stringify() << "k" << i;
+            REQUIRE( get(bin, key) == valueOf(key, i < 8 ? 2 : 1, RECORD_SIZE) );
+        }
+    }
+
+    // the moved records are still there after a rebuild.
+    dropIndex();
+    {
+        osg::ref_ptr<Cache> cache = openCache();
+        CacheBin* bin = cache->addBin( "tiles" );
+        REQUIRE( get(bin, "k3") == valueOf("k3", 2, RECORD_SIZE) );
+        REQUIRE( get(bin, "k9") == valueOf("k9", 1, RECORD_SIZE) );
+    }
+
+    removeTree( ROOT );
+}
+
+TEST_CASE( "PackFileCache evicts the least recently used segment" ) {
+
+    removeTree( ROOT );
+    {
+        osg::ref_ptr<Cache> cache = openCache( 3u );
+        CacheBin* bin = cache->addBin( "tiles" );
+
+        // k0-k4 fill the first segment and k5-k9 the second.
+        for(unsigned i=0; i<10; ++i)
+            REQUIRE( put(bin, Stringify() << "k" << i, valueOf(Stringify() << "k" << i, 1, RECORD_SIZE)) );
+
+        // access times are in seconds, so let one go by before using the first segment.
+        OpenThreads::Thread::microSleep( 1100000 );
+        REQUIRE( get(bin, "k0") == valueOf("k0", 1, RECORD_SIZE) );
+
+        // two more segments go over the limit.
+        for(unsigned i=10; i<16; ++i)
+            REQUIRE( put(bin, Stringify() << "k" << i, valueOf(Stringify() << "k" << i, 1, RECORD_SIZE)) );
+
+        REQUIRE( cache->compact() );
+
+        REQUIRE( get(bin, "k0") == valueOf("k0", 1, RECORD_SIZE) );
+        REQUIRE( bin->getRecordStatus("k5") == CacheBin::STATUS_NOT_FOUND );
+        REQUIRE( bin->getRecordStatus("k9") == CacheBin::STATUS_NOT_FOUND );
+        REQUIRE( get(bin, "k10") == valueOf("k10", 1, RECORD_SIZE) );
+        REQUIRE( get(bin, "k15") == valueOf("k15", 1, RECORD_SIZE) );
+    }
+
+    // evicted records stay gone after a rebuild.
+    dropIndex();
+    {
+        osg::ref_ptr<Cache> cache = openCache( 3u );
+        CacheBin* bin = cache->addBin( "tiles" );
+        REQUIRE( bin->getRecordStatus("k5") == CacheBin::STATUS_NOT_FOUND );
+        REQUIRE( get(bin, "k0") == valueOf("k0", 1, RECORD_SIZE) );
+    }
+
+    removeTree( ROOT );
+}
@@ -0,0 +1,169 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarthFeatures/PreparedBoundaries>
+#include <osgEarthFeatures/FeatureListSource>
+#include <cmath>
+
+using namespace osgEarth;
+using namespace osgEarth::Symbology;
+using namespace osgEarth::Features;
+
+namespace
+{
+    // a star with many edges, so its rings get several Y bands
+    Polygon* makeStar(double cx, double cy, double r0, double r1, unsigned points)
+    {
+        Polygon* star = new Polygon();
+        for(unsigned i = 0; i < 2*points; ++i)
+        {
+            double a = osg::PI * (double)i / (double)points;
+            double r = (i % 2) ? r0 : r1;
+            star->push_back( osg::Vec3d(cx + r*cos(a), cy + r*sin(a), 0) );
+        }
+        return star;
+    }
+
+    Polygon* makeBox(double xmin, double ymin, double xmax, double ymax)
+    {
+        Polygon* box = new Polygon();
+        box->push_back( osg::Vec3d(xmin, ymin, 0) );
+        box->push_back( osg::Vec3d(xmax, ymin, 0) );
+        box->push_back( osg::Vec3d(xmax, ymax, 0) );
+        box->push_back( osg::Vec3d(xmin, ymax, 0) );
+        return box;
+    }
+
+    // Test points: a grid over the bounds plus every vertex coordinate and
+    // the band edges of each ring, where off-by-one errors would show.
+    void makePoints(const std::vector<const Ring*>& rings, std::vector<osg::Vec2d>& points)
+    {
+        Bounds b;
+        std::vector<double> xs, ys;
+        for(unsigned r = 0; r < rings.size(); ++r)
+        {
+            Bounds rb = rings[r]->getBounds();
+            b.expandBy( rb );
+
+            for(Ring::const_iterator v = rings[r]->begin(); v != rings[r]->end(); ++v)
+            {
+                xs.push_back( v->x() );
+                ys.push_back( v->y() );
+            }
+
+            // PreparedBoundaries splits a ring into about one band per 4 edges:
+            unsigned numBands = osg::maximum( (unsigned)rings[r]->size() / 4u, 1u );
+            for(unsigned k = 0; k <= numBands; ++k)
+                ys.push_back( rb.yMin() + (rb.yMax() - rb.yMin()) * (double)k / (double)numBands );
+        }
+
+        for(unsigned i = 0; i <= 40; ++i)
+        {
+            xs.push_back( b.xMin() - 1.0 + (b.width() + 2.0) * (double)i / 40.0 );
+            ys.push_back( b.yMin() - 1.0 + (b.height() + 2.0) * (double)i / 40.0 );
+        }
+
+        for(unsigned i = 0; i < xs.size(); ++i)
+            for(unsigned j = 0; j < ys.size(); ++j)
+                points.push_back( osg::Vec2d(xs[i], ys[j]) );
+    }
+}
+
+TEST_CASE("PreparedBoundaries matches Polygon::contains2D") {
+    osg::ref_ptr<Polygon> star = makeStar(0, 0, 4, 10, 24);
+    osg::ref_ptr<Ring> hole = makeStar(0, 0, 1, 3, 12);
+    hole->rewind( Ring::ORIENTATION_CW );
+    star->getHoles().push_back( hole.get() );
+
+    osg::ref_ptr<Polygon> box = makeBox(20, -5, 30, 5);
+
+    osg::ref_ptr<MultiGeometry> multi = new MultiGeometry();
+    multi->add( star.get() );
+    multi->add( box.get() );
+
+    osg::ref_ptr<PreparedBoundaries> prepared = new PreparedBoundaries();
+    prepared->add( multi.get() );
+    prepared->build();
+    REQUIRE( prepared->getNumPolygons() == 2u );
+
+    std::vector<const Ring*> rings;
+    rings.push_back( star.get() );
+    rings.push_back( hole.get() );
+    rings.push_back( box.get() );
+    std::vector<osg::Vec2d> points;
+    makePoints( rings, points );
+
+    std::vector<bool> results;
+    prepared->contains( points, results );
+    REQUIRE( results.size() == points.size() );
+
+    unsigned numInside = 0u, numMismatches = 0u;
+    std::vector<unsigned> hits;
+    for(unsigned i = 0; i < points.size(); ++i)
+    {
+        double x = points[i].x(), y = points[i].y();
+        bool expected = star->contains2D(x, y) || box->contains2D(x, y);
+        if ( expected )
+            ++numInside;
+        if ( results[i] != expected || prepared->contains(x, y, hits) != expected )
+            ++numMismatches;
+    }
+
+    // make sure the points exercise both outcomes:
+    REQUIRE( numInside > 0u );
+    REQUIRE( numInside < points.size() );
+    REQUIRE( numMismatches == 0u );
+
+    SECTION("points in the hole are outside") {
+        REQUIRE( !prepared->contains(0.0, 0.0, hits) );
+        REQUIRE( prepared->contains(6.0, 0.0, hits) );
+    }
+}
+
+TEST_CASE("PreparedBoundariesCache prepares a source again when it changes") {
+    osg::ref_ptr<FeatureListSource> source = new FeatureListSource();
+    const SpatialReference* srs = osgEarth::SpatialReference::create("wgs84");
+    source->insertFeature( new Feature(makeBox(0, 0, 10, 10), srs, Style(), 1) );
+
+    osg::ref_ptr<PreparedBoundariesCache> cache = new PreparedBoundariesCache( source.get() );
+    GeoExtent extent(srs, -180, -90, 180, 90);
+    std::vector<unsigned> hits;
+
+    osg::ref_ptr<PreparedBoundaries> first = cache->get( extent, srs );
+    REQUIRE( first->getNumPolygons() == 1u );
+    REQUIRE( first->contains(5, 5, hits) );
+    REQUIRE( !first->contains(25, 5, hits) );
+
+    SECTION("and not otherwise") {
+        REQUIRE( cache->get(extent, srs).get() == first.get() );
+    }
+
+    SECTION("as when a feature is inserted") {
+        source->insertFeature( new Feature(makeBox(20, 0, 30, 10), srs, Style(), 2) );
+        osg::ref_ptr<PreparedBoundaries> second = cache->get( extent, srs );
+        REQUIRE( second.get() != first.get() );
+        REQUIRE( second->getNumPolygons() == 2u );
+        REQUIRE( second->contains(25, 5, hits) );
+    }
+}
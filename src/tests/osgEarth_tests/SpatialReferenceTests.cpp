@@ -90,3 +90,77 @@ TEST_CASE("Plate Carre SpatialReferences can be created") {
     REQUIRE(!plateCarre->isGeodetic());
     REQUIRE(plateCarre->isProjected());
 }
+
+namespace
+{
+    // lon/lat grid covering the mercator range, including the antimeridian
+    std::vector<osg::Vec3d> makeGeographicGrid()
+    {
+        std::vector<osg::Vec3d> points;
+        for (double lat = -85.0; lat <= 85.0; lat += 8.5)
+            for (double lon = -180.0; lon <= 180.0; lon += 7.5)
+                points.push_back(osg::Vec3d(lon, lat, 100.0));
+        return points;
+    }
+}
+
+TEST_CASE("Native transforms agree with OGR") {
+    osg::ref_ptr< const SpatialReference > wgs84 = SpatialReference::create("wgs84");
+    osg::ref_ptr< const SpatialReference > merc = SpatialReference::create("spherical-mercator");
+
+    // Same projection in km, which the native path does not recognize, so OGR does the math.
+    osg::ref_ptr< const SpatialReference > mercKM = SpatialReference::create(
+        "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=km +nadgrids=@null +wktext +no_defs");
+    REQUIRE(mercKM.valid());
+
+    const std::vector<osg::Vec3d> geo = makeGeographicGrid();
+
+    SECTION("Geographic to spherical mercator") {
+        std::vector<osg::Vec3d> fast = geo, ogr = geo;
+        REQUIRE(wgs84->transform(fast, merc.get()));
+        REQUIRE(wgs84->transform(ogr, mercKM.get()));
+        for (unsigned i = 0; i < geo.size(); ++i) {
+            REQUIRE(fabs(fast[i].x() - ogr[i].x()*1000.0) < 1e-6);
+            REQUIRE(fabs(fast[i].y() - ogr[i].y()*1000.0) < 1e-6);
+        }
+    }
+
+    SECTION("Spherical mercator to geographic") {
+        std::vector<osg::Vec3d> fast = geo;
+        REQUIRE(wgs84->transform(fast, merc.get()));
+        std::vector<osg::Vec3d> ogr = fast;
+        for (unsigned i = 0; i < ogr.size(); ++i)
+            ogr[i].set(ogr[i].x()/1000.0, ogr[i].y()/1000.0, ogr[i].z());
+
+        REQUIRE(merc->transform(fast, wgs84.get()));
+        REQUIRE(mercKM->transform(ogr, wgs84.get()));
+        for (unsigned i = 0; i < geo.size(); ++i) {
+            REQUIRE(fabs(fast[i].x() - ogr[i].x()) < 1e-9);
+            REQUIRE(fabs(fast[i].y() - ogr[i].y()) < 1e-9);
+            REQUIRE(fabs(fast[i].y() - geo[i].y()) < 1e-9);
+        }
+    }
+
+    SECTION("Geographic to geocentric and back") {
+        const osg::EllipsoidModel* em = wgs84->getEllipsoid();
+        std::vector<osg::Vec3d> ecef = geo;
+        REQUIRE(wgs84->transform(ecef, wgs84->getGeocentricSRS()));
+        for (unsigned i = 0; i < geo.size(); ++i) {
+            double x, y, z;
+            em->convertLatLongHeightToXYZ(
+                osg::DegreesToRadians(geo[i].y()), osg::DegreesToRadians(geo[i].x()), geo[i].z(), x, y, z);
+            REQUIRE(fabs(ecef[i].x() - x) < 1e-6);
+            REQUIRE(fabs(ecef[i].y() - y) < 1e-6);
+            REQUIRE(fabs(ecef[i].z() - z) < 1e-6);
+        }
+
+        REQUIRE(wgs84->getGeocentricSRS()->transform(ecef, wgs84.get()));
+        for (unsigned i = 0; i < geo.size(); ++i) {
+            // the antimeridian may come back as either +180 or -180
+            if (fabs(geo[i].x()) < 180.0)
+                REQUIRE(fabs(ecef[i].x() - geo[i].x()) < 1e-9);
+            REQUIRE(fabs(ecef[i].y() - geo[i].y()) < 1e-9);
+            REQUIRE(fabs(ecef[i].z() - geo[i].z()) < 1e-6);
+        }
+    }
+}
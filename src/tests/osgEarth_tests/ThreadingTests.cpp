@@ -132,4 +132,48 @@ TEST_CASE( "ReadWriteMutex can handle multiple read locks from the same thread w
     REQUIRE(!thread2.isRunning());
     REQUIRE(elapsedTime < maxTimeSeconds);
 }
-*/
\ No newline at end of file
+*/
+TEST_CASE( "SingleFlight shares the leader's result with followers" ) {
+
+    typedef Threading::SingleFlight<std::string, int> Table;
+    Table table;
+
+    SECTION("Followers get the resolved result") {
+        Table::Scope leader(table, "a");
+        Table::Scope follower(table, "a");
+        REQUIRE(leader.isLeader());
+        REQUIRE(!follower.isLeader());
+        REQUIRE(!follower.wait(0u));
+
+        leader.resolve(42);
+        REQUIRE(follower.wait(0u));
+        REQUIRE(follower.succeeded());
+        REQUIRE(follower.result() == 42);
+
+        // the finished flight no longer coalesces new requests:
+        Table::Scope next(table, "a");
+        REQUIRE(next.isLeader());
+    }
+
+    SECTION("Followers wake up when the leader abandons the request") {
+        Table::Scope* leader = new Table::Scope(table, "b");
+        Table::Scope follower(table, "b");
+        delete leader;
+        REQUIRE(follower.wait(0u));
+        REQUIRE(!follower.succeeded());
+    }
+
+    SECTION("Closing counts the followers and lets new callers lead") {
+        Table::Scope leader(table, "c");
+        Table::Scope follower(table, "c");
+        REQUIRE(leader.close() == 1u);
+
+        Table::Scope next(table, "c");
+        REQUIRE(next.isLeader());
+        next.resolve(7);
+
+        leader.resolve(42);
+        REQUIRE(follower.result() == 42);
+        REQUIRE(next.close() == 0u);
+    }
+}
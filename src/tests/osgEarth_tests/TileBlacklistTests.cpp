@@ -0,0 +1,82 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileSource>
+#include <osgEarth/Registry>
+#include <sstream>
+
+using namespace osgEarth;
+
+TEST_CASE( "TileBlacklist infers empty descendants" ) {
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    osg::ref_ptr<TileBlacklist> blacklist = new TileBlacklist();
+    REQUIRE( !blacklist->getInherit() );
+    blacklist->setInherit( true );
+
+    blacklist->add( TileKey(3, 4, 2, profile) );
+    REQUIRE( blacklist->contains(TileKey(3, 4, 2, profile)) );
+    REQUIRE( blacklist->contains(TileKey(6, 4*8+5, 2*8+1, profile)) );
+    REQUIRE( !blacklist->contains(TileKey(6, 5*8, 2*8, profile)) );
+    REQUIRE( !blacklist->contains(TileKey(2, 2, 1, profile)) );
+    REQUIRE( blacklist->getNumHits() == 1u );
+    REQUIRE( blacklist->getNumInferredHits() == 1u );
+
+    SECTION( "but not from errors" ) {
+        blacklist->clear();
+        blacklist->add( TileKey(3, 4, 2, profile), TileBlacklist::REASON_ERROR );
+
+        TileBlacklist::Reason reason;
+        REQUIRE( blacklist->contains(TileKey(3, 4, 2, profile), reason) );
+        REQUIRE( reason == TileBlacklist::REASON_ERROR );
+        REQUIRE( !blacklist->contains(TileKey(4, 8, 4, profile)) );
+    }
+
+    SECTION( "unless inheritance is off" ) {
+        blacklist->setInherit( false );
+        REQUIRE( !blacklist->contains(TileKey(6, 4*8+5, 2*8+1, profile)) );
+    }
+}
+
+TEST_CASE( "TileBlacklist round-trips entries and drops expired ones" ) {
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+    osg::ref_ptr<TileBlacklist> blacklist = new TileBlacklist();
+    blacklist->add( TileKey(5, 10, 7, profile) );
+    blacklist->add( TileKey(5, 11, 7, profile), TileBlacklist::REASON_ERROR );
+
+    std::stringstream buf;
+    blacklist->write( buf );
+    // an entry in the original "lod x y" format, and one that has expired:
+    buf << "4 1 1\n" << "5 12 7 1000 0\n";
+
+    osg::ref_ptr<TileBlacklist> copy = TileBlacklist::read( buf );
+    TileBlacklist::Reason reason;
+    REQUIRE( copy->contains(TileKey(5, 10, 7, profile), reason) );
+    REQUIRE( reason == TileBlacklist::REASON_NO_DATA );
+    REQUIRE( copy->contains(TileKey(5, 11, 7, profile), reason) );
+    REQUIRE( reason == TileBlacklist::REASON_ERROR );
+    REQUIRE( copy->contains(TileKey(4, 1, 1, profile)) );
+    REQUIRE( !copy->contains(TileKey(5, 12, 7, profile)) );
+}
@@ -0,0 +1,75 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/TileKey>
+#include <osgEarth/Registry>
+
+using namespace osgEarth;
+
+TEST_CASE( "TileKey" ) {
+
+    const Profile* profile = Registry::instance()->getGlobalGeodeticProfile();
+
+    SECTION("String form is lod/x/y") {
+        REQUIRE(TileKey(0, 1, 0, profile).str() == "0/1/0");
+        REQUIRE(TileKey(12, 4095, 1234, profile).str() == "12/4095/1234");
+        REQUIRE(TileKey::INVALID.str() == "invalid");
+    }
+
+    SECTION("Packed IDs are unique within a profile") {
+        TileKey a(5, 10, 3, profile);
+        TileKey b(5, 3, 10, profile);
+        TileKey c(6, 10, 3, profile);
+        REQUIRE(a.getId() != b.getId());
+        REQUIRE(a.getId() != c.getId());
+        REQUIRE(a == TileKey(5, 10, 3, profile));
+        REQUIRE(a != b);
+    }
+
+    SECTION("Keys sort by LOD first") {
+        REQUIRE(TileKey(3, 7, 7, profile) < TileKey(4, 0, 0, profile));
+        REQUIRE(!(TileKey(4, 0, 0, profile) < TileKey(3, 7, 7, profile)));
+    }
+
+    SECTION("Parent, child and neighbor keys round trip") {
+        TileKey key(8, 301, 77, profile);
+        for(unsigned q=0; q<4; ++q)
+        {
+            TileKey child = key.createChildKey(q);
+            REQUIRE(child.getQuadrant() == q);
+            REQUIRE(child.createParentKey() == key);
+        }
+        REQUIRE(key.createNeighborKey(1, -1).createNeighborKey(-1, 1) == key);
+        REQUIRE(key.createAncestorKey(0).getLOD() == 0u);
+    }
+
+    SECTION("TileKeyMap finds keys by value") {
+        TileKeyMap<int>::type map;
+        map[TileKey(2, 1, 1, profile)] = 1;
+        map[TileKey(2, 1, 2, profile)] = 2;
+        REQUIRE(map.size() == 2u);
+        REQUIRE(map[TileKey(2, 1, 2, profile)] == 2);
+        REQUIRE(map.find(TileKey(2, 2, 1, profile)) == map.end());
+    }
+}
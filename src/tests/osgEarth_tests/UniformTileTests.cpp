@@ -0,0 +1,105 @@
+/* -*-c++-*- */
+/* osgEarth - Dynamic map generation toolkit for OpenSceneGraph
+* Copyright 2016 Pelican Mapping
+* http://osgearth.org
+*
+* osgEarth is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+*
+* You should have received a copy of the GNU Lesser General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <osgEarth/catch.hpp>
+
+#include <osgEarth/UniformTile>
+#include <osgEarth/ImageUtils>
+#include <osg/Image>
+#include <osg/Shape>
+#include <osgDB/Registry>
+#include <cstring>
+#include <sstream>
+
+using namespace osgEarth;
+
+TEST_CASE( "UniformTile round-trips a solid image" ) {
+
+    osg::ref_ptr<osg::Image> image = new osg::Image();
+    image->allocateImage(256, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+    for(unsigned i=0; i<256*256; ++i)
+    {
+        unsigned char* p = image->data() + i*4;
+        p[0] = 10; p[1] = 20; p[2] = 200; p[3] = 255;
+    }
+
+    REQUIRE( ImageUtils::isUniformImage(image.get()) );
+
+    std::string desc;
+    REQUIRE( UniformTile::encode(image.get(), desc) );
+    REQUIRE( desc.size() < 64u );
+    REQUIRE( UniformTile::isDescriptor(desc.data(), desc.size()) );
+
+    osg::ref_ptr<osg::Image> out = dynamic_cast<osg::Image*>(UniformTile::decode(desc.data(), desc.size()));
+    REQUIRE( out.valid() );
+    REQUIRE( out->s() == 256 );
+    REQUIRE( out->t() == 256 );
+    REQUIRE( out->getPixelFormat() == image->getPixelFormat() );
+    REQUIRE( ::memcmp(out->data(), image->data(), image->getTotalSizeInBytes()) == 0 );
+
+    SECTION( "but not an image with one odd pixel" ) {
+        image->data(255, 255)[0] = 11;
+        REQUIRE( !ImageUtils::isUniformImage(image.get()) );
+        REQUIRE( !UniformTile::encode(image.get(), desc) );
+    }
+
+    SECTION( "but not an image that carries user data" ) {
+        ImageUtils::markAsUnNormalized(image.get(), true);
+        REQUIRE( !UniformTile::encode(image.get(), desc) );
+
+        // the caches then store it as OSGB, which keeps the flag.
+        osgDB::ReaderWriter* rw = osgDB::Registry::instance()->getReaderWriterForExtension("osgb");
+        if ( rw )
+        {
+            std::stringstream buf;
+            REQUIRE( rw->writeImage(*image.get(), buf).success() );
+            osgDB::ReaderWriter::ReadResult r = rw->readImage(buf);
+            REQUIRE( r.validImage() );
+            REQUIRE( ImageUtils::isUnNormalized(r.getImage()) );
+        }
+    }
+}
+
+TEST_CASE( "UniformTile round-trips a flat heightfield" ) {
+
+    osg::ref_ptr<osg::HeightField> hf = new osg::HeightField();
+    hf->allocate(17, 17);
+    hf->setOrigin(osg::Vec3(-10.0f, 20.0f, 0.0f));
+    hf->setXInterval(0.5f);
+    hf->setYInterval(0.25f);
+    for(unsigned i=0; i<hf->getFloatArray()->size(); ++i)
+        (*hf->getFloatArray())[i] = -32768.0f;
+
+    std::string desc;
+    REQUIRE( UniformTile::encode(hf.get(), desc) );
+
+    osg::ref_ptr<osg::HeightField> out = dynamic_cast<osg::HeightField*>(UniformTile::decode(desc.data(), desc.size()));
+    REQUIRE( out.valid() );
+    REQUIRE( out->getNumColumns() == 17u );
+    REQUIRE( out->getNumRows() == 17u );
+    REQUIRE( out->getXInterval() == 0.5f );
+    REQUIRE( out->getHeight(8, 8) == -32768.0f );
+
+    // an OSGB stream is never mistaken for a descriptor
+    const char osgb[] = { (char)0x6C, (char)0xD6, (char)0xDA, (char)0xFB, 0, 0, 0, 0 };
+    REQUIRE( !UniformTile::isDescriptor(osgb, sizeof(osgb)) );
+}